@@ -0,0 +1,71 @@
+#include <algorithm>
+
+#include "accumulation.h"
+
+namespace accumulation {
+  static float luminance(FXMVECTOR color) {
+    return XMVectorGetX(XMVector3Dot(color, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f)));
+  }
+
+  uint64_t hash(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    for (size_t i = 0; i < size; ++i) {
+      seed = (seed ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    return seed;
+  }
+
+  bool begin_frame(State& state, uint64_t key, Settings settings) {
+    if (!settings.enabled || key != state.key) {
+      state = {
+        .key = key,
+      };
+    }
+
+    if (settings.enabled && settings.max_samples > 0 && state.sample_count >= settings.max_samples) {
+      state.converged = true;
+    }
+
+    return !state.converged;
+  }
+
+  void end_frame(State& state) {
+    state.sample_count++;
+  }
+
+  void report_error(State& state, uint64_t key, uint32_t sample_count, uint32_t unconverged_pixels, Settings settings) {
+    if (settings.enabled && settings.target_error > 0.0f && key == state.key && sample_count >= MIN_ERROR_SAMPLES && unconverged_pixels == 0) {
+      state.converged = true;
+    }
+  }
+
+  float correlation_length(uint32_t max_history_length, uint32_t indirect_stride) {
+    return std::max(CORRELATION_PER_HISTORY_FRAME * (float)max_history_length, (float)indirect_stride);
+  }
+
+  void accumulate(Pixel& pixel, XMFLOAT3 color, uint32_t sample_count) {
+    XMVECTOR x = XMLoadFloat3(&color);
+    XMVECTOR mean = sample_count > 0 ? XMLoadFloat3(&pixel.mean) : XMVectorZero();
+    float m2 = sample_count > 0 ? pixel.m2 : 0.0f;
+
+    XMVECTOR new_mean = mean + (x - mean) / (float)(sample_count + 1);
+    float l = luminance(x);
+
+    XMStoreFloat3(&pixel.mean, new_mean);
+    pixel.m2 = m2 + (l - luminance(mean)) * (l - luminance(new_mean));
+  }
+
+  bool converged(const Pixel& pixel, uint32_t sample_count, float target_error, float correlation_length) {
+    if (sample_count < 2) {
+      return false;
+    }
+
+    float n = (float)sample_count;
+    float variance_of_mean = pixel.m2 / (n * (n - 1.0f)) * std::max(correlation_length, 1.0f);
+    float tolerance = target_error * (luminance(XMLoadFloat3(&pixel.mean)) + 1e-3f);
+
+    return variance_of_mean <= tolerance * tolerance;
+  }
+};
\ No newline at end of file
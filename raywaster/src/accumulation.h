@@ -0,0 +1,60 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <stdint.h>
+
+using namespace DirectX;
+
+// averages frames while nothing that affects the image changes, and stops rendering once the average has converged
+namespace accumulation {
+  // the error readback is only trusted after this many frames, fewer don't give a usable variance
+  static constexpr uint32_t MIN_ERROR_SAMPLES = 16;
+
+  // frames of correlation per frame of reservoir history, the accumulation_stopping check measures welford's
+  // variance of the mean coming out about 1.5 times max_history_length too small
+  static constexpr float CORRELATION_PER_HISTORY_FRAME = 1.5f;
+
+  struct Settings {
+    bool enabled;
+    uint32_t max_samples; // stop after this many frames, zero never stops on the count
+    float target_error;   // stop once no pixel's standard error is above this fraction of its luminance, zero never does
+  };
+
+  static constexpr Settings DEFAULT_SETTINGS = {
+    .enabled = true,
+    .max_samples = 4096,
+    .target_error = 0.01f,
+  };
+
+  struct State {
+    uint64_t key;
+    uint32_t sample_count; // frames already in the accumulation buffer
+    bool converged;
+  };
+
+  // running mean and sum of squared luminance deviations, as stored in the accumulation buffer
+  struct Pixel {
+    XMFLOAT3 mean;
+    float m2;
+  };
+
+  // fnv-1a, chain calls through seed to hash several things together
+  uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+  // starts over when the key changed. returns false once converged, the frame shouldn't be rendered
+  bool begin_frame(State& state, uint64_t key, Settings settings);
+  void end_frame(State& state);
+
+  // how many pixels were above the target error after sample_count frames accumulated under key.
+  // readbacks arrive late, ones from before the last reset are ignored
+  void report_error(State& state, uint64_t key, uint32_t sample_count, uint32_t unconverged_pixels, Settings settings);
+
+  // welford's variance assumes independent frames, but reservoirs carry a sample on for about max_history_length
+  // frames and strided pixels repeat their indirect path for stride. how many times too small that makes it
+  float correlation_length(uint32_t max_history_length, uint32_t indirect_stride);
+
+  // same as lighting_cs, welford's update of sample sample_count
+  void accumulate(Pixel& pixel, XMFLOAT3 color, uint32_t sample_count);
+  bool converged(const Pixel& pixel, uint32_t sample_count, float target_error, float correlation_length);
+};
\ No newline at end of file
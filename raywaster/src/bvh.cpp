@@ -12,6 +12,7 @@ namespace bvh {
     XMVECTOR min;
     XMVECTOR max;
     uint32_t index;
+    uint32_t base_vertex;
   };
 
   template<size_t A>
@@ -87,6 +88,7 @@ namespace bvh {
         .min = minf3,
         .max = maxf3,
         .left = tris[0].index | (1 << 31), // mark as leaf
+        .right = tris[0].base_vertex,
       });
 
       return index;
@@ -127,26 +129,31 @@ namespace bvh {
     return index;
   }
 
-  std::vector<Node> construct_bvh(const std::vector<XMFLOAT3>& positions, const std::vector<uint32_t>& indices) {
+  std::vector<Node> construct_bvh(const Mesh& mesh) {
     std::vector<Tri> tris;
-    tris.reserve(indices.size()/3);
+    tris.reserve(mesh.indices.size()/3);
 
-    for (uint32_t i = 0; i < indices.size()/3; ++i) {
-      XMVECTOR a = XMLoadFloat3(&positions[indices[i*3+0]]);
-      XMVECTOR b = XMLoadFloat3(&positions[indices[i*3+1]]);
-      XMVECTOR c = XMLoadFloat3(&positions[indices[i*3+2]]);
+    for (auto& segment : mesh.segments) {
+      const XMFLOAT3* positions = mesh.positions.data() + segment.base_vertex;
 
-      XMVECTOR center = (a + b + c) / 3.0f;
+      for (uint32_t i = segment.first_index/3; i < (segment.first_index + segment.index_count)/3; ++i) {
+        XMVECTOR a = XMLoadFloat3(&positions[mesh.indices[i*3+0]]);
+        XMVECTOR b = XMLoadFloat3(&positions[mesh.indices[i*3+1]]);
+        XMVECTOR c = XMLoadFloat3(&positions[mesh.indices[i*3+2]]);
 
-      XMVECTOR min = XMVectorMin(a, XMVectorMin(b, c));
-      XMVECTOR max = XMVectorMax(a, XMVectorMax(b, c));
+        XMVECTOR center = (a + b + c) / 3.0f;
 
-      tris.push_back(Tri{
-        .center = center,
-        .min = min,
-        .max = max,
-        .index = i,
-      });
+        XMVECTOR min = XMVectorMin(a, XMVectorMin(b, c));
+        XMVECTOR max = XMVectorMax(a, XMVectorMax(b, c));
+
+        tris.push_back(Tri{
+          .center = center,
+          .min = min,
+          .max = max,
+          .index = i,
+          .base_vertex = segment.base_vertex,
+        });
+      }
     }
 
     std::vector<Node> nodes;
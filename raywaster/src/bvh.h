@@ -5,9 +5,12 @@
 #include <variant>
 #include <vector>
 
+#include "model.h"
+
 using namespace DirectX;
 
 namespace bvh {
+  // leaves have the top bit of left set, the rest is the triangle index and right is the base vertex of its segment
   struct Node {
     XMFLOAT3 min;
     XMFLOAT3 max;
@@ -15,6 +18,6 @@ namespace bvh {
     uint32_t right;
   };
 
-  std::vector<Node> construct_bvh(const std::vector<XMFLOAT3>& positions, const std::vector<uint32_t>& indices);
+  std::vector<Node> construct_bvh(const Mesh& mesh);
 };
 
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+
+#include "restir.h"
+#include "trace.h"
+
+// headless checks of the cpu references against what their commits claim, run by checks_main.cpp.
+// each prints what it measured and returns false when that's outside the expected range
+namespace checks {
+  // an octahedral sky with a gradient, a bright band and a small sun, already split into lights and the residual
+  struct Sky {
+    std::vector<hdri::Image> mips;
+    hdri::Distribution2D distribution;
+    std::vector<hdri::DiskLight> lights;
+
+    restir::Environment environment() const;
+  };
+
+  Sky make_sky(uint32_t size);
+
+  // what a static camera sees of a plane whose normal tilts across the columns, so every column has its own
+  // reference and every row shares it
+  std::vector<restir::Surface> make_tilted_plane(uint32_t width, uint32_t height, XMMATRIX* view_proj);
+
+  // brute force over every texel of the top mip, what a reservoir's luminance times cosine converges to
+  double integrate_target(const restir::Environment& env, FXMVECTOR origin, FXMVECTOR normal, const restir::VisibilityFn& visible);
+
+  // a 10x10 floor at y = 0 and a 4 high wall facing -x along x = 1
+  struct FloorAndWall {
+    Mesh mesh;
+    std::vector<bvh::Node> nodes;
+
+    trace::Scene scene() const;
+  };
+
+  FloorAndWall make_floor_and_wall();
+
+  // a and b and c and d counter clockwise seen from the front, appended to the mesh's 32 bit indices
+  void add_quad(Mesh& mesh, XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c, XMFLOAT3 d, XMFLOAT3 normal);
+
+  // size x size quads of rolling hills over the same 10x10 as make_floor_and_wall, in one segment
+  Mesh make_heightfield(uint32_t size);
+
+  // what a camera ray through each texel corner hits, the way reservoir1_cs reconstructs surfaces. depth 0 where it misses
+  std::vector<restir::Surface> trace_surfaces(const trace::Scene& scene, FXMMATRIX view_proj, uint32_t width, uint32_t height);
+
+  // hdri
+  bool hdr_decode();
+  bool hdri_encode();
+
+  // restir
+  bool temporal_reuse();
+  bool spatial_reuse();
+  bool reservoir_packing();
+
+  // sampler
+  bool sampler_convergence();
+
+  // pathtrace
+  bool indirect_paths();
+  bool indirect_reprojection();
+
+  // trace
+  bool traversal_per_pixel();
+
+  // accumulation
+  bool accumulation_stopping();
+
+  // denoise
+  bool denoise_convergence();
+
+  // upsample
+  bool upsample_edges();
+
+  // reference
+  bool reference_throughput();
+};
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "checks.h"
+#include "accumulation.h"
+
+namespace checks {
+  // the reservoirs on the tilted plane accumulated the way lighting_cs does, until every pixel claims its
+  // standard error is within the target. frames share samples through temporal reuse, so without the correlation
+  // length welford's claim should be wrong for more pixels than noise explains, and with it for none
+  bool accumulation_stopping() {
+    Sky sky = make_sky(128);
+    restir::Environment env = sky.environment();
+
+    uint32_t width = 32;
+    uint32_t height = 32;
+    float target_error = 0.05f;
+
+    XMMATRIX view_proj;
+    std::vector<restir::Surface> surfaces = make_tilted_plane(width, height, &view_proj);
+
+    restir::VisibilityFn unoccluded = [](size_t, FXMVECTOR, FXMVECTOR) { return true; };
+
+    std::vector<double> reference(width);
+
+    for (uint32_t x = 0; x < width; ++x) {
+      reference[x] = integrate_target(env, XMVectorZero(), XMLoadFloat3(&surfaces[x].normal), unoccluded);
+    }
+
+    restir::TemporalSettings temporal = restir::DEFAULT_TEMPORAL_SETTINGS;
+    bool passed = true;
+
+    for (float correlation_length : { 1.0f, accumulation::correlation_length(temporal.max_history_length, 1) }) {
+      std::vector<restir::Reservoir> previous(surfaces.size());
+      std::vector<restir::Reservoir> current(surfaces.size());
+      std::vector<accumulation::Pixel> accumulated(surfaces.size());
+
+      accumulation::Settings settings = accumulation::DEFAULT_SETTINGS;
+      settings.target_error = target_error;
+
+      accumulation::State state = {};
+
+      while (accumulation::begin_frame(state, 1, settings)) {
+        uint32_t sample_count = state.sample_count;
+
+        restir::resample_frame(env, width, height, sample_count + 1, surfaces.data(), surfaces.data(), sample_count > 0 ? previous.data() : nullptr,
+                               view_proj, temporal, { .type = sampler::Type::SOBOL, .blue_noise = nullptr }, unoccluded, current.data());
+
+        uint32_t unconverged = 0;
+
+        for (size_t i = 0; i < current.size(); ++i) {
+          float value = current[i].cosine * current[i].contribution;
+          accumulation::accumulate(accumulated[i], XMFLOAT3(value, value, value), sample_count);
+
+          unconverged += !accumulation::converged(accumulated[i], sample_count + 1, target_error, correlation_length);
+          previous[i] = restir::unpack(restir::pack(current[i]));
+        }
+
+        accumulation::end_frame(state);
+        accumulation::report_error(state, 1, state.sample_count, unconverged, settings);
+      }
+
+      double squared = 0.0;
+      double estimated = 0.0;
+      uint32_t outside = 0; // off by more than 3 times the target, 0.27% of pixels if their standard error really is within it
+      double n = (double)state.sample_count;
+
+      for (size_t i = 0; i < accumulated.size(); ++i) {
+        double expected = reference[i % width];
+        double relative = (accumulated[i].mean.x - expected) / expected;
+
+        squared += relative * relative;
+        outside += std::abs(relative) > 3.0 * target_error;
+        estimated += accumulated[i].m2 / (n * (n - 1.0)) / (expected * expected);
+      }
+
+      double error = std::sqrt(squared / (double)accumulated.size());
+      double underestimate = squared / estimated;
+
+      std::cout << std::format("  correlation length {:4.1f}: stopped after {:4} frames, relative rmse {:.4f}, welford {:.1f} times too small, {} pixels off by 3 times the target\n",
+                               correlation_length, state.sample_count, error, underestimate, outside);
+
+      if (correlation_length > 1.0f) {
+        passed &= outside <= accumulated.size() * 3 / 1000 && error < target_error && underestimate > correlation_length * 0.5f && underestimate < correlation_length * 2.0f;
+      }
+      else {
+        passed &= outside > accumulated.size() * 3 / 1000;
+      }
+    }
+
+    return passed;
+  }
+};
\ No newline at end of file
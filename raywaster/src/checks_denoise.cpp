@@ -0,0 +1,101 @@
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "checks.h"
+#include "denoise.h"
+
+namespace checks {
+  // two planes at different depths and orientations with a strip of sky above, lit by a gradient on the
+  // left and flat on the right, under exponential noise like a single sample per pixel. the denoised error should
+  // drop by more than an order of magnitude on the first frame and keep dropping, without bleeding across the edge
+  bool denoise_convergence() {
+    uint32_t width = 640;
+    uint32_t height = 360;
+    uint32_t sky_rows = 20;
+
+    std::vector<restir::Surface> surfaces((size_t)width * height);
+    std::vector<float> truth(surfaces.size());
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        size_t i = (size_t)y * width + x;
+
+        float ndc_x = ((float)x + 0.5f) / (float)width * 2.0f - 1.0f;
+        float ndc_y = ((float)y + 0.5f) / (float)height * -2.0f + 1.0f;
+
+        bool left = x < width / 2;
+        float depth = y < sky_rows ? 0.0f : left ? 5.0f : 10.0f;
+
+        surfaces[i] = {
+          .position = XMFLOAT3(ndc_x * depth, ndc_y * depth, depth),
+          .normal = left ? XMFLOAT3(0.0f, 0.0f, -1.0f) : XMFLOAT3(0.6f, 0.0f, -0.8f),
+          .depth = depth,
+        };
+
+        truth[i] = depth <= 0.0f ? 0.0f : left ? 0.5f + 0.5f * (float)x / (float)width : 0.2f;
+      }
+    }
+
+    // projects position to (x, y) / z with w = z, which maps the planes back onto the pixels they came from
+    XMMATRIX view_proj = XMMatrixIdentity();
+    view_proj.r[2] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+    view_proj.r[3] = XMVectorZero();
+
+    auto rmse = [&](const std::vector<XMFLOAT3>& image, bool edge_only) {
+      double squared = 0.0;
+      size_t count = 0;
+
+      for (uint32_t y = sky_rows; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          if (edge_only && (x + 3 < width / 2 || x > width / 2 + 2)) {
+            continue;
+          }
+
+          size_t i = (size_t)y * width + x;
+          double d = image[i].x - truth[i];
+
+          squared += d * d;
+          count++;
+        }
+      }
+
+      return std::sqrt(squared / (double)count);
+    };
+
+    std::mt19937 rng(7);
+    std::exponential_distribution<float> noise(1.0f);
+
+    denoise::History history = {};
+    std::vector<XMFLOAT3> input(surfaces.size());
+    std::vector<XMFLOAT3> output(surfaces.size());
+
+    double input_error = 0.0;
+    double first_error = 0.0;
+    double last_error = 0.0;
+    double last_edge_error = 0.0;
+
+    for (uint32_t frame = 1; frame <= 16; ++frame) {
+      for (size_t i = 0; i < input.size(); ++i) {
+        float value = truth[i] * noise(rng);
+        input[i] = XMFLOAT3(value, value, value);
+      }
+
+      denoise::denoise_frame(width, height, surfaces.data(), input.data(), view_proj, denoise::DEFAULT_SETTINGS, history, output.data());
+
+      input_error = rmse(input, false);
+      last_error = rmse(output, false);
+      last_edge_error = rmse(output, true);
+      first_error = frame == 1 ? last_error : first_error;
+
+      if (frame == 1 || frame == 2 || frame == 4 || frame == 8 || frame == 16) {
+        std::cout << std::format("  frame {:2}: input rmse {:.4f}, denoised {:.4f}, within 3 pixels of the edge {:.4f}\n",
+                                 frame, input_error, last_error, last_edge_error);
+      }
+    }
+
+    return first_error < input_error * 0.1 && last_error < first_error * 0.5 && last_edge_error < 0.05;
+  }
+};
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include <chrono>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <DirectXPackedVector.h>
+
+#include "checks.h"
+#include "radiance.h"
+#include "hdri_encode.h"
+#include "stb_image.h"
+
+using namespace DirectX::PackedVector;
+
+// new style rle for one channel of a scanline, runs of 3 or more and literals in between
+static void write_rle(std::vector<uint8_t>& out, const uint8_t* values, size_t count) {
+  size_t x = 0;
+
+  while (x < count) {
+    size_t run = 1;
+
+    while (x + run < count && run < 127 && values[x + run] == values[x]) {
+      ++run;
+    }
+
+    if (run >= 3) {
+      out.push_back((uint8_t)(128 + run));
+      out.push_back(values[x]);
+      x += run;
+      continue;
+    }
+
+    size_t start = x;
+
+    while (x < count && x - start < 128 && !(x + 2 < count && values[x] == values[x + 1] && values[x] == values[x + 2])) {
+      ++x;
+    }
+
+    x = std::max(x, start + 1);
+    out.push_back((uint8_t)(x - start));
+    out.insert(out.end(), values + start, values + x);
+  }
+}
+
+// noisy and flat stretches so both literal and run packets show up, plus some zero exponents
+static std::vector<uint8_t> make_hdr(uint32_t width, uint32_t height) {
+  std::string header = std::format("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y {} +X {}\n", height, width);
+  std::vector<uint8_t> file(header.begin(), header.end());
+
+  std::mt19937 rng(3);
+  std::vector<uint8_t> planes(4 * (size_t)width);
+
+  for (uint32_t y = 0; y < height; ++y) {
+    for (uint32_t x = 0; x < width; ++x) {
+      bool flat = (x / 16) % 2 == 1;
+
+      for (uint32_t c = 0; c < 3; ++c) {
+        planes[c * width + x] = flat ? 200 : (uint8_t)rng();
+      }
+
+      planes[3 * width + x] = y % 7 == 0 && x % 5 == 0 ? 0 : flat ? 130 : (uint8_t)(120 + rng() % 20);
+    }
+
+    file.insert(file.end(), { 2, 2, (uint8_t)(width >> 8), (uint8_t)(width & 0xff) });
+
+    for (uint32_t c = 0; c < 4; ++c) {
+      write_rle(file, planes.data() + c * width, width);
+    }
+  }
+
+  return file;
+}
+
+namespace checks {
+  // matches stb_image bit for bit, and the half path to within half precision
+  bool hdr_decode() {
+    uint32_t width = 4099;
+    uint32_t height = 1031;
+
+    std::vector<uint8_t> file = make_hdr(width, height);
+
+    auto start = std::chrono::steady_clock::now();
+
+    int stb_width, stb_height;
+    float* expected = stbi_loadf_from_memory(file.data(), (int)file.size(), &stb_width, &stb_height, nullptr, 3);
+
+    auto stb_end = std::chrono::steady_clock::now();
+
+    std::optional<hdri::Image> image = hdri::load_hdr(file.data(), file.size());
+
+    auto end = std::chrono::steady_clock::now();
+
+    if (!expected || !image) {
+      std::cout << "  failed to decode\n";
+      return false;
+    }
+
+    size_t count = (size_t)width * height;
+    size_t mismatches = 0;
+
+    for (size_t i = 0; i < count * 3; ++i) {
+      mismatches += image->texels[i] != expected[i] ? 1 : 0;
+    }
+
+    std::vector<HALF> half(count * 4);
+    hdri::decode_hdr(file.data(), file.size(), hdri::TexelFormat::RGBA16F, half.data());
+
+    float max_half_error = 0.0f;
+
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t c = 0; c < 3; ++c) {
+        float reference = expected[i * 3 + c];
+
+        if (reference > 1e-4f) {
+          max_half_error = std::max(max_half_error, std::abs(XMConvertHalfToFloat(half[i * 4 + c]) - reference) / reference);
+        }
+      }
+    }
+
+    stbi_image_free(expected);
+
+    std::cout << std::format("  {}x{}: stb {:.1f} ms, ours {:.1f} ms\n", width, height,
+                             std::chrono::duration<double, std::milli>(stb_end - start).count(),
+                             std::chrono::duration<double, std::milli>(end - stb_end).count());
+    std::cout << std::format("  rgb32f texels differing from stb {}, rgba16f max relative error {:.2e}\n", mismatches, max_half_error);
+
+    return mismatches == 0 && max_half_error < 1.0f / 1024.0f;
+  }
+
+  // error of every encoding on a smooth sky with noise and a small very bright spot, and bc6h on
+  // blocks simple enough that the single region mode should be close to exact
+  bool hdri_encode() {
+    uint32_t width = 1024;
+    uint32_t height = 512;
+
+    hdri::Image image = {
+      .width = width,
+      .height = height,
+      .texels = std::vector<float>((size_t)width * height * 3),
+    };
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(0.9f, 1.1f);
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        bool sun = y < height / 8 && x > width / 3 && x < width / 3 + 8;
+        float base = 0.2f + std::sin((float)x * 0.02f) * 0.1f + (sun ? 5000.0f : 0.0f);
+
+        for (uint32_t c = 0; c < 3; ++c) {
+          image.texels[((size_t)y * width + x) * 3 + c] = base * (1.0f + 0.3f * (float)c) * noise(rng);
+        }
+      }
+    }
+
+    struct Expected {
+      hdri::TexelEncoding encoding;
+      const char* name;
+      float max_mean_relative;
+    };
+
+    // half keeps 11 bits, rgb9e5 9 bits below the largest channel and bc6h interpolates 16 levels between endpoints
+    Expected expected[] = {
+      { hdri::TexelEncoding::RGBA16F, "rgba16f", 0.001f },
+      { hdri::TexelEncoding::RGB9E5, "rgb9e5", 0.005f },
+      { hdri::TexelEncoding::BC6H, "bc6h", 0.05f },
+    };
+
+    bool passed = true;
+
+    for (const Expected& e : expected) {
+      std::vector<uint8_t> encoded(hdri::encoded_size(e.encoding, width, height));
+
+      auto start = std::chrono::steady_clock::now();
+      hdri::encode_image(image, e.encoding, encoded.data());
+      double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+      hdri::EncodeError error = hdri::measure_error(image, encoded.data(), e.encoding);
+
+      std::cout << std::format("  {:8} {:8} bytes {:6.1f} ms, rmse {:.4f}, mean relative {:.4f}, max relative {:.4f}\n",
+                               e.name, encoded.size(), milliseconds, error.rmse, error.mean_relative, error.max_relative);
+
+      passed &= error.mean_relative < e.max_mean_relative;
+    }
+
+    XMFLOAT3 block[16];
+
+    for (uint32_t i = 0; i < 16; ++i) {
+      block[i] = { 1.0f, 0.5f, 0.25f };
+    }
+
+    hdri::BC6HBlock constant = hdri::encode_bc6h_block(block);
+    float constant_error = XMVectorGetX(XMVector3Length(hdri::decode_bc6h_texel(constant, 5) - XMVectorSet(1.0f, 0.5f, 0.25f, 0.0f)));
+
+    // bc6h interpolates in half float bit space, so a linear ramp is only followed closely within an exponent or two
+    for (uint32_t i = 0; i < 16; ++i) {
+      block[i] = { 1.0f + (float)i * 0.1f, 2.0f - (float)i * 0.1f, 0.5f };
+    }
+
+    hdri::BC6HBlock ramp = hdri::encode_bc6h_block(block);
+    float max_ramp_error = 0.0f;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+      XMVECTOR error = XMVectorAbs(hdri::decode_bc6h_texel(ramp, i) - XMLoadFloat3(&block[i])) / XMLoadFloat3(&block[i]);
+      max_ramp_error = std::max(max_ramp_error, std::max(XMVectorGetX(error), XMVectorGetY(error)));
+    }
+
+    std::cout << std::format("  bc6h constant block error {:.4f}, ramp block max relative error {:.4f}\n", constant_error, max_ramp_error);
+
+    return passed && constant_error < 0.01f && max_ramp_error < 0.2f;
+  }
+};
\ No newline at end of file
@@ -0,0 +1,63 @@
+// headless checks for the cpu side, for machines without a d3d11 device. not part of the windows build, see
+// CMakeLists.txt
+//
+// checks [name ...] runs every check, or only the named ones, and exits with the number that failed
+
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <iterator>
+
+#include "checks.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct Check {
+  const char* name;
+  bool (*run)();
+};
+
+static constexpr Check CHECKS[] = {
+  { "hdr_decode", checks::hdr_decode },
+  { "hdri_encode", checks::hdri_encode },
+  { "temporal_reuse", checks::temporal_reuse },
+  { "spatial_reuse", checks::spatial_reuse },
+  { "reservoir_packing", checks::reservoir_packing },
+  { "sampler_convergence", checks::sampler_convergence },
+  { "indirect_paths", checks::indirect_paths },
+  { "indirect_reprojection", checks::indirect_reprojection },
+  { "traversal_per_pixel", checks::traversal_per_pixel },
+  { "accumulation_stopping", checks::accumulation_stopping },
+  { "denoise_convergence", checks::denoise_convergence },
+  { "upsample_edges", checks::upsample_edges },
+  { "reference_throughput", checks::reference_throughput },
+};
+
+int main(int argc, char** argv) {
+  int failed = 0;
+
+  for (const Check& check : CHECKS) {
+    bool selected = argc < 2;
+
+    for (int i = 1; i < argc; ++i) {
+      selected |= !strcmp(argv[i], check.name);
+    }
+
+    if (!selected) {
+      continue;
+    }
+
+    std::cout << std::format("{}:\n", check.name);
+
+    auto start = std::chrono::steady_clock::now();
+    bool passed = check.run();
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::format("{} {} ({:.0f} ms)\n\n", passed ? "passed" : "FAILED", check.name, milliseconds);
+    failed += passed ? 0 : 1;
+  }
+
+  return failed;
+}
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "checks.h"
+#include "pathtrace.h"
+
+namespace checks {
+  // trace.cpp culls clockwise ones
+  void add_quad(Mesh& mesh, XMFLOAT3 a, XMFLOAT3 b, XMFLOAT3 c, XMFLOAT3 d, XMFLOAT3 normal) {
+    uint32_t base = (uint32_t)mesh.positions.size();
+
+    for (XMFLOAT3 p : { a, b, c, d }) {
+      mesh.positions.push_back(p);
+      mesh.normals.push_back(normal);
+      mesh.tex_coords.push_back({ 0.0f, 0.0f });
+    }
+
+    std::vector<uint32_t>& indices = std::get<1>(mesh.indices.data);
+
+    for (uint32_t k : { 0u, 2u, 1u, 0u, 3u, 2u }) {
+      indices.push_back(base + k);
+    }
+  }
+
+  trace::Scene FloorAndWall::scene() const {
+    return { &mesh, &nodes };
+  }
+
+  FloorAndWall make_floor_and_wall() {
+    FloorAndWall result = {};
+    result.mesh.indices.data = std::vector<uint32_t>();
+
+    add_quad(result.mesh, { -5.0f, 0.0f, -5.0f }, { -5.0f, 0.0f, 5.0f }, { 5.0f, 0.0f, 5.0f }, { 5.0f, 0.0f, -5.0f }, { 0.0f, 1.0f, 0.0f });
+    add_quad(result.mesh, { 1.0f, 0.0f, 5.0f }, { 1.0f, 4.0f, 5.0f }, { 1.0f, 4.0f, -5.0f }, { 1.0f, 0.0f, -5.0f }, { -1.0f, 0.0f, 0.0f });
+
+    result.mesh.segments.push_back({ 0, (uint32_t)result.mesh.indices.size(), 0 });
+    result.nodes = bvh::construct_bvh(result.mesh);
+
+    return result;
+  }
+
+  std::vector<restir::Surface> trace_surfaces(const trace::Scene& scene, FXMMATRIX view_proj, uint32_t width, uint32_t height) {
+    XMMATRIX inv_view_proj = XMMatrixInverse(nullptr, view_proj);
+    std::vector<restir::Surface> surfaces((size_t)width * height);
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        XMVECTOR ndc = XMVectorSet((float)x / (float)width * 2.0f - 1.0f, 1.0f - (float)y / (float)height * 2.0f, 1.0f, 1.0f);
+        XMVECTOR near_point = XMVector3TransformCoord(ndc, inv_view_proj);
+        XMVECTOR dir = XMVector3Normalize(XMVector3TransformCoord(XMVectorSetZ(ndc, 0.5f), inv_view_proj) - near_point);
+
+        restir::Surface& s = surfaces[(size_t)y * width + x];
+        trace::Hit hit;
+
+        if (trace::intersect(scene, near_point, dir, &hit)) {
+          s.position = hit.position;
+          s.normal = hit.normal;
+          s.depth = XMVectorGetW(XMVector4Transform(XMVectorSetW(XMLoadFloat3(&hit.position), 1.0f), view_proj));
+        }
+        else {
+          s = {};
+        }
+      }
+    }
+
+    return surfaces;
+  }
+
+  // the gradient of make_sky without the sun or the band, so a naive estimator converges in reasonable time
+  static Sky make_overcast_sky(uint32_t size) {
+    hdri::Image image = {
+      .width = size,
+      .height = size,
+      .texels = std::vector<float>((size_t)size * size * 3),
+    };
+
+    for (uint32_t y = 0; y < size; ++y) {
+      for (uint32_t x = 0; x < size; ++x) {
+        XMVECTOR dir = hdri::octahedral_to_dir({ ((float)x + 0.5f) / (float)size, ((float)y + 0.5f) / (float)size });
+
+        for (uint32_t c = 0; c < 3; ++c) {
+          image.texels[((size_t)y * size + x) * 3 + c] = 0.5f + 0.5f * std::max(XMVectorGetY(dir), 0.0f);
+        }
+      }
+    }
+
+    Sky sky = {};
+    sky.distribution = hdri::build_octahedral_distribution(image.texels.data(), size);
+    sky.mips = hdri::build_mips(std::move(image), hdri::MipFilter::BOX, hdri::Layout::OCTAHEDRAL);
+
+    return sky;
+  }
+
+  // cosine sampled bounces without next event estimation or roulette, the environment only counts when one escapes
+  static double naive_indirect(const trace::Scene& scene, const restir::Environment& env, FXMVECTOR origin, FXMVECTOR normal,
+                               pathtrace::Settings settings, uint32_t sample_count, double* standard_error)
+  {
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    double sum = 0.0;
+    double squared = 0.0;
+
+    for (uint32_t i = 0; i < sample_count; ++i) {
+      XMVECTOR o = origin;
+      XMVECTOR n = normal;
+      double throughput = 1.0;
+      double value = 0.0;
+
+      for (uint32_t bounce = 0; bounce <= settings.max_bounces; ++bounce) {
+        float phi = XM_2PI * uniform(rng);
+        float u = uniform(rng);
+        float r = std::sqrt(u);
+
+        XMVECTOR a = std::abs(XMVectorGetX(n)) > 0.9f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+        XMVECTOR s = XMVector3Normalize(XMVector3Cross(n, a));
+        XMVECTOR t = XMVector3Cross(n, s);
+        XMVECTOR dir = std::cos(phi) * r * s + std::sin(phi) * r * t + std::sqrt(1.0f - u) * n;
+
+        trace::Hit hit;
+
+        if (!trace::intersect(scene, o + n * 1e-6f, dir, &hit)) {
+          if (bounce > 0) {
+            value += throughput * XMVectorGetX(hdri::sample_bilinear((*env.mips)[0], hdri::dir_to_octahedral(dir), hdri::Layout::OCTAHEDRAL));
+          }
+
+          break;
+        }
+
+        throughput *= settings.albedo;
+        o = XMLoadFloat3(&hit.position);
+        n = XMLoadFloat3(&hit.normal);
+      }
+
+      sum += value;
+      squared += value * value;
+    }
+
+    double mean = sum / sample_count;
+    *standard_error = std::sqrt(std::max(squared / sample_count - mean * mean, 0.0) / sample_count);
+
+    return mean;
+  }
+
+  // on the floor next to a wall, what trace_path converges to should match brute force for both samplers,
+  // and the ray budget should pick the strides its commit quotes without ever being exceeded
+  bool indirect_paths() {
+    Sky sky = make_overcast_sky(256);
+    restir::Environment env = { &sky.mips, &sky.distribution, &sky.lights, 0.0f };
+
+    FloorAndWall room = make_floor_and_wall();
+    trace::Scene scene = room.scene();
+
+    pathtrace::Settings settings = pathtrace::DEFAULT_SETTINGS;
+    bool passed = true;
+
+    for (float x : { -2.0f, 0.0f, 0.5f, 0.9f }) {
+      XMVECTOR origin = XMVectorSet(x, 0.0f, 0.0f, 0.0f);
+      XMVECTOR normal = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+
+      double naive_error;
+      double naive = naive_indirect(scene, env, origin, normal, settings, 400000, &naive_error);
+
+      std::cout << std::format("  x {:+.1f}: naive {:.4f} +- {:.4f}", x, naive, naive_error);
+
+      for (sampler::Type type : { sampler::Type::RANDOM, sampler::Type::SOBOL }) {
+        sampler::Sampler s = sampler::make_sampler({ .type = type, .blue_noise = nullptr }, { 0, 0 }, sampler::hash32((uint32_t)(x * 100.0f + 1000.0f)));
+
+        uint32_t sample_count = 20000;
+        trace::TraversalStats stats = trace::empty_traversal_stats();
+        double sum = 0.0;
+        double squared = 0.0;
+
+        for (uint32_t i = 0; i < sample_count; ++i) {
+          sampler::start_sample(s, i);
+
+          double value = XMVectorGetX(pathtrace::trace_path(scene, env, origin, normal, settings, s, &stats));
+          sum += value;
+          squared += value * value;
+        }
+
+        double mean = sum / sample_count;
+        double error = std::sqrt(std::max(squared / sample_count - mean * mean, 0.0) / sample_count);
+
+        std::cout << std::format(", {} {:.4f} +- {:.4f}", type == sampler::Type::SOBOL ? "sobol" : "random", mean, error);
+
+        passed &= std::abs(mean - naive) < 4.0 * std::sqrt(error * error + naive_error * naive_error);
+      }
+
+      std::cout << "\n";
+    }
+
+    uint32_t width = 320;
+    uint32_t height = 180;
+
+    XMMATRIX view_proj = XMMatrixLookAtRH(XMVectorSet(-3.0f, 2.0f, 3.0f, 1.0f), XMVectorSet(0.0f, 0.5f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+                         XMMatrixPerspectiveFovRH(XM_PI * 0.25f, (float)width / (float)height, 1000.0f, 0.01f);
+    std::vector<restir::Surface> surfaces = trace_surfaces(scene, view_proj, width, height);
+    std::vector<XMFLOAT3> indirect[2] = { std::vector<XMFLOAT3>(surfaces.size()), std::vector<XMFLOAT3>(surfaces.size()) };
+
+    for (auto [budget, expected_stride] : { std::pair(1u << 20, 1u), std::pair(200000u, 2u), std::pair(50000u, 5u) }) {
+      settings.ray_budget = budget;
+
+      uint32_t stride = pathtrace::pixel_stride(settings, width * height);
+      uint64_t max_rays = 0;
+
+      for (uint32_t frame = 0; frame < 8; ++frame) {
+        uint64_t rays = pathtrace::render_indirect(scene, env, width, height, frame, surfaces.data(), surfaces.data(),
+                                                   frame > 0 ? indirect[1 - frame % 2].data() : nullptr, view_proj, settings,
+                                                   { .type = sampler::Type::SOBOL, .blue_noise = nullptr }, indirect[frame % 2].data());
+        max_rays = std::max(max_rays, rays);
+      }
+
+      std::cout << std::format("  budget {:7}: stride {}, at most {} rays a frame\n", budget, stride, max_rays);
+
+      passed &= stride == expected_stride && max_rays <= budget;
+    }
+
+    return passed;
+  }
+
+  // with the camera panned since last frame, the pixels not traced this frame should carry what was
+  // computed for their own surface, not for whatever the same pixel saw before
+  bool indirect_reprojection() {
+    Sky sky = make_overcast_sky(64);
+    restir::Environment env = { &sky.mips, &sky.distribution, &sky.lights, 0.0f };
+
+    FloorAndWall room = make_floor_and_wall();
+    trace::Scene scene = room.scene();
+
+    uint32_t width = 160;
+    uint32_t height = 90;
+
+    XMMATRIX proj = XMMatrixPerspectiveFovRH(XM_PI * 0.25f, (float)width / (float)height, 1000.0f, 0.01f);
+    XMMATRIX prev_view_proj = XMMatrixLookAtRH(XMVectorSet(-3.0f, 2.0f, 3.0f, 1.0f), XMVectorSet(0.0f, 0.5f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * proj;
+    XMMATRIX view_proj = XMMatrixLookAtRH(XMVectorSet(-3.0f, 2.0f, 2.6f, 1.0f), XMVectorSet(0.0f, 0.5f, -0.4f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * proj;
+
+    std::vector<restir::Surface> previous_surfaces = trace_surfaces(scene, prev_view_proj, width, height);
+    std::vector<restir::Surface> surfaces = trace_surfaces(scene, view_proj, width, height);
+
+    // a smooth function of position stands in for last frame's result, so every pixel's right answer is known
+    auto expected = [](const XMFLOAT3& p) { return XMFLOAT3(p.x + 10.0f, p.y + 10.0f, p.z + 10.0f); };
+
+    std::vector<XMFLOAT3> previous_indirect(surfaces.size());
+
+    for (size_t i = 0; i < surfaces.size(); ++i) {
+      previous_indirect[i] = previous_surfaces[i].depth > 0.0f ? expected(previous_surfaces[i].position) : XMFLOAT3(0.0f, 0.0f, 0.0f);
+    }
+
+    pathtrace::Settings settings = pathtrace::DEFAULT_SETTINGS;
+    settings.ray_budget = width * height * pathtrace::max_rays_per_path(settings) / 4;
+
+    uint32_t frame = 1;
+    uint32_t stride = pathtrace::pixel_stride(settings, width * height);
+
+    std::vector<XMFLOAT3> indirect(surfaces.size());
+    pathtrace::render_indirect(scene, env, width, height, frame, surfaces.data(), previous_surfaces.data(), previous_indirect.data(),
+                               prev_view_proj, settings, { .type = sampler::Type::SOBOL, .blue_noise = nullptr }, indirect.data());
+
+    // one texel of the previous frame at the far end of the floor, reprojection rounds to the nearest
+    float tolerance = 0.25f;
+
+    uint32_t untraced = 0;
+    uint32_t reused = 0;
+    uint32_t wrong = 0;
+    uint32_t stale = 0;
+
+    for (uint32_t p = 0; p < width * height; ++p) {
+      if (surfaces[p].depth <= 0.0f || p % stride == frame % stride) {
+        continue;
+      }
+
+      XMFLOAT3 e = expected(surfaces[p].position);
+      auto differs = [&](const XMFLOAT3& v) { return std::abs(v.x - e.x) + std::abs(v.y - e.y) + std::abs(v.z - e.z) > tolerance; };
+
+      untraced += 1;
+      stale += differs(previous_indirect[p]);
+
+      if (indirect[p].x != 0.0f) {
+        reused += 1;
+        wrong += differs(indirect[p]);
+      }
+    }
+
+    std::cout << std::format("  stride {}: {} untraced pixels, {} reprojected, {} of those wrong, {} would be wrong kept in place\n",
+                             stride, untraced, reused, wrong, stale);
+
+    return stride == 4 && wrong == 0 && reused > untraced * 9 / 10 && stale > untraced / 2;
+  }
+};
\ No newline at end of file
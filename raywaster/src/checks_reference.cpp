@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "checks.h"
+#include "parallel.h"
+#include "reference.h"
+
+namespace checks {
+  // the five faces that can be seen of a box standing on y = low.y
+  static void add_box(Mesh& mesh, XMFLOAT3 low, XMFLOAT3 high) {
+    XMVECTOR center = (XMLoadFloat3(&low) + XMLoadFloat3(&high)) * 0.5f;
+    XMVECTOR half = (XMLoadFloat3(&high) - XMLoadFloat3(&low)) * 0.5f;
+
+    // normal, then the right and up of someone looking at that face
+    static const XMFLOAT3 faces[5][3] = {
+      { { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f }, { 0.0f, 1.0f, 0.0f } },
+      { { -1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } },
+      { { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+      { { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } },
+      { { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, -1.0f } },
+    };
+
+    for (const XMFLOAT3* face : faces) {
+      XMVECTOR n = XMLoadFloat3(&face[0]);
+      XMVECTOR right = XMLoadFloat3(&face[1]);
+      XMVECTOR up = XMLoadFloat3(&face[2]);
+
+      XMFLOAT3 corners[4];
+      float signs[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+
+      for (uint32_t k = 0; k < 4; ++k) {
+        XMStoreFloat3(&corners[k], center + (n + right * signs[k][0] + up * signs[k][1]) * half);
+      }
+
+      add_quad(mesh, corners[0], corners[1], corners[2], corners[3], face[0]);
+    }
+  }
+
+  // a gradient sky over a dark ground with a sun bright enough for extract_lights, as an equirect like an .hdr decodes to
+  static hdri::Image make_sun_sky(uint32_t width, uint32_t height) {
+    hdri::Image image = {
+      .width = width,
+      .height = height,
+      .texels = std::vector<float>((size_t)width * height * 3),
+    };
+
+    XMVECTOR sun = XMVector3Normalize(XMVectorSet(0.4f, 0.7f, 0.3f, 0.0f));
+    float sun_cos = std::cos(XMConvertToRadians(1.5f));
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        XMVECTOR dir = hdri::equirect_to_dir({ ((float)x + 0.5f) / (float)width, ((float)y + 0.5f) / (float)height });
+        float up = XMVectorGetY(dir);
+
+        XMVECTOR color = up > 0.0f ? XMVectorSet(0.4f, 0.6f, 1.0f, 0.0f) * (0.5f + up) : XMVectorReplicate(0.1f);
+
+        if (XMVectorGetX(XMVector3Dot(dir, sun)) > sun_cos) {
+          color = XMVectorReplicate(20000.0f);
+        }
+
+        XMFLOAT3 rgb;
+        XMStoreFloat3(&rgb, color);
+
+        float* texel = &image.texels[((size_t)y * width + x) * 3];
+        texel[0] = rgb.x;
+        texel[1] = rgb.y;
+        texel[2] = rgb.z;
+      }
+    }
+
+    return image;
+  }
+
+  // the reference renderer on a wavy floor with two boxes under a sun sky, from reference_main's camera.
+  // ms and Mrays/s depend on the machine so they're only printed. what's checked is that every frame's rays are
+  // the primary ones plus what its pixels counted, and that accumulation stops at the max_samples cap
+  bool reference_throughput() {
+    Mesh mesh = make_heightfield(64);
+
+    add_box(mesh, { -2.0f, -0.5f, -1.5f }, { -0.5f, 1.5f, 0.0f });
+    add_box(mesh, { 0.8f, -0.5f, 0.5f }, { 2.0f, 0.7f, 1.7f });
+    mesh.segments[0].index_count = (uint32_t)std::get<1>(mesh.indices.data).size();
+
+    std::vector<bvh::Node> nodes = bvh::construct_bvh(mesh);
+    trace::Scene scene = { &mesh, &nodes };
+
+    reference::Environment env = reference::build_environment(make_sun_sky(512, 256));
+
+    XMMATRIX view = XMMatrixLookAtRH(XMVectorSet(0.0f, 6.0f * std::cos(XM_PI * 0.25f), 6.0f * std::sin(XM_PI * 0.25f), 1.0f),
+                                     XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+    std::cout << std::format("  {} triangles, {} lights, {} threads\n", std::get<1>(mesh.indices.data).size() / 3, env.lights.size(),
+                             parallel::thread_count());
+
+    bool passed = !env.lights.empty();
+
+    struct Run {
+      uint32_t width, height;
+      uint32_t max_samples;
+      uint32_t frames;
+    };
+
+    // a few frames at the size the commit quotes, then a small one run into a lowered cap
+    for (Run run : { Run{ 640, 360, 4096, 3 }, Run{ 160, 90, 64, 100 } }) {
+      reference::Settings settings = reference::DEFAULT_SETTINGS;
+      settings.width = run.width;
+      settings.height = run.height;
+      settings.accumulation.max_samples = run.max_samples;
+
+      XMMATRIX proj = XMMatrixPerspectiveFovRH(XM_PI * 0.25f, (float)run.width / (float)run.height, 1000.0f, 0.01f);
+      reference::State state = reference::make_state(settings);
+
+      uint64_t total_rays = 0;
+      double total_milliseconds = 0.0;
+      uint32_t rendered = 0;
+      bool rays_add_up = true;
+
+      for (uint32_t frame = 0; frame < run.frames; ++frame) {
+        reference::FrameStats stats = reference::render_frame(scene, env, view, proj, state);
+
+        if (!stats.rendered) {
+          break;
+        }
+
+        uint64_t counted = (uint64_t)run.width * run.height + (uint64_t)std::llround((double)stats.traversal.mean[0] * stats.traversal.pixel_count);
+        rays_add_up &= stats.ray_count == counted;
+
+        total_rays += stats.ray_count;
+        total_milliseconds += stats.milliseconds;
+        rendered++;
+      }
+
+      std::cout << std::format("  {}x{}: {} frames, {:.1f} ms/frame, {:.2f} Mrays/s\n", run.width, run.height, rendered,
+                               total_milliseconds / rendered, (double)total_rays / (total_milliseconds * 1e3));
+
+      bool stopped = rendered == std::min(run.frames, run.max_samples);
+      passed &= rays_add_up && stopped;
+    }
+
+    return passed;
+  }
+};
\ No newline at end of file
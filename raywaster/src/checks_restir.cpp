@@ -0,0 +1,388 @@
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "checks.h"
+#include "restir.h"
+
+namespace checks {
+  Sky make_sky(uint32_t size) {
+    hdri::Image image = {
+      .width = size,
+      .height = size,
+      .texels = std::vector<float>((size_t)size * size * 3),
+    };
+
+    XMVECTOR sun = XMVector3Normalize(XMVectorSet(0.3f, 0.8f, -0.5f, 0.0f));
+    float sun_cos = std::cos(XMConvertToRadians(2.4f));
+
+    for (uint32_t y = 0; y < size; ++y) {
+      for (uint32_t x = 0; x < size; ++x) {
+        XMVECTOR dir = hdri::octahedral_to_dir({ ((float)x + 0.5f) / (float)size, ((float)y + 0.5f) / (float)size });
+
+        float value = 0.5f + 0.5f * std::max(XMVectorGetY(dir), 0.0f) + (XMVectorGetX(dir) > 0.9f ? 20.0f : 0.0f);
+
+        if (XMVectorGetX(XMVector3Dot(dir, sun)) > sun_cos) {
+          value = 20000.0f;
+        }
+
+        for (uint32_t c = 0; c < 3; ++c) {
+          image.texels[((size_t)y * size + x) * 3 + c] = value;
+        }
+      }
+    }
+
+    Sky sky = {};
+    sky.lights = hdri::extract_lights(image, hdri::Layout::OCTAHEDRAL, { .threshold = 64.0f, .max_solid_angle = 0.02f, .max_lights = 4 });
+    sky.distribution = hdri::build_octahedral_distribution(image.texels.data(), size);
+    sky.mips = hdri::build_mips(std::move(image), hdri::MipFilter::BOX, hdri::Layout::OCTAHEDRAL);
+
+    return sky;
+  }
+
+  restir::Environment Sky::environment() const {
+    return { &mips, &distribution, &lights, 0.5f };
+  }
+
+  double integrate_target(const restir::Environment& env, FXMVECTOR origin, FXMVECTOR normal, const restir::VisibilityFn& visible) {
+    const hdri::Image& top = (*env.mips)[0];
+    double sum = 0.0;
+
+    for (uint32_t y = 0; y < top.height; ++y) {
+      for (uint32_t x = 0; x < top.width; ++x) {
+        float jacobian;
+        XMVECTOR dir = hdri::layout_to_dir(hdri::Layout::OCTAHEDRAL, { ((float)x + 0.5f) / (float)top.width, ((float)y + 0.5f) / (float)top.height }, &jacobian);
+
+        if (visible(0, origin, dir)) {
+          sum += restir::sample_luminance(env, dir) * std::max(XMVectorGetX(XMVector3Dot(normal, dir)), 0.0f) * jacobian;
+        }
+      }
+    }
+
+    return sum / ((double)top.width * top.height);
+  }
+
+  std::vector<restir::Surface> make_tilted_plane(uint32_t width, uint32_t height, XMMATRIX* view_proj) {
+    *view_proj = XMMatrixLookAtRH(XMVectorSet(0.0f, 5.0f, 5.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+                 XMMatrixPerspectiveFovRH(XM_PI * 0.25f, 1.0f, 1000.0f, 0.01f);
+    XMMATRIX inv_view_proj = XMMatrixInverse(nullptr, *view_proj);
+
+    std::vector<restir::Surface> surfaces((size_t)width * height);
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        XMVECTOR ndc = XMVectorSet((float)x / (float)width * 2.0f - 1.0f, 1.0f - (float)y / (float)height * 2.0f, 1.0f, 1.0f);
+        XMVECTOR near_point = XMVector3TransformCoord(ndc, inv_view_proj);
+        XMVECTOR dir = XMVector3Normalize(XMVector3TransformCoord(XMVectorSetZ(ndc, 0.5f), inv_view_proj) - near_point);
+        XMVECTOR position = near_point - dir * (XMVectorGetY(near_point) / XMVectorGetY(dir));
+
+        restir::Surface& s = surfaces[(size_t)y * width + x];
+        XMStoreFloat3(&s.position, position);
+        XMStoreFloat3(&s.normal, XMVector3Normalize(XMVectorSet((float)x / (float)width - 0.5f, 1.0f, 0.0f, 0.0f)));
+        s.depth = XMVectorGetW(XMVector4Transform(XMVectorSetW(position, 1.0f), *view_proj));
+      }
+    }
+
+    return surfaces;
+  }
+
+  // temporal reuse on the tilted plane should shrink the per pixel error many times over without biasing it
+  bool temporal_reuse() {
+    Sky sky = make_sky(256);
+    restir::Environment env = sky.environment();
+
+    uint32_t width = 128;
+    uint32_t height = 128;
+
+    XMMATRIX view_proj;
+    std::vector<restir::Surface> surfaces = make_tilted_plane(width, height, &view_proj);
+
+    restir::VisibilityFn unoccluded = [](size_t, FXMVECTOR, FXMVECTOR) { return true; };
+
+    std::vector<double> reference(width);
+
+    for (uint32_t x = 0; x < width; ++x) {
+      reference[x] = integrate_target(env, XMVectorZero(), XMLoadFloat3(&surfaces[x].normal), unoccluded);
+    }
+
+    std::vector<restir::Reservoir> previous(surfaces.size());
+    std::vector<restir::Reservoir> current(surfaces.size());
+
+    double first_error = 0.0;
+    double last_error = 0.0;
+    double last_bias = 0.0;
+
+    for (uint32_t frame = 1; frame <= 30; ++frame) {
+      restir::resample_frame(env, width, height, frame, surfaces.data(), surfaces.data(), frame > 1 ? previous.data() : nullptr, view_proj,
+                             restir::DEFAULT_TEMPORAL_SETTINGS, { .type = sampler::Type::SOBOL, .blue_noise = nullptr }, unoccluded, current.data());
+
+      double squared = 0.0;
+      double bias = 0.0;
+
+      for (size_t i = 0; i < current.size(); ++i) {
+        double expected = reference[i % width];
+        double relative = (current[i].cosine * current[i].contribution - expected) / expected;
+
+        squared += relative * relative;
+        bias += relative;
+      }
+
+      double error = std::sqrt(squared / (double)current.size());
+      bias /= (double)current.size();
+
+      if (frame == 1 || frame == 2 || frame == 5 || frame == 10 || frame == 20 || frame == 30) {
+        std::cout << std::format("  frame {:2}: relative rmse {:.4f}, mean relative error {:+.4f}\n", frame, error, bias);
+      }
+
+      first_error = frame == 1 ? error : first_error;
+      last_error = error;
+      last_bias = bias;
+
+      // the gpu only keeps the packed layout between frames
+      for (size_t i = 0; i < current.size(); ++i) {
+        previous[i] = restir::unpack(restir::pack(current[i]));
+      }
+    }
+
+    return last_error < first_error * 0.3 && std::abs(last_bias) < 0.02;
+  }
+
+  // a flat strip where a wall blocks everything towards +x from the right half. biased weighting
+  // should darken next to the wall, unbiased should stay within noise, and both should cut the noise
+  bool spatial_reuse() {
+    Sky sky = make_sky(128);
+    restir::Environment env = sky.environment();
+
+    uint32_t width = 64;
+    uint32_t height = 16;
+
+    std::vector<restir::Surface> surfaces((size_t)width * height);
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        surfaces[(size_t)y * width + x] = {
+          .position = { (float)x - (float)width * 0.5f, 0.0f, (float)y },
+          .normal = { 0.0f, 1.0f, 0.0f },
+          .depth = 10.0f,
+        };
+      }
+    }
+
+    restir::VisibilityFn visible = [](size_t, FXMVECTOR origin, FXMVECTOR dir) {
+      return !(XMVectorGetX(origin) > 0.0f && XMVectorGetX(dir) > 0.1f);
+    };
+
+    std::vector<double> reference(width);
+
+    for (uint32_t x = 0; x < width; ++x) {
+      reference[x] = integrate_target(env, XMLoadFloat3(&surfaces[x].position), XMLoadFloat3(&surfaces[x].normal), visible);
+    }
+
+    struct Result {
+      double bias;       // mean relative, over the whole strip
+      double edge_bias;  // the same within 8 pixels of the wall's edge
+      double deviation;  // mean relative per pixel standard deviation
+    };
+
+    auto run = [&](const restir::SpatialSettings* spatial) {
+      uint32_t frame_count = 400;
+
+      std::vector<restir::Reservoir> candidates(surfaces.size());
+      std::vector<restir::Reservoir> reservoirs(surfaces.size());
+      std::vector<double> mean(width);
+      std::vector<double> mean_squared(width);
+
+      for (uint32_t frame = 1; frame <= frame_count; ++frame) {
+        restir::resample_frame(env, width, height, frame, surfaces.data(), nullptr, nullptr, XMMatrixIdentity(), restir::DEFAULT_TEMPORAL_SETTINGS,
+                               { .type = sampler::Type::RANDOM, .blue_noise = nullptr }, visible, candidates.data());
+
+        const restir::Reservoir* result = candidates.data();
+
+        if (spatial) {
+          for (restir::Reservoir& r : candidates) {
+            r = restir::unpack(restir::pack(r));
+          }
+
+          restir::resample_spatial(width, height, frame, surfaces.data(), candidates.data(), *spatial, visible, reservoirs.data());
+          result = reservoirs.data();
+        }
+
+        // lighting traces its own shadow ray for the final sample
+        for (size_t i = 0; i < surfaces.size(); ++i) {
+          const restir::Reservoir& r = result[i];
+          bool lit = r.contribution > 0.0f && visible(i, XMLoadFloat3(&surfaces[i].position), XMLoadFloat3(&r.y));
+          double estimate = lit ? r.cosine * r.contribution : 0.0;
+
+          mean[i % width] += estimate / (frame_count * height);
+          mean_squared[i % width] += estimate * estimate / (frame_count * height);
+        }
+      }
+
+      Result out = {};
+
+      for (uint32_t x = 0; x < width; ++x) {
+        double relative = (mean[x] - reference[x]) / reference[x];
+
+        out.bias += relative / width;
+        out.edge_bias += x + 8 >= width / 2 && x < width / 2 + 8 ? relative / 16.0 : 0.0;
+        out.deviation += std::sqrt(std::max(mean_squared[x] - mean[x] * mean[x], 0.0)) / reference[x] / width;
+      }
+
+      return out;
+    };
+
+    restir::SpatialSettings biased = { .count = 4, .radius = 8.0f, .weighting = restir::SpatialWeighting::BIASED, .depth_tolerance = 0.1f, .normal_tolerance = 0.9f };
+    restir::SpatialSettings unbiased = biased;
+    unbiased.weighting = restir::SpatialWeighting::UNBIASED;
+
+    Result none = run(nullptr);
+    Result with_biased = run(&biased);
+    Result with_unbiased = run(&unbiased);
+
+    auto print = [](const char* name, Result r) {
+      std::cout << std::format("  {:10} mean relative bias {:+.4f}, next to the wall {:+.4f}, relative deviation {:.3f}\n", name, r.bias, r.edge_bias, r.deviation);
+    };
+
+    print("no spatial", none);
+    print("biased", with_biased);
+    print("unbiased", with_unbiased);
+
+    return with_biased.edge_bias < -0.04 && std::abs(with_unbiased.edge_bias) < 0.02 &&
+           with_biased.deviation < none.deviation * 0.75 && with_unbiased.deviation < none.deviation * 0.75;
+  }
+
+  // round trips a fibonacci sphere of directions plus fine sweeps along the octahedral folds,
+  // where the mapping is least uniform, through the stored layout
+  bool reservoir_packing() {
+    double max_angle = 0.0;
+    double angle_sum = 0.0;
+    size_t direction_count = 0;
+    float max_contribution_error = 0.0f;
+    bool m_exact = true;
+
+    uint32_t state = 1;
+
+    auto round_trip = [&](FXMVECTOR dir, float m) {
+      restir::Reservoir r = {
+        .m = m,
+        .contribution = sampler::uniform_random(&state) * 100.0f + 1e-3f,
+        .found = true,
+      };
+
+      XMStoreFloat3(&r.y, dir);
+      restir::Reservoir unpacked = restir::unpack(restir::pack(r));
+
+      // acos of a float dot product can't resolve hundredths of a degree
+      XMFLOAT3 a;
+      XMStoreFloat3(&a, dir);
+      XMFLOAT3 b = unpacked.y;
+
+      double cross_x = (double)a.y * b.z - (double)a.z * b.y;
+      double cross_y = (double)a.z * b.x - (double)a.x * b.z;
+      double cross_z = (double)a.x * b.y - (double)a.y * b.x;
+      double dot = (double)a.x * b.x + (double)a.y * b.y + (double)a.z * b.z;
+      double angle = std::atan2(std::sqrt(cross_x * cross_x + cross_y * cross_y + cross_z * cross_z), dot) * 180.0 / XM_PI;
+
+      max_angle = std::max(max_angle, angle);
+      angle_sum += angle;
+      direction_count += 1;
+
+      max_contribution_error = std::max(max_contribution_error, std::abs(unpacked.contribution - r.contribution) / r.contribution);
+      m_exact &= unpacked.m == r.m && unpacked.found;
+    };
+
+    uint32_t fibonacci_count = 4000000;
+    float golden_angle = XM_PI * (3.0f - std::sqrt(5.0f));
+
+    for (uint32_t i = 0; i < fibonacci_count; ++i) {
+      float z = 1.0f - 2.0f * ((float)i + 0.5f) / (float)fibonacci_count;
+      float r = std::sqrt(std::max(1.0f - z * z, 0.0f));
+      float phi = golden_angle * (float)i;
+
+      round_trip(XMVectorSet(r * std::cos(phi), r * std::sin(phi), z, 0.0f), (float)(i % 32768));
+    }
+
+    uint32_t sweep_count = 1 << 20;
+
+    for (uint32_t i = 0; i < sweep_count; ++i) {
+      float t = XM_2PI * ((float)i + 0.5f) / (float)sweep_count;
+
+      round_trip(XMVectorSet(std::cos(t), std::sin(t), 0.0f, 0.0f), 0.0f);
+      round_trip(XMVectorSet(std::cos(t), 0.0f, std::sin(t), 0.0f), 0.0f);
+      round_trip(XMVectorSet(0.0f, std::cos(t), std::sin(t), 0.0f), 0.0f);
+    }
+
+    std::cout << std::format("  {} directions: max angular error {:.4f} degrees, mean {:.4f} degrees\n", direction_count, max_angle, angle_sum / (double)direction_count);
+    std::cout << std::format("  contribution max relative error {:.5f}, m and found exact {}, {} bytes\n", max_contribution_error, m_exact, sizeof(restir::PackedReservoir));
+
+    // half a 16 bit step diagonally is about 0.002 degrees, and up to twice that where the octahedral map stretches most
+    return max_angle < 0.005 && max_contribution_error < 1.0f / 1024.0f && m_exact && sizeof(restir::PackedReservoir) == 8;
+  }
+
+  // relative rmse of the mean of every frame's reservoir on the tilted plane without reuse, as the
+  // candidate count grows, for each sequence against the random stream they replaced
+  bool sampler_convergence() {
+    Sky sky = make_sky(256);
+    restir::Environment env = sky.environment();
+    sampler::BlueNoise blue_noise = sampler::generate_blue_noise(BLUE_NOISE_SIZE, 1);
+
+    uint32_t width = 128;
+    uint32_t height = 128;
+
+    XMMATRIX view_proj;
+    std::vector<restir::Surface> surfaces = make_tilted_plane(width, height, &view_proj);
+
+    restir::VisibilityFn unoccluded = [](size_t, FXMVECTOR, FXMVECTOR) { return true; };
+
+    std::vector<double> reference(width);
+
+    for (uint32_t x = 0; x < width; ++x) {
+      reference[x] = integrate_target(env, XMVectorZero(), XMLoadFloat3(&surfaces[x].normal), unoccluded);
+    }
+
+    uint32_t frame_counts[] = { 2, 8, 32, 256 };
+    double errors[4][std::size(frame_counts)] = {};
+
+    std::cout << "  candidates   random   sobol   lattice   blue noise\n";
+
+    for (uint32_t type = 0; type < 4; ++type) {
+      sampler::Settings sampling = { .type = (sampler::Type)type, .blue_noise = &blue_noise };
+
+      std::vector<restir::Reservoir> reservoirs(surfaces.size());
+      std::vector<double> sum(surfaces.size());
+
+      for (uint32_t frame = 1, next = 0; next < std::size(frame_counts); ++frame) {
+        restir::resample_frame(env, width, height, frame, surfaces.data(), nullptr, nullptr, view_proj, restir::DEFAULT_TEMPORAL_SETTINGS,
+                               sampling, unoccluded, reservoirs.data());
+
+        for (size_t i = 0; i < surfaces.size(); ++i) {
+          sum[i] += reservoirs[i].cosine * reservoirs[i].contribution;
+        }
+
+        if (frame == frame_counts[next]) {
+          double squared = 0.0;
+
+          for (size_t i = 0; i < surfaces.size(); ++i) {
+            double relative = (sum[i] / frame - reference[i % width]) / reference[i % width];
+            squared += relative * relative;
+          }
+
+          errors[type][next++] = std::sqrt(squared / (double)surfaces.size());
+        }
+      }
+    }
+
+    bool passed = true;
+
+    for (size_t i = 0; i < std::size(frame_counts); ++i) {
+      std::cout << std::format("  {:<10}   {:.3f}    {:.3f}   {:.3f}     {:.3f}\n",
+                               frame_counts[i] * restir::CANDIDATE_COUNT, errors[0][i], errors[1][i], errors[2][i], errors[3][i]);
+
+      // sobol is the default, it has to beat what it replaced at every count
+      passed &= errors[1][i] < errors[0][i];
+    }
+
+    return passed;
+  }
+};
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "checks.h"
+#include "pathtrace.h"
+
+namespace checks {
+  Mesh make_heightfield(uint32_t size) {
+    Mesh mesh = {};
+    mesh.indices.data = std::vector<uint32_t>();
+
+    auto height = [](float x, float z) { return 0.4f * std::sin(x * 1.3f) * std::cos(z * 1.7f) + 0.05f * std::sin(x * 9.0f + z * 7.0f); };
+
+    for (uint32_t j = 0; j <= size; ++j) {
+      for (uint32_t i = 0; i <= size; ++i) {
+        float x = (float)i / (float)size * 10.0f - 5.0f;
+        float z = (float)j / (float)size * 10.0f - 5.0f;
+        float e = 1e-3f;
+
+        XMVECTOR normal = XMVector3Normalize(XMVectorSet(height(x - e, z) - height(x + e, z), 2.0f * e, height(x, z - e) - height(x, z + e), 0.0f));
+
+        XMFLOAT3 n;
+        XMStoreFloat3(&n, normal);
+
+        mesh.positions.push_back({ x, height(x, z), z });
+        mesh.normals.push_back(n);
+        mesh.tex_coords.push_back({ (float)i / (float)size, (float)j / (float)size });
+      }
+    }
+
+    std::vector<uint32_t>& indices = std::get<1>(mesh.indices.data);
+
+    for (uint32_t j = 0; j < size; ++j) {
+      for (uint32_t i = 0; i < size; ++i) {
+        uint32_t p00 = j * (size + 1) + i;
+        uint32_t p10 = p00 + 1;
+        uint32_t p01 = p00 + size + 1;
+        uint32_t p11 = p01 + 1;
+
+        // counter clockwise seen from above, like the floor in make_floor_and_wall
+        for (uint32_t k : { p00, p11, p01, p00, p10, p11 }) {
+          indices.push_back(k);
+        }
+      }
+    }
+
+    mesh.segments.push_back({ 0, (uint32_t)indices.size(), 0 });
+
+    return mesh;
+  }
+
+  // with a debug view on, each pixel's stats are every ray it traced across the reservoir, indirect and
+  // lighting passes. the per pixel sums should add up to the frame's rays, and summarize should match the exact
+  // per pixel means and percentiles to within a bucket
+  bool traversal_per_pixel() {
+    Sky sky = make_sky(64);
+    restir::Environment env = sky.environment();
+
+    Mesh mesh = make_heightfield(256);
+    std::vector<bvh::Node> nodes = bvh::construct_bvh(mesh);
+    trace::Scene scene = { &mesh, &nodes };
+
+    // the lighting resolution of a 640x360 frame
+    uint32_t width = 320;
+    uint32_t height = 180;
+
+    XMMATRIX view_proj = XMMatrixLookAtRH(XMVectorSet(-4.0f, 2.5f, 4.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) *
+                         XMMatrixPerspectiveFovRH(XM_PI * 0.25f, (float)width / (float)height, 1000.0f, 0.01f);
+    std::vector<restir::Surface> surfaces = trace_surfaces(scene, view_proj, width, height);
+
+    std::vector<trace::TraversalStats> stats(surfaces.size(), trace::empty_traversal_stats());
+    std::atomic<uint64_t> visibility_rays = 0;
+
+    restir::VisibilityFn visible = [&](size_t pixel, FXMVECTOR origin, FXMVECTOR dir) {
+      trace::TraversalStats ray_stats;
+      bool blocked = trace::occluded(scene, origin, dir, &ray_stats);
+
+      stats[pixel] = trace::merge_traversal_stats(stats[pixel], ray_stats);
+      visibility_rays++;
+
+      return !blocked;
+    };
+
+    sampler::Settings sampling = { .type = sampler::Type::SOBOL, .blue_noise = nullptr };
+    restir::SpatialSettings spatial = {
+      .count = 4,
+      .radius = 16.0f,
+      .weighting = restir::SpatialWeighting::BIASED,
+      .depth_tolerance = 0.1f,
+      .normal_tolerance = 0.9f,
+    };
+
+    std::vector<restir::Reservoir> candidates(surfaces.size());
+    std::vector<restir::Reservoir> reservoirs(surfaces.size());
+    std::vector<XMFLOAT3> indirect(surfaces.size());
+
+    restir::resample_frame(env, width, height, 0, surfaces.data(), nullptr, nullptr, view_proj, restir::DEFAULT_TEMPORAL_SETTINGS,
+                           sampling, visible, candidates.data());
+    restir::resample_spatial(width, height, 0, surfaces.data(), candidates.data(), spatial, visible, reservoirs.data());
+
+    uint64_t path_rays = pathtrace::render_indirect(scene, env, width, height, 0, surfaces.data(), nullptr, nullptr, view_proj,
+                                                    pathtrace::DEFAULT_SETTINGS, sampling, indirect.data(), stats.data());
+
+    // lighting's shadow ray for the final sample
+    uint64_t shadow_rays = 0;
+
+    for (size_t i = 0; i < surfaces.size(); ++i) {
+      const restir::Reservoir& r = reservoirs[i];
+
+      if (surfaces[i].depth > 0.0f && r.found && r.contribution > 0.0f) {
+        XMVECTOR normal = XMLoadFloat3(&surfaces[i].normal);
+        trace::TraversalStats ray_stats;
+
+        trace::occluded(scene, XMLoadFloat3(&surfaces[i].position) + normal * 1e-6f, XMLoadFloat3(&r.y), &ray_stats);
+        stats[i] = trace::merge_traversal_stats(stats[i], ray_stats);
+        shadow_rays++;
+      }
+    }
+
+    // recorded like lighting_cs does, once per pixel with a surface
+    trace::TraversalAggregate aggregate = {};
+    std::vector<trace::TraversalStats> recorded;
+    uint64_t counted_rays = 0;
+    uint64_t stray_rays = 0;
+
+    for (size_t i = 0; i < surfaces.size(); ++i) {
+      if (surfaces[i].depth > 0.0f) {
+        trace::record(aggregate, stats[i]);
+        recorded.push_back(stats[i]);
+        counted_rays += stats[i].ray_count;
+      }
+      else {
+        stray_rays += stats[i].ray_count;
+      }
+    }
+
+    uint64_t traced_rays = visibility_rays + path_rays + shadow_rays;
+    bool passed = counted_rays == traced_rays && stray_rays == 0 && !recorded.empty();
+
+    std::cout << std::format("  {} triangles, {} pixels with a surface: {} visibility, {} path and {} shadow rays, {} counted per pixel\n",
+                             std::get<1>(mesh.indices.data).size() / 3, recorded.size(), (uint64_t)visibility_rays,
+                             path_rays, shadow_rays, counted_rays);
+
+    trace::TraversalSummary summary = trace::summarize(aggregate);
+    static const char* counter_names[TRAVERSAL_COUNTERS] = { "rays", "node visits", "triangle tests", "stack depth" };
+
+    for (uint32_t c = 0; c < TRAVERSAL_COUNTERS; ++c) {
+      std::vector<uint32_t> values;
+      double sum = 0.0;
+
+      for (const trace::TraversalStats& s : recorded) {
+        values.push_back(trace::traversal_counter(s, c));
+        sum += values.back();
+      }
+
+      std::sort(values.begin(), values.end());
+
+      // the same rank summarize looks for
+      double mean = sum / (double)values.size();
+      uint32_t p99 = values[((values.size() * 99 + 99) / 100) - 1];
+
+      uint32_t bucket_width = trace::traversal_bucket_width(c);
+      uint32_t top = TRAVERSAL_HISTOGRAM_BUCKETS * bucket_width - 1;
+      bool p99_matches = p99 >= top ? summary.p99[c] == top : summary.p99[c] >= p99 && summary.p99[c] < p99 + bucket_width;
+
+      std::cout << std::format("  {}: mean {:.2f} (exact {:.2f}), p99 {} (exact {})\n", counter_names[c], summary.mean[c], mean, summary.p99[c], p99);
+
+      passed &= std::abs(summary.mean[c] - mean) <= 1e-3 * std::max(mean, 1.0) && p99_matches;
+    }
+
+    std::cout << std::format("  per ray: {:.2f} node visits, {:.2f} triangle tests\n",
+                             summary.mean[1] / summary.mean[0], summary.mean[2] / summary.mean[0]);
+
+    return passed;
+  }
+};
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cmath>
+#include <format>
+#include <iostream>
+#include <vector>
+
+#include "checks.h"
+#include "upsample.h"
+
+namespace checks {
+  // a disc in front of a plane under a diagonal horizon, lit at half and quarter resolution the way the
+  // lighting pass samples it. the guided upsample should stay closer to the truth than bilinear, and at half
+  // resolution leave no pixel visibly off
+  bool upsample_edges() {
+    uint32_t width = 1280;
+    uint32_t height = 720;
+
+    std::vector<float> depth((size_t)width * height);
+    std::vector<XMFLOAT3> normals(depth.size());
+    std::vector<float> truth(depth.size());
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        size_t i = (size_t)y * width + x;
+
+        float fx = (float)x;
+        float fy = (float)y;
+
+        bool sky = fy < 100.0f + 0.3f * fx;
+        bool disc = (fx - 640.0f) * (fx - 640.0f) + (fy - 400.0f) * (fy - 400.0f) < 150.0f * 150.0f;
+
+        depth[i] = sky ? 0.0f : disc ? 2.0f : 8.0f + fy * 0.001f;
+        normals[i] = disc ? XMFLOAT3(0.0f, 0.0f, 1.0f) : XMFLOAT3(0.0f, 1.0f, 0.0f);
+        truth[i] = sky ? 0.0f : disc ? 1.0f : 0.1f + 0.2f * fx / (float)width;
+      }
+    }
+
+    upsample::Guide full = { width, height, depth.data(), normals.data() };
+    bool passed = true;
+
+    for (uint32_t lod = 1; lod <= 2; ++lod) {
+      uint32_t low_w = width >> lod;
+      uint32_t low_h = height >> lod;
+
+      std::vector<float> low_depth((size_t)low_w * low_h);
+      std::vector<XMFLOAT3> low_normals(low_depth.size());
+      std::vector<tonemap::PackedColor> lighting(low_depth.size());
+      std::vector<XMFLOAT3> output(depth.size());
+
+      upsample::downsample_guide(full, lod, low_depth.data(), low_normals.data());
+
+      // the lighting pass samples the g-buffer at uv = texel / size, the top left pixel of each texel's block
+      for (uint32_t y = 0; y < low_h; ++y) {
+        for (uint32_t x = 0; x < low_w; ++x) {
+          float value = truth[(size_t)(y << lod) * width + (x << lod)];
+          lighting[(size_t)y * low_w + x] = tonemap::pack(XMVectorReplicate(value));
+        }
+      }
+
+      upsample::Guide low = { low_w, low_h, low_depth.data(), low_normals.data() };
+      upsample::upsample_lighting(lighting.data(), low, full, lod, output.data());
+
+      double guided_squared = 0.0;
+      double bilinear_squared = 0.0;
+      uint32_t guided_off = 0;
+      uint32_t bilinear_off = 0;
+      size_t count = 0;
+
+      for (uint32_t y = 0; y < height; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = (size_t)y * width + x;
+
+          if (depth[i] <= 0.0f) {
+            continue;
+          }
+
+          float cx = upsample::upsample_coordinate(x, lod);
+          float cy = upsample::upsample_coordinate(y, lod);
+
+          int32_t bx = (int32_t)std::floor(cx);
+          int32_t by = (int32_t)std::floor(cy);
+          float fx = cx - (float)bx;
+          float fy = cy - (float)by;
+
+          float bilinear = 0.0f;
+
+          for (int32_t k = 0; k < 4; ++k) {
+            int32_t ox = k & 1;
+            int32_t oy = k >> 1;
+            int32_t tx = std::clamp(bx + ox, 0, (int32_t)low_w - 1);
+            int32_t ty = std::clamp(by + oy, 0, (int32_t)low_h - 1);
+
+            bilinear += (ox ? fx : 1.0f - fx) * (oy ? fy : 1.0f - fy) * XMVectorGetX(tonemap::unpack(lighting[(size_t)ty * low_w + tx]));
+          }
+
+          double guided_error = output[i].x - truth[i];
+          double bilinear_error = bilinear - truth[i];
+
+          guided_squared += guided_error * guided_error;
+          bilinear_squared += bilinear_error * bilinear_error;
+          guided_off += std::abs(guided_error) > 0.05;
+          bilinear_off += std::abs(bilinear_error) > 0.05;
+          count++;
+        }
+      }
+
+      double guided_rmse = std::sqrt(guided_squared / (double)count);
+      double bilinear_rmse = std::sqrt(bilinear_squared / (double)count);
+
+      std::cout << std::format("  {}x: bilinear rmse {:.4f} with {} pixels off by 0.05, guided rmse {:.4f} with {}\n",
+                               1u << lod, bilinear_rmse, bilinear_off, guided_rmse, guided_off);
+
+      passed &= guided_rmse < bilinear_rmse * 0.5 && guided_off * 10 < bilinear_off;
+
+      if (lod == 1) {
+        passed &= guided_off == 0;
+      }
+    }
+
+    return passed;
+  }
+};
\ No newline at end of file
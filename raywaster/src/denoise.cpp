@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <cmath>
+
+#include "denoise.h"
+#include "parallel.h"
+
+namespace denoise {
+  // normal and linear depth together, so each tap's guide is a single aligned load
+  struct Guide {
+    XMFLOAT4A normal_depth;
+    float depth_gradient;
+  };
+
+  // b3 spline for the a-trous taps, and the 3x3 gaussian the variance is blurred with
+  static constexpr float KERNEL[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+  static constexpr float GAUSSIAN[2] = { 1.0f / 2.0f, 1.0f / 4.0f };
+
+  static float luminance(FXMVECTOR color) {
+    return XMVectorGetX(XMVector3Dot(color, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f)));
+  }
+
+  static float edge_weight(const Guide& p, const Guide& q, float offset_length, float luminance_p, float luminance_q,
+                           float luminance_scale, Settings settings)
+  {
+    XMVECTOR np = XMLoadFloat4A(&p.normal_depth);
+    XMVECTOR nq = XMLoadFloat4A(&q.normal_depth);
+
+    float cosine = XMVectorGetX(XMVector3Dot(np, nq));
+
+    if (cosine <= 0.0f) {
+      return 0.0f;
+    }
+
+    float w_depth = std::abs(p.normal_depth.w - q.normal_depth.w) / (settings.phi_depth * p.depth_gradient * offset_length + 1e-6f);
+    float w_luminance = std::abs(luminance_p - luminance_q) * luminance_scale;
+
+    // the normal term folded into the same exp, cosine^phi_normal
+    return std::exp(settings.phi_normal * std::log(cosine) - w_depth - w_luminance);
+  }
+
+  // where the history is too short for its moments to mean anything, the variance comes from a 7x7 neighbourhood
+  static float spatial_variance(uint32_t width, uint32_t height, int32_t x, int32_t y, const Guide* guides,
+                                const XMFLOAT4A* color, Settings settings)
+  {
+    const Guide& center = guides[(size_t)y * width + x];
+
+    float m1 = 0.0f;
+    float m2 = 0.0f;
+    float wsum = 0.0f;
+
+    for (int32_t dy = -3; dy <= 3; ++dy) {
+      for (int32_t dx = -3; dx <= 3; ++dx) {
+        int32_t qx = x + dx;
+        int32_t qy = y + dy;
+
+        if (qx < 0 || qy < 0 || qx >= (int32_t)width || qy >= (int32_t)height) {
+          continue;
+        }
+
+        size_t j = (size_t)qy * width + qx;
+
+        if (guides[j].normal_depth.w <= 0.0f) {
+          continue;
+        }
+
+        float l = luminance(XMLoadFloat4A(&color[j]));
+        float w = edge_weight(center, guides[j], std::sqrt((float)(dx*dx + dy*dy)), 0.0f, 0.0f, 0.0f, settings);
+
+        m1 += l * w;
+        m2 += l * l * w;
+        wsum += w;
+      }
+    }
+
+    if (wsum <= 0.0f) {
+      return 0.0f;
+    }
+
+    m1 /= wsum;
+    m2 /= wsum;
+
+    return std::max(m2 - m1 * m1, 0.0f);
+  }
+
+  // one a-trous pass, color and variance are filtered together with weights w and w^2
+  static void atrous(uint32_t width, uint32_t height, int32_t step, const Guide* guides, const XMFLOAT4A* input,
+                     Settings settings, XMFLOAT4A* output)
+  {
+    parallel::for_range(height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = y * width + x;
+          const Guide& center = guides[i];
+
+          if (center.normal_depth.w <= 0.0f) {
+            output[i] = XMFLOAT4A(0.0f, 0.0f, 0.0f, 0.0f);
+            continue;
+          }
+
+          // the luminance edge stopping uses the variance blurred over 3x3, a single pixel's is too noisy
+          float variance = 0.0f;
+
+          for (int32_t dy = -1; dy <= 1; ++dy) {
+            for (int32_t dx = -1; dx <= 1; ++dx) {
+              int32_t qx = std::clamp((int32_t)x + dx, 0, (int32_t)width - 1);
+              int32_t qy = std::clamp((int32_t)y + dy, 0, (int32_t)height - 1);
+              variance += input[(size_t)qy * width + qx].w * GAUSSIAN[std::abs(dx)] * GAUSSIAN[std::abs(dy)];
+            }
+          }
+
+          XMVECTOR c = XMLoadFloat4A(&input[i]);
+          float luminance_p = luminance(c);
+          float luminance_scale = 1.0f / (settings.phi_color * std::sqrt(std::max(variance, 0.0f)) + 1e-6f);
+
+          XMVECTOR sum = XMVectorZero();
+          float wsum = 0.0f;
+
+          for (int32_t dy = -2; dy <= 2; ++dy) {
+            for (int32_t dx = -2; dx <= 2; ++dx) {
+              int32_t qx = (int32_t)x + dx * step;
+              int32_t qy = (int32_t)y + dy * step;
+
+              if (qx < 0 || qy < 0 || qx >= (int32_t)width || qy >= (int32_t)height) {
+                continue;
+              }
+
+              size_t j = (size_t)qy * width + qx;
+
+              if (guides[j].normal_depth.w <= 0.0f) {
+                continue;
+              }
+
+              XMVECTOR q = XMLoadFloat4A(&input[j]);
+              float offset_length = (float)step * std::sqrt((float)(dx*dx + dy*dy));
+
+              float w = KERNEL[std::abs(dx)] * KERNEL[std::abs(dy)];
+
+              if (dx != 0 || dy != 0) {
+                w *= edge_weight(center, guides[j], offset_length, luminance_p, luminance(q), luminance_scale, settings);
+              }
+
+              sum = XMVectorMultiplyAdd(q, XMVectorSet(w, w, w, w * w), sum);
+              wsum += w;
+            }
+          }
+
+          XMVECTOR norm = XMVectorSet(1.0f / wsum, 1.0f / wsum, 1.0f / wsum, 1.0f / (wsum * wsum));
+          XMStoreFloat4A(&output[i], sum * norm);
+        }
+      }
+    });
+  }
+
+  void denoise_frame(uint32_t width, uint32_t height, const restir::Surface* surfaces, const XMFLOAT3* illumination,
+                     FXMMATRIX prev_view_proj, Settings settings, History& history, XMFLOAT3* output)
+  {
+    size_t pixel_count = (size_t)width * height;
+    bool history_valid = history.width == width && history.height == height && !history.color.empty();
+
+    std::vector<Guide> guides(pixel_count);
+
+    parallel::for_range(height, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = y * width + x;
+          const restir::Surface& s = surfaces[i];
+
+          float gx = 0.0f;
+          float gy = 0.0f;
+
+          if (x > 0 && x + 1 < width) {
+            gx = std::abs(surfaces[i+1].depth - surfaces[i-1].depth) * 0.5f;
+          }
+
+          if (y > 0 && y + 1 < height) {
+            gy = std::abs(surfaces[i+width].depth - surfaces[i-width].depth) * 0.5f;
+          }
+
+          guides[i] = {
+            .normal_depth = XMFLOAT4A(s.normal.x, s.normal.y, s.normal.z, s.depth),
+            .depth_gradient = std::max(gx, gy),
+          };
+        }
+      }
+    });
+
+    std::vector<XMFLOAT4A> integrated(pixel_count);
+    std::vector<XMFLOAT2> moments(pixel_count);
+    std::vector<float> length(pixel_count);
+
+    // temporal integration, reprojected the same way the reservoir pass does it
+    restir::TemporalSettings reprojection = {
+      .depth_tolerance = settings.depth_tolerance,
+      .normal_tolerance = settings.normal_tolerance,
+    };
+
+    parallel::for_range(height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = y * width + x;
+          const restir::Surface& surface = surfaces[i];
+
+          if (surface.depth <= 0.0f) {
+            integrated[i] = XMFLOAT4A(0.0f, 0.0f, 0.0f, 0.0f);
+            moments[i] = XMFLOAT2(0.0f, 0.0f);
+            length[i] = 0.0f;
+            continue;
+          }
+
+          XMVECTOR c = XMLoadFloat3(&illumination[i]);
+          float l = luminance(c);
+
+          XMVECTOR prev_color = c;
+          XMFLOAT2 prev_moments = XMFLOAT2(l, l * l);
+          float prev_length = 0.0f;
+
+          size_t j;
+
+          if (history_valid && restir::reproject(surface, history.surfaces.data(), width, height, prev_view_proj, reprojection, &j) &&
+              history.length[j] > 0.0f) {
+            prev_color = XMLoadFloat4A(&history.color[j]);
+            prev_moments = history.moments[j];
+            prev_length = history.length[j];
+          }
+
+          // a plain average until the history is long enough for the exponential one to take over
+          float n = std::min(prev_length + 1.0f, 255.0f);
+          float alpha_color = std::max(settings.color_alpha, 1.0f / n);
+          float alpha_moments = std::max(settings.moments_alpha, 1.0f / n);
+
+          XMVECTOR color = XMVectorLerp(prev_color, c, alpha_color);
+
+          XMFLOAT2 m = {
+            prev_moments.x + (l - prev_moments.x) * alpha_moments,
+            prev_moments.y + (l * l - prev_moments.y) * alpha_moments,
+          };
+
+          XMStoreFloat4A(&integrated[i], XMVectorSetW(color, std::max(m.y - m.x * m.x, 0.0f)));
+          moments[i] = m;
+          length[i] = n;
+        }
+      }
+    });
+
+    std::vector<XMFLOAT4A> filtered(pixel_count);
+
+    parallel::for_range(height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = y * width + x;
+          filtered[i] = integrated[i];
+
+          if (length[i] > 0.0f && length[i] < 4.0f) {
+            filtered[i].w = spatial_variance(width, height, (int32_t)x, (int32_t)y, guides.data(), integrated.data(), settings) * (4.0f / length[i]);
+          }
+        }
+      }
+    });
+
+    // a-trous passes, the first one's output is what the next frame integrates into
+
+    uint32_t iterations = std::min(settings.iterations, MAX_ITERATIONS);
+
+    for (uint32_t k = 0; k < iterations; ++k) {
+      atrous(width, height, 1 << k, guides.data(), filtered.data(), settings, integrated.data());
+      std::swap(filtered, integrated);
+
+      if (k == 0) {
+        history.color = filtered;
+      }
+    }
+
+    if (iterations == 0) {
+      history.color = filtered;
+    }
+
+    for (size_t i = 0; i < pixel_count; ++i) {
+      output[i] = XMFLOAT3(filtered[i].x, filtered[i].y, filtered[i].z);
+    }
+
+    history.width = width;
+    history.height = height;
+    history.moments = std::move(moments);
+    history.length = std::move(length);
+    history.surfaces.assign(surfaces, surfaces + pixel_count);
+  }
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "restir.h"
+
+using namespace DirectX;
+
+// svgf for the half resolution lighting. illumination is integrated over frames through reprojection, its
+// variance tracked from luminance moments, and a-trous passes blur it along surfaces with edge stopping
+// on depth, normals and luminance scaled by that variance. cpu only for now, an hlsl port will follow it
+namespace denoise {
+  static constexpr uint32_t MAX_ITERATIONS = 8;
+
+  struct Settings {
+    uint32_t iterations;    // a-trous passes, the step doubles every pass starting at 1
+    float color_alpha;      // smallest weight of the new frame in the temporal average
+    float moments_alpha;
+    float phi_color;        // luminance differences are measured in this many standard deviations
+    float phi_normal;       // exponent of the cosine between normals
+    float phi_depth;        // depth difference allowed per pixel of depth gradient
+    float depth_tolerance;  // reprojection tests, same meaning as restir::TemporalSettings
+    float normal_tolerance;
+  };
+
+  static constexpr Settings DEFAULT_SETTINGS = {
+    .iterations = 5,
+    .color_alpha = 0.2f,
+    .moments_alpha = 0.2f,
+    .phi_color = 4.0f,
+    .phi_normal = 128.0f,
+    .phi_depth = 1.0f,
+    .depth_tolerance = 0.1f,
+    .normal_tolerance = 0.9f,
+  };
+
+  // what the next frame reprojects into, reset it when the resolution changes
+  struct History {
+    uint32_t width, height;
+    std::vector<XMFLOAT4A> color; // the first a-trous pass's output, w unused
+    std::vector<XMFLOAT2> moments; // luminance and luminance squared
+    std::vector<float> length;     // frames integrated, zero where nothing was
+    std::vector<restir::Surface> surfaces;
+  };
+
+  // illumination is lighting before the albedo is applied, so texture detail isn't blurred away.
+  // prev_view_proj is the matrix the history was rendered with. output can be illumination, it's read first
+  void denoise_frame(uint32_t width, uint32_t height, const restir::Surface* surfaces, const XMFLOAT3* illumination,
+                     FXMMATRIX prev_view_proj, Settings settings, History& history, XMFLOAT3* output);
+};
\ No newline at end of file
@@ -0,0 +1,640 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "hdri.h"
+#include "parallel.h"
+
+namespace hdri {
+  // Vose's alias method, an all zero table degrades to uniform
+  static void build_alias_table(const float* weights, uint32_t count, AliasEntry* table, std::vector<float>& scaled, std::vector<uint32_t>& small, std::vector<uint32_t>& large) {
+    double sum = 0.0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+      sum += weights[i];
+    }
+
+    if (sum <= 0.0) {
+      for (uint32_t i = 0; i < count; ++i) {
+        table[i] = AliasEntry{
+          .probability = 1.0f,
+          .alias = i,
+          .pdf = 1.0f,
+        };
+      }
+
+      return;
+    }
+
+    scaled.resize(count);
+    small.clear();
+    large.clear();
+
+    for (uint32_t i = 0; i < count; ++i) {
+      scaled[i] = (float)(weights[i] * count / sum);
+      table[i].pdf = scaled[i];
+
+      if (scaled[i] < 1.0f) {
+        small.push_back(i);
+      }
+      else {
+        large.push_back(i);
+      }
+    }
+
+    while (!small.empty() && !large.empty()) {
+      uint32_t s = small.back();
+      small.pop_back();
+
+      uint32_t l = large.back();
+      large.pop_back();
+
+      table[s].probability = scaled[s];
+      table[s].alias = l;
+
+      scaled[l] = (scaled[l] + scaled[s]) - 1.0f;
+
+      if (scaled[l] < 1.0f) {
+        small.push_back(l);
+      }
+      else {
+        large.push_back(l);
+      }
+    }
+
+    // whatever is left is 1 up to rounding
+    for (uint32_t i : small) {
+      table[i].probability = 1.0f;
+      table[i].alias = i;
+    }
+
+    for (uint32_t i : large) {
+      table[i].probability = 1.0f;
+      table[i].alias = i;
+    }
+  }
+
+  static uint32_t sample_alias(const AliasEntry* table, uint32_t count, float u) {
+    float x = u * (float)count;
+    uint32_t i = std::min((uint32_t)x, count - 1);
+    return (x - (float)i) < table[i].probability ? i : table[i].alias;
+  }
+
+  Distribution2D build_distribution(const float* weights, uint32_t width, uint32_t height) {
+    Distribution2D dist = {
+      .width = width,
+      .height = height,
+      .entries = std::vector<AliasEntry>(height + (size_t)width * height),
+    };
+
+    std::vector<float> row_sums(height);
+
+    parallel::for_range(height, 16, [&](size_t begin, size_t end) {
+      std::vector<float> scaled;
+      std::vector<uint32_t> small;
+      std::vector<uint32_t> large;
+
+      for (size_t y = begin; y < end; ++y) {
+        const float* row = weights + y * width;
+
+        double sum = 0.0;
+
+        for (uint32_t x = 0; x < width; ++x) {
+          sum += row[x];
+        }
+
+        row_sums[y] = (float)sum;
+        build_alias_table(row, width, dist.entries.data() + height + y * width, scaled, small, large);
+      }
+    });
+
+    std::vector<float> scaled;
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    build_alias_table(row_sums.data(), height, dist.entries.data(), scaled, small, large);
+
+    return dist;
+  }
+
+  XMFLOAT2 sample_distribution(const Distribution2D& dist, XMFLOAT4 u, float* pdf) {
+    const AliasEntry* marginal = dist.entries.data();
+
+    uint32_t y = sample_alias(marginal, dist.height, u.x);
+
+    const AliasEntry* conditional = marginal + dist.height + (size_t)y * dist.width;
+
+    uint32_t x = sample_alias(conditional, dist.width, u.y);
+
+    *pdf = marginal[y].pdf * conditional[x].pdf;
+
+    return XMFLOAT2(((float)x + u.z) / (float)dist.width, ((float)y + u.w) / (float)dist.height);
+  }
+
+  float distribution_pdf(const Distribution2D& dist, XMFLOAT2 uv) {
+    uint32_t x = std::min((uint32_t)std::max(uv.x * (float)dist.width, 0.0f), dist.width - 1);
+    uint32_t y = std::min((uint32_t)std::max(uv.y * (float)dist.height, 0.0f), dist.height - 1);
+
+    const AliasEntry* marginal = dist.entries.data();
+    const AliasEntry* conditional = marginal + dist.height + (size_t)y * dist.width;
+
+    return marginal[y].pdf * conditional[x].pdf;
+  }
+
+  XMFLOAT2 dir_to_equirect(FXMVECTOR dir) {
+    XMFLOAT3 d;
+    XMStoreFloat3(&d, dir);
+
+    // atan2 rather than asin keeps precision near the poles
+    float x = (std::atan2(d.x, d.z) / XM_PI) * 0.5f + 0.5f;
+    float y = std::atan2(std::sqrt(d.x * d.x + d.z * d.z), d.y) / XM_PI;
+
+    return XMFLOAT2(x, y);
+  }
+
+  XMVECTOR equirect_to_dir(XMFLOAT2 uv) {
+    float phi = (uv.x - 0.5f) * XM_2PI;
+    float theta = uv.y * XM_PI;
+
+    float sin_theta = std::sin(theta);
+
+    return XMVectorSet(sin_theta * std::sin(phi), std::cos(theta), sin_theta * std::cos(phi), 0.0f);
+  }
+
+  Distribution2D build_equirect_distribution(const float* rgb, uint32_t width, uint32_t height) {
+    std::vector<float> weights((size_t)width * height);
+
+    // rows near the poles cover less solid angle
+    parallel::for_range(height, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        float sin_theta = std::sin(XM_PI * ((float)y + 0.5f) / (float)height);
+
+        for (size_t x = 0; x < width; ++x) {
+          const float* c = rgb + (y * width + x) * 3;
+          float luminance = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+          weights[y * width + x] = std::max(luminance, 0.0f) * sin_theta;
+        }
+      }
+    });
+
+    return build_distribution(weights.data(), width, height);
+  }
+
+  // dw = sin(theta) dtheta dphi = 2 pi^2 sin(theta) du dv
+  static float equirect_jacobian(float v) {
+    float sin_theta = std::sin(v * XM_PI);
+    return 2.0f * XM_PI * XM_PI * sin_theta;
+  }
+
+  XMVECTOR sample_equirect(const Distribution2D& dist, XMFLOAT4 u, float* pdf) {
+    float uv_pdf;
+    XMFLOAT2 uv = sample_distribution(dist, u, &uv_pdf);
+
+    float jacobian = equirect_jacobian(uv.y);
+    *pdf = jacobian > 0.0f ? uv_pdf / jacobian : 0.0f;
+
+    return equirect_to_dir(uv);
+  }
+
+  float equirect_pdf(const Distribution2D& dist, FXMVECTOR dir) {
+    XMFLOAT2 uv = dir_to_equirect(dir);
+
+    float jacobian = equirect_jacobian(uv.y);
+    return jacobian > 0.0f ? distribution_pdf(dist, uv) / jacobian : 0.0f;
+  }
+
+  XMFLOAT2 dir_to_octahedral(FXMVECTOR dir) {
+    XMFLOAT3 d;
+    XMStoreFloat3(&d, dir);
+
+    float l1 = std::abs(d.x) + std::abs(d.y) + std::abs(d.z);
+    float x = d.x / l1;
+    float z = d.z / l1;
+
+    if (d.y < 0.0f) {
+      float folded_x = (1.0f - std::abs(z)) * (x >= 0.0f ? 1.0f : -1.0f);
+      float folded_z = (1.0f - std::abs(x)) * (z >= 0.0f ? 1.0f : -1.0f);
+
+      x = folded_x;
+      z = folded_z;
+    }
+
+    return XMFLOAT2(x * 0.5f + 0.5f, z * 0.5f + 0.5f);
+  }
+
+  XMVECTOR octahedral_to_dir(XMFLOAT2 uv) {
+    float x = uv.x * 2.0f - 1.0f;
+    float z = uv.y * 2.0f - 1.0f;
+    float y = 1.0f - std::abs(x) - std::abs(z);
+    float t = std::max(-y, 0.0f);
+
+    x += x >= 0.0f ? -t : t;
+    z += z >= 0.0f ? -t : t;
+
+    return XMVector3Normalize(XMVectorSet(x, y, z, 0.0f));
+  }
+
+  // a texel of area da projects onto the octahedron with the same area times sqrt(3), seen at
+  // distance |p| and a cosine of 1/(sqrt(3)|p|). that gives dw = da / |p|^3, and |p| = 1/l1(dir)
+  static float octahedral_jacobian(FXMVECTOR dir) {
+    float l1 = XMVectorGetX(XMVectorSum(XMVectorAndInt(XMVectorAbs(dir), g_XMSelect1110)));
+    return 4.0f * l1 * l1 * l1;
+  }
+
+  XMVECTOR layout_to_dir(Layout layout, XMFLOAT2 uv, float* jacobian) {
+    if (layout == Layout::EQUIRECT) {
+      *jacobian = equirect_jacobian(uv.y);
+      return equirect_to_dir(uv);
+    }
+
+    XMVECTOR dir = octahedral_to_dir(uv);
+    *jacobian = octahedral_jacobian(dir);
+
+    return dir;
+  }
+
+  Image equirect_to_octahedral(const Image& equirect, uint32_t size) {
+    Image result = {
+      .width = size,
+      .height = size,
+      .texels = std::vector<float>((size_t)size * size * 3),
+    };
+
+    parallel::for_range(size, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+          XMVECTOR sum = XMVectorZero();
+
+          for (uint32_t i = 0; i < 4; ++i) {
+            XMFLOAT2 uv(((float)x + 0.25f + 0.5f * (float)(i % 2)) / (float)size, ((float)y + 0.25f + 0.5f * (float)(i / 2)) / (float)size);
+            sum += sample_bilinear(equirect, dir_to_equirect(octahedral_to_dir(uv)), Layout::EQUIRECT);
+          }
+
+          XMStoreFloat3((XMFLOAT3*)(result.texels.data() + (y * size + x) * 3), sum * 0.25f);
+        }
+      }
+    });
+
+    return result;
+  }
+
+  Distribution2D build_octahedral_distribution(const float* rgb, uint32_t size) {
+    std::vector<float> weights((size_t)size * size);
+
+    parallel::for_range(size, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (size_t x = 0; x < size; ++x) {
+          XMFLOAT2 uv(((float)x + 0.5f) / (float)size, ((float)y + 0.5f) / (float)size);
+
+          const float* c = rgb + (y * size + x) * 3;
+          float luminance = 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+          weights[y * size + x] = std::max(luminance, 0.0f) * octahedral_jacobian(octahedral_to_dir(uv));
+        }
+      }
+    });
+
+    return build_distribution(weights.data(), size, size);
+  }
+
+  XMVECTOR sample_octahedral(const Distribution2D& dist, XMFLOAT4 u, float* pdf) {
+    float uv_pdf;
+    XMFLOAT2 uv = sample_distribution(dist, u, &uv_pdf);
+
+    XMVECTOR dir = octahedral_to_dir(uv);
+    *pdf = uv_pdf / octahedral_jacobian(dir);
+
+    return dir;
+  }
+
+  float octahedral_pdf(const Distribution2D& dist, FXMVECTOR dir) {
+    return distribution_pdf(dist, dir_to_octahedral(dir)) / octahedral_jacobian(dir);
+  }
+
+  struct Tap {
+    int32_t index;
+    float weight;
+  };
+
+  static double bessel_i0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; k < 32; ++k) {
+      term *= (x * 0.5 / k) * (x * 0.5 / k);
+      sum += term;
+    }
+
+    return sum;
+  }
+
+  // kaiser windowed sinc, the same defaults as most texture tools
+  static float kaiser(float x) {
+    const float width = 3.0f;
+    const float alpha = 4.0f;
+
+    if (std::abs(x) >= width) {
+      return 0.0f;
+    }
+
+    float sinc = x == 0.0f ? 1.0f : std::sin(XM_PI * x) / (XM_PI * x);
+    float t = x / width;
+
+    return sinc * (float)(bessel_i0(alpha * std::sqrt(1.0f - t * t)) / bessel_i0(alpha));
+  }
+
+  // source taps for every destination texel along one axis, indices can land outside the image
+  static std::vector<std::vector<Tap>> compute_taps(uint32_t src, uint32_t dst, MipFilter filter) {
+    std::vector<std::vector<Tap>> result(dst);
+
+    float scale = (float)src / (float)dst;
+    float radius = filter == MipFilter::BOX ? 0.5f : 3.0f;
+
+    for (uint32_t i = 0; i < dst; ++i) {
+      float center = ((float)i + 0.5f) * scale;
+
+      int32_t first = (int32_t)std::floor(center - radius * scale);
+      int32_t last = (int32_t)std::ceil(center + radius * scale);
+
+      float total = 0.0f;
+
+      for (int32_t j = first; j <= last; ++j) {
+        float weight;
+
+        if (filter == MipFilter::BOX) {
+          // exact overlap, so odd sizes still cover every source texel once
+          weight = std::max(0.0f, std::min((float)j + 1.0f, center + 0.5f * scale) - std::max((float)j, center - 0.5f * scale));
+        }
+        else {
+          weight = kaiser(((float)j + 0.5f - center) / scale);
+        }
+
+        if (weight != 0.0f) {
+          result[i].push_back(Tap{j, weight});
+          total += weight;
+        }
+      }
+
+      for (auto& tap : result[i]) {
+        tap.weight /= total;
+      }
+    }
+
+    return result;
+  }
+
+  // out += weight * in over n floats
+  static void accumulate(float* out, const float* in, size_t n, float weight) {
+    XMVECTOR w = XMVectorReplicate(weight);
+
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+      XMVECTOR o = XMLoadFloat4((const XMFLOAT4*)(out + i));
+      o = XMVectorMultiplyAdd(w, XMLoadFloat4((const XMFLOAT4*)(in + i)), o);
+      XMStoreFloat4((XMFLOAT4*)(out + i), o);
+    }
+
+    for (; i < n; ++i) {
+      out[i] += weight * in[i];
+    }
+  }
+
+  static Image downsample(const Image& src, MipFilter filter, Layout layout) {
+    uint32_t w = src.width;
+    uint32_t h = src.height;
+
+    Image dst = {
+      .width = std::max(w / 2, 1u),
+      .height = std::max(h / 2, 1u),
+    };
+
+    auto row_taps = compute_taps(h, dst.height, filter);
+    auto col_taps = compute_taps(w, dst.width, filter);
+
+    std::vector<float> vertical((size_t)w * dst.height * 3);
+
+    // vertical pass, rows past the top or bottom come from the other side of the sphere,
+    // half a turn around for equirect and mirrored for octahedral
+    parallel::for_range(dst.height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        float* out = vertical.data() + y * w * 3;
+
+        for (const Tap& tap : row_taps[y]) {
+          int32_t j = tap.index;
+          bool flipped = false;
+
+          while (j < 0 || j >= (int32_t)h) {
+            j = j < 0 ? -1 - j : 2 * (int32_t)h - 1 - j;
+            flipped = !flipped;
+          }
+
+          const float* in = src.texels.data() + (size_t)j * w * 3;
+
+          if (flipped && layout == Layout::OCTAHEDRAL) {
+            for (size_t x = 0; x < w; ++x) {
+              accumulate(out + x * 3, in + (w - 1 - x) * 3, 3, tap.weight);
+            }
+
+            continue;
+          }
+
+          size_t shift = flipped ? w / 2 : 0;
+
+          accumulate(out, in + shift * 3, (w - shift) * 3, tap.weight);
+          accumulate(out + (w - shift) * 3, in, shift * 3, tap.weight);
+        }
+      }
+    });
+
+    dst.texels.resize((size_t)dst.width * dst.height * 3);
+
+    // horizontal pass wraps around for equirect. octahedral columns past an edge mirror,
+    // which also mirrors the row, and that row has already been filtered vertically
+    parallel::for_range(dst.height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        float* out = dst.texels.data() + y * dst.width * 3;
+
+        for (uint32_t x = 0; x < dst.width; ++x) {
+          XMVECTOR sum = XMVectorZero();
+
+          for (const Tap& tap : col_taps[x]) {
+            int32_t i = tap.index;
+            size_t row = y;
+
+            if (layout == Layout::EQUIRECT) {
+              i = ((i % (int32_t)w) + (int32_t)w) % (int32_t)w;
+            }
+            else {
+              while (i < 0 || i >= (int32_t)w) {
+                i = i < 0 ? -1 - i : 2 * (int32_t)w - 1 - i;
+                row = dst.height - 1 - row;
+              }
+            }
+
+            const float* in = vertical.data() + row * w * 3;
+            sum = XMVectorMultiplyAdd(XMVectorReplicate(tap.weight), XMLoadFloat3((const XMFLOAT3*)(in + i * 3)), sum);
+          }
+
+          // kaiser lobes can ring below zero around bright spots
+          if (filter == MipFilter::KAISER) {
+            sum = XMVectorMax(sum, XMVectorZero());
+          }
+
+          XMStoreFloat3((XMFLOAT3*)(out + x * 3), sum);
+        }
+      }
+    });
+
+    return dst;
+  }
+
+  std::vector<Image> build_mips(Image top, MipFilter filter, Layout layout) {
+    std::vector<Image> levels;
+    levels.push_back(std::move(top));
+
+    while (levels.back().width > 1 || levels.back().height > 1) {
+      Image next = downsample(levels.back(), filter, layout);
+      levels.push_back(std::move(next));
+    }
+
+    return levels;
+  }
+
+  void wrap_texel(Layout layout, uint32_t width, uint32_t height, int32_t* x, int32_t* y) {
+    int32_t w = (int32_t)width;
+    int32_t h = (int32_t)height;
+
+    // past a pole is the same latitude half a turn around
+    if (layout == Layout::EQUIRECT) {
+      if (*y < 0 || *y >= h) {
+        *y = std::clamp(*y < 0 ? -1 - *y : 2 * h - 1 - *y, 0, h - 1);
+        *x += w / 2;
+      }
+
+      *x = ((*x % w) + w) % w;
+      return;
+    }
+
+    if (*x < 0 || *x >= w) {
+      *x = std::clamp(*x < 0 ? -1 - *x : 2 * w - 1 - *x, 0, w - 1);
+      *y = h - 1 - *y;
+    }
+
+    if (*y < 0 || *y >= h) {
+      *y = std::clamp(*y < 0 ? -1 - *y : 2 * h - 1 - *y, 0, h - 1);
+      *x = w - 1 - *x;
+    }
+  }
+
+  XMVECTOR sample_bilinear(const Image& image, XMFLOAT2 uv, Layout layout) {
+    float x = uv.x * (float)image.width - 0.5f;
+    float y = uv.y * (float)image.height - 0.5f;
+
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+
+    auto texel = [&](int32_t tx, int32_t ty) {
+      wrap_texel(layout, image.width, image.height, &tx, &ty);
+      return XMLoadFloat3((const XMFLOAT3*)(image.texels.data() + ((size_t)ty * image.width + tx) * 3));
+    };
+
+    int32_t x0 = (int32_t)fx;
+    int32_t y0 = (int32_t)fy;
+
+    XMVECTOR top = XMVectorLerp(texel(x0, y0), texel(x0 + 1, y0), x - fx);
+    XMVECTOR bottom = XMVectorLerp(texel(x0, y0 + 1), texel(x0 + 1, y0 + 1), x - fx);
+
+    return XMVectorLerp(top, bottom, y - fy);
+  }
+
+  XMVECTOR sample_trilinear(const std::vector<Image>& mips, XMFLOAT2 uv, float lod, Layout layout) {
+    lod = std::clamp(lod, 0.0f, (float)(mips.size() - 1));
+
+    uint32_t level = (uint32_t)lod;
+    uint32_t next = std::min(level + 1, (uint32_t)mips.size() - 1);
+
+    return XMVectorLerp(sample_bilinear(mips[level], uv, layout), sample_bilinear(mips[next], uv, layout), lod - (float)level);
+  }
+
+  static XMFLOAT2 hammersley(uint32_t i, uint32_t count) {
+    uint32_t bits = i;
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555u) << 1) | ((bits & 0xAAAAAAAAu) >> 1);
+    bits = ((bits & 0x33333333u) << 2) | ((bits & 0xCCCCCCCCu) >> 2);
+    bits = ((bits & 0x0F0F0F0Fu) << 4) | ((bits & 0xF0F0F0F0u) >> 4);
+    bits = ((bits & 0x00FF00FFu) << 8) | ((bits & 0xFF00FF00u) >> 8);
+
+    return XMFLOAT2((float)i / (float)count, (float)bits * 2.3283064365386963e-10f);
+  }
+
+  // split sum prefilter with n = v = r, each sample reads a mip matching its footprint to avoid fireflies
+  std::vector<Image> prefilter_ggx(const std::vector<Image>& mips, Layout layout, uint32_t level_count, uint32_t sample_count) {
+    assert(!mips.empty() && level_count >= 2);
+
+    level_count = std::min(level_count, (uint32_t)mips.size());
+
+    std::vector<Image> levels;
+    levels.push_back(mips[0]);
+
+    float texel_solid_angle = 4.0f * XM_PI / ((float)mips[0].width * (float)mips[0].height);
+
+    for (uint32_t level = 1; level < level_count; ++level) {
+      float roughness = (float)level / (float)(level_count - 1);
+      float alpha = roughness * roughness;
+      float alpha2 = alpha * alpha;
+
+      Image result = {
+        .width = mips[level].width,
+        .height = mips[level].height,
+        .texels = std::vector<float>((size_t)mips[level].width * mips[level].height * 3),
+      };
+
+      parallel::for_range(result.height, 1, [&](size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+          for (uint32_t x = 0; x < result.width; ++x) {
+            XMFLOAT2 uv((x + 0.5f) / (float)result.width, (y + 0.5f) / (float)result.height);
+            XMVECTOR n = layout == Layout::EQUIRECT ? equirect_to_dir(uv) : octahedral_to_dir(uv);
+
+            XMVECTOR up = std::abs(XMVectorGetY(n)) < 0.999f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+            XMVECTOR t = XMVector3Normalize(XMVector3Cross(up, n));
+            XMVECTOR b = XMVector3Cross(n, t);
+
+            XMVECTOR sum = XMVectorZero();
+            float total = 0.0f;
+
+            for (uint32_t i = 0; i < sample_count; ++i) {
+              XMFLOAT2 xi = hammersley(i, sample_count);
+
+              float phi = XM_2PI * xi.x;
+              float cos_theta = std::sqrt((1.0f - xi.y) / (1.0f + (alpha2 - 1.0f) * xi.y));
+              float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+
+              XMVECTOR h = t * (sin_theta * std::cos(phi)) + b * (sin_theta * std::sin(phi)) + n * cos_theta;
+              XMVECTOR l = h * (2.0f * cos_theta) - n;
+
+              float n_dot_l = XMVectorGetX(XMVector3Dot(n, l));
+
+              if (n_dot_l <= 0.0f) {
+                continue;
+              }
+
+              // with n = v the pdf of l is D / 4
+              float d = alpha2 / (XM_PI * std::pow(cos_theta * cos_theta * (alpha2 - 1.0f) + 1.0f, 2.0f));
+              float sample_solid_angle = 4.0f / ((float)sample_count * d);
+              float lod = 0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f;
+
+              XMFLOAT2 l_uv = layout == Layout::EQUIRECT ? dir_to_equirect(l) : dir_to_octahedral(l);
+              sum = XMVectorMultiplyAdd(XMVectorReplicate(n_dot_l), sample_trilinear(mips, l_uv, lod, layout), sum);
+              total += n_dot_l;
+            }
+
+            XMStoreFloat3((XMFLOAT3*)(result.texels.data() + (y * result.width + x) * 3), total > 0.0f ? sum / total : sum);
+          }
+        }
+      });
+
+      levels.push_back(std::move(result));
+    }
+
+    return levels;
+  }
+};
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+using namespace DirectX;
+
+namespace hdri {
+  // float rgb, rows top to bottom
+  struct Image {
+    uint32_t width;
+    uint32_t height;
+    std::vector<float> texels;
+  };
+
+  enum class MipFilter {
+    BOX,
+    KAISER,
+  };
+
+  // how an image covers the sphere, which decides how filters and lookups continue past its edges
+  enum class Layout {
+    EQUIRECT,
+    OCTAHEDRAL,
+  };
+
+  // one alias table slot, must match environment.hlsli.
+  // pdf is the slot's own probability times the table size so lookups don't need the neighbours
+  struct AliasEntry {
+    float probability;
+    uint32_t alias;
+    float pdf;
+  };
+
+  // piecewise constant distribution over a width x height grid on the unit square.
+  // entries holds the marginal table over rows, followed by one conditional table per row
+  struct Distribution2D {
+    uint32_t width;
+    uint32_t height;
+    std::vector<AliasEntry> entries;
+  };
+
+  Distribution2D build_distribution(const float* weights, uint32_t width, uint32_t height);
+
+  // u.xy pick the cell, u.zw jitter inside it. pdf is with respect to area on the unit square
+  XMFLOAT2 sample_distribution(const Distribution2D& dist, XMFLOAT4 u, float* pdf);
+  float distribution_pdf(const Distribution2D& dist, XMFLOAT2 uv);
+
+  // equirect with u around the y axis and v from the top pole down
+  XMFLOAT2 dir_to_equirect(FXMVECTOR dir);
+  XMVECTOR equirect_to_dir(XMFLOAT2 uv);
+
+  // luminance times sin(theta) over a float rgb equirect
+  Distribution2D build_equirect_distribution(const float* rgb, uint32_t width, uint32_t height);
+
+  // pdfs are per unit solid angle
+  XMVECTOR sample_equirect(const Distribution2D& dist, XMFLOAT4 u, float* pdf);
+  float equirect_pdf(const Distribution2D& dist, FXMVECTOR dir);
+
+  // same mapping as dir_to_octahedral in common.hlsli. y is the pole and the
+  // lower hemisphere is folded over the diagonals, no transcendentals either way
+  XMFLOAT2 dir_to_octahedral(FXMVECTOR dir);
+  XMVECTOR octahedral_to_dir(XMFLOAT2 uv);
+
+  // direction through uv and the solid angle per unit uv area around it
+  XMVECTOR layout_to_dir(Layout layout, XMFLOAT2 uv, float* jacobian);
+
+  // resamples onto a size x size octahedral map with 2x2 bilinear taps per texel
+  Image equirect_to_octahedral(const Image& equirect, uint32_t size);
+
+  // luminance times the solid angle of each texel
+  Distribution2D build_octahedral_distribution(const float* rgb, uint32_t size);
+
+  XMVECTOR sample_octahedral(const Distribution2D& dist, XMFLOAT4 u, float* pdf);
+  float octahedral_pdf(const Distribution2D& dist, FXMVECTOR dir);
+
+  // full chain down to 1x1 with levels[0] being the source. equirect filters wrap horizontally and
+  // continue over the poles onto the opposite meridian, octahedral ones mirror across the edges,
+  // so seams don't bleed either way
+  std::vector<Image> build_mips(Image top, MipFilter filter, Layout layout);
+
+  // level i is prefiltered for ggx roughness i/(level_count-1) at the resolution of mip i
+  std::vector<Image> prefilter_ggx(const std::vector<Image>& mips, Layout layout, uint32_t level_count, uint32_t sample_count);
+
+  // moves a texel index that stepped up to one texel past an edge back onto the image,
+  // continuing the same way the mip filters do
+  void wrap_texel(Layout layout, uint32_t width, uint32_t height, int32_t* x, int32_t* y);
+
+  // lookups continue past the edges the same way the mip filters do
+  XMVECTOR sample_bilinear(const Image& image, XMFLOAT2 uv, Layout layout);
+  XMVECTOR sample_trilinear(const std::vector<Image>& mips, XMFLOAT2 uv, float lod, Layout layout);
+};
\ No newline at end of file
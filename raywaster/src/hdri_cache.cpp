@@ -0,0 +1,290 @@
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+
+#include "hdri_cache.h"
+#include "parallel.h"
+
+namespace hdri {
+  static constexpr uint32_t CACHE_MAGIC = 0x43564e45; // "ENVC"
+  static constexpr uint32_t CACHE_VERSION = 4;
+  static constexpr uint32_t MAX_CACHE_LEVELS = 16;
+  static constexpr uint32_t MAX_CACHE_LIGHTS = 8;
+
+  // every section starts on a page so a mapped file can be handed straight to the upload
+  static constexpr size_t CACHE_ALIGNMENT = 4096;
+
+  struct CacheLevel {
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+  };
+
+  struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t source_hash;
+
+    uint32_t level_count;
+    uint32_t distribution_width;
+    uint32_t distribution_height;
+    uint32_t encoding;
+    uint64_t distribution_offset;
+
+    CacheLevel levels[MAX_CACHE_LEVELS];
+
+    uint32_t light_count;
+    uint32_t reserved;
+    DiskLight lights[MAX_CACHE_LIGHTS];
+  };
+
+  static size_t align_up(size_t x) {
+    return (x + CACHE_ALIGNMENT - 1) & ~(CACHE_ALIGNMENT - 1);
+  }
+
+  static size_t distribution_entry_count(uint32_t width, uint32_t height) {
+    return height + (size_t)width * height;
+  }
+
+  uint64_t hash_bytes(const void* data, size_t size) {
+    const uint8_t* bytes = (const uint8_t*)data;
+
+    uint64_t h = 0xcbf29ce484222325ull ^ size;
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+      uint64_t word;
+      memcpy(&word, bytes + i, 8);
+      h = (h ^ word) * 0x100000001b3ull;
+      h ^= h >> 29;
+    }
+
+    for (; i < size; ++i) {
+      h = (h ^ bytes[i]) * 0x100000001b3ull;
+    }
+
+    return h ^ (h >> 32);
+  }
+
+  std::string cache_path(const char* directory, uint64_t source_hash) {
+    return std::format("{}/{:016x}.envc", directory, source_hash);
+  }
+
+  // validates everything against the blob size before pointing into it
+  static std::optional<Cache> parse_cache(std::shared_ptr<const uint8_t> storage, size_t size, uint64_t source_hash) {
+    if (size < sizeof(CacheHeader)) {
+      return std::nullopt;
+    }
+
+    CacheHeader header;
+    memcpy(&header, storage.get(), sizeof(header));
+
+    if (header.magic != CACHE_MAGIC || header.version != CACHE_VERSION || header.source_hash != source_hash) {
+      return std::nullopt;
+    }
+
+    if (header.level_count == 0 || header.level_count > MAX_CACHE_LEVELS || header.encoding > (uint32_t)TexelEncoding::BC6H || header.light_count > MAX_CACHE_LIGHTS) {
+      return std::nullopt;
+    }
+
+    Cache cache = {
+      .size = size,
+      .source_hash = source_hash,
+      .encoding = (TexelEncoding)header.encoding,
+      .lights = std::vector<DiskLight>(header.lights, header.lights + header.light_count),
+    };
+
+    for (uint32_t i = 0; i < header.level_count; ++i) {
+      CacheLevel level = header.levels[i];
+
+      if (level.offset % CACHE_ALIGNMENT != 0 || level.offset > size || encoded_size(cache.encoding, level.width, level.height) > size - level.offset) {
+        return std::nullopt;
+      }
+
+      cache.levels.push_back(PackedLevel{
+        .width = level.width,
+        .height = level.height,
+        .row_pitch = encoded_row_pitch(cache.encoding, level.width),
+        .texels = storage.get() + level.offset,
+      });
+    }
+
+    if (header.distribution_width) {
+      size_t count = distribution_entry_count(header.distribution_width, header.distribution_height);
+
+      if (header.distribution_offset > size || count * sizeof(AliasEntry) > size - header.distribution_offset) {
+        return std::nullopt;
+      }
+
+      const AliasEntry* entries = (const AliasEntry*)(storage.get() + header.distribution_offset);
+
+      cache.distribution = Distribution2D{
+        .width = header.distribution_width,
+        .height = header.distribution_height,
+        .entries = std::vector<AliasEntry>(entries, entries + count),
+      };
+    }
+
+    cache.storage = std::move(storage);
+
+    return cache;
+  }
+
+  std::optional<Cache> load_cache(const char* path, uint64_t source_hash) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+      return std::nullopt;
+    }
+
+    LARGE_INTEGER file_size = {};
+    GetFileSizeEx(file, &file_size);
+
+    HANDLE mapping = file_size.QuadPart ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+    CloseHandle(file);
+
+    if (!mapping) {
+      return std::nullopt;
+    }
+
+    const uint8_t* view = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+
+    if (!view) {
+      return std::nullopt;
+    }
+
+    std::shared_ptr<const uint8_t> storage(view, [](const uint8_t* p) { UnmapViewOfFile(p); });
+    size_t size = (size_t)file_size.QuadPart;
+#else
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+
+    if (!input) {
+      return std::nullopt;
+    }
+
+    size_t size = (size_t)input.tellg();
+    input.seekg(0);
+
+    std::shared_ptr<uint8_t[]> blob(new uint8_t[size]);
+    input.read((char*)blob.get(), (std::streamsize)size);
+
+    std::shared_ptr<const uint8_t> storage(blob, blob.get());
+#endif
+
+    return parse_cache(std::move(storage), size, source_hash);
+  }
+
+  Cache build_cache(uint64_t source_hash, const std::vector<Image>& mips, TexelEncoding encoding, const Distribution2D* distribution, const std::vector<DiskLight>& lights) {
+    assert(!mips.empty() && mips.size() <= MAX_CACHE_LEVELS);
+    assert(lights.size() <= MAX_CACHE_LIGHTS);
+
+    CacheHeader header = {
+      .magic = CACHE_MAGIC,
+      .version = CACHE_VERSION,
+      .source_hash = source_hash,
+      .level_count = (uint32_t)mips.size(),
+      .encoding = (uint32_t)encoding,
+      .light_count = (uint32_t)lights.size(),
+    };
+
+    std::copy(lights.begin(), lights.end(), header.lights);
+
+    size_t size = align_up(sizeof(CacheHeader));
+
+    for (size_t i = 0; i < mips.size(); ++i) {
+      header.levels[i] = CacheLevel{
+        .width = mips[i].width,
+        .height = mips[i].height,
+        .offset = size,
+      };
+
+      size = align_up(size + encoded_size(encoding, mips[i].width, mips[i].height));
+    }
+
+    if (distribution) {
+      header.distribution_width = distribution->width;
+      header.distribution_height = distribution->height;
+      header.distribution_offset = size;
+
+      size += distribution->entries.size() * sizeof(AliasEntry);
+    }
+
+    std::shared_ptr<uint8_t[]> blob(new uint8_t[size]());
+    memcpy(blob.get(), &header, sizeof(header));
+
+    for (size_t i = 0; i < mips.size(); ++i) {
+      encode_image(mips[i], encoding, blob.get() + header.levels[i].offset);
+    }
+
+    if (distribution) {
+      memcpy(blob.get() + header.distribution_offset, distribution->entries.data(), distribution->entries.size() * sizeof(AliasEntry));
+    }
+
+    std::shared_ptr<const uint8_t> storage(blob, blob.get());
+
+    return *parse_cache(std::move(storage), size, source_hash);
+  }
+
+  // written next to the destination first so a crash never leaves a truncated entry behind
+  bool write_cache(const char* path, const Cache& cache) {
+    std::error_code error;
+
+    std::filesystem::path destination(path);
+
+    if (destination.has_parent_path()) {
+      std::filesystem::create_directories(destination.parent_path(), error);
+    }
+
+    std::filesystem::path temp = destination;
+    temp += ".tmp";
+
+    {
+      std::ofstream output(temp, std::ios::binary | std::ios::trunc);
+      output.write((const char*)cache.storage.get(), (std::streamsize)cache.size);
+
+      if (!output) {
+        return false;
+      }
+    }
+
+    std::filesystem::rename(temp, destination, error);
+
+    return !error;
+  }
+
+  XMVECTOR load_texel(const Cache& cache, uint32_t level, uint32_t x, uint32_t y) {
+    const PackedLevel& packed = cache.levels[level];
+    return load_encoded(packed.texels, cache.encoding, packed.width, x, y);
+  }
+
+  Image unpack_level(const Cache& cache, uint32_t level) {
+    const PackedLevel& packed = cache.levels[level];
+
+    Image image = {
+      .width = packed.width,
+      .height = packed.height,
+      .texels = std::vector<float>((size_t)packed.width * packed.height * 3),
+    };
+
+    parallel::for_range(packed.height, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < packed.width; ++x) {
+          XMStoreFloat3((XMFLOAT3*)(image.texels.data() + (y * packed.width + x) * 3), load_encoded(packed.texels, cache.encoding, packed.width, x, (uint32_t)y));
+        }
+      }
+    });
+
+    return image;
+  }
+};
\ No newline at end of file
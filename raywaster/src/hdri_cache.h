@@ -0,0 +1,46 @@
+#pragma once
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "hdri.h"
+#include "hdri_encode.h"
+#include "hdri_lights.h"
+
+namespace hdri {
+  // rows are row_pitch bytes apart so a level can be uploaded as is
+  struct PackedLevel {
+    uint32_t width;
+    uint32_t height;
+    size_t row_pitch;
+    const void* texels;
+  };
+
+  // levels point into storage, which is either the mapped cache file or a freshly built blob
+  struct Cache {
+    std::shared_ptr<const uint8_t> storage;
+    size_t size;
+
+    uint64_t source_hash;
+    TexelEncoding encoding;
+    std::vector<PackedLevel> levels;
+    Distribution2D distribution; // empty if the entry was built without one
+    std::vector<DiskLight> lights;
+  };
+
+  uint64_t hash_bytes(const void* data, size_t size);
+
+  // entries are named after the hash of the source file, so an edited source never hits a stale one
+  std::string cache_path(const char* directory, uint64_t source_hash);
+
+  std::optional<Cache> load_cache(const char* path, uint64_t source_hash);
+  Cache build_cache(uint64_t source_hash, const std::vector<Image>& mips, TexelEncoding encoding, const Distribution2D* distribution, const std::vector<DiskLight>& lights);
+  bool write_cache(const char* path, const Cache& cache);
+
+  XMVECTOR load_texel(const Cache& cache, uint32_t level, uint32_t x, uint32_t y);
+
+  // decodes a whole level back to float rgb
+  Image unpack_level(const Cache& cache, uint32_t level);
+};
\ No newline at end of file
@@ -0,0 +1,413 @@
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+
+#include "hdri_encode.h"
+#include "parallel.h"
+
+using namespace DirectX::PackedVector;
+
+namespace hdri {
+  static constexpr uint32_t BC6H_MODE_11 = 0x03;
+  static constexpr uint32_t BC6H_INDEX_OFFSET = 65;
+
+  // largest finite half, BC6H_UF16 can't hold anything above it
+  static constexpr uint32_t BC6H_MAX_HALF = 0x7bff;
+
+  static constexpr int BC6H_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+  size_t encoded_row_pitch(TexelEncoding encoding, uint32_t width) {
+    switch (encoding) {
+      case TexelEncoding::RGBA16F:
+        return (size_t)width * 4 * sizeof(HALF);
+      case TexelEncoding::RGB9E5:
+        return (size_t)width * sizeof(uint32_t);
+      case TexelEncoding::BC6H:
+        return (size_t)((width + 3) / 4) * sizeof(BC6HBlock);
+    }
+
+    assert(false);
+    return 0;
+  }
+
+  size_t encoded_size(TexelEncoding encoding, uint32_t width, uint32_t height) {
+    size_t rows = encoding == TexelEncoding::BC6H ? (height + 3) / 4 : height;
+    return encoded_row_pitch(encoding, width) * rows;
+  }
+
+  static void write_bits(BC6HBlock& block, uint32_t& offset, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i, ++offset) {
+      block.bits[offset >> 6] |= (uint64_t)((value >> i) & 1) << (offset & 63);
+    }
+  }
+
+  static uint32_t read_bits(const BC6HBlock& block, uint32_t offset, uint32_t count) {
+    uint32_t value = 0;
+
+    for (uint32_t i = 0; i < count; ++i, ++offset) {
+      value |= (uint32_t)((block.bits[offset >> 6] >> (offset & 63)) & 1) << i;
+    }
+
+    return value;
+  }
+
+  // 10 bit endpoint to the 16 bit interpolation range
+  static int bc6h_unquantize(int x) {
+    if (x == 0) {
+      return 0;
+    }
+
+    if (x == 1023) {
+      return 0xffff;
+    }
+
+    return ((x << 16) + 0x8000) >> 10;
+  }
+
+  // interpolated value as half bits, including the final 31/64 scale of the unsigned format
+  static int bc6h_interpolate(int a, int b, int index) {
+    int w = BC6H_WEIGHTS[index];
+    return (((a * (64 - w) + b * w + 32) >> 6) * 31) >> 6;
+  }
+
+  // closest 10 bit endpoint for a value in half bits
+  static int bc6h_quantize(float h) {
+    int target = (int)std::lround(std::clamp(h, 0.0f, (float)BC6H_MAX_HALF));
+    int guess = std::clamp(target / 31, 0, 1023);
+
+    int best = guess;
+    int best_error = INT_MAX;
+
+    for (int x = std::max(guess - 1, 0); x <= std::min(guess + 1, 1023); ++x) {
+      int error = std::abs(((bc6h_unquantize(x) * 31) >> 6) - target);
+
+      if (error < best_error) {
+        best = x;
+        best_error = error;
+      }
+    }
+
+    return best;
+  }
+
+  struct BC6HFit {
+    int endpoints[2][3];
+    int indices[16];
+    int64_t error;
+  };
+
+  // picks the palette entry closest to every texel for already quantized endpoints
+  static BC6HFit bc6h_assign(const int texels[16][3], const int endpoints[2][3]) {
+    BC6HFit fit = {};
+    std::copy(&endpoints[0][0], &endpoints[0][0] + 6, &fit.endpoints[0][0]);
+
+    int palette[16][3];
+
+    for (int i = 0; i < 16; ++i) {
+      for (int c = 0; c < 3; ++c) {
+        palette[i][c] = bc6h_interpolate(bc6h_unquantize(endpoints[0][c]), bc6h_unquantize(endpoints[1][c]), i);
+      }
+    }
+
+    for (int t = 0; t < 16; ++t) {
+      int64_t best_error = INT64_MAX;
+
+      for (int i = 0; i < 16; ++i) {
+        int64_t error = 0;
+
+        for (int c = 0; c < 3; ++c) {
+          int64_t d = palette[i][c] - texels[t][c];
+          error += d * d;
+        }
+
+        if (error < best_error) {
+          best_error = error;
+          fit.indices[t] = i;
+        }
+      }
+
+      fit.error += best_error;
+    }
+
+    return fit;
+  }
+
+  static BC6HFit bc6h_fit(const int texels[16][3], XMVECTOR e0, XMVECTOR e1) {
+    XMFLOAT3 a, b;
+    XMStoreFloat3(&a, e0);
+    XMStoreFloat3(&b, e1);
+
+    int endpoints[2][3] = {
+      { bc6h_quantize(a.x), bc6h_quantize(a.y), bc6h_quantize(a.z) },
+      { bc6h_quantize(b.x), bc6h_quantize(b.y), bc6h_quantize(b.z) },
+    };
+
+    return bc6h_assign(texels, endpoints);
+  }
+
+  // interpolation happens on half bit patterns, so the fit is done there too, which
+  // roughly weights errors relative to brightness
+  BC6HBlock encode_bc6h_block(const XMFLOAT3 texels[16]) {
+    int h[16][3];
+    XMVECTOR points[16];
+    XMVECTOR mean = XMVectorZero();
+    XMVECTOR lower = XMVectorReplicate((float)BC6H_MAX_HALF);
+    XMVECTOR upper = XMVectorZero();
+
+    for (int t = 0; t < 16; ++t) {
+      const float* rgb = &texels[t].x;
+
+      for (int c = 0; c < 3; ++c) {
+        float f = rgb[c] > 0.0f ? rgb[c] : 0.0f; // also catches nan
+        h[t][c] = std::min((int)XMConvertFloatToHalf(f), (int)BC6H_MAX_HALF);
+      }
+
+      points[t] = XMVectorSet((float)h[t][0], (float)h[t][1], (float)h[t][2], 0.0f);
+      mean += points[t];
+      lower = XMVectorMin(lower, points[t]);
+      upper = XMVectorMax(upper, points[t]);
+    }
+
+    mean /= 16.0f;
+
+    XMVECTOR cov[3] = { XMVectorZero(), XMVectorZero(), XMVectorZero() };
+
+    for (int t = 0; t < 16; ++t) {
+      XMVECTOR d = points[t] - mean;
+      cov[0] += d * XMVectorSplatX(d);
+      cov[1] += d * XMVectorSplatY(d);
+      cov[2] += d * XMVectorSplatZ(d);
+    }
+
+    // principal axis by power iteration, rescaled each step to stay in range
+    XMVECTOR axis = XMVectorSet(1.0f, 1.0f, 1.0f, 0.0f);
+
+    for (int i = 0; i < 8; ++i) {
+      axis = cov[0] * XMVectorSplatX(axis) + cov[1] * XMVectorSplatY(axis) + cov[2] * XMVectorSplatZ(axis);
+
+      float length = XMVectorGetX(XMVector3Length(axis));
+
+      if (length < 1e-6f) {
+        axis = XMVectorZero();
+        break;
+      }
+
+      axis /= length;
+    }
+
+    float t_min = 0.0f;
+    float t_max = 0.0f;
+
+    for (int t = 0; t < 16; ++t) {
+      float d = XMVectorGetX(XMVector3Dot(points[t] - mean, axis));
+      t_min = std::min(t_min, d);
+      t_max = std::max(t_max, d);
+    }
+
+    // endpoints are kept inside the block's bounds, extrapolating past a black texel costs a lot of range
+    BC6HFit fit = bc6h_fit(h, XMVectorClamp(mean + axis * t_min, lower, upper), XMVectorClamp(mean + axis * t_max, lower, upper));
+
+    // refit the endpoints by least squares against the chosen weights while it keeps helping
+    for (int iteration = 0; iteration < 2; ++iteration) {
+      float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+      XMVECTOR ra = XMVectorZero();
+      XMVECTOR rb = XMVectorZero();
+
+      for (int t = 0; t < 16; ++t) {
+        float w = BC6H_WEIGHTS[fit.indices[t]] / 64.0f;
+
+        aa += (1.0f - w) * (1.0f - w);
+        ab += (1.0f - w) * w;
+        bb += w * w;
+
+        ra += points[t] * (1.0f - w);
+        rb += points[t] * w;
+      }
+
+      float det = aa * bb - ab * ab;
+
+      if (std::abs(det) < 1e-6f) {
+        break;
+      }
+
+      XMVECTOR e0 = XMVectorClamp((ra * bb - rb * ab) / det, lower, upper);
+      XMVECTOR e1 = XMVectorClamp((rb * aa - ra * ab) / det, lower, upper);
+
+      BC6HFit refined = bc6h_fit(h, e0, e1);
+
+      if (refined.error >= fit.error) {
+        break;
+      }
+
+      fit = refined;
+    }
+
+    // the anchor index is stored without its top bit, flipping the endpoints mirrors the palette
+    if (fit.indices[0] >= 8) {
+      for (int c = 0; c < 3; ++c) {
+        std::swap(fit.endpoints[0][c], fit.endpoints[1][c]);
+      }
+
+      for (int t = 0; t < 16; ++t) {
+        fit.indices[t] = 15 - fit.indices[t];
+      }
+    }
+
+    BC6HBlock block = {};
+    uint32_t offset = 0;
+
+    write_bits(block, offset, BC6H_MODE_11, 5);
+
+    for (int e = 0; e < 2; ++e) {
+      for (int c = 0; c < 3; ++c) {
+        write_bits(block, offset, (uint32_t)fit.endpoints[e][c], 10);
+      }
+    }
+
+    assert(offset == BC6H_INDEX_OFFSET);
+
+    for (int t = 0; t < 16; ++t) {
+      write_bits(block, offset, (uint32_t)fit.indices[t], t == 0 ? 3 : 4);
+    }
+
+    assert(offset == 128);
+
+    return block;
+  }
+
+  XMVECTOR decode_bc6h_texel(const BC6HBlock& block, uint32_t index) {
+    assert(read_bits(block, 0, 5) == BC6H_MODE_11);
+
+    uint32_t weight = index == 0 ? read_bits(block, BC6H_INDEX_OFFSET, 3) : read_bits(block, BC6H_INDEX_OFFSET - 1 + index * 4, 4);
+
+    float rgb[3];
+
+    for (uint32_t c = 0; c < 3; ++c) {
+      int a = bc6h_unquantize((int)read_bits(block, 5 + c * 10, 10));
+      int b = bc6h_unquantize((int)read_bits(block, 35 + c * 10, 10));
+      rgb[c] = XMConvertHalfToFloat((HALF)bc6h_interpolate(a, b, (int)weight));
+    }
+
+    return XMVectorSet(rgb[0], rgb[1], rgb[2], 1.0f);
+  }
+
+  void encode_image(const Image& image, TexelEncoding encoding, void* out) {
+    size_t pitch = encoded_row_pitch(encoding, image.width);
+
+    switch (encoding) {
+      case TexelEncoding::RGBA16F: {
+        // alpha is 1
+        parallel::for_range(image.height, 16, [&](size_t begin, size_t end) {
+          for (size_t y = begin; y < end; ++y) {
+            HALF* row = (HALF*)((uint8_t*)out + y * pitch);
+            const float* in = image.texels.data() + y * image.width * 3;
+
+            for (size_t c = 0; c < 3; ++c) {
+              XMConvertFloatToHalfStream(row + c, 4 * sizeof(HALF), in + c, 3 * sizeof(float), image.width);
+            }
+
+            for (size_t x = 0; x < image.width; ++x) {
+              row[x * 4 + 3] = 0x3c00;
+            }
+          }
+        });
+      } break;
+
+      case TexelEncoding::RGB9E5: {
+        parallel::for_range(image.height, 16, [&](size_t begin, size_t end) {
+          for (size_t y = begin; y < end; ++y) {
+            XMFLOAT3SE* row = (XMFLOAT3SE*)((uint8_t*)out + y * pitch);
+            const XMFLOAT3* in = (const XMFLOAT3*)image.texels.data() + y * image.width;
+
+            for (size_t x = 0; x < image.width; ++x) {
+              XMStoreFloat3SE(&row[x], XMVectorMax(XMLoadFloat3(&in[x]), XMVectorZero()));
+            }
+          }
+        });
+      } break;
+
+      case TexelEncoding::BC6H: {
+        uint32_t blocks_wide = (image.width + 3) / 4;
+        uint32_t blocks_high = (image.height + 3) / 4;
+
+        parallel::for_range(blocks_high, 1, [&](size_t begin, size_t end) {
+          for (size_t by = begin; by < end; ++by) {
+            BC6HBlock* row = (BC6HBlock*)((uint8_t*)out + by * pitch);
+
+            for (uint32_t bx = 0; bx < blocks_wide; ++bx) {
+              XMFLOAT3 texels[16];
+
+              // partial blocks repeat the edge texels
+              for (uint32_t i = 0; i < 16; ++i) {
+                size_t x = std::min(bx * 4 + i % 4, image.width - 1);
+                size_t y = std::min(by * 4 + i / 4, (size_t)image.height - 1);
+                texels[i] = ((const XMFLOAT3*)image.texels.data())[y * image.width + x];
+              }
+
+              row[bx] = encode_bc6h_block(texels);
+            }
+          }
+        });
+      } break;
+    }
+  }
+
+  XMVECTOR load_encoded(const void* texels, TexelEncoding encoding, uint32_t width, uint32_t x, uint32_t y) {
+    const uint8_t* row = (const uint8_t*)texels + (encoding == TexelEncoding::BC6H ? y / 4 : y) * encoded_row_pitch(encoding, width);
+
+    switch (encoding) {
+      case TexelEncoding::RGBA16F:
+        return XMLoadHalf4((const XMHALF4*)row + x);
+      case TexelEncoding::RGB9E5:
+        return XMVectorSetW(XMLoadFloat3SE((const XMFLOAT3SE*)row + x), 1.0f);
+      case TexelEncoding::BC6H:
+        return decode_bc6h_texel(((const BC6HBlock*)row)[x / 4], (y % 4) * 4 + x % 4);
+    }
+
+    assert(false);
+    return XMVectorZero();
+  }
+
+  EncodeError measure_error(const Image& reference, const void* texels, TexelEncoding encoding) {
+    std::vector<double> squared(reference.height);
+    std::vector<double> relative(reference.height);
+    std::vector<float> worst(reference.height);
+
+    parallel::for_range(reference.height, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        const XMFLOAT3* in = (const XMFLOAT3*)reference.texels.data() + y * reference.width;
+
+        for (uint32_t x = 0; x < reference.width; ++x) {
+          XMVECTOR expected = XMLoadFloat3(&in[x]);
+          XMVECTOR difference = XMVectorAbs(load_encoded(texels, encoding, reference.width, x, (uint32_t)y) - expected);
+          XMVECTOR r = difference / XMVectorMax(expected, XMVectorReplicate(1.0f / 256.0f));
+
+          squared[y] += XMVectorGetX(XMVector3Dot(difference, difference));
+          relative[y] += XMVectorGetX(XMVectorSum(XMVectorAndInt(r, g_XMSelect1110)));
+          worst[y] = std::max(worst[y], std::max(XMVectorGetX(r), std::max(XMVectorGetY(r), XMVectorGetZ(r))));
+        }
+      }
+    });
+
+    double total_squared = 0.0;
+    double total_relative = 0.0;
+    float max_relative = 0.0f;
+
+    for (uint32_t y = 0; y < reference.height; ++y) {
+      total_squared += squared[y];
+      total_relative += relative[y];
+      max_relative = std::max(max_relative, worst[y]);
+    }
+
+    double count = std::max((double)reference.width * reference.height * 3, 1.0);
+
+    return EncodeError{
+      .rmse = (float)std::sqrt(total_squared / count),
+      .mean_relative = (float)(total_relative / count),
+      .max_relative = max_relative,
+    };
+  }
+};
\ No newline at end of file
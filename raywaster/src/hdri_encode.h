@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "hdri.h"
+
+using namespace DirectX;
+
+namespace hdri {
+  // gpu texel layouts an environment level can be stored in, 8, 4 and 1 bytes per texel
+  enum class TexelEncoding {
+    RGBA16F,
+    RGB9E5,
+    BC6H,
+  };
+
+  // one BC6H_UF16 block covering 4x4 texels
+  struct BC6HBlock {
+    uint64_t bits[2];
+  };
+
+  // measured against the float source. relative errors divide by max(reference, 1/256)
+  // so near black texels don't dominate
+  struct EncodeError {
+    float rmse;
+    float mean_relative;
+    float max_relative;
+  };
+
+  // block encodings pad partial blocks at the right and bottom edges
+  size_t encoded_row_pitch(TexelEncoding encoding, uint32_t width);
+  size_t encoded_size(TexelEncoding encoding, uint32_t width, uint32_t height);
+
+  // out must hold encoded_size bytes, rows are encoded in parallel
+  void encode_image(const Image& image, TexelEncoding encoding, void* out);
+
+  XMVECTOR load_encoded(const void* texels, TexelEncoding encoding, uint32_t width, uint32_t x, uint32_t y);
+
+  // single region mode with 10 bit endpoints, fitted along the principal axis in half float space
+  BC6HBlock encode_bc6h_block(const XMFLOAT3 texels[16]);
+
+  // only decodes the mode encode_bc6h_block writes
+  XMVECTOR decode_bc6h_texel(const BC6HBlock& block, uint32_t index);
+
+  EncodeError measure_error(const Image& reference, const void* texels, TexelEncoding encoding);
+};
\ No newline at end of file
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cmath>
+
+#include "hdri_lights.h"
+#include "parallel.h"
+
+namespace hdri {
+  static float luminance(const float* c) {
+    return 0.2126f * c[0] + 0.7152f * c[1] + 0.0722f * c[2];
+  }
+
+  struct Region {
+    std::vector<uint32_t> texels;
+    float solid_angle;
+    XMVECTOR power;
+    XMVECTOR centroid;
+  };
+
+  std::vector<DiskLight> extract_lights(Image& image, Layout layout, LightExtractionSettings settings) {
+    uint32_t w = image.width;
+    uint32_t h = image.height;
+    size_t count = (size_t)w * h;
+
+    std::vector<float> solid_angles(count);
+    std::vector<XMFLOAT3> dirs(count);
+    std::vector<double> row_energy(h);
+
+    parallel::for_range(h, 16, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < w; ++x) {
+          size_t i = y * w + x;
+
+          float jacobian;
+          XMVECTOR dir = layout_to_dir(layout, XMFLOAT2(((float)x + 0.5f) / (float)w, ((float)y + 0.5f) / (float)h), &jacobian);
+
+          solid_angles[i] = jacobian / (float)count;
+          XMStoreFloat3(&dirs[i], dir);
+
+          row_energy[y] += std::max(luminance(image.texels.data() + i * 3), 0.0f) * solid_angles[i];
+        }
+      }
+    });
+
+    double energy = 0.0;
+
+    for (double e : row_energy) {
+      energy += e;
+    }
+
+    float threshold = settings.threshold * (float)(energy / (4.0 * XM_PI));
+
+    if (threshold <= 0.0f) {
+      return {};
+    }
+
+    auto is_bright = [&](size_t i) {
+      return luminance(image.texels.data() + i * 3) > threshold;
+    };
+
+    // bright texels are few, so the flood fill runs serially
+    std::vector<uint8_t> visited(count);
+    std::vector<uint32_t> stack;
+    std::vector<Region> regions;
+
+    for (size_t seed = 0; seed < count; ++seed) {
+      if (visited[seed] || !is_bright(seed)) {
+        continue;
+      }
+
+      Region region = {
+        .solid_angle = 0.0f,
+        .power = XMVectorZero(),
+        .centroid = XMVectorZero(),
+      };
+
+      visited[seed] = 1;
+      stack.push_back((uint32_t)seed);
+
+      while (!stack.empty()) {
+        uint32_t i = stack.back();
+        stack.pop_back();
+
+        const float* texel = image.texels.data() + (size_t)i * 3;
+
+        // only what's above the threshold moves into the light
+        XMVECTOR radiance = XMLoadFloat3((const XMFLOAT3*)texel);
+        XMVECTOR excess = radiance * (1.0f - threshold / luminance(texel)) * solid_angles[i];
+
+        region.texels.push_back(i);
+        region.solid_angle += solid_angles[i];
+        region.power += excess;
+        region.centroid += XMLoadFloat3(&dirs[i]) * XMVectorGetX(XMVector3Dot(excess, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f)));
+
+        const int32_t offsets[4][2] = { {-1, 0}, {1, 0}, {0, -1}, {0, 1} };
+
+        for (auto& offset : offsets) {
+          int32_t nx = (int32_t)(i % w) + offset[0];
+          int32_t ny = (int32_t)(i / w) + offset[1];
+          wrap_texel(layout, w, h, &nx, &ny);
+
+          size_t j = (size_t)ny * w + nx;
+
+          if (!visited[j] && is_bright(j)) {
+            visited[j] = 1;
+            stack.push_back((uint32_t)j);
+          }
+        }
+      }
+
+      if (region.solid_angle <= settings.max_solid_angle) {
+        regions.push_back(std::move(region));
+      }
+    }
+
+    auto region_luminance = [](const Region& region) {
+      return XMVectorGetX(XMVector3Dot(region.power, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f)));
+    };
+
+    std::sort(regions.begin(), regions.end(), [&](const Region& a, const Region& b) {
+      return region_luminance(a) > region_luminance(b);
+    });
+
+    regions.resize(std::min(regions.size(), (size_t)settings.max_lights));
+
+    float total = 0.0f;
+
+    for (const Region& region : regions) {
+      total += region_luminance(region);
+    }
+
+    std::vector<DiskLight> lights;
+
+    for (const Region& region : regions) {
+      for (uint32_t i : region.texels) {
+        float* texel = image.texels.data() + (size_t)i * 3;
+        float scale = threshold / luminance(texel);
+
+        texel[0] *= scale;
+        texel[1] *= scale;
+        texel[2] *= scale;
+      }
+
+      DiskLight light = {
+        .cos_half_angle = 1.0f - region.solid_angle / XM_2PI,
+        .selection = region_luminance(region) / total,
+      };
+
+      XMStoreFloat3(&light.direction, XMVector3Normalize(region.centroid));
+      XMStoreFloat3(&light.radiance, region.power / region.solid_angle);
+
+      lights.push_back(light);
+    }
+
+    return lights;
+  }
+
+  float disk_solid_angle(const DiskLight& light) {
+    return XM_2PI * (1.0f - light.cos_half_angle);
+  }
+
+  static bool inside_disk(const DiskLight& light, FXMVECTOR dir) {
+    return XMVectorGetX(XMVector3Dot(dir, XMLoadFloat3(&light.direction))) >= light.cos_half_angle;
+  }
+
+  XMVECTOR sample_disk_lights(const std::vector<DiskLight>& lights, XMFLOAT3 u, float* pdf) {
+    size_t k = 0;
+    float sum = 0.0f;
+
+    for (; k + 1 < lights.size(); ++k) {
+      sum += lights[k].selection;
+
+      if (u.x < sum) {
+        break;
+      }
+    }
+
+    const DiskLight& light = lights[k];
+
+    // uniform over the cone
+    float cos_theta = 1.0f - u.y * (1.0f - light.cos_half_angle);
+    float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+    float phi = XM_2PI * u.z;
+
+    XMVECTOR n = XMLoadFloat3(&light.direction);
+    XMVECTOR up = std::abs(light.direction.y) < 0.999f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+    XMVECTOR t = XMVector3Normalize(XMVector3Cross(up, n));
+    XMVECTOR b = XMVector3Cross(n, t);
+
+    XMVECTOR dir = XMVector3Normalize(t * (sin_theta * std::cos(phi)) + b * (sin_theta * std::sin(phi)) + n * cos_theta);
+
+    // cones can overlap, so the pdf sums every light that could have produced dir
+    *pdf = disk_lights_pdf(lights, dir);
+
+    return dir;
+  }
+
+  float disk_lights_pdf(const std::vector<DiskLight>& lights, FXMVECTOR dir) {
+    float pdf = 0.0f;
+
+    for (const DiskLight& light : lights) {
+      if (inside_disk(light, dir)) {
+        pdf += light.selection / disk_solid_angle(light);
+      }
+    }
+
+    return pdf;
+  }
+
+  XMVECTOR disk_lights_radiance(const std::vector<DiskLight>& lights, FXMVECTOR dir) {
+    XMVECTOR radiance = XMVectorZero();
+
+    for (const DiskLight& light : lights) {
+      if (inside_disk(light, dir)) {
+        radiance += XMLoadFloat3(&light.radiance);
+      }
+    }
+
+    return radiance;
+  }
+};
\ No newline at end of file
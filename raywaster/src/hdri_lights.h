@@ -0,0 +1,37 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "hdri.h"
+
+using namespace DirectX;
+
+namespace hdri {
+  // a cone of constant radiance pulled out of the environment, must match environment.hlsli.
+  // selection is the probability of picking this light when sampling the lights
+  struct DiskLight {
+    XMFLOAT3 direction;
+    float cos_half_angle;
+    XMFLOAT3 radiance;
+    float selection;
+  };
+
+  struct LightExtractionSettings {
+    float threshold;         // texels brighter than this times the mean luminance can become lights
+    float max_solid_angle;   // regions covering more than this stay in the environment
+    uint32_t max_lights;
+  };
+
+  // finds compact bright regions and replaces them with disk lights of the same solid angle and power.
+  // the region's texels are clamped to the threshold in place, leaving the residual environment
+  std::vector<DiskLight> extract_lights(Image& image, Layout layout, LightExtractionSettings settings);
+
+  float disk_solid_angle(const DiskLight& light);
+
+  // combined over all lights, the same as the shader's light strategy
+  XMVECTOR sample_disk_lights(const std::vector<DiskLight>& lights, XMFLOAT3 u, float* pdf);
+  float disk_lights_pdf(const std::vector<DiskLight>& lights, FXMVECTOR dir);
+  XMVECTOR disk_lights_radiance(const std::vector<DiskLight>& lights, FXMVECTOR dir);
+};
\ No newline at end of file
@@ -0,0 +1,52 @@
+// for headers included by both c++ and hlsl, which only use what the two have in common. in c++ the hlsl types
+// and intrinsics they need come from namespace hlsl, which SHARED_NAMESPACE_BEGIN pulls into theirs
+
+#ifdef __cplusplus
+#pragma once
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace hlsl {
+  typedef uint32_t uint;
+
+  using std::abs;
+  using std::exp;
+  using std::max;
+  using std::min;
+  using std::pow;
+  using std::round;
+
+  inline float saturate(float x) {
+    return std::clamp(x, 0.0f, 1.0f);
+  }
+
+  inline uint f32tof16(float x) {
+    return DirectX::PackedVector::XMConvertFloatToHalf(x);
+  }
+
+  inline float f16tof32(uint x) {
+    return DirectX::PackedVector::XMConvertHalfToFloat((DirectX::PackedVector::HALF)x);
+  }
+
+  inline uint reversebits(uint x) {
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+  }
+};
+
+#define SHARED_NAMESPACE_BEGIN(name) namespace name { using namespace hlsl;
+#define SHARED_NAMESPACE_END };
+#define SHARED_FN inline
+#else
+#define SHARED_NAMESPACE_BEGIN(name)
+#define SHARED_NAMESPACE_END
+#define SHARED_FN
+#endif
\ No newline at end of file
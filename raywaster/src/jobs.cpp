@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <format>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "jobs.h"
+
+namespace jobs {
+  JobId Graph::add(const char* name, std::function<void()> fn, std::vector<JobId> dependencies) {
+    for (JobId dep : dependencies) {
+      assert(dep < jobs.size());
+    }
+
+    jobs.push_back(Job{
+      .name = name,
+      .fn = std::move(fn),
+      .dependencies = std::move(dependencies),
+      .main_thread = false,
+    });
+
+    return jobs.size() - 1;
+  }
+
+  JobId Graph::add_main(const char* name, std::function<void()> fn, std::vector<JobId> dependencies) {
+    JobId id = add(name, std::move(fn), std::move(dependencies));
+    jobs[id].main_thread = true;
+    return id;
+  }
+
+  void Graph::run() {
+    std::vector<std::vector<JobId>> dependents(jobs.size());
+    std::vector<size_t> remaining(jobs.size());
+
+    std::deque<JobId> ready;
+    std::deque<JobId> ready_main;
+
+    for (JobId id = 0; id < jobs.size(); ++id) {
+      remaining[id] = jobs[id].dependencies.size();
+
+      for (JobId dep : jobs[id].dependencies) {
+        dependents[dep].push_back(id);
+      }
+
+      if (remaining[id] == 0) {
+        (jobs[id].main_thread ? ready_main : ready).push_back(id);
+      }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t finished = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    auto elapsed_ms = [&]() {
+      return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto execute = [&](std::unique_lock<std::mutex>& lock, JobId id) {
+      lock.unlock();
+
+      Job& job = jobs[id];
+      job.start_ms = elapsed_ms();
+      job.fn();
+      job.end_ms = elapsed_ms();
+
+      lock.lock();
+      finished++;
+
+      for (JobId dependent : dependents[id]) {
+        if (--remaining[dependent] == 0) {
+          (jobs[dependent].main_thread ? ready_main : ready).push_back(dependent);
+        }
+      }
+
+      cv.notify_all();
+    };
+
+    // workers only ever take the general queue
+    auto worker = [&]() {
+      std::unique_lock lock(mutex);
+
+      for (;;) {
+        cv.wait(lock, [&]() { return !ready.empty() || finished == jobs.size(); });
+
+        if (ready.empty()) {
+          break;
+        }
+
+        JobId id = ready.front();
+        ready.pop_front();
+        execute(lock, id);
+      }
+    };
+
+    size_t worker_count = std::min(jobs.size(), (size_t)std::max(std::thread::hardware_concurrency(), 2u) - 1);
+
+    std::vector<std::thread> threads;
+
+    for (size_t i = 0; i < worker_count; ++i) {
+      threads.emplace_back(worker);
+    }
+
+    // the calling thread prefers its own queue but helps out with the rest
+    {
+      std::unique_lock lock(mutex);
+
+      for (;;) {
+        cv.wait(lock, [&]() { return !ready_main.empty() || !ready.empty() || finished == jobs.size(); });
+
+        if (!ready_main.empty()) {
+          JobId id = ready_main.front();
+          ready_main.pop_front();
+          execute(lock, id);
+        }
+        else if (!ready.empty()) {
+          JobId id = ready.front();
+          ready.pop_front();
+          execute(lock, id);
+        }
+        else {
+          break;
+        }
+      }
+    }
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+
+  void Graph::print_timings() const {
+    if (jobs.empty()) {
+      return;
+    }
+
+    // longest chain ending at each job, measured by job durations alone
+    std::vector<double> path_ms(jobs.size());
+    std::vector<JobId> previous(jobs.size(), (JobId)-1);
+
+    double wall_ms = 0.0;
+
+    for (JobId id = 0; id < jobs.size(); ++id) {
+      const Job& job = jobs[id];
+
+      double longest = 0.0;
+
+      for (JobId dep : job.dependencies) {
+        if (path_ms[dep] > longest) {
+          longest = path_ms[dep];
+          previous[id] = dep;
+        }
+      }
+
+      path_ms[id] = longest + (job.end_ms - job.start_ms);
+      wall_ms = std::max(wall_ms, job.end_ms);
+
+      std::cout << std::format("  {:<20} start {:8.2f} ms  took {:8.2f} ms\n", job.name, job.start_ms, job.end_ms - job.start_ms);
+    }
+
+    JobId last = (JobId)(std::max_element(path_ms.begin(), path_ms.end()) - path_ms.begin());
+
+    std::vector<JobId> chain;
+
+    for (JobId id = last; id != (JobId)-1; id = previous[id]) {
+      chain.push_back(id);
+    }
+
+    std::string path;
+
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      path += std::format("{}{} ({:.2f} ms)", path.empty() ? "" : " -> ", jobs[*it].name, jobs[*it].end_ms - jobs[*it].start_ms);
+    }
+
+    std::cout << std::format("critical path: {}\n", path);
+    std::cout << std::format("critical path total {:.2f} ms, wall {:.2f} ms\n", path_ms[last], wall_ms);
+  }
+};
\ No newline at end of file
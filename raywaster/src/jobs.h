@@ -0,0 +1,36 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace jobs {
+  using JobId = size_t;
+
+  struct Job {
+    const char* name;
+    std::function<void()> fn;
+    std::vector<JobId> dependencies;
+    bool main_thread;
+
+    // filled in by run, relative to the start of the graph
+    double start_ms;
+    double end_ms;
+  };
+
+  // jobs must be added after everything they depend on, so ids are already in topological order
+  struct Graph {
+    std::vector<Job> jobs;
+
+    JobId add(const char* name, std::function<void()> fn, std::vector<JobId> dependencies = {});
+
+    // for work that has to stay on the calling thread, e.g. anything touching the window
+    JobId add_main(const char* name, std::function<void()> fn, std::vector<JobId> dependencies = {});
+
+    // runs everything on worker threads plus the calling thread, returns once all jobs are done
+    void run();
+
+    // per job timings and the longest dependency chain
+    void print_timings() const;
+  };
+};
\ No newline at end of file
@@ -1,3 +1,4 @@
+#define NOMINMAX
 #include <Windows.h>
 #include <dxgi.h>
 #include <d3d11.h>
@@ -5,6 +6,7 @@
 #include <DirectXMath.h>
 
 #include <algorithm>
+#include <cmath>
 
 #include <iostream>
 #include <utility>
@@ -15,7 +17,19 @@
 #include <chrono>
 
 #include "model.h"
+#include "quantize.h"
 #include "bvh.h"
+#include "meshlet.h"
+#include "jobs.h"
+#include "hdri.h"
+#include "hdri_cache.h"
+#include "radiance.h"
+#include "sh.h"
+#include "reservoir_packing.h"
+#include "sampler.h"
+#include "trace.h"
+#include "pathtrace.h"
+#include "accumulation.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -24,20 +38,25 @@ using namespace DirectX;
 
 static constexpr DXGI_FORMAT SWAPCHAIN_FORMAT = DXGI_FORMAT_R8G8B8A8_UNORM;
 
+// must match DEBUG_VIEW_* in traversal_stats.h, everything but NONE shows a heatmap of that bvh traversal counter
+// summed over every ray a lighting pixel traced
+enum class DebugView : uint32_t {
+  NONE,
+  RAY_COUNT,
+  NODE_VISITS,
+  TRIANGLE_TESTS,
+  STACK_DEPTH,
+};
+
 static struct {
   bool closed;
   std::optional<std::pair<int32_t, int32_t>> resize;
   bool resized;
   XMFLOAT2 mouse_delta;
   float scroll_delta;
+  bool next_debug_view;
 } window_events;
 
-struct SerializedReservoir {
-  uint32_t y;
-  float w;
-  float factor;
-};
-
 struct FrameDependents {
   ID3D11Texture2D* swapchain_texture;
   ID3D11RenderTargetView* swapchain_rtv;
@@ -46,8 +65,38 @@ struct FrameDependents {
   ID3D11UnorderedAccessView* lighting_buffer_uav;
   ID3D11ShaderResourceView* lighting_buffer_srv;
 
-  ID3D11Buffer* reservoir_buffer;
-  ID3D11UnorderedAccessView* reservoir_buffer_uav;
+  // temporal output, the spatial pass reads it and writes the reservoirs lighting and the next frame use
+  ID3D11Buffer* temporal_reservoir_buffer;
+  ID3D11UnorderedAccessView* temporal_reservoir_buffer_uav;
+  ID3D11ShaderResourceView* temporal_reservoir_buffer_srv;
+
+  // reservoirs and the surfaces they were resampled for ping-pong between frames, so the
+  // reservoir pass can reuse last frame's while writing this frame's
+  ID3D11Buffer* reservoir_buffers[2];
+  ID3D11UnorderedAccessView* reservoir_buffer_uavs[2];
+  ID3D11ShaderResourceView* reservoir_buffer_srvs[2];
+
+  ID3D11Texture2D* surfaces[2];
+  ID3D11UnorderedAccessView* surfaces_uavs[2];
+  ID3D11ShaderResourceView* surfaces_srvs[2];
+
+  bool history_valid;
+
+  // radiance from the path traced bounces, ping-ponged so pixels that weren't traced this frame can reproject
+  // their surface's last path
+  ID3D11Texture2D* indirect_buffers[2];
+  ID3D11UnorderedAccessView* indirect_buffer_uavs[2];
+  ID3D11ShaderResourceView* indirect_buffer_srvs[2];
+
+  // lighting averaged over the frames since the view last changed, an accumulation::Pixel per lighting pixel.
+  // a structured buffer since cs_5_0 can't load from an R32G32B32A32_FLOAT texture uav
+  ID3D11Buffer* accumulation_buffer;
+  ID3D11UnorderedAccessView* accumulation_buffer_uav;
+
+  // a trace::TraversalStats per lighting pixel, summed over the rays it traced in every pass while a debug view is on
+  ID3D11Buffer* traversal_stats_buffer;
+  ID3D11UnorderedAccessView* traversal_stats_buffer_uav;
+  ID3D11ShaderResourceView* traversal_stats_buffer_srv;
 
   ID3D11Texture2D* depth_buffer;
   ID3D11DepthStencilView* dsv;
@@ -65,11 +114,33 @@ struct FrameDependents {
   uint32_t w, h;
 
   uint32_t lighting_w, lighting_h;
+  uint32_t lighting_lod; // the g-buffer mip the lighting buffer lines up with
 
   void release() {
     if (swapchain_texture) {
-      reservoir_buffer_uav->Release();
-      reservoir_buffer->Release();
+      for (uint32_t i = 0; i < 2; ++i) {
+        surfaces_srvs[i]->Release();
+        surfaces_uavs[i]->Release();
+        surfaces[i]->Release();
+        reservoir_buffer_srvs[i]->Release();
+        reservoir_buffer_uavs[i]->Release();
+        reservoir_buffers[i]->Release();
+        indirect_buffer_srvs[i]->Release();
+        indirect_buffer_uavs[i]->Release();
+        indirect_buffers[i]->Release();
+      }
+
+      temporal_reservoir_buffer_srv->Release();
+      temporal_reservoir_buffer_uav->Release();
+      temporal_reservoir_buffer->Release();
+
+      accumulation_buffer_uav->Release();
+      accumulation_buffer->Release();
+
+      traversal_stats_buffer_srv->Release();
+      traversal_stats_buffer_uav->Release();
+      traversal_stats_buffer->Release();
+
       gbuffer_normal_srv->Release();
       gbuffer_albedo_srv->Release();
       gbuffer_normal_rtv->Release();
@@ -88,7 +159,7 @@ struct FrameDependents {
     }
   }
 
-  void init(ID3D11Device* device, IDXGISwapChain* swapchain) {
+  void init(ID3D11Device* device, IDXGISwapChain* swapchain, uint32_t lod) {
     DXGI_SWAP_CHAIN_DESC swapchain_desc;
     swapchain->GetDesc(&swapchain_desc);
 
@@ -104,11 +175,13 @@ struct FrameDependents {
     device->CreateRenderTargetView(swapchain_texture, &swapchain_rtv_rtv_desc, &swapchain_rtv);
 
     D3D11_TEXTURE2D_DESC lighting_buffer_desc = {};
-    lighting_buffer_desc.Width = swapchain_desc.BufferDesc.Width >> 1;
-    lighting_buffer_desc.Height = swapchain_desc.BufferDesc.Height >> 1;
+    lighting_lod = lod;
+
+    lighting_buffer_desc.Width = swapchain_desc.BufferDesc.Width >> lighting_lod;
+    lighting_buffer_desc.Height = swapchain_desc.BufferDesc.Height >> lighting_lod;
     lighting_buffer_desc.MipLevels = 1;
     lighting_buffer_desc.ArraySize = 1;
-    lighting_buffer_desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    lighting_buffer_desc.Format = DXGI_FORMAT_R11G11B10_FLOAT; // must match tonemap::PackedColor
     lighting_buffer_desc.SampleDesc.Count = 1;
     lighting_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
     lighting_buffer_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
@@ -132,19 +205,66 @@ struct FrameDependents {
     device->CreateShaderResourceView(lighting_buffer, &lighting_buffer_srv_desc, &lighting_buffer_srv);
 
     D3D11_BUFFER_DESC reservoir_buffer_desc = {};
-    reservoir_buffer_desc.ByteWidth = lighting_buffer_desc.Width * lighting_buffer_desc.Height * sizeof(SerializedReservoir);
+    reservoir_buffer_desc.ByteWidth = lighting_buffer_desc.Width * lighting_buffer_desc.Height * sizeof(restir::PackedReservoir);
     reservoir_buffer_desc.Usage = D3D11_USAGE_DEFAULT;
-    reservoir_buffer_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
-    reservoir_buffer_desc.StructureByteStride = sizeof(SerializedReservoir);
+    reservoir_buffer_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+    reservoir_buffer_desc.StructureByteStride = sizeof(restir::PackedReservoir);
     reservoir_buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 
-    device->CreateBuffer(&reservoir_buffer_desc, nullptr, &reservoir_buffer);
-
     D3D11_UNORDERED_ACCESS_VIEW_DESC reservoir_buffer_uav_desc = {};
     reservoir_buffer_uav_desc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
     reservoir_buffer_uav_desc.Buffer.NumElements = lighting_buffer_desc.Width * lighting_buffer_desc.Height;
 
-    device->CreateUnorderedAccessView(reservoir_buffer, &reservoir_buffer_uav_desc, &reservoir_buffer_uav);
+    D3D11_SHADER_RESOURCE_VIEW_DESC reservoir_buffer_srv_desc = {};
+    reservoir_buffer_srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    reservoir_buffer_srv_desc.Buffer.NumElements = reservoir_buffer_uav_desc.Buffer.NumElements;
+
+    // normal and linear view depth
+    D3D11_TEXTURE2D_DESC surfaces_desc = {};
+    surfaces_desc.Width = lighting_buffer_desc.Width;
+    surfaces_desc.Height = lighting_buffer_desc.Height;
+    surfaces_desc.MipLevels = 1;
+    surfaces_desc.ArraySize = 1;
+    surfaces_desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
+    surfaces_desc.SampleDesc.Count = 1;
+    surfaces_desc.Usage = D3D11_USAGE_DEFAULT;
+    surfaces_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS | D3D11_BIND_SHADER_RESOURCE;
+
+    device->CreateBuffer(&reservoir_buffer_desc, nullptr, &temporal_reservoir_buffer);
+    device->CreateUnorderedAccessView(temporal_reservoir_buffer, &reservoir_buffer_uav_desc, &temporal_reservoir_buffer_uav);
+    device->CreateShaderResourceView(temporal_reservoir_buffer, &reservoir_buffer_srv_desc, &temporal_reservoir_buffer_srv);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+      device->CreateBuffer(&reservoir_buffer_desc, nullptr, &reservoir_buffers[i]);
+      device->CreateUnorderedAccessView(reservoir_buffers[i], &reservoir_buffer_uav_desc, &reservoir_buffer_uavs[i]);
+      device->CreateShaderResourceView(reservoir_buffers[i], &reservoir_buffer_srv_desc, &reservoir_buffer_srvs[i]);
+
+      device->CreateTexture2D(&surfaces_desc, nullptr, &surfaces[i]);
+      device->CreateUnorderedAccessView(surfaces[i], nullptr, &surfaces_uavs[i]);
+      device->CreateShaderResourceView(surfaces[i], nullptr, &surfaces_srvs[i]);
+
+      device->CreateTexture2D(&surfaces_desc, nullptr, &indirect_buffers[i]);
+      device->CreateUnorderedAccessView(indirect_buffers[i], nullptr, &indirect_buffer_uavs[i]);
+      device->CreateShaderResourceView(indirect_buffers[i], nullptr, &indirect_buffer_srvs[i]);
+    }
+
+    history_valid = false;
+
+    D3D11_BUFFER_DESC accumulation_buffer_desc = reservoir_buffer_desc;
+    accumulation_buffer_desc.ByteWidth = lighting_w * lighting_h * sizeof(accumulation::Pixel);
+    accumulation_buffer_desc.BindFlags = D3D11_BIND_UNORDERED_ACCESS;
+    accumulation_buffer_desc.StructureByteStride = sizeof(accumulation::Pixel);
+
+    device->CreateBuffer(&accumulation_buffer_desc, nullptr, &accumulation_buffer);
+    device->CreateUnorderedAccessView(accumulation_buffer, &reservoir_buffer_uav_desc, &accumulation_buffer_uav);
+
+    D3D11_BUFFER_DESC traversal_stats_buffer_desc = reservoir_buffer_desc;
+    traversal_stats_buffer_desc.ByteWidth = lighting_w * lighting_h * sizeof(trace::TraversalStats);
+    traversal_stats_buffer_desc.StructureByteStride = sizeof(trace::TraversalStats);
+
+    device->CreateBuffer(&traversal_stats_buffer_desc, nullptr, &traversal_stats_buffer);
+    device->CreateUnorderedAccessView(traversal_stats_buffer, &reservoir_buffer_uav_desc, &traversal_stats_buffer_uav);
+    device->CreateShaderResourceView(traversal_stats_buffer, &reservoir_buffer_srv_desc, &traversal_stats_buffer_srv);
 
     D3D11_TEXTURE2D_DESC depth_buffer_desc = {};
     depth_buffer_desc.Width = swapchain_desc.BufferDesc.Width;
@@ -301,6 +421,13 @@ static LRESULT window_proc(HWND window, UINT msg, WPARAM w_param, LPARAM l_param
       float delta = (float)GET_WHEEL_DELTA_WPARAM(w_param);
       window_events.scroll_delta += delta;
     } break;
+
+    case WM_KEYDOWN: {
+      // f1 steps through the traversal heatmaps and back to the image
+      if (w_param == VK_F1) {
+        window_events.next_debug_view = true;
+      }
+    } break;
   }
 
   return DefWindowProcA(window, msg, w_param, l_param);
@@ -321,11 +448,27 @@ static std::vector<char> load_bin(const char* path) {
   return std::vector(std::istreambuf_iterator<char>(input), {});
 }
 
+static DXGI_FORMAT hdri_texel_format(hdri::TexelEncoding encoding) {
+  switch (encoding) {
+    case hdri::TexelEncoding::RGBA16F:
+      return DXGI_FORMAT_R16G16B16A16_FLOAT;
+    case hdri::TexelEncoding::RGB9E5:
+      return DXGI_FORMAT_R9G9B9E5_SHAREDEXP;
+    case hdri::TexelEncoding::BC6H:
+      return DXGI_FORMAT_BC6H_UF16;
+  }
+
+  assert(false);
+  return DXGI_FORMAT_UNKNOWN;
+}
+
 struct CameraCbuffer {
   XMMATRIX inv_view;
   XMMATRIX inv_view_proj;
   XMMATRIX view_proj;
   uint32_t frame;
+  uint32_t lighting_lod;
+  DebugView debug_view;
 };
 
 template<typename T>
@@ -359,51 +502,64 @@ static std::pair<ID3D11Buffer*, ID3D11ShaderResourceView*> create_immutable_stru
   return {buffer, srv};
 }
 
-static Mesh combine_model(const Model& model) {
-  std::vector<XMFLOAT3> positions;
-  std::vector<XMFLOAT3> normals;
-  std::vector<XMFLOAT2> tex_coords;
-  std::vector<uint32_t> indices;
+template<typename T>
+static std::pair<ID3D11Buffer*, ID3D11ShaderResourceView*> create_dynamic_structured_buffer(ID3D11Device* device, size_t count) {
+  assert(count <= UINT_MAX);
 
-  uint32_t indices_offset = 0; 
+  D3D11_BUFFER_DESC buffer_desc = {};
+  buffer_desc.ByteWidth = (UINT)(std::max(count, (size_t)1) * sizeof(T));
+  buffer_desc.Usage = D3D11_USAGE_DYNAMIC;
+  buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  buffer_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+  buffer_desc.StructureByteStride = sizeof(T);
+  buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 
-  for (auto& instance : model.instances) {
-    auto& mesh = model.meshes[instance.mesh];
+  ID3D11Buffer* buffer = nullptr;
+  device->CreateBuffer(&buffer_desc, nullptr, &buffer);
 
-    for (auto idx : mesh.indices) {
-      indices.push_back(indices_offset + idx);
-    }
+  D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+  srv_desc.Format = DXGI_FORMAT_UNKNOWN;
+  srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+  srv_desc.Buffer.NumElements = (UINT)std::max(count, (size_t)1);
 
-    for (auto pos : mesh.positions) {
-      XMVECTOR p = {pos.x, pos.y, pos.z, 1.0f};
-      p = XMVector4Transform(p, instance.transform);
-      XMStoreFloat3(&pos, p);
-      positions.push_back(pos);
-    }
+  ID3D11ShaderResourceView* srv;
+  device->CreateShaderResourceView(buffer, &srv_desc, &srv);
 
-    for (auto norm : mesh.normals) {
-      XMVECTOR n = {norm.x, norm.y, norm.z, 0.0f};
-      n = XMVector3Normalize(XMVector4Transform(n, instance.transform));
-      XMStoreFloat3(&norm, n);
-      normals.push_back(norm);
-    }
+  return {buffer, srv};
+}
 
-    for (auto tc : mesh.tex_coords) {
-      tex_coords.push_back(tc);
-    }
+// byte address buffer, the data is zero padded to a multiple of 4 bytes
+static std::pair<ID3D11Buffer*, ID3D11ShaderResourceView*> create_immutable_raw_buffer(ID3D11Device* device, const void* data, size_t size) {
+  size_t padded_size = std::max((size + 3) & ~(size_t)3, (size_t)4);
+  assert(padded_size <= UINT_MAX);
 
-    assert(positions.size() == normals.size());
-    assert(positions.size() == tex_coords.size());
+  std::vector<uint8_t> padded(padded_size);
+  memcpy(padded.data(), data, size);
 
-    indices_offset = (uint32_t)positions.size();
-  }
+  D3D11_BUFFER_DESC buffer_desc = {};
+  buffer_desc.ByteWidth = (UINT)padded_size;
+  buffer_desc.Usage = D3D11_USAGE_IMMUTABLE;
+  buffer_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+  buffer_desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS;
 
-  return Mesh {
-    .positions = positions,
-    .normals = normals,
-    .tex_coords = tex_coords,
-    .indices = indices
+  D3D11_SUBRESOURCE_DATA initial_data = {
+    .pSysMem = padded.data(),
+    .SysMemPitch = buffer_desc.ByteWidth
   };
+
+  ID3D11Buffer* buffer = nullptr;
+  device->CreateBuffer(&buffer_desc, &initial_data, &buffer);
+
+  D3D11_SHADER_RESOURCE_VIEW_DESC srv_desc = {};
+  srv_desc.Format = DXGI_FORMAT_R32_TYPELESS;
+  srv_desc.ViewDimension = D3D11_SRV_DIMENSION_BUFFEREX;
+  srv_desc.BufferEx.NumElements = (UINT)(padded_size / 4);
+  srv_desc.BufferEx.Flags = D3D11_BUFFEREX_SRV_FLAG_RAW;
+
+  ID3D11ShaderResourceView* srv;
+  device->CreateShaderResourceView(buffer, &srv_desc, &srv);
+
+  return {buffer, srv};
 }
 
 static std::tuple<ID3D11ComputeShader*, uint32_t, uint32_t> create_compute_shader(ID3D11Device* device, const std::vector<char>& code) {
@@ -443,10 +599,63 @@ struct ConstantBuffer {
   }
 };
 
+struct SceneConstants {
+  XMFLOAT4 env_irradiance[sh::L2_COEFFICIENTS];
+  uint32_t index_width;
+  uint32_t env_light_count;
+};
+
 struct ReservoirConstants {
+  XMMATRIX view_proj;
+  XMMATRIX inv_view_proj;
+  XMMATRIX prev_view_proj;
   uint32_t width;
   uint32_t height;
   uint32_t frame;
+  uint32_t env_width;
+  uint32_t env_height;
+  float env_light_probability;
+  uint32_t history_valid;
+  uint32_t sampler_type;
+  uint32_t lighting_lod;
+  DebugView debug_view;
+};
+
+struct SpatialConstants {
+  XMMATRIX inv_view_proj;
+  uint32_t width;
+  uint32_t height;
+  uint32_t frame;
+  uint32_t spatial_count;
+  float spatial_radius;
+  uint32_t unbiased;
+  uint32_t lighting_lod;
+  DebugView debug_view;
+};
+
+struct IndirectConstants {
+  XMMATRIX inv_view_proj;
+  XMMATRIX prev_view_proj;
+  uint32_t width;
+  uint32_t height;
+  uint32_t frame;
+  uint32_t stride;
+  uint32_t max_bounces;
+  uint32_t roulette_start;
+  float albedo;
+  uint32_t env_width;
+  uint32_t env_height;
+  float env_light_probability;
+  uint32_t sampler_type;
+  uint32_t lighting_lod;
+  uint32_t history_valid;
+  DebugView debug_view;
+};
+
+struct AccumulationConstants {
+  uint32_t sample_count;
+  float target_error;
+  float correlation_length;
 };
 
 int main() {
@@ -476,109 +685,408 @@ int main() {
 
   auto [initial_w, initial_h] = window_size(window);
 
-  DXGI_SWAP_CHAIN_DESC swapchain_desc = {};
-  swapchain_desc.BufferDesc.Width = initial_w;
-  swapchain_desc.BufferDesc.Height = initial_h;
-  swapchain_desc.BufferDesc.Format = SWAPCHAIN_FORMAT;
-  swapchain_desc.SampleDesc.Count = 1;
-  swapchain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-  swapchain_desc.BufferCount = 3;
-  swapchain_desc.OutputWindow = window;
-  swapchain_desc.Windowed = TRUE;
-  swapchain_desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-
   IDXGISwapChain* swapchain = nullptr;
   ID3D11Device* device = nullptr;
   ID3D11DeviceContext* ctx = nullptr;
 
-  if(FAILED(D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, device_flags, nullptr, 0, D3D11_SDK_VERSION, &swapchain_desc, &swapchain, &device, nullptr, &ctx))) {
-    MessageBoxA(nullptr, "Failed to create D3D11 device.", "Error", 0);
-    return 1;
-  }
-
   FrameDependents frame_dependents = {};
-  frame_dependents.init(device, swapchain);
-
-  std::vector<char> lighting_cs_code = load_bin("bin/lighting_cs.cso");
-  std::vector<char> reservoir1_cs_code = load_bin("bin/reservoir1_cs.cso");
-  std::vector<char> gbuffer_vs_code = load_bin("bin/gbuffer_vs.cso");
-  std::vector<char> gbuffer_ps_code = load_bin("bin/gbuffer_ps.cso");
-  std::vector<char> screen_quad_vs_code = load_bin("bin/screen_quad_vs.cso");
-  std::vector<char> combine_ps_code = load_bin("bin/combine_ps.cso");
 
-  auto [lighting_cs, lighting_cs_thread_group_x, lighting_cs_thread_group_y] = create_compute_shader(device, lighting_cs_code);
-  auto [reservoir1_cs, reservoir1_cs_thread_group_x, reservoir1_cs_thread_group_y] = create_compute_shader(device, reservoir1_cs_code);
+  // lighting is rendered at 1/2^lighting_lod of the resolution on each axis and upsampled along the g-buffer's
+  // edges, 1 and 2 are half and quarter resolution
+  uint32_t lighting_lod = 1;
+
+  std::vector<char> lighting_cs_code;
+  std::vector<char> reservoir1_cs_code;
+  std::vector<char> reservoir2_cs_code;
+  std::vector<char> indirect_cs_code;
+  std::vector<char> gbuffer_vs_code;
+  std::vector<char> gbuffer_ps_code;
+  std::vector<char> screen_quad_vs_code;
+  std::vector<char> combine_ps_code;
+
+  ID3D11ComputeShader* lighting_cs = nullptr;
+  ID3D11ComputeShader* reservoir1_cs = nullptr;
+  ID3D11ComputeShader* reservoir2_cs = nullptr;
+  ID3D11ComputeShader* indirect_cs = nullptr;
+  uint32_t lighting_cs_thread_group_x, lighting_cs_thread_group_y;
+  uint32_t reservoir1_cs_thread_group_x, reservoir1_cs_thread_group_y;
+  uint32_t reservoir2_cs_thread_group_x, reservoir2_cs_thread_group_y;
+  uint32_t indirect_cs_thread_group_x, indirect_cs_thread_group_y;
 
   ID3D11VertexShader* gbuffer_vs = nullptr;
   ID3D11PixelShader* gbuffer_ps = nullptr;
-  device->CreateVertexShader(gbuffer_vs_code.data(), gbuffer_vs_code.size(), nullptr, &gbuffer_vs);
-  device->CreatePixelShader(gbuffer_ps_code.data(), gbuffer_ps_code.size(), nullptr, &gbuffer_ps);
-
   ID3D11VertexShader* screen_quad_vs = nullptr;
   ID3D11PixelShader* combine_ps = nullptr;
-  device->CreateVertexShader(screen_quad_vs_code.data(), screen_quad_vs_code.size(), nullptr, &screen_quad_vs);
-  device->CreatePixelShader(combine_ps_code.data(), combine_ps_code.size(), nullptr, &combine_ps);
 
-  D3D11_DEPTH_STENCIL_DESC depth_state_desc = {};
-  depth_state_desc.DepthEnable = TRUE;
-  depth_state_desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-  depth_state_desc.DepthFunc = D3D11_COMPARISON_GREATER;
+  std::optional<Model> model;
+  QuantizedMesh quantized_mesh;
+  Mesh mesh;
+  std::vector<bvh::Node> bvh;
+  meshlet::Meshlets meshlets;
+
+  ID3D11Buffer* positions_buf = nullptr;
+  ID3D11Buffer* normals_buf = nullptr;
+  ID3D11Buffer* tex_coords_buf = nullptr;
+  ID3D11Buffer* position_bounds_buf = nullptr;
+  ID3D11Buffer* indices_buf = nullptr;
+  ID3D11Buffer* bvh_buf = nullptr;
+  ID3D11ShaderResourceView* positions_srv = nullptr;
+  ID3D11ShaderResourceView* normals_srv = nullptr;
+  ID3D11ShaderResourceView* tex_coords_srv = nullptr;
+  ID3D11ShaderResourceView* position_bounds_srv = nullptr;
+  ID3D11ShaderResourceView* indices_srv = nullptr;
+  ID3D11ShaderResourceView* bvh_srv = nullptr;
+
+  ID3D11Buffer* meshlets_buf = nullptr;
+  ID3D11Buffer* meshlet_vertices_buf = nullptr;
+  ID3D11Buffer* meshlet_triangles_buf = nullptr;
+  ID3D11Buffer* visible_meshlets_buf = nullptr;
+  ID3D11ShaderResourceView* meshlets_srv = nullptr;
+  ID3D11ShaderResourceView* meshlet_vertices_srv = nullptr;
+  ID3D11ShaderResourceView* meshlet_triangles_srv = nullptr;
+  ID3D11ShaderResourceView* visible_meshlets_srv = nullptr;
+
+  sampler::BlueNoise blue_noise;
+  ID3D11Texture2D* blue_noise_texture = nullptr;
+  ID3D11ShaderResourceView* blue_noise_srv = nullptr;
+
+  const char* hdri_path = "sky/symmetrical_garden_02_4k.hdr";
+
+  std::vector<char> hdri_file;
+  uint64_t hdri_hash = 0;
+  std::optional<hdri::Cache> hdri_cache;
+  bool hdri_cache_hit = false;
+  std::optional<hdri::EncodeError> hdri_error;
+  sh::L2 env_irradiance = {};
+  float env_light_probability = 0.0f;
+
+  std::vector<hdri::Image> hdri_mips;
 
-  ID3D11DepthStencilState* depth_state = nullptr;
-  device->CreateDepthStencilState(&depth_state_desc, &depth_state);
+  ID3D11Texture2D* hdri = nullptr;
+  ID3D11ShaderResourceView* hdri_srv = nullptr;
 
-  Mesh mesh = combine_model(*load_gltf("models/test/scene.gltf"));
+  hdri::Distribution2D env_distribution;
+  ID3D11Buffer* env_distribution_buf = nullptr;
+  ID3D11ShaderResourceView* env_distribution_srv = nullptr;
+
+  std::vector<hdri::DiskLight> env_lights;
+  ID3D11Buffer* env_lights_buf = nullptr;
+  ID3D11ShaderResourceView* env_lights_srv = nullptr;
+
+  // startup runs as a job graph, file io and cpu work overlap with device creation and each other.
+  // device creation stays on this thread since the swapchain talks to the window
+  jobs::Graph startup;
+
+  jobs::JobId create_device = startup.add_main("create device", [&]() {
+    DXGI_SWAP_CHAIN_DESC swapchain_desc = {};
+    swapchain_desc.BufferDesc.Width = initial_w;
+    swapchain_desc.BufferDesc.Height = initial_h;
+    swapchain_desc.BufferDesc.Format = SWAPCHAIN_FORMAT;
+    swapchain_desc.SampleDesc.Count = 1;
+    swapchain_desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+    swapchain_desc.BufferCount = 3;
+    swapchain_desc.OutputWindow = window;
+    swapchain_desc.Windowed = TRUE;
+    swapchain_desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+
+    if(FAILED(D3D11CreateDeviceAndSwapChain(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, device_flags, nullptr, 0, D3D11_SDK_VERSION, &swapchain_desc, &swapchain, &device, nullptr, &ctx))) {
+      return;
+    }
 
-  std::vector<bvh::Node> bvh = bvh::construct_bvh(mesh.positions, mesh.indices);
+    frame_dependents.init(device, swapchain, lighting_lod);
+  });
+
+  jobs::JobId load_shaders = startup.add("load shaders", [&]() {
+    lighting_cs_code = load_bin("bin/lighting_cs.cso");
+    reservoir1_cs_code = load_bin("bin/reservoir1_cs.cso");
+    reservoir2_cs_code = load_bin("bin/reservoir2_cs.cso");
+    indirect_cs_code = load_bin("bin/indirect_cs.cso");
+    gbuffer_vs_code = load_bin("bin/gbuffer_vs.cso");
+    gbuffer_ps_code = load_bin("bin/gbuffer_ps.cso");
+    screen_quad_vs_code = load_bin("bin/screen_quad_vs.cso");
+    combine_ps_code = load_bin("bin/combine_ps.cso");
+  });
+
+  jobs::JobId load_model = startup.add("load gltf", [&]() {
+    model = load_gltf("models/test/scene.gltf");
+  });
+
+  // decoded environments are cached by source hash, a hit skips decoding, filtering and table building
+  jobs::JobId lookup_hdri = startup.add("hdri cache lookup", [&]() {
+    hdri_file = load_bin(hdri_path);
+    hdri_hash = hdri::hash_bytes(hdri_file.data(), hdri_file.size());
+    hdri_cache = hdri::load_cache(hdri::cache_path("cache", hdri_hash).c_str(), hdri_hash);
+    hdri_cache_hit = hdri_cache.has_value();
+  });
+
+  jobs::JobId decode_hdri = startup.add("decode hdri", [&]() {
+    if (hdri_cache || hdri_file.empty()) {
+      return;
+    }
 
-  auto [positions_buf, positions_srv]   = create_immutable_structured_buffer<XMFLOAT3>(device, mesh.positions.data(),  mesh.positions.size());
-  auto [normals_buf, normals_srv]       = create_immutable_structured_buffer<XMFLOAT3>(device, mesh.normals.data(),    mesh.normals.size());
-  auto [tex_coords_buf, tex_coords_srv] = create_immutable_structured_buffer<XMFLOAT2>(device, mesh.tex_coords.data(), mesh.tex_coords.size());
-  auto [indices_buf, indices_srv]       = create_immutable_structured_buffer<uint32_t>(device, mesh.indices.data(),    mesh.indices.size());
-  auto [bvh_buf, bvh_srv]               = create_immutable_structured_buffer<bvh::Node>(device, bvh.data(), bvh.size());
+    // our decoder handles the common rle rgbe case, anything else falls back to stb
+    if (std::optional<hdri::Image> image = hdri::load_hdr(hdri_file.data(), hdri_file.size())) {
+      hdri_mips.push_back(std::move(*image));
+      return;
+    }
 
-  int hdri_w, hdri_h;
-  float* hdri_data = stbi_loadf("sky/symmetrical_garden_02_4k.hdr", &hdri_w, &hdri_h, nullptr, 3);
+    int hdri_w, hdri_h;
+    float* hdri_data = stbi_loadf_from_memory((const stbi_uc*)hdri_file.data(), (int)hdri_file.size(), &hdri_w, &hdri_h, nullptr, 3);
 
-  if (!hdri_data) {
-    std::cout << "Failed to load hdri\n";
-    return 1;
+    if (hdri_data) {
+      hdri_mips.push_back(hdri::Image{
+        .width = (uint32_t)hdri_w,
+        .height = (uint32_t)hdri_h,
+        .texels = std::vector<float>(hdri_data, hdri_data + (size_t)hdri_w * hdri_h * 3),
+      });
+
+      stbi_image_free(hdri_data);
+    }
+  }, {lookup_hdri});
+
+  // everything downstream works on an octahedral map, half the equirect's width keeps at least its resolution around the horizon
+  jobs::JobId convert_hdri = startup.add("hdri octahedral", [&]() {
+    if (!hdri_mips.empty()) {
+      hdri_mips[0] = hdri::equirect_to_octahedral(hdri_mips[0], std::max(hdri_mips[0].width / 2, 1u));
+    }
+  }, {decode_hdri});
+
+  // suns and other small hot spots become analytic lights, everything after works on the residual
+  jobs::JobId extract_hdri_lights = startup.add("hdri lights", [&]() {
+    if (!hdri_mips.empty()) {
+      env_lights = hdri::extract_lights(hdri_mips[0], hdri::Layout::OCTAHEDRAL, hdri::LightExtractionSettings{
+        .threshold = 64.0f,
+        .max_solid_angle = 0.02f,
+        .max_lights = 4,
+      });
+    }
+  }, {convert_hdri});
+
+  jobs::JobId build_hdri_mips = startup.add("hdri mips", [&]() {
+    if (!hdri_mips.empty()) {
+      hdri_mips = hdri::build_mips(std::move(hdri_mips[0]), hdri::MipFilter::KAISER, hdri::Layout::OCTAHEDRAL);
+    }
+  }, {extract_hdri_lights});
+
+  jobs::JobId build_env_distribution = startup.add("hdri distribution", [&]() {
+    if (!hdri_mips.empty()) {
+      env_distribution = hdri::build_octahedral_distribution(hdri_mips[0].texels.data(), hdri_mips[0].width);
+    }
+  }, {build_hdri_mips});
+
+  jobs::JobId pack_hdri = startup.add("hdri pack", [&]() {
+    if (hdri_cache || hdri_mips.empty()) {
+      return;
+    }
+
+    // BC6H needs the top level to be whole blocks
+    hdri::TexelEncoding encoding = hdri_mips[0].width % 4 == 0 && hdri_mips[0].height % 4 == 0 ? hdri::TexelEncoding::BC6H : hdri::TexelEncoding::RGB9E5;
+
+    hdri_cache = hdri::build_cache(hdri_hash, hdri_mips, encoding, &env_distribution, env_lights);
+    hdri_error = hdri::measure_error(hdri_mips[0], hdri_cache->levels[0].texels, encoding);
+
+    hdri_mips.clear();
+    env_distribution = {};
+  }, {build_env_distribution});
+
+  // sh only holds low frequencies, so a level around 64 texels across projects as well as the full map
+  startup.add("hdri sh", [&]() {
+    if (!hdri_cache) {
+      return;
+    }
+
+    uint32_t level = 0;
+
+    while (level + 1 < hdri_cache->levels.size() && hdri_cache->levels[level].width > 64) {
+      ++level;
+    }
+
+    sh::L2 radiance = sh::project_environment(hdri::unpack_level(*hdri_cache, level), hdri::Layout::OCTAHEDRAL);
+
+    // the dc term integrates to the residual's total over the sphere
+    XMVECTOR luminance_weights = XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f);
+    float residual_power = XMVectorGetX(XMVector3Dot(XMLoadFloat3(&radiance.coefficients[0]), luminance_weights)) * std::sqrt(4.0f * XM_PI);
+    float light_power = 0.0f;
+
+    for (const hdri::DiskLight& light : hdri_cache->lights) {
+      XMVECTOR power = XMLoadFloat3(&light.radiance) * hdri::disk_solid_angle(light);
+      sh::add_directional(radiance, XMLoadFloat3(&light.direction), power);
+
+      light_power += XMVectorGetX(XMVector3Dot(power, luminance_weights));
+    }
+
+    env_irradiance = sh::convolve_cosine(radiance);
+
+    // lights get candidates in proportion to their power, but neither strategy is ever starved
+    // since each covers directions the other can't
+    if (!hdri_cache->lights.empty()) {
+      env_light_probability = std::clamp(light_power / std::max(light_power + residual_power, 1e-6f), 0.1f, 0.9f);
+    }
+  }, {pack_hdri});
+
+  startup.add("hdri cache write", [&]() {
+    if (hdri_cache && !hdri_cache_hit) {
+      hdri::write_cache(hdri::cache_path("cache", hdri_hash).c_str(), *hdri_cache);
+    }
+
+    hdri_file = {};
+  }, {pack_hdri});
+
+  // the gpu only gets the packed layout, the bvh and meshlets are built from what it decodes to so they agree exactly
+  jobs::JobId combine = startup.add("combine model", [&]() {
+    quantized_mesh = quantize_mesh(combine_model(*model));
+    mesh = dequantize_mesh(quantized_mesh);
+    model.reset();
+  }, {load_model});
+
+  jobs::JobId build_bvh = startup.add("build bvh", [&]() {
+    bvh = bvh::construct_bvh(mesh);
+  }, {combine});
+
+  jobs::JobId build_meshlets = startup.add("build meshlets", [&]() {
+    meshlets = meshlet::build_meshlets(mesh);
+  }, {combine});
+
+  jobs::JobId generate_blue_noise = startup.add("blue noise", [&]() {
+    blue_noise = sampler::generate_blue_noise(BLUE_NOISE_SIZE, 1);
+  });
+
+  // the rest only touches the device, which is free threaded
+  startup.add("create shaders", [&]() {
+    if (!device) {
+      return;
+    }
+
+    std::tie(lighting_cs, lighting_cs_thread_group_x, lighting_cs_thread_group_y) = create_compute_shader(device, lighting_cs_code);
+    std::tie(reservoir1_cs, reservoir1_cs_thread_group_x, reservoir1_cs_thread_group_y) = create_compute_shader(device, reservoir1_cs_code);
+    std::tie(reservoir2_cs, reservoir2_cs_thread_group_x, reservoir2_cs_thread_group_y) = create_compute_shader(device, reservoir2_cs_code);
+    std::tie(indirect_cs, indirect_cs_thread_group_x, indirect_cs_thread_group_y) = create_compute_shader(device, indirect_cs_code);
+
+    device->CreateVertexShader(gbuffer_vs_code.data(), gbuffer_vs_code.size(), nullptr, &gbuffer_vs);
+    device->CreatePixelShader(gbuffer_ps_code.data(), gbuffer_ps_code.size(), nullptr, &gbuffer_ps);
+
+    device->CreateVertexShader(screen_quad_vs_code.data(), screen_quad_vs_code.size(), nullptr, &screen_quad_vs);
+    device->CreatePixelShader(combine_ps_code.data(), combine_ps_code.size(), nullptr, &combine_ps);
+  }, {create_device, load_shaders});
+
+  startup.add("upload mesh", [&]() {
+    if (!device) {
+      return;
+    }
+
+    std::tie(positions_buf, positions_srv)   = create_immutable_raw_buffer(device, quantized_mesh.positions.data(), quantized_mesh.positions.size() * sizeof(QuantizedPosition));
+    std::tie(normals_buf, normals_srv)       = create_immutable_structured_buffer<XMSHORTN2>(device, quantized_mesh.normals.data(), quantized_mesh.normals.size());
+    std::tie(tex_coords_buf, tex_coords_srv) = create_immutable_structured_buffer<XMHALF2>(device, quantized_mesh.tex_coords.data(), quantized_mesh.tex_coords.size());
+    std::tie(position_bounds_buf, position_bounds_srv) = create_immutable_raw_buffer(device, quantized_mesh.bounds.data(), quantized_mesh.bounds.size() * sizeof(PositionBounds));
+    std::tie(indices_buf, indices_srv)       = create_immutable_raw_buffer(device, mesh.indices.bytes(), mesh.indices.size() * mesh.indices.width());
+    std::tie(bvh_buf, bvh_srv)               = create_immutable_structured_buffer<bvh::Node>(device, bvh.data(), bvh.size());
+
+    std::tie(meshlets_buf, meshlets_srv)                   = create_immutable_structured_buffer<meshlet::Meshlet>(device, meshlets.meshlets.data(), meshlets.meshlets.size());
+    std::tie(meshlet_vertices_buf, meshlet_vertices_srv)   = create_immutable_structured_buffer<uint32_t>(device, meshlets.vertices.data(), meshlets.vertices.size());
+    std::tie(meshlet_triangles_buf, meshlet_triangles_srv) = create_immutable_structured_buffer<uint32_t>(device, meshlets.triangles.data(), meshlets.triangles.size());
+    std::tie(visible_meshlets_buf, visible_meshlets_srv)   = create_dynamic_structured_buffer<uint32_t>(device, meshlets.meshlets.size());
+  }, {create_device, build_bvh, build_meshlets});
+
+  startup.add("upload blue noise", [&]() {
+    if (!device) {
+      return;
+    }
+
+    D3D11_TEXTURE2D_DESC blue_noise_desc = {};
+    blue_noise_desc.Width = blue_noise.size;
+    blue_noise_desc.Height = blue_noise.size;
+    blue_noise_desc.MipLevels = 1;
+    blue_noise_desc.ArraySize = 1;
+    blue_noise_desc.Format = DXGI_FORMAT_R16_UINT;
+    blue_noise_desc.SampleDesc.Count = 1;
+    blue_noise_desc.Usage = D3D11_USAGE_IMMUTABLE;
+    blue_noise_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_SUBRESOURCE_DATA blue_noise_data = {
+      .pSysMem = blue_noise.ranks.data(),
+      .SysMemPitch = blue_noise.size * (UINT)sizeof(uint16_t),
+    };
+
+    device->CreateTexture2D(&blue_noise_desc, &blue_noise_data, &blue_noise_texture);
+    device->CreateShaderResourceView(blue_noise_texture, nullptr, &blue_noise_srv);
+  }, {create_device, generate_blue_noise});
+
+  startup.add("upload hdri", [&]() {
+    if (!device || !hdri_cache) {
+      return;
+    }
+
+    D3D11_TEXTURE2D_DESC hdri_desc = {};
+    hdri_desc.Width = hdri_cache->levels[0].width;
+    hdri_desc.Height = hdri_cache->levels[0].height;
+    hdri_desc.MipLevels = (UINT)hdri_cache->levels.size();
+    hdri_desc.ArraySize = 1;
+    hdri_desc.Format = hdri_texel_format(hdri_cache->encoding);
+    hdri_desc.SampleDesc.Count = 1;
+    hdri_desc.Usage = D3D11_USAGE_IMMUTABLE;
+    hdri_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    std::vector<D3D11_SUBRESOURCE_DATA> hdri_subresource_data;
+
+    for (auto& level : hdri_cache->levels) {
+      hdri_subresource_data.push_back(D3D11_SUBRESOURCE_DATA{
+        .pSysMem = level.texels,
+        .SysMemPitch = (UINT)level.row_pitch,
+        .SysMemSlicePitch = 1
+      });
+    }
+
+    device->CreateTexture2D(&hdri_desc, hdri_subresource_data.data(), &hdri);
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC hdri_srv_desc = {};
+    hdri_srv_desc.Format = hdri_desc.Format;
+    hdri_srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+    hdri_srv_desc.Texture2D.MipLevels = hdri_desc.MipLevels;
+
+    device->CreateShaderResourceView(hdri, &hdri_srv_desc, &hdri_srv);
+
+    hdri::Distribution2D& distribution = hdri_cache->distribution;
+    std::tie(env_distribution_buf, env_distribution_srv) = create_immutable_structured_buffer<hdri::AliasEntry>(device, distribution.entries.data(), distribution.entries.size());
+
+    // buffers can't be empty, the shaders never read past env_light_count anyway
+    std::vector<hdri::DiskLight> lights = hdri_cache->lights;
+
+    if (lights.empty()) {
+      lights.push_back({});
+    }
+
+    std::tie(env_lights_buf, env_lights_srv) = create_immutable_structured_buffer<hdri::DiskLight>(device, lights.data(), lights.size());
+  }, {create_device, pack_hdri});
+
+  startup.run();
+
+  std::cout << "startup:\n";
+  startup.print_timings();
+
+  if (hdri_error) {
+    std::cout << std::format("hdri encoding error: rmse {:.5f}, mean relative {:.5f}, max relative {:.5f}\n", hdri_error->rmse, hdri_error->mean_relative, hdri_error->max_relative);
   }
 
-  D3D11_TEXTURE2D_DESC hdri_desc = {};
-  hdri_desc.Width = hdri_w;
-  hdri_desc.Height = hdri_h;
-  hdri_desc.MipLevels = 1;
-  hdri_desc.ArraySize = 1;
-  hdri_desc.Format = DXGI_FORMAT_R32G32B32_FLOAT;
-  hdri_desc.SampleDesc.Count = 1;
-  hdri_desc.Usage = D3D11_USAGE_IMMUTABLE;
-  hdri_desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-
-  D3D11_SUBRESOURCE_DATA hdri_subresource_data = {
-    .pSysMem = hdri_data,
-    .SysMemPitch = hdri_w * 3 * sizeof(float),
-    .SysMemSlicePitch = 1
-  };
+  if (!device) {
+    MessageBoxA(nullptr, "Failed to create D3D11 device.", "Error", 0);
+    return 1;
+  }
 
-  ID3D11Texture2D* hdri = nullptr;
-  device->CreateTexture2D(&hdri_desc, &hdri_subresource_data,&hdri);
+  if (!hdri_srv) {
+    std::cout << "Failed to load hdri\n";
+    return 1;
+  }
 
-  D3D11_SHADER_RESOURCE_VIEW_DESC hdri_srv_desc = {};
-  hdri_srv_desc.Format = hdri_desc.Format;
-  hdri_srv_desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-  hdri_srv_desc.Texture2D.MipLevels = 1;
+  std::vector<uint32_t> visible_meshlets;
+  visible_meshlets.reserve(meshlets.meshlets.size());
 
-  ID3D11ShaderResourceView* hdri_srv = nullptr;
-  device->CreateShaderResourceView(hdri, &hdri_srv_desc, &hdri_srv);
+  D3D11_DEPTH_STENCIL_DESC depth_state_desc = {};
+  depth_state_desc.DepthEnable = TRUE;
+  depth_state_desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+  depth_state_desc.DepthFunc = D3D11_COMPARISON_GREATER;
 
-  D3D11_SAMPLER_DESC linear_wrap_sampler_desc = {
-    .Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR,
-    .AddressU = D3D11_TEXTURE_ADDRESS_WRAP,
-    .AddressV = D3D11_TEXTURE_ADDRESS_WRAP,
-    .AddressW = D3D11_TEXTURE_ADDRESS_CLAMP,
-    .MaxLOD = D3D11_FLOAT32_MAX
-  };
+  ID3D11DepthStencilState* depth_state = nullptr;
+  device->CreateDepthStencilState(&depth_state_desc, &depth_state);
 
   D3D11_SAMPLER_DESC linear_clamp_sampler_desc = {
     .Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR,
@@ -596,18 +1104,88 @@ int main() {
     .MaxLOD = D3D11_FLOAT32_MAX
   };
 
-  ID3D11SamplerState* linear_wrap_sampler = nullptr;
   ID3D11SamplerState* point_clamp_sampler = nullptr;
   ID3D11SamplerState* linear_clamp_sampler = nullptr;
-  device->CreateSamplerState(&linear_wrap_sampler_desc, &linear_wrap_sampler);
   device->CreateSamplerState(&point_clamp_sampler_desc, &point_clamp_sampler);
   device->CreateSamplerState(&linear_clamp_sampler_desc, &linear_clamp_sampler);
 
   ConstantBuffer<CameraCbuffer> camera_cbuffer;
   ConstantBuffer<ReservoirConstants> reservoir_cbuffer;
+  ConstantBuffer<SpatialConstants> spatial_cbuffer;
+  ConstantBuffer<IndirectConstants> indirect_cbuffer;
+  ConstantBuffer<AccumulationConstants> accumulation_cbuffer;
+
+  ConstantBuffer<SceneConstants> scene_cbuffer;
 
   camera_cbuffer.init(device);
   reservoir_cbuffer.init(device);
+  spatial_cbuffer.init(device);
+  indirect_cbuffer.init(device);
+  accumulation_cbuffer.init(device);
+  scene_cbuffer.init(device);
+
+  SceneConstants* scene_constants = scene_cbuffer.map(ctx);
+  scene_constants->index_width = mesh.indices.width();
+  scene_constants->env_light_count = (uint32_t)hdri_cache->lights.size();
+
+  for (uint32_t i = 0; i < sh::L2_COEFFICIENTS; ++i) {
+    XMFLOAT3 c = env_irradiance.coefficients[i];
+    scene_constants->env_irradiance[i] = XMFLOAT4(c.x, c.y, c.z, 0.0f);
+  }
+
+  scene_cbuffer.unmap(ctx);
+
+  // how many pixels the lighting pass found above the target error, read back without waiting for the gpu
+  D3D11_BUFFER_DESC unconverged_pixels_desc = {
+    .ByteWidth = sizeof(uint32_t),
+    .Usage = D3D11_USAGE_DEFAULT,
+    .BindFlags = D3D11_BIND_UNORDERED_ACCESS,
+    .MiscFlags = D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS,
+  };
+
+  ID3D11Buffer* unconverged_pixels = nullptr;
+  device->CreateBuffer(&unconverged_pixels_desc, nullptr, &unconverged_pixels);
+
+  D3D11_UNORDERED_ACCESS_VIEW_DESC unconverged_pixels_uav_desc = {
+    .Format = DXGI_FORMAT_R32_TYPELESS,
+    .ViewDimension = D3D11_UAV_DIMENSION_BUFFER,
+    .Buffer = {
+      .NumElements = 1,
+      .Flags = D3D11_BUFFER_UAV_FLAG_RAW,
+    },
+  };
+
+  ID3D11UnorderedAccessView* unconverged_pixels_uav = nullptr;
+  device->CreateUnorderedAccessView(unconverged_pixels, &unconverged_pixels_uav_desc, &unconverged_pixels_uav);
+
+  D3D11_BUFFER_DESC unconverged_pixels_readback_desc = {
+    .ByteWidth = sizeof(uint32_t),
+    .Usage = D3D11_USAGE_STAGING,
+    .CPUAccessFlags = D3D11_CPU_ACCESS_READ,
+  };
+
+  ID3D11Buffer* unconverged_pixels_readback = nullptr;
+  device->CreateBuffer(&unconverged_pixels_readback_desc, nullptr, &unconverged_pixels_readback);
+
+  // a trace::TraversalAggregate of the lighting pixels with a surface, added to by the lighting pass once their
+  // counts are complete while a debug view is on
+  D3D11_BUFFER_DESC traversal_aggregate_desc = unconverged_pixels_desc;
+  traversal_aggregate_desc.ByteWidth = sizeof(trace::TraversalAggregate);
+
+  ID3D11Buffer* traversal_aggregate = nullptr;
+  device->CreateBuffer(&traversal_aggregate_desc, nullptr, &traversal_aggregate);
+
+  D3D11_UNORDERED_ACCESS_VIEW_DESC traversal_aggregate_uav_desc = unconverged_pixels_uav_desc;
+  traversal_aggregate_uav_desc.Buffer.NumElements = sizeof(trace::TraversalAggregate) / sizeof(uint32_t);
+
+  ID3D11UnorderedAccessView* traversal_aggregate_uav = nullptr;
+  device->CreateUnorderedAccessView(traversal_aggregate, &traversal_aggregate_uav_desc, &traversal_aggregate_uav);
+
+  D3D11_BUFFER_DESC traversal_aggregate_readback_desc = unconverged_pixels_readback_desc;
+  traversal_aggregate_readback_desc.ByteWidth = sizeof(trace::TraversalAggregate);
+
+  ID3D11Buffer* traversal_aggregate_readback = nullptr;
+  device->CreateBuffer(&traversal_aggregate_readback_desc, nullptr, &traversal_aggregate_readback);
 
   auto timer_start = std::chrono::steady_clock::now();
   int timer_count = 0;
@@ -620,10 +1198,37 @@ int main() {
   float camera_speed = 2e-3f;
 
   uint32_t frame = 0;
+  XMMATRIX prev_view_proj = XMMatrixIdentity();
 
-  for (;;) {
-    frame++;
+  // neighbours per pixel and how far away they're picked, in lighting buffer pixels.
+  // unbiased weighting costs a visibility ray per neighbour but keeps shadow edges from darkening
+  uint32_t spatial_count = 4;
+  float spatial_radius = 16.0f;
+  bool spatial_unbiased = false;
+
+  // what the candidates are drawn with. scrambled sobol reaches the random sampler's error with fewer candidates
+  sampler::Type sampler_type = sampler::Type::SOBOL;
+
+  // path traced bounces on top of the reservoirs' direct lighting, zero bounces turns them off.
+  // the ray budget bounds their cost, pixels take turns once it's exceeded
+  pathtrace::Settings path_settings = pathtrace::DEFAULT_SETTINGS;
+
+  // frames are averaged while the camera and settings stay the same, rendering stops once the
+  // target sample count or error is reached and starts over on the next change
+  accumulation::Settings accumulation_settings = accumulation::DEFAULT_SETTINGS;
+  accumulation::State accumulation_state = {};
 
+  // which key and sample count the readback in flight belongs to
+  bool readback_pending = false;
+  uint64_t readback_key = 0;
+  uint32_t readback_sample_count = 0;
+
+  // heatmap of a traversal counter instead of the image, its statistics are printed with the frame time
+  DebugView debug_view = DebugView::NONE;
+  bool traversal_readback_pending = false;
+  trace::TraversalAggregate traversal_aggregate_data = {};
+
+  for (;;) {
     window_events = {};
 
     MSG msg;
@@ -640,7 +1245,11 @@ int main() {
       auto [w, h] = *size;
       frame_dependents.release();
       swapchain->ResizeBuffers(0, w, h, DXGI_FORMAT_UNKNOWN, 0);
-      frame_dependents.init(device, swapchain);
+      frame_dependents.init(device, swapchain, lighting_lod);
+    }
+
+    if (window_events.next_debug_view) {
+      debug_view = (DebugView)(((uint32_t)debug_view + 1) % (DEBUG_VIEW_STACK_DEPTH + 1));
     }
 
     XMVECTOR camera_offset = {
@@ -677,13 +1286,73 @@ int main() {
     XMMATRIX proj = XMMatrixPerspectiveFovRH(XM_PI*0.25f, (float)frame_dependents.w/(float)frame_dependents.h, 1000.0f, 0.01f);
     XMMATRIX view_proj = view * proj;
 
-    CameraCbuffer* camera_cbuffer_data = camera_cbuffer.map(ctx);
-    camera_cbuffer_data->inv_view = XMMatrixInverse(nullptr, view);
-    camera_cbuffer_data->inv_view_proj = XMMatrixInverse(nullptr, view_proj);
-    camera_cbuffer_data->view_proj = view_proj;
-    camera_cbuffer_data->frame = frame;
+    CameraCbuffer camera_constants = {
+      .inv_view = XMMatrixInverse(nullptr, view),
+      .inv_view_proj = XMMatrixInverse(nullptr, view_proj),
+      .view_proj = view_proj,
+      .lighting_lod = frame_dependents.lighting_lod,
+      .debug_view = debug_view,
+    };
+
+    // everything the image depends on that can change at runtime, the frame number is left out
+    uint64_t view_key = accumulation::hash(&camera_constants, offsetof(CameraCbuffer, frame));
+    view_key = accumulation::hash(&frame_dependents.w, sizeof(frame_dependents.w), view_key);
+    view_key = accumulation::hash(&frame_dependents.h, sizeof(frame_dependents.h), view_key);
+    view_key = accumulation::hash(&camera_constants.lighting_lod, sizeof(camera_constants.lighting_lod), view_key);
+    view_key = accumulation::hash(&camera_constants.debug_view, sizeof(camera_constants.debug_view), view_key);
+    view_key = accumulation::hash(&spatial_count, sizeof(spatial_count), view_key);
+    view_key = accumulation::hash(&spatial_radius, sizeof(spatial_radius), view_key);
+    view_key = accumulation::hash(&spatial_unbiased, sizeof(spatial_unbiased), view_key);
+    view_key = accumulation::hash(&sampler_type, sizeof(sampler_type), view_key);
+    view_key = accumulation::hash(&path_settings, sizeof(path_settings), view_key);
+
+    if (readback_pending) {
+      D3D11_MAPPED_SUBRESOURCE mapped_readback;
+
+      if (ctx->Map(unconverged_pixels_readback, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped_readback) == S_OK) {
+        uint32_t count = *(uint32_t*)mapped_readback.pData;
+        ctx->Unmap(unconverged_pixels_readback, 0);
+
+        accumulation::report_error(accumulation_state, readback_key, readback_sample_count, count, accumulation_settings);
+        readback_pending = false;
+      }
+    }
+
+    if (traversal_readback_pending) {
+      D3D11_MAPPED_SUBRESOURCE mapped_readback;
+
+      if (ctx->Map(traversal_aggregate_readback, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &mapped_readback) == S_OK) {
+        traversal_aggregate_data = *(trace::TraversalAggregate*)mapped_readback.pData;
+        ctx->Unmap(traversal_aggregate_readback, 0);
+
+        traversal_readback_pending = false;
+      }
+    }
+
+    if (!accumulation::begin_frame(accumulation_state, view_key, accumulation_settings)) {
+      WaitMessage(); // converged, the last presented frame stays on screen until input changes something
+
+      timer_count = 0;
+      timer_start = std::chrono::steady_clock::now();
+      continue;
+    }
+
+    // only counts rendered frames, so the reservoir ping-pong and path strides carry on where they stopped
+    frame++;
+    camera_constants.frame = frame;
+
+    *camera_cbuffer.map(ctx) = camera_constants;
     camera_cbuffer.unmap(ctx);
 
+    meshlet::cull_meshlets(meshlets, meshlet::extract_frustum(view_proj), camera_offset + camera_focus, visible_meshlets);
+
+    if (!visible_meshlets.empty()) {
+      D3D11_MAPPED_SUBRESOURCE mapped_visible_meshlets;
+      ctx->Map(visible_meshlets_buf, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped_visible_meshlets);
+      memcpy(mapped_visible_meshlets.pData, visible_meshlets.data(), visible_meshlets.size() * sizeof(uint32_t));
+      ctx->Unmap(visible_meshlets_buf, 0);
+    }
+
     float clear_color[4] = {};
     ctx->ClearRenderTargetView(frame_dependents.gbuffer_albedo_rtv, clear_color);
     ctx->ClearRenderTargetView(frame_dependents.gbuffer_normal_rtv, clear_color);
@@ -698,7 +1367,11 @@ int main() {
       positions_srv,
       normals_srv,
       tex_coords_srv,
-      indices_srv,
+      position_bounds_srv,
+      meshlets_srv,
+      meshlet_vertices_srv,
+      meshlet_triangles_srv,
+      visible_meshlets_srv,
     };
 
     ctx->VSSetShaderResources(0, std::size(gbuffer_srvs_bind), gbuffer_srvs_bind);
@@ -727,7 +1400,10 @@ int main() {
     ctx->OMSetRenderTargets(std::size(render_targets_bind), render_targets_bind, frame_dependents.dsv);
     ctx->OMSetDepthStencilState(depth_state, 0);
 
-    ctx->Draw((UINT)mesh.indices.size(), 0);
+    if (!visible_meshlets.empty()) {
+      ctx->Draw((UINT)visible_meshlets.size() * meshlet::MAX_TRIANGLES * 3, 0);
+    }
+
     ctx->OMSetRenderTargets(0, nullptr, nullptr);
 
     ctx->CopySubresourceRegion(frame_dependents.depth_texture, 0, 0, 0, 0, frame_dependents.depth_buffer, 0, nullptr);
@@ -736,55 +1412,257 @@ int main() {
     ctx->GenerateMips(frame_dependents.gbuffer_albedo_srv);
     ctx->GenerateMips(frame_dependents.gbuffer_normal_srv);
 
-    // generate reservoirs
+    // generate reservoirs, reusing last frame's where the surface is still visible
+
+    uint32_t current = frame % 2;
+    uint32_t previous = 1 - current;
 
     ReservoirConstants* reservoir_constants = reservoir_cbuffer.map(ctx);
+    reservoir_constants->view_proj = view_proj;
+    reservoir_constants->inv_view_proj = XMMatrixInverse(nullptr, view_proj);
+    reservoir_constants->prev_view_proj = prev_view_proj;
     reservoir_constants->width = frame_dependents.lighting_w;
     reservoir_constants->height = frame_dependents.lighting_h;
     reservoir_constants->frame = frame;
+    reservoir_constants->env_width = hdri_cache->distribution.width;
+    reservoir_constants->env_height = hdri_cache->distribution.height;
+    reservoir_constants->env_light_probability = env_light_probability;
+    reservoir_constants->history_valid = frame_dependents.history_valid;
+    reservoir_constants->sampler_type = (uint32_t)sampler_type;
+    reservoir_constants->lighting_lod = frame_dependents.lighting_lod;
+    reservoir_constants->debug_view = debug_view;
     reservoir_cbuffer.unmap(ctx);
 
     ctx->CSSetShader(reservoir1_cs, nullptr, 0);
-    ctx->CSSetConstantBuffers(0, 1, &reservoir_cbuffer.buffer);
-    ctx->CSSetUnorderedAccessViews(0, 1, &frame_dependents.reservoir_buffer_uav, nullptr);
+
+    ID3D11Buffer* reservoir1_cbuffer_binds[] = {
+      reservoir_cbuffer.buffer,
+      scene_cbuffer.buffer,
+    };
+
+    ctx->CSSetConstantBuffers(0, std::size(reservoir1_cbuffer_binds), reservoir1_cbuffer_binds);
+
+    ID3D11UnorderedAccessView* reservoir1_uav_binds[] = {
+      frame_dependents.temporal_reservoir_buffer_uav,
+      frame_dependents.surfaces_uavs[current],
+      frame_dependents.traversal_stats_buffer_uav,
+    };
+
+    ctx->CSSetUnorderedAccessViews(0, std::size(reservoir1_uav_binds), reservoir1_uav_binds, nullptr);
 
     ID3D11ShaderResourceView* reservoir1_srv_binds[] = {
+      positions_srv,
+      normals_srv,
+      tex_coords_srv,
+      position_bounds_srv,
+      indices_srv,
+      bvh_srv,
       frame_dependents.gbuffer_normal_srv,
       hdri_srv,
+      env_distribution_srv,
+      env_lights_srv,
+      frame_dependents.depth_texture_srv,
+      frame_dependents.reservoir_buffer_srvs[previous],
+      frame_dependents.surfaces_srvs[previous],
+      blue_noise_srv,
     };
 
     ctx->CSSetShaderResources(0, std::size(reservoir1_srv_binds), reservoir1_srv_binds);
 
     ID3D11SamplerState* reservoir1_sampler_binds[] = {
       point_clamp_sampler,
-      linear_wrap_sampler
+      linear_clamp_sampler
     };
 
     ctx->CSSetSamplers(0, std::size(reservoir1_sampler_binds), reservoir1_sampler_binds);
     ctx->Dispatch((frame_dependents.lighting_w+reservoir1_cs_thread_group_x-1)/reservoir1_cs_thread_group_x, (frame_dependents.lighting_h+reservoir1_cs_thread_group_y-1)/reservoir1_cs_thread_group_y, 1);
 
+    memset(reservoir1_uav_binds, 0, sizeof(reservoir1_uav_binds));
+    ctx->CSSetUnorderedAccessViews(0, std::size(reservoir1_uav_binds), reservoir1_uav_binds, nullptr);
+
+    memset(reservoir1_srv_binds, 0, sizeof(reservoir1_srv_binds));
+    ctx->CSSetShaderResources(0, std::size(reservoir1_srv_binds), reservoir1_srv_binds);
+
+    // spatial reuse
+
+    SpatialConstants* spatial_constants = spatial_cbuffer.map(ctx);
+    spatial_constants->inv_view_proj = XMMatrixInverse(nullptr, view_proj);
+    spatial_constants->width = frame_dependents.lighting_w;
+    spatial_constants->height = frame_dependents.lighting_h;
+    spatial_constants->frame = frame;
+    spatial_constants->spatial_count = spatial_count;
+    spatial_constants->spatial_radius = spatial_radius;
+    spatial_constants->unbiased = spatial_unbiased;
+    spatial_constants->lighting_lod = frame_dependents.lighting_lod;
+    spatial_constants->debug_view = debug_view;
+    spatial_cbuffer.unmap(ctx);
+
+    ctx->CSSetShader(reservoir2_cs, nullptr, 0);
+
+    ID3D11Buffer* reservoir2_cbuffer_binds[] = {
+      spatial_cbuffer.buffer,
+      scene_cbuffer.buffer,
+    };
+
+    ctx->CSSetConstantBuffers(0, std::size(reservoir2_cbuffer_binds), reservoir2_cbuffer_binds);
+
+    ID3D11UnorderedAccessView* reservoir2_uav_binds[] = {
+      frame_dependents.reservoir_buffer_uavs[current],
+      frame_dependents.traversal_stats_buffer_uav,
+    };
+
+    ctx->CSSetUnorderedAccessViews(0, std::size(reservoir2_uav_binds), reservoir2_uav_binds, nullptr);
+
+    ID3D11ShaderResourceView* reservoir2_srv_binds[] = {
+      positions_srv,
+      normals_srv,
+      tex_coords_srv,
+      position_bounds_srv,
+      indices_srv,
+      bvh_srv,
+      frame_dependents.temporal_reservoir_buffer_srv,
+      frame_dependents.surfaces_srvs[current],
+      frame_dependents.depth_texture_srv,
+    };
+
+    ctx->CSSetShaderResources(0, std::size(reservoir2_srv_binds), reservoir2_srv_binds);
+    ctx->CSSetSamplers(0, 1, &point_clamp_sampler);
+    ctx->Dispatch((frame_dependents.lighting_w+reservoir2_cs_thread_group_x-1)/reservoir2_cs_thread_group_x, (frame_dependents.lighting_h+reservoir2_cs_thread_group_y-1)/reservoir2_cs_thread_group_y, 1);
+
+    memset(reservoir2_uav_binds, 0, sizeof(reservoir2_uav_binds));
+    ctx->CSSetUnorderedAccessViews(0, std::size(reservoir2_uav_binds), reservoir2_uav_binds, nullptr);
+
+    memset(reservoir2_srv_binds, 0, sizeof(reservoir2_srv_binds));
+    ctx->CSSetShaderResources(0, std::size(reservoir2_srv_binds), reservoir2_srv_binds);
+
+    // indirect pass
+
+    if (path_settings.max_bounces == 0) {
+      float zero[4] = {};
+      ctx->ClearUnorderedAccessViewFloat(frame_dependents.indirect_buffer_uavs[current], zero);
+    }
+
+    if (path_settings.max_bounces > 0) {
+      uint32_t pixel_count = frame_dependents.lighting_w * frame_dependents.lighting_h;
+      uint32_t stride = pathtrace::pixel_stride(path_settings, pixel_count);
+
+      IndirectConstants* indirect_constants = indirect_cbuffer.map(ctx);
+      indirect_constants->inv_view_proj = XMMatrixInverse(nullptr, view_proj);
+      indirect_constants->prev_view_proj = prev_view_proj;
+      indirect_constants->width = frame_dependents.lighting_w;
+      indirect_constants->height = frame_dependents.lighting_h;
+      indirect_constants->frame = frame;
+      indirect_constants->stride = stride;
+      indirect_constants->max_bounces = path_settings.max_bounces;
+      indirect_constants->roulette_start = path_settings.roulette_start;
+      indirect_constants->albedo = path_settings.albedo;
+      indirect_constants->env_width = hdri_cache->distribution.width;
+      indirect_constants->env_height = hdri_cache->distribution.height;
+      indirect_constants->env_light_probability = env_light_probability;
+      indirect_constants->sampler_type = (uint32_t)sampler_type;
+      indirect_constants->lighting_lod = frame_dependents.lighting_lod;
+      indirect_constants->history_valid = frame_dependents.history_valid;
+      indirect_constants->debug_view = debug_view;
+      indirect_cbuffer.unmap(ctx);
+
+      ctx->CSSetShader(indirect_cs, nullptr, 0);
+
+      ID3D11Buffer* indirect_cbuffer_binds[] = {
+        indirect_cbuffer.buffer,
+        scene_cbuffer.buffer,
+      };
+
+      ctx->CSSetConstantBuffers(0, std::size(indirect_cbuffer_binds), indirect_cbuffer_binds);
+
+      ID3D11UnorderedAccessView* indirect_uav_binds[] = {
+        frame_dependents.indirect_buffer_uavs[current],
+        frame_dependents.traversal_stats_buffer_uav,
+      };
+
+      ctx->CSSetUnorderedAccessViews(0, std::size(indirect_uav_binds), indirect_uav_binds, nullptr);
+
+      ID3D11ShaderResourceView* indirect_srv_binds[] = {
+        positions_srv,
+        normals_srv,
+        tex_coords_srv,
+        position_bounds_srv,
+        indices_srv,
+        bvh_srv,
+        hdri_srv,
+        env_distribution_srv,
+        env_lights_srv,
+        frame_dependents.depth_texture_srv,
+        frame_dependents.gbuffer_normal_srv,
+        blue_noise_srv,
+        frame_dependents.surfaces_srvs[previous],
+        frame_dependents.indirect_buffer_srvs[previous],
+      };
+
+      ctx->CSSetShaderResources(0, std::size(indirect_srv_binds), indirect_srv_binds);
+
+      ID3D11SamplerState* indirect_sampler_binds[] = {
+        point_clamp_sampler,
+        linear_clamp_sampler
+      };
+
+      ctx->CSSetSamplers(0, std::size(indirect_sampler_binds), indirect_sampler_binds);
+      ctx->Dispatch((pixel_count+indirect_cs_thread_group_x-1)/indirect_cs_thread_group_x, 1, 1);
+
+      memset(indirect_uav_binds, 0, sizeof(indirect_uav_binds));
+      ctx->CSSetUnorderedAccessViews(0, std::size(indirect_uav_binds), indirect_uav_binds, nullptr);
+
+      memset(indirect_srv_binds, 0, sizeof(indirect_srv_binds));
+      ctx->CSSetShaderResources(0, std::size(indirect_srv_binds), indirect_srv_binds);
+    }
+
+    frame_dependents.history_valid = true;
+    prev_view_proj = view_proj;
+
     // lighting pass
 
+    AccumulationConstants* accumulation_constants = accumulation_cbuffer.map(ctx);
+    accumulation_constants->sample_count = accumulation_state.sample_count;
+    accumulation_constants->target_error = accumulation_settings.target_error;
+    accumulation_constants->correlation_length = accumulation::correlation_length(restir::DEFAULT_TEMPORAL_SETTINGS.max_history_length,
+                                                                                  pathtrace::pixel_stride(path_settings, frame_dependents.lighting_w * frame_dependents.lighting_h));
+    accumulation_cbuffer.unmap(ctx);
+
+    UINT zero_count[4] = {};
+    ctx->ClearUnorderedAccessViewUint(unconverged_pixels_uav, zero_count);
+
+    if (debug_view != DebugView::NONE) {
+      ctx->ClearUnorderedAccessViewUint(traversal_aggregate_uav, zero_count);
+    }
+
     ctx->CSSetShader(lighting_cs, nullptr, 0);
 
-    ctx->CSSetConstantBuffers(0, 1, &camera_cbuffer.buffer);
+    ID3D11Buffer* lighting_cbuffers_bind[] = {
+      camera_cbuffer.buffer,
+      scene_cbuffer.buffer,
+      accumulation_cbuffer.buffer,
+    };
+
+    ctx->CSSetConstantBuffers(0, std::size(lighting_cbuffers_bind), lighting_cbuffers_bind);
 
     ID3D11ShaderResourceView* cs_srvs_bind[] = {
       positions_srv,
       normals_srv,
       tex_coords_srv,
+      position_bounds_srv,
       indices_srv,
       bvh_srv,
       hdri_srv,
       frame_dependents.depth_texture_srv,
       frame_dependents.gbuffer_albedo_srv,
       frame_dependents.gbuffer_normal_srv,
+      env_lights_srv,
+      frame_dependents.indirect_buffer_srvs[current],
     };
 
     ctx->CSSetShaderResources(0, std::size(cs_srvs_bind), cs_srvs_bind);
 
     ID3D11SamplerState* lighting_samplers_bind[] = {
-      linear_wrap_sampler,
+      linear_clamp_sampler,
       point_clamp_sampler
     };
 
@@ -792,7 +1670,11 @@ int main() {
 
     ID3D11UnorderedAccessView* lighting_uavs_bind[] = {
       frame_dependents.lighting_buffer_uav,
-      frame_dependents.reservoir_buffer_uav
+      frame_dependents.reservoir_buffer_uavs[current],
+      frame_dependents.accumulation_buffer_uav,
+      unconverged_pixels_uav,
+      frame_dependents.traversal_stats_buffer_uav,
+      traversal_aggregate_uav,
     };
 
     ctx->CSSetUnorderedAccessViews(0, std::size(lighting_uavs_bind), lighting_uavs_bind, nullptr);
@@ -804,6 +1686,21 @@ int main() {
     memset(cs_srvs_bind, 0, sizeof(cs_srvs_bind));
     ctx->CSSetShaderResources(0, std::size(cs_srvs_bind), cs_srvs_bind);
 
+    accumulation::end_frame(accumulation_state);
+
+    if (!readback_pending && accumulation_settings.enabled && accumulation_settings.target_error > 0.0f) {
+      ctx->CopyResource(unconverged_pixels_readback, unconverged_pixels);
+
+      readback_pending = true;
+      readback_key = accumulation_state.key;
+      readback_sample_count = accumulation_state.sample_count;
+    }
+
+    if (!traversal_readback_pending && debug_view != DebugView::NONE) {
+      ctx->CopyResource(traversal_aggregate_readback, traversal_aggregate);
+      traversal_readback_pending = true;
+    }
+
     // combine pass
 
     ctx->VSSetShader(screen_quad_vs, nullptr, 0);
@@ -813,16 +1710,23 @@ int main() {
       frame_dependents.lighting_buffer_srv,
       hdri_srv,
       frame_dependents.depth_texture_srv,
+      env_lights_srv,
+      frame_dependents.gbuffer_normal_srv,
+      frame_dependents.traversal_stats_buffer_srv,
     };
 
     ctx->PSSetShaderResources(0, std::size(combine_srvs_bind), combine_srvs_bind);
 
-    ctx->PSSetConstantBuffers(0, 1, &camera_cbuffer.buffer);
+    ID3D11Buffer* combine_cbuffers_bind[] = {
+      camera_cbuffer.buffer,
+      scene_cbuffer.buffer,
+    };
+
+    ctx->PSSetConstantBuffers(0, std::size(combine_cbuffers_bind), combine_cbuffers_bind);
 
     ID3D11SamplerState* combine_samplers_bind[] = {
       point_clamp_sampler,
-      linear_clamp_sampler,
-      linear_wrap_sampler
+      linear_clamp_sampler
     };
 
     ctx->PSSetSamplers(0, std::size(combine_samplers_bind), combine_samplers_bind);
@@ -840,6 +1744,29 @@ int main() {
       auto diff = (float)std::chrono::duration_cast<std::chrono::microseconds>(timer_end-timer_start).count()/float(timer_count) * 1e-3;
       std::cout << std::format("frame-time: {} ms\n",  diff);
 
+      if (debug_view != DebugView::NONE) {
+        static const char* counter_names[TRAVERSAL_COUNTERS] = { "rays", "node visits", "triangle tests", "stack depth" };
+        trace::TraversalSummary summary = trace::summarize(traversal_aggregate_data);
+
+        std::cout << std::format("  per pixel over {} pixels\n", summary.pixel_count);
+
+        for (uint32_t i = 0; i < TRAVERSAL_COUNTERS; ++i) {
+          std::cout << std::format("  {}: mean {:.1f}, p99 {}\n", counter_names[i], summary.mean[i], summary.p99[i]);
+        }
+
+        // the viewed counter's histogram, as the share of pixels per bucket
+        uint32_t counter = (uint32_t)debug_view - 1;
+        uint32_t width = trace::traversal_bucket_width(counter);
+
+        for (uint32_t b = 0; b < TRAVERSAL_HISTOGRAM_BUCKETS; ++b) {
+          uint32_t count = traversal_aggregate_data.histograms[counter * TRAVERSAL_HISTOGRAM_BUCKETS + b];
+
+          if (count > 0) {
+            std::cout << std::format("    {:>4}+ {:5.1f}%\n", b * width, 100.0f * (float)count / (float)summary.pixel_count);
+          }
+        }
+      }
+
       timer_count = 0;
       timer_start = timer_end;
     }
@@ -0,0 +1,221 @@
+#include <algorithm>
+
+#include "meshlet.h"
+
+namespace meshlet {
+
+  static XMVECTOR face_normal(const Mesh& mesh, uint32_t i0, uint32_t i1, uint32_t i2) {
+    XMVECTOR a = XMLoadFloat3(&mesh.positions[i0]);
+    XMVECTOR b = XMLoadFloat3(&mesh.positions[i1]);
+    XMVECTOR c = XMLoadFloat3(&mesh.positions[i2]);
+
+    XMVECTOR n = XMVector3Cross(b - a, c - a);
+
+    // winding is flipped on load, so orient against the shading normals instead
+    XMVECTOR shading = XMLoadFloat3(&mesh.normals[i0]) + XMLoadFloat3(&mesh.normals[i1]) + XMLoadFloat3(&mesh.normals[i2]);
+    if (XMVectorGetX(XMVector3Dot(n, shading)) < 0.0f) {
+      n = -n;
+    }
+
+    float length = XMVectorGetX(XMVector3Length(n));
+    return length > 0.0f ? n / length : XMVectorZero();
+  }
+
+  static void compute_bounds(const Mesh& mesh, const Meshlets& meshlets, Meshlet& m) {
+    XMVECTOR min = XMVectorSplatInfinity();
+    XMVECTOR max = -XMVectorSplatInfinity();
+
+    for (uint32_t i = 0; i < m.vertex_count; ++i) {
+      XMVECTOR p = XMLoadFloat3(&mesh.positions[meshlets.vertices[m.vertex_offset + i]]);
+      min = XMVectorMin(min, p);
+      max = XMVectorMax(max, p);
+    }
+
+    XMVECTOR center = (min + max) * 0.5f;
+    float radius = 0.0f;
+
+    for (uint32_t i = 0; i < m.vertex_count; ++i) {
+      XMVECTOR p = XMLoadFloat3(&mesh.positions[meshlets.vertices[m.vertex_offset + i]]);
+      radius = XMMax(radius, XMVectorGetX(XMVector3Length(p - center)));
+    }
+
+    XMStoreFloat3(&m.min, min);
+    XMStoreFloat3(&m.max, max);
+    XMStoreFloat3(&m.center, center);
+    m.radius = radius;
+
+    XMVECTOR axis = XMVectorZero();
+
+    for (uint32_t i = 0; i < m.triangle_count; ++i) {
+      uint32_t tri = meshlets.triangles[m.triangle_offset + i];
+      uint32_t i0 = meshlets.vertices[m.vertex_offset + ((tri >> 0) & 0xff)];
+      uint32_t i1 = meshlets.vertices[m.vertex_offset + ((tri >> 8) & 0xff)];
+      uint32_t i2 = meshlets.vertices[m.vertex_offset + ((tri >> 16) & 0xff)];
+      axis += face_normal(mesh, i0, i1, i2);
+    }
+
+    float axis_length = XMVectorGetX(XMVector3Length(axis));
+    axis = axis_length > 0.0f ? axis / axis_length : XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+
+    float min_dot = 1.0f;
+
+    for (uint32_t i = 0; i < m.triangle_count; ++i) {
+      uint32_t tri = meshlets.triangles[m.triangle_offset + i];
+      uint32_t i0 = meshlets.vertices[m.vertex_offset + ((tri >> 0) & 0xff)];
+      uint32_t i1 = meshlets.vertices[m.vertex_offset + ((tri >> 8) & 0xff)];
+      uint32_t i2 = meshlets.vertices[m.vertex_offset + ((tri >> 16) & 0xff)];
+      min_dot = XMMin(min_dot, XMVectorGetX(XMVector3Dot(axis, face_normal(mesh, i0, i1, i2))));
+    }
+
+    XMStoreFloat3(&m.cone_axis, axis);
+    m.cone_apex = m.center;
+
+    // a cone wider than ~84 degrees is never going to be culled
+    if (min_dot <= 0.1f) {
+      m.cone_cutoff = 1.0f;
+      return;
+    }
+
+    // push the apex back along the axis until every triangle plane is in front of it
+    float max_t = 0.0f;
+
+    for (uint32_t i = 0; i < m.triangle_count; ++i) {
+      uint32_t tri = meshlets.triangles[m.triangle_offset + i];
+      uint32_t i0 = meshlets.vertices[m.vertex_offset + ((tri >> 0) & 0xff)];
+      uint32_t i1 = meshlets.vertices[m.vertex_offset + ((tri >> 8) & 0xff)];
+      uint32_t i2 = meshlets.vertices[m.vertex_offset + ((tri >> 16) & 0xff)];
+
+      XMVECTOR n = face_normal(mesh, i0, i1, i2);
+      float dc = XMVectorGetX(XMVector3Dot(center - XMLoadFloat3(&mesh.positions[i0]), n));
+      float dn = XMVectorGetX(XMVector3Dot(axis, n));
+
+      max_t = XMMax(max_t, dc / dn);
+    }
+
+    XMStoreFloat3(&m.cone_apex, center - axis * max_t);
+
+    // cos(a + 90) for the widest triangle, the cone is grown by 90 degrees to cover backfacing views
+    m.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+  }
+
+  Meshlets build_meshlets(const Mesh& mesh) {
+    Meshlets result;
+
+    size_t triangle_count = mesh.indices.size() / 3;
+    result.meshlets.reserve(triangle_count / MAX_TRIANGLES + 1);
+    result.triangles.reserve(triangle_count);
+    result.vertices.reserve(triangle_count);
+
+    // 0xff marks vertices that aren't part of the current meshlet
+    std::vector<uint8_t> local(mesh.positions.size(), 0xff);
+
+    Meshlet current = {};
+
+    auto flush = [&]() {
+      if (current.triangle_count == 0) {
+        return;
+      }
+
+      for (uint32_t i = 0; i < current.vertex_count; ++i) {
+        local[result.vertices[current.vertex_offset + i]] = 0xff;
+      }
+
+      compute_bounds(mesh, result, current);
+      result.meshlets.push_back(current);
+
+      current = Meshlet{
+        .vertex_offset = (uint32_t)result.vertices.size(),
+        .triangle_offset = (uint32_t)result.triangles.size(),
+      };
+    };
+
+    // meshlets are kept within one segment so their bounds stay tight
+    for (auto& segment : mesh.segments) {
+      for (size_t i = segment.first_index/3; i < (segment.first_index + segment.index_count)/3; ++i) {
+        uint32_t tri[3] = {
+          segment.base_vertex + mesh.indices[i*3+0],
+          segment.base_vertex + mesh.indices[i*3+1],
+          segment.base_vertex + mesh.indices[i*3+2],
+        };
+
+        uint32_t new_vertices = (local[tri[0]] == 0xff) + (local[tri[1]] == 0xff && tri[1] != tri[0]) + (local[tri[2]] == 0xff && tri[2] != tri[0] && tri[2] != tri[1]);
+
+        if (current.vertex_count + new_vertices > MAX_VERTICES || current.triangle_count + 1 > MAX_TRIANGLES) {
+          flush();
+        }
+
+        uint32_t packed = 0;
+
+        for (int j = 0; j < 3; ++j) {
+          if (local[tri[j]] == 0xff) {
+            local[tri[j]] = (uint8_t)current.vertex_count++;
+            result.vertices.push_back(tri[j]);
+          }
+
+          packed |= (uint32_t)local[tri[j]] << (j * 8);
+        }
+
+        result.triangles.push_back(packed);
+        current.triangle_count++;
+      }
+
+      flush();
+    }
+
+    return result;
+  }
+
+  Frustum extract_frustum(FXMMATRIX view_proj) {
+    // rows of the transpose are the clip space x, y, z and w expressed as planes
+    XMMATRIX t = XMMatrixTranspose(view_proj);
+
+    Frustum frustum = {
+      .planes = {
+        t.r[3] + t.r[0],
+        t.r[3] - t.r[0],
+        t.r[3] + t.r[1],
+        t.r[3] - t.r[1],
+        t.r[2],
+        t.r[3] - t.r[2],
+      }
+    };
+
+    for (auto& plane : frustum.planes) {
+      plane = XMPlaneNormalize(plane);
+    }
+
+    return frustum;
+  }
+
+  void cull_meshlets(const Meshlets& meshlets, const Frustum& frustum, FXMVECTOR eye, std::vector<uint32_t>& visible) {
+    visible.clear();
+
+    for (uint32_t i = 0; i < (uint32_t)meshlets.meshlets.size(); ++i) {
+      const Meshlet& m = meshlets.meshlets[i];
+
+      XMVECTOR center = XMVectorSetW(XMLoadFloat3(&m.center), 1.0f);
+
+      bool outside = false;
+
+      for (auto& plane : frustum.planes) {
+        if (XMVectorGetX(XMVector4Dot(plane, center)) < -m.radius) {
+          outside = true;
+          break;
+        }
+      }
+
+      if (outside) {
+        continue;
+      }
+
+      XMVECTOR view = XMVector3Normalize(XMLoadFloat3(&m.cone_apex) - eye);
+
+      if (XMVectorGetX(XMVector3Dot(view, XMLoadFloat3(&m.cone_axis))) >= m.cone_cutoff) {
+        continue;
+      }
+
+      visible.push_back(i);
+    }
+  }
+
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "model.h"
+
+using namespace DirectX;
+
+namespace meshlet {
+  // must match gbuffer_vs.hlsl
+  static constexpr uint32_t MAX_VERTICES = 64;
+  static constexpr uint32_t MAX_TRIANGLES = 124;
+
+  struct Meshlet {
+    uint32_t vertex_offset;
+    uint32_t triangle_offset;
+    uint32_t vertex_count;
+    uint32_t triangle_count;
+
+    XMFLOAT3 center;
+    float radius;
+
+    // backface cone, the meshlet can be culled when dot(normalize(cone_apex - eye), cone_axis) >= cone_cutoff
+    XMFLOAT3 cone_apex;
+    XMFLOAT3 cone_axis;
+    float cone_cutoff;
+
+    XMFLOAT3 min;
+    XMFLOAT3 max;
+  };
+
+  struct Meshlets {
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> vertices; // mesh vertex index for every meshlet-local vertex
+    std::vector<uint32_t> triangles; // three 8-bit meshlet-local indices per triangle
+  };
+
+  struct Frustum {
+    XMVECTOR planes[6];
+  };
+
+  Meshlets build_meshlets(const Mesh& mesh);
+
+  Frustum extract_frustum(FXMMATRIX view_proj);
+  void cull_meshlets(const Meshlets& meshlets, const Frustum& frustum, FXMVECTOR eye, std::vector<uint32_t>& visible);
+};
@@ -0,0 +1,599 @@
+#include <emmintrin.h>
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "meshopt.h"
+
+namespace meshopt {
+
+  static constexpr uint8_t VERTEX_HEADER = 0xa0;
+  static constexpr uint8_t INDEX_HEADER = 0xe0;
+  static constexpr uint8_t SEQUENCE_HEADER = 0xd0;
+
+  static constexpr size_t VERTEX_BLOCK_SIZE_BYTES = 8192;
+  static constexpr size_t VERTEX_BLOCK_MAX_SIZE = 256;
+  static constexpr size_t BYTE_GROUP_SIZE = 16;
+  static constexpr size_t BYTE_GROUP_DECODE_LIMIT = 24;
+  static constexpr size_t TAIL_MAX_SIZE = 32;
+
+  static size_t vertex_block_size(size_t vertex_size) {
+    size_t result = (VERTEX_BLOCK_SIZE_BYTES / vertex_size) & ~(BYTE_GROUP_SIZE - 1);
+    return std::min(result, VERTEX_BLOCK_MAX_SIZE);
+  }
+
+  // 16 values, either all zero, packed 2 or 4 bits with an escape to a trailing byte, or raw
+  static const uint8_t* decode_bytes_group(const uint8_t* data, uint8_t* buffer, int bitslog2) {
+    switch (bitslog2) {
+      default:
+      case 0:
+        memset(buffer, 0, BYTE_GROUP_SIZE);
+        return data;
+
+      case 1:
+      case 2: {
+        int bits = 1 << bitslog2;
+        int per_byte = 8 / bits;
+        uint8_t escape = (uint8_t)((1 << bits) - 1);
+
+        const uint8_t* extra = data + BYTE_GROUP_SIZE / per_byte;
+
+        for (size_t i = 0; i < BYTE_GROUP_SIZE; i += per_byte) {
+          uint8_t byte = *data++;
+
+          for (int j = 0; j < per_byte; ++j) {
+            uint8_t enc = (uint8_t)(byte >> (8 - bits));
+            byte = (uint8_t)(byte << bits);
+
+            buffer[i + j] = enc == escape ? *extra++ : enc;
+          }
+        }
+
+        return extra;
+      }
+
+      case 3:
+        memcpy(buffer, data, BYTE_GROUP_SIZE);
+        return data + BYTE_GROUP_SIZE;
+    }
+  }
+
+  static const uint8_t* decode_bytes(const uint8_t* data, const uint8_t* data_end, uint8_t* buffer, size_t buffer_size) {
+    assert(buffer_size % BYTE_GROUP_SIZE == 0);
+
+    const uint8_t* header = data;
+    size_t header_size = (buffer_size / BYTE_GROUP_SIZE + 3) / 4;
+
+    if ((size_t)(data_end - data) < header_size) {
+      return nullptr;
+    }
+
+    data += header_size;
+
+    for (size_t i = 0; i < buffer_size; i += BYTE_GROUP_SIZE) {
+      if ((size_t)(data_end - data) < BYTE_GROUP_DECODE_LIMIT) {
+        return nullptr;
+      }
+
+      size_t group = i / BYTE_GROUP_SIZE;
+      int bitslog2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+
+      data = decode_bytes_group(data, buffer + i, bitslog2);
+    }
+
+    return data;
+  }
+
+  static const uint8_t* decode_vertex_block(const uint8_t* data, const uint8_t* data_end, uint8_t* vertex_data, size_t vertex_count, size_t vertex_size, uint8_t last_vertex[256]) {
+    alignas(16) uint8_t buffer[VERTEX_BLOCK_MAX_SIZE];
+    alignas(16) uint8_t deltas[BYTE_GROUP_SIZE];
+
+    size_t vertex_count_aligned = (vertex_count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i low7 = _mm_set1_epi8(0x7f);
+
+    for (size_t k = 0; k < vertex_size; ++k) {
+      data = decode_bytes(data, data_end, buffer, vertex_count_aligned);
+
+      if (!data) {
+        return nullptr;
+      }
+
+      uint8_t p = last_vertex[k];
+
+      // unzigzag and prefix sum 16 deltas at a time
+      for (size_t i = 0; i < vertex_count; i += BYTE_GROUP_SIZE) {
+        __m128i v = _mm_load_si128((const __m128i*)&buffer[i]);
+
+        __m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(v, 1), low7), _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(v, one)));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi8(d, _mm_set1_epi8((char)p));
+
+        _mm_store_si128((__m128i*)deltas, d);
+
+        size_t n = std::min(BYTE_GROUP_SIZE, vertex_count - i);
+        uint8_t* out = vertex_data + i * vertex_size + k;
+
+        for (size_t j = 0; j < n; ++j) {
+          out[j * vertex_size] = deltas[j];
+        }
+
+        p = deltas[n - 1];
+      }
+
+      last_vertex[k] = p;
+    }
+
+    return data;
+  }
+
+  bool decode_vertex_buffer(void* destination, size_t vertex_count, size_t vertex_size, const uint8_t* buffer, size_t buffer_size) {
+    assert(vertex_size > 0 && vertex_size <= 256 && vertex_size % 4 == 0);
+
+    const uint8_t* data = buffer;
+    const uint8_t* data_end = buffer + buffer_size;
+
+    if (buffer_size < 1 + vertex_size) {
+      return false;
+    }
+
+    uint8_t header = *data++;
+
+    if ((header & 0xf0) != VERTEX_HEADER || (header & 0x0f) > 0) {
+      return false;
+    }
+
+    // the tail holds the first vertex, deltas of the first block are relative to it
+    uint8_t last_vertex[256];
+    memcpy(last_vertex, data_end - vertex_size, vertex_size);
+
+    size_t block_size = vertex_block_size(vertex_size);
+    uint8_t* vertex_data = (uint8_t*)destination;
+
+    for (size_t offset = 0; offset < vertex_count; offset += block_size) {
+      size_t count = std::min(block_size, vertex_count - offset);
+      data = decode_vertex_block(data, data_end, vertex_data + offset * vertex_size, count, vertex_size, last_vertex);
+
+      if (!data) {
+        return false;
+      }
+    }
+
+    return (size_t)(data_end - data) == std::max(vertex_size, TAIL_MAX_SIZE);
+  }
+
+  static uint32_t decode_vbyte(const uint8_t*& data) {
+    uint8_t lead = *data++;
+
+    if (lead < 128) {
+      return lead;
+    }
+
+    uint32_t result = lead & 127;
+    uint32_t shift = 7;
+
+    for (int i = 0; i < 4; ++i) {
+      uint8_t group = *data++;
+      result |= (uint32_t)(group & 127) << shift;
+      shift += 7;
+
+      if (group < 128) {
+        break;
+      }
+    }
+
+    return result;
+  }
+
+  static uint32_t decode_index(const uint8_t*& data, uint32_t last) {
+    uint32_t v = decode_vbyte(data);
+    uint32_t d = (v >> 1) ^ (0u - (v & 1));
+    return last + d;
+  }
+
+  static void write_index(void* destination, size_t i, size_t index_size, uint32_t value) {
+    if (index_size == 2) {
+      ((uint16_t*)destination)[i] = (uint16_t)value;
+    }
+    else {
+      ((uint32_t*)destination)[i] = value;
+    }
+  }
+
+  bool decode_index_buffer(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size) {
+    assert(index_count % 3 == 0);
+    assert(index_size == 2 || index_size == 4);
+
+    // header, a code byte per triangle and the 16 byte codeaux table
+    if (buffer_size < 1 + index_count / 3 + 16) {
+      return false;
+    }
+
+    if ((buffer[0] & 0xf0) != INDEX_HEADER) {
+      return false;
+    }
+
+    int version = buffer[0] & 0x0f;
+
+    if (version > 1) {
+      return false;
+    }
+
+    uint32_t edge_fifo[16][2];
+    uint32_t vertex_fifo[16];
+    memset(edge_fifo, -1, sizeof(edge_fifo));
+    memset(vertex_fifo, -1, sizeof(vertex_fifo));
+
+    size_t edge_fifo_offset = 0;
+    size_t vertex_fifo_offset = 0;
+
+    auto push_vertex = [&](uint32_t v, bool cond = true) {
+      vertex_fifo[vertex_fifo_offset] = v;
+      vertex_fifo_offset = (vertex_fifo_offset + cond) & 15;
+    };
+
+    auto push_edge = [&](uint32_t a, uint32_t b) {
+      edge_fifo[edge_fifo_offset][0] = a;
+      edge_fifo[edge_fifo_offset][1] = b;
+      edge_fifo_offset = (edge_fifo_offset + 1) & 15;
+    };
+
+    uint32_t next = 0;
+    uint32_t last = 0;
+
+    int fec_max = version >= 1 ? 13 : 15;
+
+    const uint8_t* code = buffer + 1;
+    const uint8_t* data = code + index_count / 3;
+    const uint8_t* data_safe_end = buffer + buffer_size - 16;
+    const uint8_t* codeaux_table = data_safe_end;
+
+    for (size_t i = 0; i < index_count; i += 3) {
+      // a triangle reads at most 16 bytes past data, which the codeaux table pads
+      if (data > data_safe_end) {
+        return false;
+      }
+
+      uint8_t codetri = *code++;
+
+      if (codetri < 0xf0) {
+        int fe = codetri >> 4;
+
+        uint32_t a = edge_fifo[(edge_fifo_offset - 1 - fe) & 15][0];
+        uint32_t b = edge_fifo[(edge_fifo_offset - 1 - fe) & 15][1];
+
+        int fec = codetri & 15;
+
+        if (fec < fec_max) {
+          uint32_t c = fec == 0 ? next : vertex_fifo[(vertex_fifo_offset - 1 - fec) & 15];
+          next += fec == 0;
+
+          write_index(destination, i + 0, index_size, a);
+          write_index(destination, i + 1, index_size, b);
+          write_index(destination, i + 2, index_size, c);
+
+          push_vertex(c, fec == 0);
+
+          push_edge(c, b);
+          push_edge(a, c);
+        }
+        else {
+          // 13 and 14 encode -1 and +1 relative to the last free index
+          uint32_t c = last = fec != 15 ? last + (fec - (fec ^ 3)) : decode_index(data, last);
+
+          write_index(destination, i + 0, index_size, a);
+          write_index(destination, i + 1, index_size, b);
+          write_index(destination, i + 2, index_size, c);
+
+          push_vertex(c);
+
+          push_edge(c, b);
+          push_edge(a, c);
+        }
+      }
+      else if (codetri < 0xfe) {
+        uint8_t codeaux = codeaux_table[codetri & 15];
+
+        int feb = codeaux >> 4;
+        int fec = codeaux & 15;
+
+        uint32_t a = next++;
+
+        uint32_t b = feb == 0 ? next : vertex_fifo[(vertex_fifo_offset - feb) & 15];
+        next += feb == 0;
+
+        uint32_t c = fec == 0 ? next : vertex_fifo[(vertex_fifo_offset - fec) & 15];
+        next += fec == 0;
+
+        write_index(destination, i + 0, index_size, a);
+        write_index(destination, i + 1, index_size, b);
+        write_index(destination, i + 2, index_size, c);
+
+        push_vertex(a);
+        push_vertex(b, feb == 0);
+        push_vertex(c, fec == 0);
+
+        push_edge(b, a);
+        push_edge(c, b);
+        push_edge(a, c);
+      }
+      else {
+        uint8_t codeaux = *data++;
+
+        int fea = codetri == 0xfe ? 0 : 15;
+        int feb = codeaux >> 4;
+        int fec = codeaux & 15;
+
+        // a zero codeaux outside of the table resets the vertex counter
+        if (codeaux == 0) {
+          next = 0;
+        }
+
+        uint32_t a = fea == 0 ? next++ : 0;
+        uint32_t b = feb == 0 ? next++ : vertex_fifo[(vertex_fifo_offset - feb) & 15];
+        uint32_t c = fec == 0 ? next++ : vertex_fifo[(vertex_fifo_offset - fec) & 15];
+
+        if (fea == 15) {
+          last = a = decode_index(data, last);
+        }
+
+        if (feb == 15) {
+          last = b = decode_index(data, last);
+        }
+
+        if (fec == 15) {
+          last = c = decode_index(data, last);
+        }
+
+        write_index(destination, i + 0, index_size, a);
+        write_index(destination, i + 1, index_size, b);
+        write_index(destination, i + 2, index_size, c);
+
+        push_vertex(a);
+        push_vertex(b, feb == 0 || feb == 15);
+        push_vertex(c, fec == 0 || fec == 15);
+
+        push_edge(b, a);
+        push_edge(c, b);
+        push_edge(a, c);
+      }
+    }
+
+    return data == data_safe_end;
+  }
+
+  bool decode_index_sequence(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size) {
+    assert(index_size == 2 || index_size == 4);
+
+    // header, at least a byte per index and a 4 byte tail
+    if (buffer_size < 1 + index_count + 4) {
+      return false;
+    }
+
+    if ((buffer[0] & 0xf0) != SEQUENCE_HEADER || (buffer[0] & 0x0f) > 1) {
+      return false;
+    }
+
+    const uint8_t* data = buffer + 1;
+    const uint8_t* data_safe_end = buffer + buffer_size - 4;
+
+    // two baselines, the low bit of every value picks which one the delta applies to
+    uint32_t last[2] = {};
+
+    for (size_t i = 0; i < index_count; ++i) {
+      if (data >= data_safe_end) {
+        return false;
+      }
+
+      uint32_t v = decode_vbyte(data);
+      uint32_t baseline = v & 1;
+      v >>= 1;
+
+      uint32_t index = last[baseline] + ((v >> 1) ^ (0u - (v & 1)));
+      last[baseline] = index;
+
+      write_index(destination, i, index_size, index);
+    }
+
+    return data == data_safe_end;
+  }
+
+  template<typename T>
+  static void decode_filter_oct_scalar(T* data, size_t count) {
+    const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+
+    for (size_t i = 0; i < count; ++i) {
+      // z holds 1.0 at the encoded precision
+      float x = float(data[i * 4 + 0]);
+      float y = float(data[i * 4 + 1]);
+      float z = float(data[i * 4 + 2]) - fabsf(x) - fabsf(y);
+
+      float t = std::min(z, 0.0f);
+      x += x >= 0.0f ? t : -t;
+      y += y >= 0.0f ? t : -t;
+
+      float s = max / sqrtf(x * x + y * y + z * z);
+
+      data[i * 4 + 0] = T(int(x * s + (x >= 0.0f ? 0.5f : -0.5f)));
+      data[i * 4 + 1] = T(int(y * s + (y >= 0.0f ? 0.5f : -0.5f)));
+      data[i * 4 + 2] = T(int(z * s + (z >= 0.0f ? 0.5f : -0.5f)));
+    }
+  }
+
+  static void decode_filter_oct16(int16_t* data, size_t count) {
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+      __m128i n4_0 = _mm_loadu_si128((const __m128i*)&data[(i + 0) * 4]);
+      __m128i n4_1 = _mm_loadu_si128((const __m128i*)&data[(i + 2) * 4]);
+
+      // one vertex per 32-bit lane: x/y pairs and z/w pairs
+      __m128i xy = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(n4_0), _mm_castsi128_ps(n4_1), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i zw = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(n4_0), _mm_castsi128_ps(n4_1), _MM_SHUFFLE(3, 1, 3, 1)));
+
+      __m128 x = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(xy, 16), 16));
+      __m128 y = _mm_cvtepi32_ps(_mm_srai_epi32(xy, 16));
+      __m128 z = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(zw, 16), 16));
+
+      z = _mm_sub_ps(z, _mm_add_ps(_mm_andnot_ps(sign, x), _mm_andnot_ps(sign, y)));
+
+      __m128 t = _mm_min_ps(z, _mm_setzero_ps());
+      x = _mm_add_ps(x, _mm_xor_ps(t, _mm_and_ps(x, sign)));
+      y = _mm_add_ps(y, _mm_xor_ps(t, _mm_and_ps(y, sign)));
+
+      __m128 ll = _mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z)));
+      __m128 s = _mm_div_ps(_mm_set1_ps(32767.0f), _mm_sqrt_ps(ll));
+
+      __m128i xr = _mm_cvtps_epi32(_mm_mul_ps(x, s));
+      __m128i yr = _mm_cvtps_epi32(_mm_mul_ps(y, s));
+      __m128i zr = _mm_cvtps_epi32(_mm_mul_ps(z, s));
+
+      // interleave back to x y z, then patch the untouched w in
+      __m128i xz = _mm_or_si128(_mm_and_si128(xr, _mm_set1_epi32(0xffff)), _mm_slli_epi32(zr, 16));
+      __m128i y0 = _mm_and_si128(yr, _mm_set1_epi32(0xffff));
+
+      __m128i w_mask = _mm_set_epi32((int)0xffff0000, 0, (int)0xffff0000, 0);
+
+      __m128i res_0 = _mm_or_si128(_mm_unpacklo_epi16(xz, y0), _mm_and_si128(n4_0, w_mask));
+      __m128i res_1 = _mm_or_si128(_mm_unpackhi_epi16(xz, y0), _mm_and_si128(n4_1, w_mask));
+
+      _mm_storeu_si128((__m128i*)&data[(i + 0) * 4], res_0);
+      _mm_storeu_si128((__m128i*)&data[(i + 2) * 4], res_1);
+    }
+
+    decode_filter_oct_scalar(data + i * 4, count - i);
+  }
+
+  void decode_filter_oct(void* data, size_t count, size_t stride) {
+    assert(stride == 4 || stride == 8);
+
+    if (stride == 4) {
+      decode_filter_oct_scalar((int8_t*)data, count);
+    }
+    else {
+      decode_filter_oct16((int16_t*)data, count);
+    }
+  }
+
+  static uint64_t rotate_left(uint64_t v, int x) {
+    x &= 63;
+    return x ? (v << x) | (v >> (64 - x)) : v;
+  }
+
+  static void decode_filter_quat_scalar(int16_t* data, size_t count) {
+    const float scale = 1.0f / sqrtf(2.0f);
+
+    for (size_t i = 0; i < count; ++i) {
+      // the top 14 bits of w hold the component range, the bottom 2 the index of the dropped component
+      int sf = data[i * 4 + 3] | 3;
+      float ss = scale / float(sf);
+
+      float x = float(data[i * 4 + 0]) * ss;
+      float y = float(data[i * 4 + 1]) * ss;
+      float z = float(data[i * 4 + 2]) * ss;
+      float w = sqrtf(std::max(1.0f - x * x - y * y - z * z, 0.0f));
+
+      int qc = data[i * 4 + 3] & 3;
+
+      data[i * 4 + ((qc + 1) & 3)] = (int16_t)int(x * 32767.0f + (x >= 0.0f ? 0.5f : -0.5f));
+      data[i * 4 + ((qc + 2) & 3)] = (int16_t)int(y * 32767.0f + (y >= 0.0f ? 0.5f : -0.5f));
+      data[i * 4 + ((qc + 3) & 3)] = (int16_t)int(z * 32767.0f + (z >= 0.0f ? 0.5f : -0.5f));
+      data[i * 4 + ((qc + 0) & 3)] = (int16_t)int(w * 32767.0f + 0.5f);
+    }
+  }
+
+  void decode_filter_quat(void* data, size_t count, size_t stride) {
+    assert(stride == 8);
+    (void)stride;
+
+    int16_t* quats = (int16_t*)data;
+    const float scale = 1.0f / sqrtf(2.0f);
+
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+      __m128i q4_0 = _mm_loadu_si128((const __m128i*)&quats[(i + 0) * 4]);
+      __m128i q4_1 = _mm_loadu_si128((const __m128i*)&quats[(i + 2) * 4]);
+
+      __m128i xy = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(q4_0), _mm_castsi128_ps(q4_1), _MM_SHUFFLE(2, 0, 2, 0)));
+      __m128i zc = _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(q4_0), _mm_castsi128_ps(q4_1), _MM_SHUFFLE(3, 1, 3, 1)));
+
+      __m128i cf = _mm_srai_epi32(zc, 16);
+      __m128 ss = _mm_div_ps(_mm_set1_ps(scale), _mm_cvtepi32_ps(_mm_or_si128(cf, _mm_set1_epi32(3))));
+
+      __m128 x = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(xy, 16), 16)), ss);
+      __m128 y = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(xy, 16)), ss);
+      __m128 z = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(zc, 16), 16)), ss);
+
+      __m128 ww = _mm_sub_ps(_mm_set1_ps(1.0f), _mm_add_ps(_mm_mul_ps(x, x), _mm_add_ps(_mm_mul_ps(y, y), _mm_mul_ps(z, z))));
+      __m128 w = _mm_sqrt_ps(_mm_max_ps(ww, _mm_setzero_ps()));
+
+      __m128 s = _mm_set1_ps(32767.0f);
+
+      __m128i xr = _mm_cvtps_epi32(_mm_mul_ps(x, s));
+      __m128i yr = _mm_cvtps_epi32(_mm_mul_ps(y, s));
+      __m128i zr = _mm_cvtps_epi32(_mm_mul_ps(z, s));
+      __m128i wr = _mm_cvtps_epi32(_mm_mul_ps(w, s));
+
+      // packs w x y z per quaternion, then rotates w into the slot of the dropped component
+      __m128i xz = _mm_or_si128(_mm_and_si128(xr, _mm_set1_epi32(0xffff)), _mm_slli_epi32(zr, 16));
+      __m128i wy = _mm_or_si128(_mm_and_si128(wr, _mm_set1_epi32(0xffff)), _mm_slli_epi32(yr, 16));
+
+      alignas(16) uint64_t packed[4];
+      _mm_store_si128((__m128i*)&packed[0], _mm_unpacklo_epi16(wy, xz));
+      _mm_store_si128((__m128i*)&packed[2], _mm_unpackhi_epi16(wy, xz));
+
+      uint64_t* out = (uint64_t*)&quats[i * 4];
+
+      for (int j = 0; j < 4; ++j) {
+        int qc = quats[(i + j) * 4 + 3] & 3;
+        out[j] = rotate_left(packed[j], qc * 16);
+      }
+    }
+
+    decode_filter_quat_scalar(quats + i * 4, count - i);
+  }
+
+  void decode_filter_exp(void* data, size_t count, size_t stride) {
+    assert(stride % 4 == 0);
+
+    uint32_t* values = (uint32_t*)data;
+    size_t value_count = count * (stride / 4);
+
+    size_t i = 0;
+
+    // 24-bit signed mantissa, 8-bit signed exponent
+    for (; i + 4 <= value_count; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i*)&values[i]);
+
+      __m128i m = _mm_srai_epi32(_mm_slli_epi32(v, 8), 8);
+      __m128i e = _mm_srai_epi32(v, 24);
+
+      __m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(e, _mm_set1_epi32(127)), 23));
+      __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(m), scale);
+
+      _mm_storeu_si128((__m128i*)&values[i], _mm_castps_si128(r));
+    }
+
+    for (; i < value_count; ++i) {
+      int32_t m = (int32_t)(values[i] << 8) >> 8;
+      int32_t e = (int32_t)values[i] >> 24;
+
+      uint32_t scale_bits = (uint32_t)(e + 127) << 23;
+      float scale;
+      memcpy(&scale, &scale_bits, sizeof(float));
+
+      float r = scale * float(m);
+      memcpy(&values[i], &r, sizeof(float));
+    }
+  }
+
+}
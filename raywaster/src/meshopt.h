@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Decoders for the EXT_meshopt_compression bitstreams, compatible with meshoptimizer's
+// vertex codec v0, index codec v0/v1 and index sequence codec v0/v1.
+namespace meshopt {
+  bool decode_vertex_buffer(void* destination, size_t vertex_count, size_t vertex_size, const uint8_t* buffer, size_t buffer_size);
+  bool decode_index_buffer(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size);
+  bool decode_index_sequence(void* destination, size_t index_count, size_t index_size, const uint8_t* buffer, size_t buffer_size);
+
+  // filters are applied in place to the output of decode_vertex_buffer
+  void decode_filter_oct(void* data, size_t count, size_t stride);
+  void decode_filter_quat(void* data, size_t count, size_t stride);
+  void decode_filter_exp(void* data, size_t count, size_t stride);
+};
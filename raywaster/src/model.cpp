@@ -1,7 +1,11 @@
 #define CGLTF_IMPLEMENTATION
 #include "cgltf.h"
 
+#include <algorithm>
+
 #include "model.h"
+#include "meshopt.h"
+#include "parallel.h"
 
 struct StructuredAttributes {
   cgltf_accessor* pos;
@@ -33,11 +37,129 @@ StructuredAttributes find_attribs(cgltf_primitive* prim) {
 
 template<typename T>
 static T* accessor_data(cgltf_accessor* accessor) {
-  uint8_t* base = (uint8_t*)accessor->buffer_view->buffer->data;
-  base += accessor->buffer_view->offset + accessor->offset;
+  uint8_t* base = (uint8_t*)cgltf_buffer_view_data(accessor->buffer_view);
+  base += accessor->offset;
   return (T*)base;
 }
 
+template<typename S, typename T>
+static void copy_indices(std::vector<T>& result, cgltf_accessor* accessor) {
+  S* data = accessor_data<S>(accessor);
+
+  for (size_t i = 0; i < accessor->count/3; ++i) {
+    result[i*3+0] = (T)data[i*3+0];
+    result[i*3+1] = (T)data[i*3+2];
+    result[i*3+2] = (T)data[i*3+1];
+  }
+}
+
+template<typename T>
+static std::vector<T> read_indices(cgltf_accessor* accessor) {
+  std::vector<T> result(accessor->count);
+
+  switch (accessor->component_type) {
+    default:
+      assert(false);
+      break;
+
+    case cgltf_component_type_r_8u:
+      copy_indices<uint8_t>(result, accessor);
+      break;
+
+    case cgltf_component_type_r_16u:
+      copy_indices<uint16_t>(result, accessor);
+      break;
+
+    case cgltf_component_type_r_32u:
+      copy_indices<uint32_t>(result, accessor);
+      break;
+  }
+
+  return result;
+}
+
+// decoded views are stored in buffer_view->data, which cgltf_free releases
+static bool decompress_meshopt(cgltf_data* data) {
+  for (size_t i = 0; i < data->buffer_views_count; ++i) {
+    cgltf_buffer_view* view = &data->buffer_views[i];
+
+    if (!view->has_meshopt_compression) {
+      continue;
+    }
+
+    cgltf_meshopt_compression* mc = &view->meshopt_compression;
+
+    if (!mc->buffer->data) {
+      return false;
+    }
+
+    const uint8_t* source = (const uint8_t*)mc->buffer->data + mc->offset;
+    void* result = malloc(mc->count * mc->stride);
+
+    bool ok = false;
+
+    switch (mc->mode) {
+      default:
+        break;
+
+      case cgltf_meshopt_compression_mode_attributes:
+        ok = meshopt::decode_vertex_buffer(result, mc->count, mc->stride, source, mc->size);
+        break;
+
+      case cgltf_meshopt_compression_mode_triangles:
+        ok = meshopt::decode_index_buffer(result, mc->count, mc->stride, source, mc->size);
+        break;
+
+      case cgltf_meshopt_compression_mode_indices:
+        ok = meshopt::decode_index_sequence(result, mc->count, mc->stride, source, mc->size);
+        break;
+    }
+
+    if (!ok) {
+      free(result);
+      return false;
+    }
+
+    switch (mc->filter) {
+      default:
+        break;
+
+      case cgltf_meshopt_compression_filter_octahedral:
+        meshopt::decode_filter_oct(result, mc->count, mc->stride);
+        break;
+
+      case cgltf_meshopt_compression_filter_quaternion:
+        meshopt::decode_filter_quat(result, mc->count, mc->stride);
+        break;
+
+      case cgltf_meshopt_compression_filter_exponential:
+        meshopt::decode_filter_exp(result, mc->count, mc->stride);
+        break;
+    }
+
+    view->data = result;
+  }
+
+  return true;
+}
+
+// float accessors are copied directly, anything else (KHR_mesh_quantization, sparse, strided) goes through cgltf's conversion
+template<typename T>
+static std::vector<T> read_accessor(cgltf_accessor* accessor) {
+  std::vector<T> result(accessor->count);
+
+  if (accessor->component_type == cgltf_component_type_r_32f && accessor->stride == sizeof(T) && !accessor->is_sparse) {
+    memcpy(result.data(), accessor_data<T>(accessor), accessor->count * sizeof(T));
+  }
+  else {
+    cgltf_size unpacked = cgltf_accessor_unpack_floats(accessor, (float*)result.data(), accessor->count * (sizeof(T)/sizeof(float)));
+    assert(unpacked == accessor->count * (sizeof(T)/sizeof(float)));
+    (void)unpacked;
+  }
+
+  return result;
+}
+
 std::optional<Model> load_gltf(const char* path) {
   cgltf_options options = {};
   cgltf_data* data = NULL;
@@ -51,6 +173,11 @@ std::optional<Model> load_gltf(const char* path) {
     return std::nullopt;
   }
 
+  if (!decompress_meshopt(data)) {
+    cgltf_free(data);
+    return std::nullopt;
+  }
+
   std::vector<Mesh> meshes;
   std::vector<size_t> mesh_first_primitives;
 
@@ -63,51 +190,25 @@ std::optional<Model> load_gltf(const char* path) {
       cgltf_primitive* prim = &mesh->primitives[prim_index];
       auto [pos_acc, norm_acc, uv_acc] = find_attribs(prim);        
       
-      assert(pos_acc->component_type = cgltf_component_type_r_32f);
-      assert(norm_acc->component_type = cgltf_component_type_r_32f);
-      assert(uv_acc->component_type = cgltf_component_type_r_32f);
-
       assert(pos_acc->type  == cgltf_type_vec3);
       assert(norm_acc->type == cgltf_type_vec3);
       assert(uv_acc->type   == cgltf_type_vec2);
 
-      XMFLOAT3* pos_data = accessor_data<XMFLOAT3>(pos_acc);
-      XMFLOAT3* norm_data = accessor_data<XMFLOAT3>(norm_acc);
-      XMFLOAT2* uv_data = accessor_data<XMFLOAT2>(uv_acc);
-
-      std::vector<XMFLOAT3> positions(pos_data, pos_data + pos_acc->count);
-      std::vector<XMFLOAT3> normals(norm_data, norm_data + norm_acc->count);
-      std::vector<XMFLOAT2> tex_coords(uv_data, uv_data + uv_acc->count);
+      std::vector<XMFLOAT3> positions = read_accessor<XMFLOAT3>(pos_acc);
+      std::vector<XMFLOAT3> normals = read_accessor<XMFLOAT3>(norm_acc);
+      std::vector<XMFLOAT2> tex_coords = read_accessor<XMFLOAT2>(uv_acc);
 
       cgltf_accessor* ind_acc = prim->indices;
       assert(ind_acc->type == cgltf_type_scalar);
 
-      std::vector<uint32_t> indices;
+      // winding is flipped while copying, stored 16-bit whenever the primitive allows it
+      Indices indices;
 
-      switch (ind_acc->component_type) {
-        default:
-          assert(false);
-          break;
-
-        case cgltf_component_type_r_16u: {
-          uint16_t* ind_data = accessor_data<uint16_t>(ind_acc);
-          indices.reserve(ind_acc->count);
-          for (int i = 0; i < ind_acc->count/3; ++i) {
-            indices.push_back(ind_data[i*3+0]);
-            indices.push_back(ind_data[i*3+2]);
-            indices.push_back(ind_data[i*3+1]);
-          }
-        } break;
-
-        case cgltf_component_type_r_32u: {
-          uint32_t* ind_data = accessor_data<uint32_t>(ind_acc);
-          indices.reserve(ind_acc->count);
-          for (int i = 0; i < ind_acc->count/3; ++i) {
-            indices.push_back(ind_data[i*3+0]);
-            indices.push_back(ind_data[i*3+2]);
-            indices.push_back(ind_data[i*3+1]);
-          }
-        } break;
+      if (pos_acc->count <= 0x10000) {
+        indices.data = read_indices<uint16_t>(ind_acc);
+      }
+      else {
+        indices.data = read_indices<uint32_t>(ind_acc);
       }
 
       meshes.push_back(Mesh{
@@ -115,6 +216,13 @@ std::optional<Model> load_gltf(const char* path) {
         .normals = normals,
         .tex_coords = tex_coords,
         .indices = indices,
+        .segments = {
+          MeshSegment{
+            .first_index = 0,
+            .index_count = (uint32_t)indices.size(),
+            .base_vertex = 0,
+          }
+        },
       });
     }
   }
@@ -188,4 +296,153 @@ std::optional<Model> load_gltf(const char* path) {
     .meshes = meshes,
     .instances = instances
   };
+}
+
+Mesh combine_model(const Model& model) {
+  size_t instance_count = model.instances.size();
+
+  // segment-local indices stay 16-bit unless some mesh needed 32
+  bool wide = std::any_of(model.meshes.begin(), model.meshes.end(), [](const Mesh& mesh) { return mesh.indices.wide(); });
+
+  // exclusive prefix sums give every instance its slice of the output
+  std::vector<size_t> vertex_offsets(instance_count + 1);
+  std::vector<size_t> index_offsets(instance_count + 1);
+  std::vector<size_t> segment_offsets(instance_count + 1);
+
+  for (size_t i = 0; i < instance_count; ++i) {
+    auto& mesh = model.meshes[model.instances[i].mesh];
+
+    assert(mesh.positions.size() == mesh.normals.size());
+    assert(mesh.positions.size() == mesh.tex_coords.size());
+
+    vertex_offsets[i+1] = vertex_offsets[i] + mesh.positions.size();
+    index_offsets[i+1] = index_offsets[i] + mesh.indices.size();
+    segment_offsets[i+1] = segment_offsets[i] + mesh.segments.size();
+  }
+
+  size_t vertex_count = vertex_offsets[instance_count];
+  size_t index_count = index_offsets[instance_count];
+
+  assert(vertex_count <= UINT32_MAX && index_count <= UINT32_MAX);
+
+  std::vector<XMFLOAT3> positions(vertex_count);
+  std::vector<XMFLOAT3> normals(vertex_count);
+  std::vector<XMFLOAT2> tex_coords(vertex_count);
+  std::vector<MeshSegment> segments(segment_offsets[instance_count]);
+
+  Indices indices;
+
+  if (wide) {
+    indices.data = std::vector<uint32_t>(index_count);
+  }
+  else {
+    indices.data = std::vector<uint16_t>(index_count);
+  }
+
+  // big instances are split into blocks so one huge mesh doesn't serialize the rest
+  const size_t block_size = 16384;
+
+  struct Block {
+    size_t instance;
+    size_t first;
+    size_t count;
+  };
+
+  std::vector<Block> blocks;
+
+  for (size_t i = 0; i < instance_count; ++i) {
+    size_t count = vertex_offsets[i+1] - vertex_offsets[i];
+
+    for (size_t first = 0; first < count; first += block_size) {
+      blocks.push_back(Block{
+        .instance = i,
+        .first = first,
+        .count = std::min(block_size, count - first),
+      });
+    }
+  }
+
+  // normals go through the inverse transpose, only renormalized when it isn't a pure rotation
+  std::vector<XMMATRIX> normal_transforms(instance_count);
+  std::vector<uint8_t> renormalize(instance_count);
+
+  parallel::for_range(instance_count, 256, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      XMMATRIX m = model.instances[i].transform;
+      m.r[3] = g_XMIdentityR3;
+
+      XMMATRIX n = XMMatrixTranspose(XMMatrixInverse(nullptr, m));
+      normal_transforms[i] = n;
+
+      XMVECTOR epsilon = XMVectorReplicate(1e-4f);
+      XMVECTOR one = XMVectorSplatOne();
+      XMVECTOR zero = XMVectorZero();
+
+      bool rotation = XMVector3NearEqual(XMVector3LengthSq(n.r[0]), one, epsilon)
+                   && XMVector3NearEqual(XMVector3LengthSq(n.r[1]), one, epsilon)
+                   && XMVector3NearEqual(XMVector3LengthSq(n.r[2]), one, epsilon)
+                   && XMVector3NearEqual(XMVector3Dot(n.r[0], n.r[1]), zero, epsilon)
+                   && XMVector3NearEqual(XMVector3Dot(n.r[0], n.r[2]), zero, epsilon)
+                   && XMVector3NearEqual(XMVector3Dot(n.r[1], n.r[2]), zero, epsilon);
+
+      renormalize[i] = !rotation;
+    }
+  });
+
+  parallel::for_range(blocks.size(), 4, [&](size_t begin, size_t end) {
+    for (size_t b = begin; b < end; ++b) {
+      Block block = blocks[b];
+
+      auto& instance = model.instances[block.instance];
+      auto& mesh = model.meshes[instance.mesh];
+
+      size_t dst = vertex_offsets[block.instance] + block.first;
+
+      XMVector3TransformCoordStream(&positions[dst], sizeof(XMFLOAT3), &mesh.positions[block.first], sizeof(XMFLOAT3), block.count, instance.transform);
+      XMVector3TransformNormalStream(&normals[dst], sizeof(XMFLOAT3), &mesh.normals[block.first], sizeof(XMFLOAT3), block.count, normal_transforms[block.instance]);
+
+      if (renormalize[block.instance]) {
+        for (size_t i = dst; i < dst + block.count; ++i) {
+          XMStoreFloat3(&normals[i], XMVector3Normalize(XMLoadFloat3(&normals[i])));
+        }
+      }
+
+      memcpy(&tex_coords[dst], &mesh.tex_coords[block.first], block.count * sizeof(XMFLOAT2));
+    }
+  });
+
+  parallel::for_range(instance_count, 64, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      auto& mesh = model.meshes[model.instances[i].mesh];
+
+      uint32_t first_index = (uint32_t)index_offsets[i];
+      uint32_t base_vertex = (uint32_t)vertex_offsets[i];
+
+      for (size_t s = 0; s < mesh.segments.size(); ++s) {
+        const MeshSegment& segment = mesh.segments[s];
+
+        segments[segment_offsets[i] + s] = MeshSegment{
+          .first_index = first_index + segment.first_index,
+          .index_count = segment.index_count,
+          .base_vertex = base_vertex + segment.base_vertex,
+        };
+      }
+
+      std::visit([&](auto& dst) {
+        using T = typename std::decay_t<decltype(dst)>::value_type;
+
+        std::visit([&](auto& src) {
+          std::transform(src.begin(), src.end(), dst.begin() + first_index, [](auto index) { return (T)index; });
+        }, mesh.indices.data);
+      }, indices.data);
+    }
+  });
+
+  return Mesh {
+    .positions = std::move(positions),
+    .normals = std::move(normals),
+    .tex_coords = std::move(tex_coords),
+    .indices = std::move(indices),
+    .segments = std::move(segments),
+  };
 }
\ No newline at end of file
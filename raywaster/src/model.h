@@ -1,16 +1,73 @@
 #pragma once
 
 #include <DirectXMath.h>
+#include <DirectXPackedVector.h>
 using namespace DirectX;
+using namespace DirectX::PackedVector;
 
 #include <vector>
 #include <optional>
+#include <variant>
+
+// 16-bit whenever every index of a segment fits, 32-bit otherwise
+struct Indices {
+  std::variant<std::vector<uint16_t>, std::vector<uint32_t>> data;
+
+  bool wide() const {
+    return data.index() == 1;
+  }
+
+  size_t size() const {
+    return wide() ? std::get<1>(data).size() : std::get<0>(data).size();
+  }
+
+  uint32_t operator[](size_t i) const {
+    return wide() ? std::get<1>(data)[i] : std::get<0>(data)[i];
+  }
+
+  uint32_t width() const {
+    return wide() ? sizeof(uint32_t) : sizeof(uint16_t);
+  }
+
+  const void* bytes() const {
+    return wide() ? (const void*)std::get<1>(data).data() : (const void*)std::get<0>(data).data();
+  }
+};
+
+// a range of indices relative to base_vertex, vertex i of the range is positions[base_vertex + indices[first_index + i]]
+struct MeshSegment {
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t base_vertex;
+};
 
 struct Mesh {
   std::vector<XMFLOAT3> positions;
   std::vector<XMFLOAT3> normals;
   std::vector<XMFLOAT2> tex_coords;
-  std::vector<uint32_t> indices;
+  Indices indices;
+  std::vector<MeshSegment> segments;
+};
+
+// 16-bit unorm position relative to bounds[bounds]
+struct QuantizedPosition {
+  uint16_t x, y, z;
+  uint16_t bounds;
+};
+
+struct PositionBounds {
+  XMFLOAT3 offset;
+  XMFLOAT3 scale;
+};
+
+// 16 bytes per vertex instead of 32, see quantize.h
+struct QuantizedMesh {
+  std::vector<PositionBounds> bounds; // one per distinct segment base_vertex
+  std::vector<QuantizedPosition> positions;
+  std::vector<XMSHORTN2> normals; // octahedral
+  std::vector<XMHALF2> tex_coords;
+  Indices indices;
+  std::vector<MeshSegment> segments;
 };
 
 struct Instance {
@@ -24,3 +81,6 @@ struct Model {
 };
 
 std::optional<Model> load_gltf(const char* path);
+
+// flattens every instance into one mesh in world space
+Mesh combine_model(const Model& model);
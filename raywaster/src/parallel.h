@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+  inline size_t thread_count() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+  }
+
+  // calls fn(begin, end) on chunks of [0, count) from every core and waits for all of them
+  template<typename F>
+  void for_range(size_t count, size_t grain, F&& fn) {
+    grain = std::max(grain, (size_t)1);
+
+    size_t chunks = (count + grain - 1) / grain;
+    size_t workers = std::min(chunks, thread_count());
+
+    if (workers <= 1) {
+      if (count) {
+        fn((size_t)0, count);
+      }
+      return;
+    }
+
+    std::atomic<size_t> next = 0;
+
+    auto work = [&]() {
+      for (;;) {
+        size_t chunk = next.fetch_add(1, std::memory_order_relaxed);
+
+        if (chunk >= chunks) {
+          break;
+        }
+
+        size_t begin = chunk * grain;
+        fn(begin, std::min(begin + grain, count));
+      }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+
+    for (size_t i = 1; i < workers; ++i) {
+      threads.emplace_back(work);
+    }
+
+    work();
+
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+};
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "pathtrace.h"
+#include "parallel.h"
+
+namespace pathtrace {
+  // same as cosine_direction in common.hlsli
+  static XMVECTOR cosine_direction(XMFLOAT2 u, FXMVECTOR n) {
+    XMVECTOR a = std::abs(XMVectorGetX(n)) > 0.9f ? XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f) : XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+    XMVECTOR s = XMVector3Normalize(XMVector3Cross(n, a));
+    XMVECTOR t = XMVector3Cross(n, s);
+
+    float phi = XM_2PI * u.x;
+    float r = std::sqrt(u.y);
+
+    return std::cos(phi) * r * s + std::sin(phi) * r * t + std::sqrt(1.0f - u.y) * n;
+  }
+
+  static XMVECTOR environment_radiance(const restir::Environment& env, FXMVECTOR dir) {
+    return hdri::sample_bilinear((*env.mips)[0], hdri::dir_to_octahedral(dir), hdri::Layout::OCTAHEDRAL) + hdri::disk_lights_radiance(*env.lights, dir);
+  }
+
+  uint32_t max_rays_per_path(Settings settings) {
+    return 2 * std::min(settings.max_bounces, MAX_BOUNCES);
+  }
+
+  uint32_t pixel_stride(Settings settings, uint32_t pixel_count) {
+    uint64_t rays = (uint64_t)pixel_count * max_rays_per_path(settings);
+    uint64_t budget = std::max(settings.ray_budget, 1u);
+    return (uint32_t)std::max((rays + budget - 1) / budget, (uint64_t)1);
+  }
+
+  XMVECTOR trace_path(const trace::Scene& scene, const restir::Environment& env, FXMVECTOR origin, FXMVECTOR normal,
+                      Settings settings, sampler::Sampler& s, trace::TraversalStats* stats)
+  {
+    XMVECTOR radiance = XMVectorZero();
+    XMVECTOR o = origin;
+    XMVECTOR n = normal;
+    float throughput = 1.0f;
+
+    uint32_t bounces = std::min(settings.max_bounces, MAX_BOUNCES);
+
+    for (uint32_t bounce = 0; bounce < bounces; ++bounce) {
+      XMFLOAT2 u_dir = sampler::next_2d(s);
+      float u_roulette = sampler::next_1d(s);
+      float u_strategy = sampler::next_1d(s);
+      XMFLOAT2 u0 = sampler::next_2d(s);
+      XMFLOAT2 u1 = sampler::next_2d(s);
+
+      trace::Hit hit;
+      trace::TraversalStats ray_stats;
+
+      bool found = trace::intersect(scene, o + n * 1e-6f, cosine_direction(u_dir, n), &hit, &ray_stats);
+      *stats = trace::merge_traversal_stats(*stats, ray_stats);
+
+      if (!found) {
+        break; // the environment along bounce rays was already counted by the previous vertex's light sample
+      }
+
+      o = XMLoadFloat3(&hit.position);
+      n = XMLoadFloat3(&hit.normal);
+
+      // cosine sampling cancels everything of the lambertian brdf but its albedo
+      throughput *= settings.albedo;
+
+      float pdf;
+      XMVECTOR wi = restir::sample_mixture(env, XMFLOAT4(u0.x, u0.y, u1.x, u1.y), u_strategy, &pdf);
+      float cosine = XMVectorGetX(XMVector3Dot(n, wi));
+
+      if (pdf > 0.0f && cosine > 0.0f) {
+        bool blocked = trace::occluded(scene, o + n * 1e-6f, wi, &ray_stats);
+        *stats = trace::merge_traversal_stats(*stats, ray_stats);
+
+        if (!blocked) {
+          radiance += environment_radiance(env, wi) * (throughput * cosine / (XM_PI * pdf));
+        }
+      }
+
+      if (bounce + 1 >= settings.roulette_start) {
+        float survival = std::min(throughput, 0.95f);
+
+        if (u_roulette >= survival) {
+          break;
+        }
+
+        throughput /= survival;
+      }
+    }
+
+    return radiance;
+  }
+
+  uint64_t render_indirect(const trace::Scene& scene, const restir::Environment& env, uint32_t width, uint32_t height,
+                           uint32_t frame, const restir::Surface* surfaces, const restir::Surface* previous_surfaces,
+                           const XMFLOAT3* previous_indirect, FXMMATRIX prev_view_proj, Settings settings,
+                           sampler::Settings sampling, XMFLOAT3* indirect, trace::TraversalStats* stats)
+  {
+    uint32_t pixel_count = width * height;
+
+    if (settings.max_bounces == 0) {
+      std::fill(indirect, indirect + pixel_count, XMFLOAT3(0.0f, 0.0f, 0.0f));
+      return 0;
+    }
+
+    uint32_t stride = pixel_stride(settings, pixel_count);
+    uint32_t phase = frame % stride;
+
+    std::atomic<uint64_t> total_rays = 0;
+
+    parallel::for_range(pixel_count, 256, [&](size_t begin, size_t end) {
+      uint64_t rays = 0;
+
+      for (size_t i = begin; i < end; ++i) {
+        uint32_t p = (uint32_t)i;
+        const restir::Surface& surface = surfaces[p];
+
+        indirect[p] = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+        if (surface.depth <= 0.0f) {
+          continue;
+        }
+
+        if (p % stride != phase) {
+          size_t j;
+
+          if (previous_indirect && restir::reproject(surface, previous_surfaces, width, height, prev_view_proj, restir::DEFAULT_TEMPORAL_SETTINGS, &j)) {
+            indirect[p] = previous_indirect[j];
+          }
+
+          continue;
+        }
+
+        sampler::Sampler s = sampler::make_sampler(sampling, XMUINT2(p % width, p / width), sampler::hash32(p));
+        sampler::start_sample(s, frame / stride);
+
+        trace::TraversalStats path_stats = trace::empty_traversal_stats();
+
+        XMVECTOR radiance = trace_path(scene, env, XMLoadFloat3(&surface.position), XMLoadFloat3(&surface.normal), settings, s, &path_stats);
+        XMStoreFloat3(&indirect[p], radiance);
+
+        rays += path_stats.ray_count;
+
+        if (stats) {
+          stats[p] = trace::merge_traversal_stats(stats[p], path_stats);
+        }
+      }
+
+      total_rays += rays;
+    });
+
+    return total_rays;
+  }
+};
\ No newline at end of file
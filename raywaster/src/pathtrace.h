@@ -0,0 +1,51 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "restir.h"
+#include "sampler.h"
+#include "trace.h"
+
+using namespace DirectX;
+
+// cpu reference for indirect_cs, the same paths for the same sampler settings
+namespace pathtrace {
+  // must match indirect_cs.hlsl
+  static constexpr uint32_t MAX_BOUNCES = 8;
+  static constexpr uint32_t DIMENSIONS_PER_BOUNCE = 8;
+
+  struct Settings {
+    uint32_t max_bounces;    // at most MAX_BOUNCES, zero turns indirect lighting off
+    uint32_t roulette_start; // bounces that always continue before russian roulette can end the path
+    float albedo;            // of every surface past the first, the mesh carries no materials
+    uint32_t ray_budget;     // per frame, bounce and shadow rays together
+  };
+
+  static constexpr Settings DEFAULT_SETTINGS = {
+    .max_bounces = 2,
+    .roulette_start = 1,
+    .albedo = 0.7f,
+    .ray_budget = 1u << 20,
+  };
+
+  // a bounce ray and a shadow ray per bounce, roulette only ever makes paths shorter
+  uint32_t max_rays_per_path(Settings settings);
+
+  // each pixel traces a path every stride frames, so the worst case stays within the budget
+  uint32_t pixel_stride(Settings settings, uint32_t pixel_count);
+
+  // radiance arriving at origin from the surfaces around it, lit by the environment with next event
+  // estimation at every bounce. dimensions of s are used DIMENSIONS_PER_BOUNCE at a time. the path's rays are
+  // merged into stats
+  XMVECTOR trace_path(const trace::Scene& scene, const restir::Environment& env, FXMVECTOR origin, FXMVECTOR normal,
+                      Settings settings, sampler::Sampler& s, trace::TraversalStats* stats);
+
+  // traces the pixels whose turn it is this frame. the rest reproject what previous_indirect had for the same surface
+  // last frame, with the temporal pass's tolerances, and go dark where it wasn't visible. previous_surfaces and
+  // previous_indirect are null when there's no history. stats is optional, each pixel's rays are merged into its
+  // entry like indirect_cs does with a debug view on. returns the number of rays traced
+  uint64_t render_indirect(const trace::Scene& scene, const restir::Environment& env, uint32_t width, uint32_t height,
+                           uint32_t frame, const restir::Surface* surfaces, const restir::Surface* previous_surfaces,
+                           const XMFLOAT3* previous_indirect, FXMMATRIX prev_view_proj, Settings settings,
+                           sampler::Settings sampling, XMFLOAT3* indirect, trace::TraversalStats* stats = nullptr);
+};
\ No newline at end of file
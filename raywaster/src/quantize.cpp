@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <cmath>
+
+#include "quantize.h"
+
+// maps the unit sphere onto the [-1, 1] square, lower hemisphere folded over the diagonals
+XMVECTOR octahedral_encode(FXMVECTOR n) {
+  XMVECTOR p = n / XMVectorSum(XMVectorAndInt(XMVectorAbs(n), g_XMSelect1110));
+
+  if (XMVectorGetZ(p) < 0.0f) {
+    XMVECTOR sign = XMVectorSelect(g_XMNegativeOne, g_XMOne, XMVectorGreaterOrEqual(p, XMVectorZero()));
+    p = (g_XMOne - XMVectorAbs(XMVectorSwizzle<XM_SWIZZLE_Y, XM_SWIZZLE_X, XM_SWIZZLE_Z, XM_SWIZZLE_W>(p))) * sign;
+  }
+
+  return XMVectorAndInt(p, XMVectorSelectControl(1, 1, 0, 0));
+}
+
+XMVECTOR octahedral_decode(FXMVECTOR e) {
+  float x = XMVectorGetX(e);
+  float y = XMVectorGetY(e);
+  float z = 1.0f - std::abs(x) - std::abs(y);
+  float t = XMMax(-z, 0.0f);
+
+  x += x >= 0.0f ? -t : t;
+  y += y >= 0.0f ? -t : t;
+
+  return XMVector3Normalize(XMVectorSet(x, y, z, 0.0f));
+}
+
+// where each run of vertices that gets its own bounds starts. every segment's base_vertex starts one, so an instance
+// far from the others doesn't cost them precision. runs are merged pairwise until their index fits in 16 bits
+static std::vector<uint32_t> bounds_starts(const Mesh& mesh) {
+  std::vector<uint32_t> starts = { 0 };
+
+  for (auto& segment : mesh.segments) {
+    if (segment.base_vertex < mesh.positions.size()) {
+      starts.push_back(segment.base_vertex);
+    }
+  }
+
+  std::sort(starts.begin(), starts.end());
+  starts.erase(std::unique(starts.begin(), starts.end()), starts.end());
+
+  while (starts.size() > 65536) {
+    size_t merged = (starts.size() + 1) / 2;
+
+    for (size_t i = 0; i < merged; ++i) {
+      starts[i] = starts[i * 2];
+    }
+
+    starts.resize(merged);
+  }
+
+  return starts;
+}
+
+QuantizedMesh quantize_mesh(const Mesh& mesh) {
+  std::vector<uint32_t> starts = bounds_starts(mesh);
+
+  QuantizedMesh result = {};
+  result.bounds.resize(starts.size());
+  result.positions.resize(mesh.positions.size());
+  result.normals.resize(mesh.normals.size());
+  result.tex_coords.resize(mesh.tex_coords.size());
+  result.indices = mesh.indices;
+  result.segments = mesh.segments;
+
+  for (size_t b = 0; b < starts.size(); ++b) {
+    size_t end = b + 1 < starts.size() ? starts[b + 1] : mesh.positions.size();
+
+    XMVECTOR min = XMVectorSplatInfinity();
+    XMVECTOR max = -XMVectorSplatInfinity();
+
+    for (size_t i = starts[b]; i < end; ++i) {
+      min = XMVectorMin(min, XMLoadFloat3(&mesh.positions[i]));
+      max = XMVectorMax(max, XMLoadFloat3(&mesh.positions[i]));
+    }
+
+    XMVECTOR scale = XMVectorMax(max - min, XMVectorSplatEpsilon());
+    XMVECTOR to_unorm = XMVectorReplicate(65535.0f) / scale;
+
+    XMStoreFloat3(&result.bounds[b].offset, min);
+    XMStoreFloat3(&result.bounds[b].scale, scale);
+
+    for (size_t i = starts[b]; i < end; ++i) {
+      XMVECTOR q = XMVectorClamp(XMVectorRound((XMLoadFloat3(&mesh.positions[i]) - min) * to_unorm), XMVectorZero(), XMVectorReplicate(65535.0f));
+
+      result.positions[i] = QuantizedPosition{
+        .x = (uint16_t)XMVectorGetX(q),
+        .y = (uint16_t)XMVectorGetY(q),
+        .z = (uint16_t)XMVectorGetZ(q),
+        .bounds = (uint16_t)b,
+      };
+    }
+  }
+
+  for (size_t i = 0; i < mesh.normals.size(); ++i) {
+    XMStoreShortN2(&result.normals[i], octahedral_encode(XMVector3Normalize(XMLoadFloat3(&mesh.normals[i]))));
+  }
+
+  for (size_t i = 0; i < mesh.tex_coords.size(); ++i) {
+    XMStoreHalf2(&result.tex_coords[i], XMLoadFloat2(&mesh.tex_coords[i]));
+  }
+
+  return result;
+}
+
+XMVECTOR decode_position(const QuantizedMesh& mesh, size_t index) {
+  const QuantizedPosition& q = mesh.positions[index];
+  const PositionBounds& bounds = mesh.bounds[q.bounds];
+
+  XMVECTOR unorm = XMVectorSet(q.x, q.y, q.z, 0.0f) * (1.0f / 65535.0f);
+  return XMVectorMultiplyAdd(unorm, XMLoadFloat3(&bounds.scale), XMLoadFloat3(&bounds.offset));
+}
+
+XMVECTOR decode_normal(const QuantizedMesh& mesh, size_t index) {
+  return octahedral_decode(XMLoadShortN2(&mesh.normals[index]));
+}
+
+XMVECTOR decode_tex_coord(const QuantizedMesh& mesh, size_t index) {
+  return XMLoadHalf2(&mesh.tex_coords[index]);
+}
+
+Mesh dequantize_mesh(const QuantizedMesh& mesh) {
+  Mesh result = {};
+
+  result.positions.resize(mesh.positions.size());
+  result.normals.resize(mesh.normals.size());
+  result.tex_coords.resize(mesh.tex_coords.size());
+  result.indices = mesh.indices;
+  result.segments = mesh.segments;
+
+  for (size_t i = 0; i < mesh.positions.size(); ++i) {
+    XMStoreFloat3(&result.positions[i], decode_position(mesh, i));
+  }
+
+  for (size_t i = 0; i < mesh.normals.size(); ++i) {
+    XMStoreFloat3(&result.normals[i], decode_normal(mesh, i));
+  }
+
+  for (size_t i = 0; i < mesh.tex_coords.size(); ++i) {
+    XMStoreFloat2(&result.tex_coords[i], decode_tex_coord(mesh, i));
+  }
+
+  return result;
+}
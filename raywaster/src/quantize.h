@@ -0,0 +1,17 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "model.h"
+
+using namespace DirectX;
+
+XMVECTOR octahedral_encode(FXMVECTOR n);
+XMVECTOR octahedral_decode(FXMVECTOR e);
+
+QuantizedMesh quantize_mesh(const Mesh& mesh);
+Mesh dequantize_mesh(const QuantizedMesh& mesh);
+
+XMVECTOR decode_position(const QuantizedMesh& mesh, size_t index);
+XMVECTOR decode_normal(const QuantizedMesh& mesh, size_t index);
+XMVECTOR decode_tex_coord(const QuantizedMesh& mesh, size_t index);
@@ -0,0 +1,418 @@
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <DirectXPackedVector.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+
+#include "radiance.h"
+#include "parallel.h"
+
+using namespace DirectX::PackedVector;
+
+// avx2 paths are picked at runtime, so they have to compile without /arch:AVX2
+#ifdef _MSC_VER
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#endif
+
+namespace hdri {
+  struct Header {
+    HdrInfo info;
+    size_t data_offset;
+  };
+
+  static std::optional<Header> parse_header(const uint8_t* data, size_t size) {
+    size_t pos = 0;
+
+    auto next_line = [&]() -> std::optional<std::string_view> {
+      size_t start = pos;
+
+      while (pos < size && data[pos] != '\n') {
+        pos++;
+      }
+
+      if (pos >= size) {
+        return std::nullopt;
+      }
+
+      return std::string_view((const char*)data + start, pos++ - start);
+    };
+
+    auto magic = next_line();
+
+    if (!magic || !magic->starts_with("#?")) {
+      return std::nullopt;
+    }
+
+    for (;;) {
+      auto line = next_line();
+
+      if (!line) {
+        return std::nullopt;
+      }
+
+      if (line->empty()) {
+        break;
+      }
+
+      if (line->starts_with("FORMAT=") && *line != "FORMAT=32-bit_rle_rgbe") {
+        return std::nullopt;
+      }
+    }
+
+    auto resolution = next_line();
+
+    if (!resolution) {
+      return std::nullopt;
+    }
+
+    char buffer[64] = {};
+    memcpy(buffer, resolution->data(), std::min(resolution->size(), sizeof(buffer) - 1));
+
+    int width, height;
+
+    if (sscanf(buffer, "-Y %d +X %d", &height, &width) != 2 || width <= 0 || height <= 0) {
+      return std::nullopt;
+    }
+
+    return Header{
+      .info = {
+        .width = (uint32_t)width,
+        .height = (uint32_t)height,
+      },
+      .data_offset = pos,
+    };
+  }
+
+  static bool is_rle_scanline(const uint8_t* p, const uint8_t* end, uint32_t width) {
+    return width >= 8 && width < 0x8000 && end - p >= 4 && p[0] == 2 && p[1] == 2 && (p[2] & 0x80) == 0 && (((uint32_t)p[2] << 8) | p[3]) == width;
+  }
+
+  // walks the runs without decoding them, returns the start of the next scanline
+  static const uint8_t* skip_scanline(const uint8_t* p, const uint8_t* end, uint32_t width) {
+    if (is_rle_scanline(p, end, width)) {
+      p += 4;
+
+      for (int channel = 0; channel < 4; ++channel) {
+        uint32_t x = 0;
+
+        while (x < width) {
+          if (p >= end) {
+            return nullptr;
+          }
+
+          uint32_t count = *p;
+
+          if (count > 128) {
+            count -= 128;
+            p += 2;
+          }
+          else {
+            p += 1 + count;
+          }
+
+          if (count == 0 || x + count > width || p > end) {
+            return nullptr;
+          }
+
+          x += count;
+        }
+      }
+
+      return p;
+    }
+
+    // flat pixels, possibly with old style (1, 1, 1, n) repeats
+    uint32_t x = 0;
+    int shift = 0;
+
+    while (x < width) {
+      if (end - p < 4) {
+        return nullptr;
+      }
+
+      if (p[0] == 1 && p[1] == 1 && p[2] == 1) {
+        if (x == 0) {
+          return nullptr;
+        }
+
+        x += (uint32_t)p[3] << shift;
+        shift += 8;
+      }
+      else {
+        x++;
+        shift = 0;
+      }
+
+      p += 4;
+    }
+
+    return x == width ? p : nullptr;
+  }
+
+  // scanline into separate r, g, b, e planes
+  static void decode_scanline(const uint8_t* p, uint32_t width, uint8_t* planes) {
+    if (is_rle_scanline(p, p + 4, width)) {
+      p += 4;
+
+      for (int channel = 0; channel < 4; ++channel) {
+        uint8_t* out = planes + channel * width;
+        uint32_t x = 0;
+
+        while (x < width) {
+          uint32_t count = *p;
+
+          if (count > 128) {
+            count -= 128;
+            memset(out + x, p[1], count);
+            p += 2;
+          }
+          else {
+            memcpy(out + x, p + 1, count);
+            p += 1 + count;
+          }
+
+          x += count;
+        }
+      }
+
+      return;
+    }
+
+    uint32_t x = 0;
+    int shift = 0;
+
+    while (x < width) {
+      if (p[0] == 1 && p[1] == 1 && p[2] == 1) {
+        uint32_t count = std::min((uint32_t)p[3] << shift, width - x);
+
+        for (uint32_t i = 0; i < count; ++i, ++x) {
+          for (int channel = 0; channel < 4; ++channel) {
+            planes[channel * width + x] = planes[channel * width + x - 1];
+          }
+        }
+
+        shift += 8;
+      }
+      else {
+        for (int channel = 0; channel < 4; ++channel) {
+          planes[channel * width + x] = p[channel];
+        }
+
+        x++;
+        shift = 0;
+      }
+
+      p += 4;
+    }
+  }
+
+  // same scale as stb_image, mantissa * 2^(e - 136)
+  static float rgbe_scale(uint8_t e) {
+    return e ? std::ldexp(1.0f, (int)e - 136) : 0.0f;
+  }
+
+  static void convert_scalar(const uint8_t* planes, uint32_t width, uint32_t begin, TexelFormat format, void* out) {
+    const uint8_t* r = planes;
+    const uint8_t* g = planes + width;
+    const uint8_t* b = planes + width * 2;
+    const uint8_t* e = planes + width * 3;
+
+    for (uint32_t x = begin; x < width; ++x) {
+      float scale = rgbe_scale(e[x]);
+
+      if (format == TexelFormat::RGB32F) {
+        float* texel = (float*)out + x * 3;
+        texel[0] = r[x] * scale;
+        texel[1] = g[x] * scale;
+        texel[2] = b[x] * scale;
+      }
+      else {
+        HALF* texel = (HALF*)out + x * 4;
+        texel[0] = XMConvertFloatToHalf(r[x] * scale);
+        texel[1] = XMConvertFloatToHalf(g[x] * scale);
+        texel[2] = XMConvertFloatToHalf(b[x] * scale);
+        texel[3] = 0x3c00;
+      }
+    }
+  }
+
+  // exponents below 10 would be denormal scales, those are flushed to zero
+  TARGET_AVX2 static __m256 load_scale(const uint8_t* e) {
+    __m256i exponent = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)e));
+    __m256i bits = _mm256_slli_epi32(_mm256_sub_epi32(exponent, _mm256_set1_epi32(9)), 23);
+    __m256i valid = _mm256_cmpgt_epi32(exponent, _mm256_set1_epi32(9));
+    return _mm256_castsi256_ps(_mm256_and_si256(bits, valid));
+  }
+
+  TARGET_AVX2 static __m256 load_channel(const uint8_t* c, __m256 scale) {
+    return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)c))), scale);
+  }
+
+  TARGET_AVX2 static void convert_avx2(const uint8_t* planes, uint32_t width, TexelFormat format, void* out) {
+    const uint8_t* r = planes;
+    const uint8_t* g = planes + width;
+    const uint8_t* b = planes + width * 2;
+    const uint8_t* e = planes + width * 3;
+
+    uint32_t x = 0;
+
+    for (; x + 8 <= width; x += 8) {
+      __m256 scale = load_scale(e + x);
+
+      __m256 rr = load_channel(r + x, scale);
+      __m256 gg = load_channel(g + x, scale);
+      __m256 bb = load_channel(b + x, scale);
+
+      if (format == TexelFormat::RGB32F) {
+        // planar to interleaved, each 128 bit lane produces 4 texels
+        __m256 rg_lo = _mm256_unpacklo_ps(rr, gg);
+        __m256 rg_hi = _mm256_unpackhi_ps(rr, gg);
+        __m256 gb_lo = _mm256_unpacklo_ps(gg, bb);
+        __m256 gb_hi = _mm256_unpackhi_ps(gg, bb);
+        __m256 br_lo = _mm256_unpacklo_ps(bb, rr);
+        __m256 br_hi = _mm256_unpackhi_ps(bb, rr);
+
+        __m256 out0 = _mm256_shuffle_ps(rg_lo, br_lo, _MM_SHUFFLE(3, 0, 1, 0));
+        __m256 out1 = _mm256_shuffle_ps(gb_lo, rg_hi, _MM_SHUFFLE(1, 0, 3, 2));
+        __m256 out2 = _mm256_shuffle_ps(br_hi, gb_hi, _MM_SHUFFLE(3, 2, 3, 0));
+
+        float* texels = (float*)out + x * 3;
+
+        _mm_storeu_ps(texels + 0, _mm256_castps256_ps128(out0));
+        _mm_storeu_ps(texels + 4, _mm256_castps256_ps128(out1));
+        _mm_storeu_ps(texels + 8, _mm256_castps256_ps128(out2));
+        _mm_storeu_ps(texels + 12, _mm256_extractf128_ps(out0, 1));
+        _mm_storeu_ps(texels + 16, _mm256_extractf128_ps(out1, 1));
+        _mm_storeu_ps(texels + 20, _mm256_extractf128_ps(out2, 1));
+      }
+      else {
+        __m128i rh = _mm256_cvtps_ph(rr, _MM_FROUND_TO_NEAREST_INT);
+        __m128i gh = _mm256_cvtps_ph(gg, _MM_FROUND_TO_NEAREST_INT);
+        __m128i bh = _mm256_cvtps_ph(bb, _MM_FROUND_TO_NEAREST_INT);
+        __m128i ah = _mm_set1_epi16(0x3c00);
+
+        __m128i rg_lo = _mm_unpacklo_epi16(rh, gh);
+        __m128i rg_hi = _mm_unpackhi_epi16(rh, gh);
+        __m128i ba_lo = _mm_unpacklo_epi16(bh, ah);
+        __m128i ba_hi = _mm_unpackhi_epi16(bh, ah);
+
+        __m128i* texels = (__m128i*)((HALF*)out + x * 4);
+
+        _mm_storeu_si128(texels + 0, _mm_unpacklo_epi32(rg_lo, ba_lo));
+        _mm_storeu_si128(texels + 1, _mm_unpackhi_epi32(rg_lo, ba_lo));
+        _mm_storeu_si128(texels + 2, _mm_unpacklo_epi32(rg_hi, ba_hi));
+        _mm_storeu_si128(texels + 3, _mm_unpackhi_epi32(rg_hi, ba_hi));
+      }
+    }
+
+    convert_scalar(planes, width, x, format, out);
+  }
+
+  static bool has_avx2() {
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool f16c = (info[2] & (1 << 29)) != 0;
+
+    if (!osxsave || !f16c || (_xgetbv(0) & 0x6) != 0x6) {
+      return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#endif
+  }
+
+  std::optional<HdrInfo> read_hdr_info(const void* data, size_t size) {
+    auto header = parse_header((const uint8_t*)data, size);
+
+    if (!header) {
+      return std::nullopt;
+    }
+
+    return header->info;
+  }
+
+  bool decode_hdr(const void* data, size_t size, TexelFormat format, void* out) {
+    auto header = parse_header((const uint8_t*)data, size);
+
+    if (!header) {
+      return false;
+    }
+
+    uint32_t width = header->info.width;
+    uint32_t height = header->info.height;
+
+    const uint8_t* end = (const uint8_t*)data + size;
+
+    // scanlines are variable length, so they are found serially before anything is decoded
+    std::vector<const uint8_t*> scanlines(height);
+
+    const uint8_t* p = (const uint8_t*)data + header->data_offset;
+
+    for (uint32_t y = 0; y < height; ++y) {
+      scanlines[y] = p;
+      p = skip_scanline(p, end, width);
+
+      if (!p) {
+        return false;
+      }
+    }
+
+    size_t row_size = format == TexelFormat::RGB32F ? (size_t)width * 3 * sizeof(float) : (size_t)width * 4 * sizeof(HALF);
+    bool avx2 = has_avx2();
+
+    parallel::for_range(height, 8, [&](size_t begin, size_t end) {
+      std::vector<uint8_t> planes((size_t)width * 4);
+
+      for (size_t y = begin; y < end; ++y) {
+        void* row = (uint8_t*)out + y * row_size;
+
+        decode_scanline(scanlines[y], width, planes.data());
+
+        if (avx2) {
+          convert_avx2(planes.data(), width, format, row);
+        }
+        else {
+          convert_scalar(planes.data(), width, 0, format, row);
+        }
+      }
+    });
+
+    return true;
+  }
+
+  std::optional<Image> load_hdr(const void* data, size_t size) {
+    auto info = read_hdr_info(data, size);
+
+    if (!info) {
+      return std::nullopt;
+    }
+
+    Image image = {
+      .width = info->width,
+      .height = info->height,
+      .texels = std::vector<float>((size_t)info->width * info->height * 3),
+    };
+
+    if (!decode_hdr(data, size, TexelFormat::RGB32F, image.texels.data())) {
+      return std::nullopt;
+    }
+
+    return image;
+  }
+};
\ No newline at end of file
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <optional>
+
+#include "hdri.h"
+
+namespace hdri {
+  enum class TexelFormat {
+    RGB32F,
+    RGBA16F,
+  };
+
+  struct HdrInfo {
+    uint32_t width;
+    uint32_t height;
+  };
+
+  // Radiance .hdr in the usual -Y +X orientation with rgbe pixels
+  std::optional<HdrInfo> read_hdr_info(const void* data, size_t size);
+
+  // scanlines are located in one pass then decoded in parallel straight into out,
+  // which must hold width * height texels of format with tightly packed rows
+  bool decode_hdr(const void* data, size_t size, TexelFormat format, void* out);
+
+  std::optional<Image> load_hdr(const void* data, size_t size);
+};
\ No newline at end of file
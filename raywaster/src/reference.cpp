@@ -0,0 +1,433 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+
+#include "reference.h"
+#include "upsample.h"
+#include "parallel.h"
+
+namespace reference {
+  // calls fn(x, y) for every pixel, a TILE_SIZE square at a time from every core. fn returns the rays it traced
+  template<typename F>
+  static uint64_t for_tiles(uint32_t width, uint32_t height, F&& fn) {
+    uint32_t tiles_x = (width + TILE_SIZE - 1) / TILE_SIZE;
+    uint32_t tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    std::atomic<uint64_t> total_rays = 0;
+
+    parallel::for_range((size_t)tiles_x * tiles_y, 1, [&](size_t begin, size_t end) {
+      uint64_t rays = 0;
+
+      for (size_t tile = begin; tile < end; ++tile) {
+        uint32_t x0 = (uint32_t)(tile % tiles_x) * TILE_SIZE;
+        uint32_t y0 = (uint32_t)(tile / tiles_x) * TILE_SIZE;
+
+        for (uint32_t y = y0; y < std::min(y0 + TILE_SIZE, height); ++y) {
+          for (uint32_t x = x0; x < std::min(x0 + TILE_SIZE, width); ++x) {
+            rays += fn(x, y);
+          }
+        }
+      }
+
+      total_rays += rays;
+    });
+
+    return total_rays;
+  }
+
+  // what a R8G8B8A8_UNORM g-buffer normal decodes to, a cleared texel is all -1
+  static XMFLOAT3 gbuffer_normal(FXMVECTOR n) {
+    XMVECTOR stored = XMVectorRound(XMVectorSaturate(n * 0.5f + XMVectorReplicate(0.5f)) * 255.0f) / 255.0f;
+
+    XMFLOAT3 decoded;
+    XMStoreFloat3(&decoded, stored * 2.0f - XMVectorReplicate(1.0f));
+    return decoded;
+  }
+
+  // same as pathtrace.cpp
+  static XMVECTOR environment_radiance(const Environment& env, FXMVECTOR dir) {
+    return hdri::sample_bilinear(env.mips[0], hdri::dir_to_octahedral(dir), hdri::Layout::OCTAHEDRAL) + hdri::disk_lights_radiance(env.lights, dir);
+  }
+
+  static float luminance(FXMVECTOR color) {
+    return XMVectorGetX(XMVector3Dot(color, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f)));
+  }
+
+  Environment build_environment(hdri::Image equirect) {
+    Environment env = {};
+
+    hdri::Image octahedral = hdri::equirect_to_octahedral(equirect, std::max(equirect.width / 2, 1u));
+
+    env.lights = hdri::extract_lights(octahedral, hdri::Layout::OCTAHEDRAL, hdri::LightExtractionSettings{
+      .threshold = 64.0f,
+      .max_solid_angle = 0.02f,
+      .max_lights = 4,
+    });
+
+    env.mips = hdri::build_mips(std::move(octahedral), hdri::MipFilter::KAISER, hdri::Layout::OCTAHEDRAL);
+    env.distribution = hdri::build_octahedral_distribution(env.mips[0].texels.data(), env.mips[0].width);
+
+    // the same sh and light probability as main.cpp's "hdri sh" job
+    uint32_t level = 0;
+
+    while (level + 1 < env.mips.size() && env.mips[level].width > 64) {
+      ++level;
+    }
+
+    sh::L2 radiance = sh::project_environment(env.mips[level], hdri::Layout::OCTAHEDRAL);
+
+    float residual_power = luminance(XMLoadFloat3(&radiance.coefficients[0])) * std::sqrt(4.0f * XM_PI);
+    float light_power = 0.0f;
+
+    for (const hdri::DiskLight& light : env.lights) {
+      XMVECTOR power = XMLoadFloat3(&light.radiance) * hdri::disk_solid_angle(light);
+      sh::add_directional(radiance, XMLoadFloat3(&light.direction), power);
+
+      light_power += luminance(power);
+    }
+
+    env.irradiance = sh::convolve_cosine(radiance);
+
+    if (!env.lights.empty()) {
+      env.light_probability = std::clamp(light_power / std::max(light_power + residual_power, 1e-6f), 0.1f, 0.9f);
+    }
+
+    return env;
+  }
+
+  State make_state(Settings settings) {
+    size_t pixel_count = (size_t)settings.width * settings.height;
+    size_t lighting_count = (size_t)(settings.width >> settings.lighting_lod) * (settings.height >> settings.lighting_lod);
+
+    State state = {
+      .settings = settings,
+      .prev_view_proj = XMMatrixIdentity(),
+      .depth = std::vector<float>(pixel_count),
+      .normals = std::vector<XMFLOAT3>(pixel_count),
+      .lighting_depth = std::vector<float>(lighting_count),
+      .lighting_normals = std::vector<XMFLOAT3>(lighting_count),
+      .temporal_reservoirs = std::vector<restir::Reservoir>(lighting_count),
+      .traversal = std::vector<trace::TraversalStats>(lighting_count),
+      .illumination = std::vector<XMFLOAT3>(lighting_count),
+      .accumulated = std::vector<accumulation::Pixel>(lighting_count),
+      .lighting = std::vector<tonemap::PackedColor>(lighting_count),
+      .radiance = std::vector<XMFLOAT3>(pixel_count),
+      .image = std::vector<uint32_t>(pixel_count),
+    };
+
+    for (uint32_t i = 0; i < 2; ++i) {
+      state.surfaces[i].resize(lighting_count);
+      state.reservoirs[i].resize(lighting_count);
+      state.indirect[i].resize(lighting_count);
+    }
+
+    return state;
+  }
+
+  FrameStats render_frame(const trace::Scene& scene, const Environment& env, FXMMATRIX view, CXMMATRIX proj, State& state) {
+    auto start = std::chrono::steady_clock::now();
+
+    const Settings& settings = state.settings;
+
+    uint32_t width = settings.width;
+    uint32_t height = settings.height;
+    uint32_t lighting_w = width >> settings.lighting_lod;
+    uint32_t lighting_h = height >> settings.lighting_lod;
+
+    XMMATRIX view_proj = view * proj;
+    XMMATRIX inv_view_proj = XMMatrixInverse(nullptr, view_proj);
+    XMVECTOR camera_pos = XMMatrixInverse(nullptr, view).r[3];
+
+    XMFLOAT4X4 view_key_data;
+    XMStoreFloat4x4(&view_key_data, view_proj);
+
+    if (!accumulation::begin_frame(state.accumulation, accumulation::hash(&view_key_data, sizeof(view_key_data)), settings.accumulation)) {
+      return {};
+    }
+
+    uint64_t ray_count = 0;
+
+    // g-buffer, a camera ray through each pixel center where the gpu rasterizes
+
+    ray_count += for_tiles(width, height, [&](uint32_t x, uint32_t y) -> uint64_t {
+      size_t i = (size_t)y * width + x;
+
+      float ndc_x = ((float)x + 0.5f) / (float)width * 2.0f - 1.0f;
+      float ndc_y = ((float)y + 0.5f) / (float)height * -2.0f + 1.0f;
+
+      // reversed z, the near plane is at depth 1
+      XMVECTOR near_hom = XMVector4Transform(XMVectorSet(ndc_x, ndc_y, 1.0f, 1.0f), inv_view_proj);
+      XMVECTOR dir = XMVector3Normalize(near_hom / XMVectorSplatW(near_hom) - camera_pos);
+
+      trace::Hit hit;
+
+      if (trace::intersect(scene, camera_pos, dir, &hit)) {
+        XMVECTOR clip = XMVector4Transform(XMVectorSetW(XMLoadFloat3(&hit.position), 1.0f), view_proj);
+        state.depth[i] = XMVectorGetZ(clip) / XMVectorGetW(clip);
+        state.normals[i] = gbuffer_normal(XMLoadFloat3(&hit.normal));
+      }
+      else {
+        state.depth[i] = 0.0f;
+        state.normals[i] = gbuffer_normal(XMVectorReplicate(-1.0f));
+      }
+
+      return 1;
+    });
+
+    // GenerateMips down to the lighting resolution, and the surfaces reservoir1_cs reconstructs from them
+
+    upsample::Guide full_guide = { width, height, state.depth.data(), state.normals.data() };
+    upsample::Guide lighting_guide = { lighting_w, lighting_h, state.lighting_depth.data(), state.lighting_normals.data() };
+
+    upsample::downsample_guide(full_guide, settings.lighting_lod, state.lighting_depth.data(), state.lighting_normals.data());
+
+    uint32_t current = state.frame % 2;
+    uint32_t previous = 1 - current;
+
+    restir::Surface* surfaces = state.surfaces[current].data();
+
+    for_tiles(lighting_w, lighting_h, [&](uint32_t x, uint32_t y) -> uint64_t {
+      size_t i = (size_t)y * lighting_w + x;
+
+      float depth = state.lighting_depth[i];
+      float u = (float)x / (float)lighting_w;
+      float v = (float)y / (float)lighting_h;
+
+      XMVECTOR hom = XMVector4Transform(XMVectorSet(u * 2.0f - 1.0f, v * -2.0f + 1.0f, depth, 1.0f), inv_view_proj);
+      XMVECTOR world = XMVectorSetW(hom / XMVectorSplatW(hom), 1.0f);
+
+      XMStoreFloat3(&surfaces[i].position, world);
+      surfaces[i].normal = state.lighting_normals[i];
+      surfaces[i].depth = depth > 0.0f ? XMVectorGetW(XMVector4Transform(world, view_proj)) : 0.0f;
+
+      return 0;
+    });
+
+    // reservoirs, temporal then spatial reuse. the gpu keeps them packed in between
+
+    restir::Environment restir_env = {
+      .mips = &env.mips,
+      .distribution = &env.distribution,
+      .lights = &env.lights,
+      .light_probability = env.light_probability,
+    };
+
+    std::atomic<uint64_t> visibility_rays = 0;
+
+    std::fill(state.traversal.begin(), state.traversal.end(), trace::empty_traversal_stats());
+
+    // each pass only calls this for its own pixel from one thread, so the pixel's stats aren't shared
+    restir::VisibilityFn visible = [&](size_t pixel, FXMVECTOR origin, FXMVECTOR dir) {
+      trace::TraversalStats stats;
+      bool blocked = trace::occluded(scene, origin, dir, &stats);
+
+      state.traversal[pixel] = trace::merge_traversal_stats(state.traversal[pixel], stats);
+      visibility_rays.fetch_add(1, std::memory_order_relaxed);
+
+      return !blocked;
+    };
+
+    auto round_trip = [](std::vector<restir::Reservoir>& reservoirs) {
+      for (restir::Reservoir& r : reservoirs) {
+        r = restir::unpack(restir::pack(r));
+      }
+    };
+
+    restir::resample_frame(restir_env, lighting_w, lighting_h, state.frame, surfaces,
+                           state.history_valid ? state.surfaces[previous].data() : nullptr,
+                           state.history_valid ? state.reservoirs[previous].data() : nullptr,
+                           state.prev_view_proj, restir::DEFAULT_TEMPORAL_SETTINGS, settings.sampling, visible,
+                           state.temporal_reservoirs.data());
+
+    round_trip(state.temporal_reservoirs);
+
+    restir::resample_spatial(lighting_w, lighting_h, state.frame, surfaces, state.temporal_reservoirs.data(), settings.spatial,
+                             visible, state.reservoirs[current].data());
+
+    round_trip(state.reservoirs[current]);
+
+    ray_count += visibility_rays;
+
+    // indirect
+
+    ray_count += pathtrace::render_indirect(scene, restir_env, lighting_w, lighting_h, state.frame, surfaces,
+                                            state.history_valid ? state.surfaces[previous].data() : nullptr,
+                                            state.history_valid ? state.indirect[previous].data() : nullptr,
+                                            state.prev_view_proj, settings.path, settings.sampling, state.indirect[current].data(),
+                                            state.traversal.data());
+
+    // lighting, same as lighting_cs with its shadow ray
+
+    ray_count += for_tiles(lighting_w, lighting_h, [&](uint32_t x, uint32_t y) -> uint64_t {
+      size_t i = (size_t)y * lighting_w + x;
+
+      const restir::Surface& surface = surfaces[i];
+      const restir::Reservoir& r = state.reservoirs[current][i];
+
+      XMVECTOR normal = XMLoadFloat3(&surface.normal);
+      XMVECTOR color = XMVectorZero();
+      uint64_t rays = 0;
+
+      if (surface.depth > 0.0f) {
+        XMVECTOR dir = XMLoadFloat3(&r.y);
+
+        if (!r.found) {
+          // no candidate made it into the reservoir, fall back to unshadowed diffuse from the environment's sh
+          color = sh::evaluate(env.irradiance, normal) / XM_PI;
+        }
+        else if (r.contribution > 0.0f) {
+          trace::TraversalStats stats;
+          bool blocked = trace::occluded(scene, XMLoadFloat3(&surface.position) + normal * 1e-6f, dir, &stats);
+
+          state.traversal[i] = trace::merge_traversal_stats(state.traversal[i], stats);
+          rays++;
+
+          if (!blocked) {
+            float l = restir::sample_luminance(restir_env, dir);
+            float angle_weighting = XMVectorGetX(XMVector3Dot(dir, normal)) / XM_PI;
+
+            color = l > 0.0f ? environment_radiance(env, dir) * (angle_weighting * r.contribution / l) : XMVectorZero();
+          }
+        }
+
+        color += XMLoadFloat3(&state.indirect[current][i]);
+      }
+
+      XMStoreFloat3(&state.illumination[i], color);
+
+      return rays;
+    });
+
+    // lighting_cs records the pixels with a surface
+
+    trace::TraversalAggregate aggregate = {};
+
+    for (size_t i = 0; i < state.traversal.size(); ++i) {
+      if (surfaces[i].depth > 0.0f) {
+        trace::record(aggregate, state.traversal[i]);
+      }
+    }
+
+    // denoised before the albedo, so the filter doesn't have to preserve texture detail
+
+    if (settings.denoise) {
+      denoise::denoise_frame(lighting_w, lighting_h, surfaces, state.illumination.data(), state.prev_view_proj, settings.denoising,
+                             state.denoise_history, state.illumination.data());
+    }
+
+    state.history_valid = true;
+    state.prev_view_proj = view_proj;
+
+    // albedo and welford's update
+
+    uint32_t sample_count = state.accumulation.sample_count;
+    float correlation_length = accumulation::correlation_length(restir::DEFAULT_TEMPORAL_SETTINGS.max_history_length,
+                                                                pathtrace::pixel_stride(settings.path, lighting_w * lighting_h));
+    std::atomic<uint32_t> unconverged_pixels = 0;
+
+    for_tiles(lighting_w, lighting_h, [&](uint32_t x, uint32_t y) -> uint64_t {
+      size_t i = (size_t)y * lighting_w + x;
+
+      XMVECTOR color = XMVectorZero();
+
+      if (surfaces[i].depth > 0.0f) {
+        // gbuffer_ps writes an albedo of one over a cleared target, so its mip is the coverage
+        uint32_t size = 1u << settings.lighting_lod;
+        uint32_t covered = 0;
+
+        for (uint32_t dy = 0; dy < size; ++dy) {
+          for (uint32_t dx = 0; dx < size; ++dx) {
+            if (state.depth[((size_t)y * size + dy) * width + (size_t)x * size + dx] > 0.0f) {
+              covered++;
+            }
+          }
+        }
+
+        color = XMLoadFloat3(&state.illumination[i]) * ((float)covered / (float)(size * size));
+      }
+
+      XMFLOAT3 sample;
+      XMStoreFloat3(&sample, color);
+
+      accumulation::Pixel& pixel = state.accumulated[i];
+      accumulation::accumulate(pixel, sample, sample_count);
+
+      if (!accumulation::converged(pixel, sample_count + 1, settings.accumulation.target_error, correlation_length)) {
+        unconverged_pixels.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      state.lighting[i] = tonemap::pack(XMLoadFloat3(&pixel.mean));
+
+      return 0;
+    });
+
+    accumulation::end_frame(state.accumulation);
+    accumulation::report_error(state.accumulation, state.accumulation.key, state.accumulation.sample_count, unconverged_pixels, settings.accumulation);
+
+    // combine, the upsampled lighting where there's a surface and the environment behind it
+
+    upsample::upsample_lighting(state.lighting.data(), lighting_guide, full_guide, settings.lighting_lod, state.radiance.data());
+
+    for_tiles(width, height, [&](uint32_t x, uint32_t y) -> uint64_t {
+      size_t i = (size_t)y * width + x;
+
+      if (state.depth[i] <= 0.0f) {
+        float ndc_x = ((float)x + 0.5f) / (float)width * 2.0f - 1.0f;
+        float ndc_y = ((float)y + 0.5f) / (float)height * -2.0f + 1.0f;
+
+        XMVECTOR hom = XMVector4Transform(XMVectorSet(ndc_x, ndc_y, 0.0f, 1.0f), inv_view_proj);
+        XMVECTOR dir = XMVector3Normalize(hom / XMVectorSplatW(hom) - camera_pos);
+
+        XMStoreFloat3(&state.radiance[i], environment_radiance(env, dir));
+      }
+
+      state.image[i] = tonemap::to_rgba8(tonemap::tonemap(XMLoadFloat3(&state.radiance[i])));
+
+      return 0;
+    });
+
+    state.frame++;
+
+    return {
+      .rendered = true,
+      .ray_count = ray_count,
+      .traversal = trace::summarize(aggregate),
+      .milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(),
+    };
+  }
+
+  bool write_ppm(const char* path, uint32_t width, uint32_t height, const uint32_t* rgba8) {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output << "P6\n" << width << " " << height << "\n255\n";
+
+    std::vector<uint8_t> row(width * 3);
+
+    for (uint32_t y = 0; y < height; ++y) {
+      for (uint32_t x = 0; x < width; ++x) {
+        uint32_t texel = rgba8[(size_t)y * width + x];
+        row[x * 3 + 0] = (uint8_t)(texel & 0xff);
+        row[x * 3 + 1] = (uint8_t)((texel >> 8) & 0xff);
+        row[x * 3 + 2] = (uint8_t)((texel >> 16) & 0xff);
+      }
+
+      output.write((const char*)row.data(), row.size());
+    }
+
+    return output.good();
+  }
+
+  bool write_pfm(const char* path, uint32_t width, uint32_t height, const XMFLOAT3* rgb) {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+
+    // a negative scale means little endian, and rows go bottom to top
+    output << "PF\n" << width << " " << height << "\n-1.0\n";
+
+    for (uint32_t y = height; y-- > 0;) {
+      output.write((const char*)(rgb + (size_t)y * width), width * sizeof(XMFLOAT3));
+    }
+
+    return output.good();
+  }
+};
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "hdri.h"
+#include "hdri_lights.h"
+#include "sh.h"
+#include "trace.h"
+#include "restir.h"
+#include "pathtrace.h"
+#include "accumulation.h"
+#include "denoise.h"
+#include "tonemap.h"
+
+using namespace DirectX;
+
+// the whole frame main.cpp renders on the gpu, g-buffer, reservoirs, indirect, lighting and combine, on the cpu.
+// needs no device or window, so it runs headless anywhere the rest of the cpu references build
+namespace reference {
+  // pixels per side of the tiles the per pixel passes are split into
+  static constexpr uint32_t TILE_SIZE = 16;
+
+  // the environment after main.cpp's hdri startup jobs, kept as float rgb instead of the cache's encoding
+  struct Environment {
+    std::vector<hdri::Image> mips; // octahedral, residual after light extraction
+    hdri::Distribution2D distribution;
+    std::vector<hdri::DiskLight> lights;
+    sh::L2 irradiance;
+    float light_probability;
+  };
+
+  // decoded equirect in, same steps and settings as main.cpp
+  Environment build_environment(hdri::Image equirect);
+
+  struct Settings {
+    uint32_t width, height;
+    uint32_t lighting_lod;
+    restir::SpatialSettings spatial;
+    pathtrace::Settings path;
+    sampler::Settings sampling;
+    accumulation::Settings accumulation;
+    bool denoise; // main.cpp has no denoiser yet, so it's off to match it
+    denoise::Settings denoising;
+  };
+
+  // what main.cpp starts with
+  static constexpr Settings DEFAULT_SETTINGS = {
+    .width = 1280,
+    .height = 720,
+    .lighting_lod = 1,
+    .spatial = {
+      .count = 4,
+      .radius = 16.0f,
+      .weighting = restir::SpatialWeighting::BIASED,
+      .depth_tolerance = 0.1f,
+      .normal_tolerance = 0.9f,
+    },
+    .path = pathtrace::DEFAULT_SETTINGS,
+    .sampling = { .type = sampler::Type::SOBOL, .blue_noise = nullptr },
+    .accumulation = accumulation::DEFAULT_SETTINGS,
+    .denoise = false,
+    .denoising = denoise::DEFAULT_SETTINGS,
+  };
+
+  // everything a frame leaves for the next, the cpu side of main.cpp's FrameDependents
+  struct State {
+    Settings settings;
+    uint32_t frame;
+    bool history_valid;
+    XMMATRIX prev_view_proj;
+
+    accumulation::State accumulation;
+
+    // full resolution g-buffer, device depth and normals as decoded from R8G8B8A8_UNORM
+    std::vector<float> depth;
+    std::vector<XMFLOAT3> normals;
+
+    // the same at the lighting resolution, and the surfaces the reservoir passes work on
+    std::vector<float> lighting_depth;
+    std::vector<XMFLOAT3> lighting_normals;
+    std::vector<restir::Surface> surfaces[2];
+
+    std::vector<restir::Reservoir> temporal_reservoirs;
+    std::vector<restir::Reservoir> reservoirs[2];
+    std::vector<XMFLOAT3> indirect[2];
+
+    // every ray each lighting pixel traced this frame, what traversal_stats holds with a debug view on
+    std::vector<trace::TraversalStats> traversal;
+
+    // direct and indirect lighting before the albedo, what the denoiser filters
+    std::vector<XMFLOAT3> illumination;
+    denoise::History denoise_history;
+
+    std::vector<accumulation::Pixel> accumulated;
+    std::vector<tonemap::PackedColor> lighting;
+
+    // combine's output, linear before the tonemap and the R8G8B8A8_UNORM it writes
+    std::vector<XMFLOAT3> radiance;
+    std::vector<uint32_t> image;
+  };
+
+  State make_state(Settings settings);
+
+  struct FrameStats {
+    bool rendered;       // false once accumulation converged, the image is left as it was
+    uint64_t ray_count;  // primary, visibility, path and shadow rays
+    trace::TraversalSummary traversal; // per lighting pixel with a surface, all but the primary rays
+    double milliseconds;
+  };
+
+  // renders one frame from view and proj, accumulating onto the previous ones while neither changes
+  FrameStats render_frame(const trace::Scene& scene, const Environment& env, FXMMATRIX view, CXMMATRIX proj, State& state);
+
+  // binary ppm of an R8G8B8A8_UNORM image, alpha is dropped
+  bool write_ppm(const char* path, uint32_t width, uint32_t height, const uint32_t* rgba8);
+
+  // little endian pfm, linear float rgb for comparing against other renderers
+  bool write_pfm(const char* path, uint32_t width, uint32_t height, const XMFLOAT3* rgb);
+};
\ No newline at end of file
@@ -0,0 +1,181 @@
+// headless entry point for the cpu reference renderer, for machines without a d3d11 device. not part of the
+// windows build, see CMakeLists.txt
+//
+// reference [--scene path] [--hdri path] [--size WxH] [--lod n] [--frames n] [--denoise on|off] [--output prefix]
+// renders from main.cpp's starting camera until accumulation converges or frames runs out, then writes
+// prefix.ppm and prefix.pfm. --denoise filters each frame's lighting before it's accumulated, off by default like main.cpp
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "model.h"
+#include "quantize.h"
+#include "bvh.h"
+#include "radiance.h"
+#include "reference.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+static std::vector<char> load_bin(const char* path) {
+  std::ifstream input(path, std::ios::binary);
+  return std::vector(std::istreambuf_iterator<char>(input), {});
+}
+
+// our decoder handles the common rle rgbe case, anything else falls back to stb
+static std::optional<hdri::Image> load_environment(const char* path) {
+  std::vector<char> file = load_bin(path);
+
+  if (std::optional<hdri::Image> image = hdri::load_hdr(file.data(), file.size())) {
+    return image;
+  }
+
+  int w, h;
+  float* data = stbi_loadf_from_memory((const stbi_uc*)file.data(), (int)file.size(), &w, &h, nullptr, 3);
+
+  if (!data) {
+    return std::nullopt;
+  }
+
+  hdri::Image image = {
+    .width = (uint32_t)w,
+    .height = (uint32_t)h,
+    .texels = std::vector<float>(data, data + (size_t)w * h * 3),
+  };
+
+  stbi_image_free(data);
+  return image;
+}
+
+int main(int argc, char** argv) {
+  const char* scene_path = "models/test/scene.gltf";
+  const char* hdri_path = "sky/symmetrical_garden_02_4k.hdr";
+  const char* output_prefix = "reference";
+  uint32_t max_frames = 64;
+
+  reference::Settings settings = reference::DEFAULT_SETTINGS;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    const char* value = argv[i + 1];
+
+    if (!strcmp(argv[i], "--scene")) {
+      scene_path = value;
+    }
+    else if (!strcmp(argv[i], "--hdri")) {
+      hdri_path = value;
+    }
+    else if (!strcmp(argv[i], "--size")) {
+      sscanf(value, "%ux%u", &settings.width, &settings.height);
+    }
+    else if (!strcmp(argv[i], "--lod")) {
+      settings.lighting_lod = (uint32_t)atoi(value);
+    }
+    else if (!strcmp(argv[i], "--frames")) {
+      max_frames = (uint32_t)atoi(value);
+    }
+    else if (!strcmp(argv[i], "--denoise")) {
+      settings.denoise = !strcmp(value, "on");
+    }
+    else if (!strcmp(argv[i], "--output")) {
+      output_prefix = value;
+    }
+    else {
+      std::cerr << std::format("unknown option {}\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::optional<Model> model = load_gltf(scene_path);
+
+  if (!model) {
+    std::cerr << std::format("failed to load {}\n", scene_path);
+    return 1;
+  }
+
+  std::optional<hdri::Image> equirect = load_environment(hdri_path);
+
+  if (!equirect) {
+    std::cerr << std::format("failed to load {}\n", hdri_path);
+    return 1;
+  }
+
+  // what main.cpp's shaders decode from the packed layout
+  Mesh mesh = dequantize_mesh(quantize_mesh(combine_model(*model)));
+  model.reset();
+
+  std::vector<bvh::Node> nodes = bvh::construct_bvh(mesh);
+  trace::Scene scene = { &mesh, &nodes };
+
+  reference::Environment env = reference::build_environment(std::move(*equirect));
+  equirect.reset();
+
+  // main.cpp's starting camera
+  XMVECTOR camera_focus = {0.0f, 0.0f, 0.0f};
+  float camera_theta = XM_PI * 0.5f;
+  float camera_phi = XM_PI * 0.25f;
+  float camera_distance = 6.0f;
+
+  XMVECTOR camera_offset = {
+    camera_distance * std::sin(camera_phi) * std::cos(camera_theta),
+    camera_distance * std::cos(camera_phi),
+    camera_distance * std::sin(camera_phi) * std::sin(camera_theta),
+  };
+
+  XMMATRIX view = XMMatrixLookAtRH(camera_offset + camera_focus, camera_focus, {0.0f, 1.0f, 0.0f});
+  XMMATRIX proj = XMMatrixPerspectiveFovRH(XM_PI*0.25f, (float)settings.width/(float)settings.height, 1000.0f, 0.01f);
+
+  reference::State state = reference::make_state(settings);
+
+  uint64_t total_rays = 0;
+  double total_milliseconds = 0.0;
+  uint32_t frame_count = 0;
+  trace::TraversalSummary traversal = {};
+
+  for (; frame_count < max_frames; ++frame_count) {
+    reference::FrameStats stats = reference::render_frame(scene, env, view, proj, state);
+
+    if (!stats.rendered) {
+      break;
+    }
+
+    total_rays += stats.ray_count;
+    total_milliseconds += stats.milliseconds;
+    traversal = stats.traversal;
+
+    std::cout << std::format("frame {}: {:.1f} ms, {:.2f} Mrays/s\n", frame_count, stats.milliseconds, (double)stats.ray_count / (stats.milliseconds * 1e3));
+  }
+
+  if (frame_count > 0) {
+    std::cout << std::format("{} frames at {}x{}: {:.1f} ms/frame, {:.2f} Mrays/s\n", frame_count, settings.width, settings.height,
+                             total_milliseconds / frame_count, (double)total_rays / (total_milliseconds * 1e3));
+
+    // the same per pixel summary as main.cpp's traversal debug views, from the last frame
+    static const char* counter_names[TRAVERSAL_COUNTERS] = { "rays", "node visits", "triangle tests", "stack depth" };
+
+    std::cout << std::format("traversal per pixel over {} pixels\n", traversal.pixel_count);
+
+    for (uint32_t i = 0; i < TRAVERSAL_COUNTERS; ++i) {
+      std::cout << std::format("  {}: mean {:.1f}, p99 {}\n", counter_names[i], traversal.mean[i], traversal.p99[i]);
+    }
+  }
+
+  std::string ppm_path = std::format("{}.ppm", output_prefix);
+  std::string pfm_path = std::format("{}.pfm", output_prefix);
+
+  if (!reference::write_ppm(ppm_path.c_str(), settings.width, settings.height, state.image.data()) ||
+      !reference::write_pfm(pfm_path.c_str(), settings.width, settings.height, state.radiance.data()))
+  {
+    std::cerr << "failed to write the images\n";
+    return 1;
+  }
+
+  return 0;
+}
\ No newline at end of file
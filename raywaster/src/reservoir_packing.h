@@ -0,0 +1,46 @@
+// the stored reservoir layout, included by both restir.h and restir.hlsli so the two can't drift apart
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+#include "hlsl_compat.h"
+
+SHARED_NAMESPACE_BEGIN(restir)
+
+// largest half below infinity, and m keeps its top bit for the found flag
+#define RESERVOIR_MAX_CONTRIBUTION 65504.0f
+#define RESERVOIR_MAX_M 32767.0f
+
+// dir is an octahedral uv at 16 bits per axis. contribution_m holds luminance times the contribution weight
+// as a half, then whether any candidate behind it had a positive target, then m as a 15 bit integer
+struct PackedReservoir {
+  uint dir;
+  uint contribution_m;
+};
+
+SHARED_FN uint pack_unorm2x16(float x, float y) {
+  return (uint(round(saturate(x) * 65535.0f)) << 16) | uint(round(saturate(y) * 65535.0f));
+}
+
+SHARED_FN float unpack_unorm16(uint packed, uint shift) {
+  return float((packed >> shift) & 0xffff) / 65535.0f;
+}
+
+SHARED_FN uint pack_contribution_m(float contribution, bool found, float m) {
+  return (f32tof16(min(contribution, RESERVOIR_MAX_CONTRIBUTION)) << 16) | (found ? 0x8000u : 0u) | uint(min(m, RESERVOIR_MAX_M));
+}
+
+SHARED_FN float unpack_contribution(uint packed) {
+  return f16tof32(packed >> 16);
+}
+
+SHARED_FN bool unpack_found(uint packed) {
+  return (packed & 0x8000u) != 0;
+}
+
+SHARED_FN float unpack_m(uint packed) {
+  return float(packed & 0x7fffu);
+}
+
+SHARED_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <algorithm>
+#include <cmath>
+
+#include "restir.h"
+#include "parallel.h"
+
+namespace restir {
+  using sampler::hash32;
+  using sampler::uniform_random;
+
+  static float luminance(FXMVECTOR c) {
+    return XMVectorGetX(XMVector3Dot(c, XMVectorSet(0.2126f, 0.7152f, 0.0722f, 0.0f)));
+  }
+
+  float sample_luminance(const Environment& env, FXMVECTOR dir) {
+    XMVECTOR radiance = hdri::sample_trilinear(*env.mips, hdri::dir_to_octahedral(dir), CANDIDATE_LOD, hdri::Layout::OCTAHEDRAL);
+    radiance += hdri::disk_lights_radiance(*env.lights, dir);
+
+    return luminance(radiance);
+  }
+
+  static float cosine(FXMVECTOR normal, FXMVECTOR dir) {
+    return std::max(XMVectorGetX(XMVector3Dot(normal, dir)), 0.0f);
+  }
+
+  void update(Reservoir& r, FXMVECTOR x, float cosine, float w, float u) {
+    r.wsum += w;
+    r.m += 1.0f;
+
+    if (w > 0.0f) {
+      r.found = true;
+
+      if (u * r.wsum < w) {
+        XMStoreFloat3(&r.y, x);
+        r.cosine = cosine;
+      }
+    }
+  }
+
+  void merge(Reservoir& r, const Reservoir& other, FXMVECTOR normal, float u) {
+    float c = cosine(normal, XMLoadFloat3(&other.y));
+    float w = c * other.contribution * other.m;
+
+    r.wsum += w;
+    r.m += other.m;
+    r.found = r.found || other.found;
+
+    if (w > 0.0f && u * r.wsum < w) {
+      r.y = other.y;
+      r.cosine = c;
+    }
+  }
+
+  void finalize(Reservoir& r) {
+    r.contribution = r.cosine > 0.0f ? r.wsum / (r.m * r.cosine) : 0.0f;
+  }
+
+  PackedReservoir pack(const Reservoir& r) {
+    XMFLOAT2 uv = hdri::dir_to_octahedral(XMLoadFloat3(&r.y));
+
+    return PackedReservoir{
+      .dir = pack_unorm2x16(uv.x, uv.y),
+      .contribution_m = pack_contribution_m(r.contribution, r.found, r.m),
+    };
+  }
+
+  Reservoir unpack(PackedReservoir p) {
+    Reservoir r = {
+      .m = unpack_m(p.contribution_m),
+      .contribution = unpack_contribution(p.contribution_m),
+      .found = unpack_found(p.contribution_m),
+    };
+
+    XMStoreFloat3(&r.y, hdri::octahedral_to_dir(XMFLOAT2(unpack_unorm16(p.dir, 16), unpack_unorm16(p.dir, 0))));
+
+    return r;
+  }
+
+  XMVECTOR sample_mixture(const Environment& env, XMFLOAT4 u, float strategy, float* pdf) {
+    XMVECTOR dir;
+    float env_pdf;
+    float light_pdf;
+
+    if (strategy < env.light_probability) {
+      dir = hdri::sample_disk_lights(*env.lights, XMFLOAT3(u.x, u.y, u.z), &light_pdf);
+      env_pdf = hdri::octahedral_pdf(*env.distribution, dir);
+    }
+    else {
+      dir = hdri::sample_octahedral(*env.distribution, u, &env_pdf);
+      light_pdf = hdri::disk_lights_pdf(*env.lights, dir);
+    }
+
+    *pdf = env_pdf + (light_pdf - env_pdf) * env.light_probability;
+    return dir;
+  }
+
+  Reservoir generate_candidates(const Environment& env, FXMVECTOR normal, sampler::Sampler& s, uint32_t frame) {
+    Reservoir r = {};
+
+    for (uint32_t i = 0; i < CANDIDATE_COUNT; ++i) {
+      sampler::start_sample(s, frame * CANDIDATE_COUNT + i);
+
+      XMFLOAT2 u0 = sampler::next_2d(s);
+      XMFLOAT2 u1 = sampler::next_2d(s);
+      XMFLOAT4 u(u0.x, u0.y, u1.x, u1.y);
+
+      float pdf;
+      XMVECTOR x = sample_mixture(env, u, sampler::next_1d(s), &pdf);
+
+      float c = cosine(normal, x);
+      float target = sample_luminance(env, x) * c;
+
+      update(r, x, c, pdf > 0.0f ? target / pdf : 0.0f, sampler::next_1d(s));
+    }
+
+    return r;
+  }
+
+  bool reproject(const Surface& surface, const Surface* previous_surfaces, uint32_t width, uint32_t height, FXMMATRIX prev_view_proj,
+                 TemporalSettings settings, size_t* previous_pixel)
+  {
+    if (surface.depth <= 0.0f) {
+      return false;
+    }
+
+    XMVECTOR prev_clip = XMVector4Transform(XMVectorSetW(XMLoadFloat3(&surface.position), 1.0f), prev_view_proj);
+
+    float prev_w = XMVectorGetW(prev_clip);
+    float prev_u = (XMVectorGetX(prev_clip) / prev_w * 0.5f + 0.5f) * (float)width;
+    float prev_v = (XMVectorGetY(prev_clip) / prev_w * -0.5f + 0.5f) * (float)height;
+
+    int32_t px = (int32_t)std::round(prev_u);
+    int32_t py = (int32_t)std::round(prev_v);
+
+    if (prev_w <= 0.0f || px < 0 || py < 0 || px >= (int32_t)width || py >= (int32_t)height) {
+      return false;
+    }
+
+    size_t j = (size_t)py * width + px;
+    const Surface& prev_surface = previous_surfaces[j];
+
+    *previous_pixel = j;
+
+    return prev_surface.depth > 0.0f &&
+           std::abs(prev_surface.depth - prev_w) < settings.depth_tolerance * prev_w &&
+           XMVectorGetX(XMVector3Dot(XMLoadFloat3(&prev_surface.normal), XMLoadFloat3(&surface.normal))) > settings.normal_tolerance;
+  }
+
+  void resample_frame(const Environment& env, uint32_t width, uint32_t height, uint32_t frame, const Surface* surfaces,
+                      const Surface* previous_surfaces, const Reservoir* previous, FXMMATRIX prev_view_proj,
+                      TemporalSettings settings, sampler::Settings sampling, const VisibilityFn& visible, Reservoir* reservoirs)
+  {
+    float history_cap = (float)(settings.max_history_length * CANDIDATE_COUNT);
+
+    parallel::for_range(height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = y * width + x;
+
+          uint32_t seed = hash32((uint32_t)i);
+          uint32_t state = seed ^ hash32(frame);
+
+          const Surface& surface = surfaces[i];
+          XMVECTOR normal = XMLoadFloat3(&surface.normal);
+
+          sampler::Sampler s = sampler::make_sampler(sampling, XMUINT2(x, (uint32_t)y), seed);
+          Reservoir r = generate_candidates(env, normal, s, frame);
+
+          size_t j;
+
+          if (previous && reproject(surface, previous_surfaces, width, height, prev_view_proj, settings, &j)) {
+            Reservoir prev = previous[j];
+            prev.m = std::min(prev.m, history_cap);
+
+            merge(r, prev, normal, uniform_random(&state));
+          }
+
+          finalize(r);
+
+          if (surface.depth > 0.0f && r.contribution > 0.0f && !visible(i, XMLoadFloat3(&surface.position) + normal * 1e-6f, XMLoadFloat3(&r.y))) {
+            r.contribution = 0.0f;
+          }
+
+          reservoirs[i] = r;
+        }
+      }
+    });
+  }
+
+  static bool same_surface(const Surface& a, const Surface& b, float depth_tolerance, float normal_tolerance) {
+    return a.depth > 0.0f &&
+           std::abs(a.depth - b.depth) < depth_tolerance * b.depth &&
+           XMVectorGetX(XMVector3Dot(XMLoadFloat3(&a.normal), XMLoadFloat3(&b.normal))) > normal_tolerance;
+  }
+
+  void resample_spatial(uint32_t width, uint32_t height, uint32_t frame, const Surface* surfaces, const Reservoir* input,
+                        SpatialSettings settings, const VisibilityFn& visible, Reservoir* reservoirs)
+  {
+    uint32_t count = std::min(settings.count, MAX_SPATIAL_COUNT);
+
+    parallel::for_range(height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          size_t i = y * width + x;
+
+          uint32_t state = hash32((uint32_t)i) ^ hash32(~frame);
+
+          const Surface& surface = surfaces[i];
+          XMVECTOR normal = XMLoadFloat3(&surface.normal);
+
+          const Reservoir& center = input[i];
+
+          Reservoir r = {};
+          merge(r, center, normal, uniform_random(&state));
+
+          size_t accepted[MAX_SPATIAL_COUNT];
+          uint32_t accepted_count = 0;
+
+          for (uint32_t k = 0; k < count && surface.depth > 0.0f; ++k) {
+            float radius = settings.radius * std::sqrt(uniform_random(&state));
+            float phi = XM_2PI * uniform_random(&state);
+
+            int32_t nx = (int32_t)x + (int32_t)std::round(radius * std::cos(phi));
+            int32_t ny = (int32_t)y + (int32_t)std::round(radius * std::sin(phi));
+
+            if (nx < 0 || ny < 0 || nx >= (int32_t)width || ny >= (int32_t)height || (nx == (int32_t)x && ny == (int32_t)y)) {
+              continue;
+            }
+
+            size_t j = (size_t)ny * width + nx;
+
+            if (!same_surface(surfaces[j], surface, settings.depth_tolerance, settings.normal_tolerance)) {
+              continue;
+            }
+
+            merge(r, input[j], normal, uniform_random(&state));
+            accepted[accepted_count++] = j;
+          }
+
+          if (settings.weighting == SpatialWeighting::UNBIASED && r.cosine > 0.0f) {
+            XMVECTOR dir = XMLoadFloat3(&r.y);
+            float z = center.m;
+
+            for (uint32_t k = 0; k < accepted_count; ++k) {
+              const Surface& neighbour = surfaces[accepted[k]];
+              XMVECTOR neighbour_normal = XMLoadFloat3(&neighbour.normal);
+
+              if (XMVectorGetX(XMVector3Dot(neighbour_normal, dir)) > 0.0f && visible(i, XMLoadFloat3(&neighbour.position) + neighbour_normal * 1e-6f, dir)) {
+                z += input[accepted[k]].m;
+              }
+            }
+
+            r.contribution = r.wsum / (z * r.cosine);
+          }
+          else {
+            finalize(r);
+          }
+
+          reservoirs[i] = r;
+        }
+      }
+    });
+  }
+};
\ No newline at end of file
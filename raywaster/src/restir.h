@@ -0,0 +1,112 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <functional>
+#include <vector>
+
+#include "hdri.h"
+#include "hdri_lights.h"
+#include "reservoir_packing.h"
+#include "sampler.h"
+
+using namespace DirectX;
+
+// cpu reference for the reservoir passes, same math and random streams as reservoir1_cs and reservoir2_cs
+namespace restir {
+  // must match reservoir1_cs.hlsl and reservoir2_cs.hlsl
+  static constexpr uint32_t CANDIDATE_COUNT = 4;
+  static constexpr float CANDIDATE_LOD = 2.0f;
+  static constexpr uint32_t MAX_SPATIAL_COUNT = 8;
+
+  // what candidates are drawn from, mips are octahedral
+  struct Environment {
+    const std::vector<hdri::Image>* mips;
+    const hdri::Distribution2D* distribution;
+    const std::vector<hdri::DiskLight>* lights;
+    float light_probability;
+  };
+
+  // depth is linear view depth, zero where nothing was hit
+  struct Surface {
+    XMFLOAT3 position;
+    XMFLOAT3 normal;
+    float depth;
+  };
+
+  // must match Reservoir in restir.hlsli. contribution is the luminance along y times the contribution weight,
+  // cosine is that of y at the owning pixel, so the target there is luminance times cosine
+  struct Reservoir {
+    XMFLOAT3 y;
+    float cosine;
+    float wsum;
+    float m;
+    float contribution;
+    bool found;
+  };
+
+  struct TemporalSettings {
+    uint32_t max_history_length; // in frames worth of candidates
+    float depth_tolerance;       // relative to the reprojected depth
+    float normal_tolerance;      // minimum cosine between the normals
+  };
+
+  // the same defaults reservoir1_cs is compiled with
+  static constexpr TemporalSettings DEFAULT_TEMPORAL_SETTINGS = {
+    .max_history_length = 20,
+    .depth_tolerance = 0.1f,
+    .normal_tolerance = 0.9f,
+  };
+
+  // biased divides by every m merged, unbiased only by those of the reservoirs that could have produced
+  // the chosen sample, which takes a visibility ray per neighbour. since occluded samples are dropped
+  // before reuse, biased darkens next to shadow edges
+  enum class SpatialWeighting {
+    BIASED,
+    UNBIASED,
+  };
+
+  struct SpatialSettings {
+    uint32_t count;   // neighbours tried, at most MAX_SPATIAL_COUNT
+    float radius;     // in pixels
+    SpatialWeighting weighting;
+    float depth_tolerance;
+    float normal_tolerance;
+  };
+
+  // true if nothing blocks the ray. pixel is the one it's traced for, which spatial reuse's rays don't start at
+  using VisibilityFn = std::function<bool(size_t pixel, FXMVECTOR origin, FXMVECTOR dir)>;
+
+  float sample_luminance(const Environment& env, FXMVECTOR dir);
+
+  // strategy below light_probability samples the lights, otherwise the residual environment.
+  // the pdf is that of the mixture, per unit solid angle
+  XMVECTOR sample_mixture(const Environment& env, XMFLOAT4 u, float strategy, float* pdf);
+
+  void update(Reservoir& r, FXMVECTOR x, float cosine, float w, float u);
+  void merge(Reservoir& r, const Reservoir& other, FXMVECTOR normal, float u);
+  void finalize(Reservoir& r);
+
+  // the 8 byte layout the gpu passes store, wsum and cosine are only needed while resampling
+  PackedReservoir pack(const Reservoir& r);
+  Reservoir unpack(PackedReservoir p);
+
+  // candidate i of a frame is sample frame * CANDIDATE_COUNT + i of the pixel's sampler
+  Reservoir generate_candidates(const Environment& env, FXMVECTOR normal, sampler::Sampler& s, uint32_t frame);
+
+  // the pixel surface was at last frame, if it was on screen and previous_surfaces saw the same surface there
+  bool reproject(const Surface& surface, const Surface* previous_surfaces, uint32_t width, uint32_t height, FXMMATRIX prev_view_proj,
+                 TemporalSettings settings, size_t* previous_pixel);
+
+  // one frame of the reservoir pass. fresh candidates are merged with the reservoir the surface had last
+  // frame, if it was on screen and passes the depth and normal tests. previous is null when there's no history.
+  // samples that aren't visible keep their m but lose their weight
+  void resample_frame(const Environment& env, uint32_t width, uint32_t height, uint32_t frame, const Surface* surfaces,
+                      const Surface* previous_surfaces, const Reservoir* previous, FXMMATRIX prev_view_proj,
+                      TemporalSettings settings, sampler::Settings sampling, const VisibilityFn& visible, Reservoir* reservoirs);
+
+  // merges up to settings.count neighbours within the radius into each pixel's reservoir, skipping those whose
+  // surface differs too much. no new candidates are drawn, so it doesn't touch the environment
+  void resample_spatial(uint32_t width, uint32_t height, uint32_t frame, const Surface* surfaces, const Reservoir* input,
+                        SpatialSettings settings, const VisibilityFn& visible, Reservoir* reservoirs);
+};
\ No newline at end of file
@@ -0,0 +1,183 @@
+#include <assert.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "sampler.h"
+
+namespace sampler {
+  static uint32_t splitmix32(uint32_t* state) {
+    uint32_t z = (*state += 0x9e3779b9);
+    z ^= z >> 16; z *= 0x21f0aaad;
+    z ^= z >> 15; z *= 0x735a2d97;
+    z ^= z >> 15;
+    return z;
+  }
+
+  float uniform_random(uint32_t* state) {
+    return unit_float(splitmix32(state));
+  }
+
+  BlueNoise generate_blue_noise(uint32_t size, uint32_t seed) {
+    assert(std::has_single_bit(size) && size <= 256);
+
+    uint32_t count = size * size;
+
+    // energy a point spreads to each toroidal offset
+    std::vector<float> kernel(count);
+    const float sigma = 1.9f;
+
+    for (uint32_t y = 0; y < size; ++y) {
+      for (uint32_t x = 0; x < size; ++x) {
+        float dx = (float)std::min(x, size - x);
+        float dy = (float)std::min(y, size - y);
+        kernel[y * size + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+      }
+    }
+
+    std::vector<uint8_t> points(count, 0);
+    std::vector<float> energy(count, 0.0f);
+
+    auto splat = [&](uint32_t i, float sign) {
+      uint32_t px = i % size;
+      uint32_t py = i / size;
+
+      for (uint32_t y = 0; y < size; ++y) {
+        for (uint32_t x = 0; x < size; ++x) {
+          uint32_t dx = (x - px) & (size - 1);
+          uint32_t dy = (y - py) & (size - 1);
+          energy[y * size + x] += sign * kernel[dy * size + dx];
+        }
+      }
+    };
+
+    // the tightest cluster is the point with the most energy, the largest void the empty pixel with the least
+    auto tightest_cluster = [&]() {
+      uint32_t best = 0;
+
+      for (uint32_t i = 0; i < count; ++i) {
+        if (points[i] && (!points[best] || energy[i] > energy[best])) {
+          best = i;
+        }
+      }
+
+      return best;
+    };
+
+    auto largest_void = [&]() {
+      uint32_t best = 0;
+
+      for (uint32_t i = 0; i < count; ++i) {
+        if (!points[i] && (points[best] || energy[i] < energy[best])) {
+          best = i;
+        }
+      }
+
+      return best;
+    };
+
+    // random initial points, then relaxed by moving the tightest cluster into the largest void until it stays put
+    uint32_t initial_count = std::max(count / 10, 1u);
+    uint32_t state = seed;
+
+    for (uint32_t placed = 0; placed < initial_count;) {
+      uint32_t i = splitmix32(&state) % count;
+
+      if (!points[i]) {
+        points[i] = 1;
+        splat(i, 1.0f);
+        placed++;
+      }
+    }
+
+    for (;;) {
+      uint32_t cluster = tightest_cluster();
+      points[cluster] = 0;
+      splat(cluster, -1.0f);
+
+      uint32_t hole = largest_void();
+      points[hole] = 1;
+      splat(hole, 1.0f);
+
+      if (hole == cluster) {
+        break;
+      }
+    }
+
+    std::vector<uint8_t> initial_points = points;
+    std::vector<float> initial_energy = energy;
+
+    BlueNoise result = {
+      .size = size,
+      .rank_bits = (uint32_t)std::countr_zero(count),
+      .ranks = std::vector<uint16_t>(count),
+    };
+
+    // ranks below the initial points come from taking them away cluster first
+    for (uint32_t rank = initial_count; rank-- > 0;) {
+      uint32_t cluster = tightest_cluster();
+      points[cluster] = 0;
+      splat(cluster, -1.0f);
+      result.ranks[cluster] = (uint16_t)rank;
+    }
+
+    // and the rest from filling voids
+    points = std::move(initial_points);
+    energy = std::move(initial_energy);
+
+    for (uint32_t rank = initial_count; rank < count; ++rank) {
+      uint32_t hole = largest_void();
+      points[hole] = 1;
+      splat(hole, 1.0f);
+      result.ranks[hole] = (uint16_t)rank;
+    }
+
+    return result;
+  }
+
+  Sampler make_sampler(Settings settings, XMUINT2 pixel, uint32_t seed) {
+    assert(settings.type != Type::BLUE_NOISE || settings.blue_noise);
+
+    return Sampler{
+      .settings = settings,
+      .pixel = pixel,
+      .seed = seed,
+    };
+  }
+
+  void start_sample(Sampler& s, uint32_t index) {
+    s.index = index;
+    s.dimension = 0;
+    s.state = s.seed ^ hash32(index);
+  }
+
+  float next_1d(Sampler& s) {
+    uint32_t d = s.dimension++;
+
+    switch (s.settings.type) {
+      default:
+        return uniform_random(&s.state);
+
+      case Type::SOBOL:
+        return unit_float(sobol_owen(s.index, d, s.seed));
+
+      case Type::LATTICE:
+        return unit_float(lattice(s.index, d, s.seed));
+
+      case Type::BLUE_NOISE: {
+        const BlueNoise& bn = *s.settings.blue_noise;
+        uint32_t offset = blue_noise_offset(d);
+        uint32_t x = (s.pixel.x + offset) & (bn.size - 1);
+        uint32_t y = (s.pixel.y + (offset >> 16)) & (bn.size - 1);
+        return unit_float(blue_noise(bn.ranks[y * bn.size + x], bn.rank_bits, s.index, d));
+      }
+    }
+  }
+
+  XMFLOAT2 next_2d(Sampler& s) {
+    float x = next_1d(s);
+    float y = next_1d(s);
+    return XMFLOAT2(x, y);
+  }
+};
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "sequences.h"
+
+using namespace DirectX;
+
+// where the shaders get their random numbers, must match sampler.hlsli
+namespace sampler {
+  // must match the values reservoir1_cs switches on
+  enum class Type : uint32_t {
+    RANDOM,
+    SOBOL,
+    LATTICE,
+    BLUE_NOISE,
+  };
+
+  // a tileable mask where every value from 0 to size^2-1 appears once, and similar values are spread apart
+  struct BlueNoise {
+    uint32_t size;
+    uint32_t rank_bits;
+    std::vector<uint16_t> ranks;
+  };
+
+  struct Settings {
+    Type type;
+    const BlueNoise* blue_noise; // only needed for BLUE_NOISE
+  };
+
+  // one pixel's stream. every sample index restarts the dimensions, so sample i of a pixel always sees the
+  // same numbers no matter how many dimensions the samples before it used
+  struct Sampler {
+    Settings settings;
+    XMUINT2 pixel;
+    uint32_t seed;
+    uint32_t index;
+    uint32_t dimension;
+    uint32_t state;
+  };
+
+  float uniform_random(uint32_t* state);
+
+  // void and cluster with a gaussian energy, size must be a power of two
+  BlueNoise generate_blue_noise(uint32_t size, uint32_t seed);
+
+  Sampler make_sampler(Settings settings, XMUINT2 pixel, uint32_t seed);
+  void start_sample(Sampler& s, uint32_t index);
+
+  float next_1d(Sampler& s);
+  XMFLOAT2 next_2d(Sampler& s);
+};
\ No newline at end of file
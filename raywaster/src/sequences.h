@@ -0,0 +1,126 @@
+// hashes and low discrepancy sequences, included by both sampler.h and common.hlsli so the cpu reference draws
+// exactly the same numbers as the shaders. integer math wherever the two could otherwise round differently
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+#include "hlsl_compat.h"
+
+SHARED_NAMESPACE_BEGIN(sampler)
+
+#define SOBOL_DIMENSIONS 4
+#define LATTICE_DIMENSIONS 8
+#define BLUE_NOISE_DIMENSIONS 8
+
+// the blue noise mask the shaders are given, log2 of its texel count
+#define BLUE_NOISE_SIZE 64
+#define BLUE_NOISE_RANK_BITS 12
+
+// generator matrices of the first four sobol dimensions (joe-kuo), one column per index bit
+static const uint SOBOL_MATRICES[SOBOL_DIMENSIONS * 32] = {
+  0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+  0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+  0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+  0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+
+  0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+  0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+  0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+  0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+  0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+  0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+  0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+  0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+  0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+  0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+  0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+  0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u,
+};
+
+// generating vector of an extensible rank-1 lattice in base 2, from a component by component search
+// over 2^6 to 2^14 points. any power of two prefix of the sequence is a full lattice
+static const uint LATTICE_GENERATOR[LATTICE_DIMENSIONS] = {
+  1u, 389681u, 824715u, 668873u, 1021733u, 96363u, 710697u, 278149u,
+};
+
+// per dimension steps of the r8 sequence, powers of the inverse of the root of x^9 = x + 1. stepping every
+// dimension by the same golden ratio would put a pixel's points on a line
+static const uint BLUE_NOISE_STEPS[BLUE_NOISE_DIMENSIONS] = {
+  0xebedeed9u, 0xd96eb1a8u, 0xc862b36du, 0xb8acd90cu, 0xaa324f90u, 0x9cda5e69u, 0x908e3d2cu, 0x8538ecb5u,
+};
+
+SHARED_FN uint hash32(uint key) {
+  key = ~key + (key << 15); // key = (key << 15) - key - 1;
+  key = key ^ (key >> 12);
+  key = key + (key << 2);
+  key = key ^ (key >> 4);
+  key = key * 2057u; // key = (key + (key << 3)) + (key << 11);
+  key = key ^ (key >> 16);
+  return key;
+}
+
+SHARED_FN uint hash_combine(uint seed, uint value) {
+  return seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// the top 24 bits are exactly representable, so this never rounds up to 1
+SHARED_FN float unit_float(uint x) {
+  return float(x >> 8) * (1.0f / 16777216.0f);
+}
+
+// shuffled indices have random bits, so masking instead of branching saves a mispredict or a divergent branch per bit
+SHARED_FN uint sobol(uint index, uint dimension) {
+  uint x = 0;
+
+  for (uint bit = 0; index != 0; index >>= 1, ++bit) {
+    x ^= SOBOL_MATRICES[dimension * 32 + bit] * (index & 1u);
+  }
+
+  return x;
+}
+
+// laine-karras style hash, each bit only depends on itself and the bits below it
+SHARED_FN uint laine_karras_permutation(uint x, uint seed) {
+  x += seed;
+  x ^= x * 0x6c50b47cu;
+  x ^= x * 0xb82f1e52u;
+  x ^= x * 0xc7afe638u;
+  x ^= x * 0x8d22f6e6u;
+  return x;
+}
+
+// owen scrambling: each bit is flipped depending on the bits above it, which keeps the stratification
+SHARED_FN uint nested_uniform_scramble(uint x, uint seed) {
+  return reversebits(laine_karras_permutation(reversebits(x), seed));
+}
+
+// dimensions come in independently shuffled and scrambled groups of SOBOL_DIMENSIONS, so the dimensions
+// within a group are stratified against each other and a group behaves like an independent sequence
+SHARED_FN uint sobol_owen(uint index, uint dimension, uint seed) {
+  uint group_seed = hash32(hash_combine(seed, dimension / SOBOL_DIMENSIONS));
+  uint shuffled = nested_uniform_scramble(index, group_seed);
+  return nested_uniform_scramble(sobol(shuffled, dimension % SOBOL_DIMENSIONS), hash32(hash_combine(group_seed, dimension)));
+}
+
+// the index is radical inverted so the points fill in the lattice progressively, then everything is
+// cranley-patterson rotated by a per dimension shift. wrapping integer math is the fractional part
+SHARED_FN uint lattice(uint index, uint dimension, uint seed) {
+  uint generator = LATTICE_GENERATOR[dimension % LATTICE_DIMENSIONS];
+  return reversebits(index) * generator + hash32(hash_combine(seed, dimension));
+}
+
+// rank is the blue noise mask's value at the pixel out of 2^rank_bits. successive indices rotate it along an
+// additive recurrence, which keeps each pixel well distributed over time while neighbours stay decorrelated
+SHARED_FN uint blue_noise(uint rank, uint rank_bits, uint index, uint dimension) {
+  return (rank << (32 - rank_bits)) + index * BLUE_NOISE_STEPS[dimension % BLUE_NOISE_DIMENSIONS];
+}
+
+// where dimension reads the mask, so different dimensions of a pixel don't see the same value
+SHARED_FN uint blue_noise_offset(uint dimension) {
+  return hash32(dimension + 1);
+}
+
+SHARED_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include <cmath>
+
+#include "sh.h"
+#include "parallel.h"
+
+namespace sh {
+  // same ordering and constants as sh.hlsli
+  static void basis(FXMVECTOR dir, float* y) {
+    XMFLOAT3 d;
+    XMStoreFloat3(&d, dir);
+
+    y[0] = 0.282095f;
+
+    y[1] = 0.488603f * d.y;
+    y[2] = 0.488603f * d.z;
+    y[3] = 0.488603f * d.x;
+
+    y[4] = 1.092548f * d.x * d.y;
+    y[5] = 1.092548f * d.y * d.z;
+    y[6] = 0.315392f * (3.0f * d.z * d.z - 1.0f);
+    y[7] = 1.092548f * d.x * d.z;
+    y[8] = 0.546274f * (d.x * d.x - d.y * d.y);
+  }
+
+  // rows are summed separately then reduced, so the result doesn't depend on the thread count
+  L2 project_environment(const hdri::Image& image, hdri::Layout layout) {
+    std::vector<L2> rows(image.height);
+
+    parallel::for_range(image.height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        XMVECTOR sums[L2_COEFFICIENTS] = {};
+
+        for (uint32_t x = 0; x < image.width; ++x) {
+          XMFLOAT2 uv(((float)x + 0.5f) / (float)image.width, ((float)y + 0.5f) / (float)image.height);
+
+          float jacobian;
+          XMVECTOR dir = hdri::layout_to_dir(layout, uv, &jacobian);
+
+          float weights[L2_COEFFICIENTS];
+          basis(dir, weights);
+
+          XMVECTOR radiance = XMLoadFloat3((const XMFLOAT3*)(image.texels.data() + (y * image.width + x) * 3)) * jacobian;
+
+          for (uint32_t i = 0; i < L2_COEFFICIENTS; ++i) {
+            sums[i] = XMVectorMultiplyAdd(radiance, XMVectorReplicate(weights[i]), sums[i]);
+          }
+        }
+
+        for (uint32_t i = 0; i < L2_COEFFICIENTS; ++i) {
+          XMStoreFloat3(&rows[y].coefficients[i], sums[i]);
+        }
+      }
+    });
+
+    float texel_area = 1.0f / ((float)image.width * (float)image.height);
+
+    L2 result = {};
+
+    for (uint32_t i = 0; i < L2_COEFFICIENTS; ++i) {
+      XMVECTOR sum = XMVectorZero();
+
+      for (const L2& row : rows) {
+        sum += XMLoadFloat3(&row.coefficients[i]);
+      }
+
+      XMStoreFloat3(&result.coefficients[i], sum * texel_area);
+    }
+
+    return result;
+  }
+
+  void add_directional(L2& sh, FXMVECTOR dir, FXMVECTOR power) {
+    float weights[L2_COEFFICIENTS];
+    basis(dir, weights);
+
+    for (uint32_t i = 0; i < L2_COEFFICIENTS; ++i) {
+      XMStoreFloat3(&sh.coefficients[i], XMVectorMultiplyAdd(power, XMVectorReplicate(weights[i]), XMLoadFloat3(&sh.coefficients[i])));
+    }
+  }
+
+  // Ramamoorthi and Hanrahan, the cosine lobe's band factors are pi, 2pi/3 and pi/4
+  L2 convolve_cosine(const L2& radiance) {
+    static constexpr float BAND_FACTORS[L2_COEFFICIENTS] = {
+      XM_PI,
+      XM_2PI / 3.0f, XM_2PI / 3.0f, XM_2PI / 3.0f,
+      XM_PIDIV4, XM_PIDIV4, XM_PIDIV4, XM_PIDIV4, XM_PIDIV4,
+    };
+
+    L2 result;
+
+    for (uint32_t i = 0; i < L2_COEFFICIENTS; ++i) {
+      XMStoreFloat3(&result.coefficients[i], XMLoadFloat3(&radiance.coefficients[i]) * BAND_FACTORS[i]);
+    }
+
+    return result;
+  }
+
+  XMVECTOR evaluate(const L2& sh, FXMVECTOR dir) {
+    float weights[L2_COEFFICIENTS];
+    basis(dir, weights);
+
+    XMVECTOR result = XMVectorZero();
+
+    for (uint32_t i = 0; i < L2_COEFFICIENTS; ++i) {
+      result = XMVectorMultiplyAdd(XMLoadFloat3(&sh.coefficients[i]), XMVectorReplicate(weights[i]), result);
+    }
+
+    return result;
+  }
+};
\ No newline at end of file
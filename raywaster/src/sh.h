@@ -0,0 +1,26 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "hdri.h"
+
+using namespace DirectX;
+
+namespace sh {
+  static constexpr uint32_t L2_COEFFICIENTS = 9;
+
+  // real spherical harmonics up to band 2, rgb per coefficient
+  struct L2 {
+    XMFLOAT3 coefficients[L2_COEFFICIENTS];
+  };
+
+  L2 project_environment(const hdri::Image& image, hdri::Layout layout);
+
+  // a source small enough to treat as a delta, power is radiance times solid angle
+  void add_directional(L2& sh, FXMVECTOR dir, FXMVECTOR power);
+
+  // convolves with the clamped cosine lobe, evaluating the result gives irradiance
+  L2 convolve_cosine(const L2& radiance);
+
+  XMVECTOR evaluate(const L2& sh, FXMVECTOR dir);
+};
\ No newline at end of file
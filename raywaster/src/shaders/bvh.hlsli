@@ -0,0 +1,6 @@
+// must match bvh.h, leaves have the top bit of children[0] set
+struct BVHNode {
+  float3 min;
+  float3 max;
+  uint children[2];
+};
\ No newline at end of file
@@ -1,20 +1,33 @@
 #include "screen_quad.hlsli"
 #include "common.hlsli"
+#include "environment.hlsli"
+#include "upsample.hlsli"
+#include "../traversal_stats.h"
 
 cbuffer Camera : register(b0) {
   float4x4 inv_view;
   float4x4 inv_view_proj;
   float4x4 view_proj;
   uint frame;
+  uint lighting_lod;
+  uint debug_view;
+};
+
+cbuffer Scene : register(b1) {
+  float4 env_irradiance[9];
+  uint index_width;
+  uint env_light_count;
 };
 
 Texture2D<float3> lighting_buffer : register(t0);
 Texture2D<float3> hdri : register(t1);
 Texture2D<float> depth_buffer : register(t2);
+StructuredBuffer<DiskLight> env_lights : register(t3);
+Texture2D gbuffer_normal : register(t4);
+StructuredBuffer<TraversalStats> traversal_stats : register(t5);
 
 sampler point_clamp_sampler : register(s0);
 sampler linear_clamp_sampler : register(s1);
-sampler linear_wrap_sampler : register(s2);
 
 float4 main(VSOut vso) : SV_TARGET
 {
@@ -23,10 +36,18 @@ float4 main(VSOut vso) : SV_TARGET
 
 	float3 color;
 
+  if (debug_view != DEBUG_VIEW_NONE) {
+    uint lighting_w, lighting_h;
+    lighting_buffer.GetDimensions(lighting_w, lighting_h);
+
+    uint2 texel = min(uint2(vso.sv_pos.xy) >> lighting_lod, uint2(lighting_w, lighting_h) - 1);
+    return float4(heatmap(traversal_heat(traversal_stats[texel.y * lighting_w + texel.x], debug_view - 1)), 1.0f);
+  }
+
   float depth = depth_buffer.SampleLevel(point_clamp_sampler, uv, 0.0f) ;
 
   if (depth > 0.0f) {
-		color = lighting_buffer.SampleLevel(linear_clamp_sampler, uv, 0);
+		color = upsample_lighting(lighting_buffer, depth_buffer, gbuffer_normal, uint2(vso.sv_pos.xy), lighting_lod);
   }
   else {
     float4 ndc = float4(vso.ndc, depth, 1.0f);
@@ -35,8 +56,10 @@ float4 main(VSOut vso) : SV_TARGET
 
     float3 camera_pos = mul(inv_view, float4(0.0f, 0.0, 0.0f, 1.0f)).xyz;
 
-		color = sqrt(ACESFilm(hdri.SampleLevel(linear_wrap_sampler, dir_to_equi(normalize(world-camera_pos)), 0.0f)));
+    float3 dir = normalize(world-camera_pos);
+		color = hdri.SampleLevel(linear_clamp_sampler, dir_to_octahedral(dir), 0.0f) + disk_lights_radiance(env_lights, env_light_count, dir);
   }
-	
-	return float4(color, 1.0f);
+
+  // the only place anything is tonemapped, everything before works in linear radiance
+	return float4(sqrt(ACESFilm(color)), 1.0f);
 }
\ No newline at end of file
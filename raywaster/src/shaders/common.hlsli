@@ -1,3 +1,5 @@
+#include "../sequences.h"
+
 #define PI 3.14159265f
 
 float3 ACESFilm(float3 x)
@@ -10,21 +12,23 @@ float3 ACESFilm(float3 x)
   return saturate((x*(a*x+b))/(x*(c*x+d)+e));
 }
 
-float2 dir_to_equi(float3 d) {
-  float x = (atan2(d.x, d.z) * 1.0f/PI) * 0.5f + 0.5f;
-  float y = (asin(d.y) * 2.0f/PI) * 0.5f + 0.5f;
-  return float2(x, 1.0f-y);
+// y is the pole and the lower hemisphere folds over the diagonals, must match hdri::dir_to_octahedral
+float2 dir_to_octahedral(float3 d) {
+  float2 e = d.xz / (abs(d.x) + abs(d.y) + abs(d.z));
+
+  if (d.y < 0.0f) {
+    e = (1.0f - abs(e.yx)) * (e >= 0.0f ? 1.0f : -1.0f);
+  }
+
+  return e * 0.5f + 0.5f;
 }
 
-uint hash32(uint key)
-{
-  key = ~key + (key << 15); // key = (key << 15) - key - 1;
-  key = key ^ (key >> 12);
-  key = key + (key << 2);
-  key = key ^ (key >> 4);
-  key = key * 2057; // key = (key + (key << 3)) + (key << 11);
-  key = key ^ (key >> 16);
-  return key;
+// inverse of dir_to_octahedral
+float3 octahedral_to_dir(float2 uv) {
+  float2 e = uv * 2.0f - 1.0f;
+  float y = 1.0f - abs(e.x) - abs(e.y);
+  e += (e >= 0.0f ? -1.0f : 1.0f) * max(-y, 0.0f);
+  return normalize(float3(e.x, y, e.y));
 }
 
 uint splitmix32(inout uint state) {
@@ -36,7 +40,7 @@ uint splitmix32(inout uint state) {
 }
 
 float uniform_random(inout uint state) {
-  return (float)((double)splitmix32(state)/(double)0xffffffff);
+  return unit_float(splitmix32(state));
 }
 
 float3 random_cosine_direction(inout uint state) {
@@ -51,7 +55,8 @@ float3 random_cosine_direction(inout uint state) {
   return float3(x, y, z);
 }
 
-float3 sample_cosine_hemisphere(inout uint state, float3 n) {
+// v is in tangent space with n along z
+float3 tangent_to_world(float3 v, float3 n) {
   float3 a;
 
   if (abs(n.x) > 0.9f) {
@@ -63,10 +68,20 @@ float3 sample_cosine_hemisphere(inout uint state, float3 n) {
   float3 s = normalize(cross(n, a));
   float3 t = cross(n, s);
 
-  float3 v = random_cosine_direction(state);
   return v.x*s + v.y*t + v.z*n;
 }
 
+float3 sample_cosine_hemisphere(inout uint state, float3 n) {
+  return tangent_to_world(random_cosine_direction(state), n);
+}
+
+// the same distribution from a sampler's pair, must match pathtrace.cpp
+float3 cosine_direction(float2 u, float3 n) {
+  float phi = 2.0f * PI * u.x;
+  float r = sqrt(u.y);
+  return tangent_to_world(float3(cos(phi) * r, sin(phi) * r, sqrt(1.0f - u.y)), n);
+}
+
 float3 sample_uniform_sphere(inout uint state) {
   float u = uniform_random(state);
   float v = uniform_random(state);
@@ -86,20 +101,32 @@ float3 sample_uniform_hemisphere(inout uint state, float3 n) {
   return v;
 }
 
+// blue through green to red for t in [0, 1], must match trace::heatmap
+float3 heatmap(float t) {
+  return saturate(1.5f - abs(4.0f * t - float3(3.0f, 2.0f, 1.0f)));
+}
+
 float compute_luminance(float3 col) {
   return 0.2126f * col.r + 0.7152f * col.g + 0.0722f * col.b;
 }
 
-struct SerializedReservoir {
-  uint y;
-  float w;
-  float factor;
-
-  float3 dir() {
-    uint3 result;
-    result.x = (y >> 16) & 0xff;
-    result.y = (y >> 8) & 0xff;
-    result.z = (y) & 0xff;
-    return (float3(result) / 255.0f) * 2.0f - 1.0f;
+// the texel world was at last frame, if it was on screen and prev_surfaces (normal and linear view depth) saw the
+// same surface there. must match restir::reproject
+bool reproject(float3 world, float3 normal, float4x4 prev_view_proj, Texture2D<float4> prev_surfaces, uint2 size,
+               float depth_tolerance, float normal_tolerance, out uint2 prev_texel) {
+  float4 prev_clip = mul(prev_view_proj, float4(world, 1.0f));
+  float2 prev_uv = float2(prev_clip.x, -prev_clip.y) / prev_clip.w * 0.5f + 0.5f;
+  int2 t = int2(round(prev_uv * float2(size)));
+
+  prev_texel = uint2(t);
+
+  if (prev_clip.w <= 0.0f || any(t < 0) || any(t >= int2(size))) {
+    return false;
   }
-};
+
+  float4 prev_surface = prev_surfaces[prev_texel];
+
+  return prev_surface.w > 0.0f &&
+         abs(prev_surface.w - prev_clip.w) < depth_tolerance * prev_clip.w &&
+         dot(prev_surface.xyz, normal) > normal_tolerance;
+}
\ No newline at end of file
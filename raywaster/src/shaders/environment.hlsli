@@ -0,0 +1,129 @@
+// include after common.hlsli
+
+// must match hdri::AliasEntry
+struct AliasEntry {
+  float probability;
+  uint alias;
+  float pdf;
+};
+
+// must match hdri::DiskLight
+struct DiskLight {
+  float3 direction;
+  float cos_half_angle;
+  float3 radiance;
+  float selection;
+};
+
+// solid angle per unit uv area, 4 * l1(dir)^3 for a unit direction
+float octahedral_jacobian(float3 dir) {
+  float l1 = abs(dir.x) + abs(dir.y) + abs(dir.z);
+  return 4.0f * l1 * l1 * l1;
+}
+
+uint sample_alias(StructuredBuffer<AliasEntry> table, uint offset, uint count, float u) {
+  float x = u * float(count);
+  uint i = min(uint(x), count - 1);
+  AliasEntry entry = table[offset + i];
+  return (x - float(i)) < entry.probability ? i : entry.alias;
+}
+
+// the table layout is hdri::Distribution2D, size is the octahedral map's resolution.
+// u.xy pick the texel and u.zw jitter inside it, pdf is per unit solid angle
+float3 sample_environment(StructuredBuffer<AliasEntry> dist, uint2 size, float4 u, out float2 uv, out float pdf) {
+  uint y = sample_alias(dist, 0, size.y, u.x);
+  uint row = size.y + y * size.x;
+  uint x = sample_alias(dist, row, size.x, u.y);
+
+  uv = (float2(x, y) + u.zw) / float2(size);
+
+  float3 dir = octahedral_to_dir(uv);
+  pdf = dist[y].pdf * dist[row + x].pdf / octahedral_jacobian(dir);
+
+  return dir;
+}
+
+float environment_pdf(StructuredBuffer<AliasEntry> dist, uint2 size, float3 dir) {
+  uint2 texel = min(uint2(dir_to_octahedral(dir) * float2(size)), size - 1);
+  return dist[texel.y].pdf * dist[size.y + texel.y * size.x + texel.x].pdf / octahedral_jacobian(dir);
+}
+
+float disk_solid_angle(DiskLight light) {
+  return 2.0f * PI * (1.0f - light.cos_half_angle);
+}
+
+float3 disk_lights_radiance(StructuredBuffer<DiskLight> lights, uint count, float3 dir) {
+  float3 radiance = 0.0f;
+
+  for (uint i = 0; i < count; ++i) {
+    if (dot(dir, lights[i].direction) >= lights[i].cos_half_angle) {
+      radiance += lights[i].radiance;
+    }
+  }
+
+  return radiance;
+}
+
+// cones can overlap, so every light that could have produced dir counts
+float disk_lights_pdf(StructuredBuffer<DiskLight> lights, uint count, float3 dir) {
+  float pdf = 0.0f;
+
+  for (uint i = 0; i < count; ++i) {
+    if (dot(dir, lights[i].direction) >= lights[i].cos_half_angle) {
+      pdf += lights[i].selection / disk_solid_angle(lights[i]);
+    }
+  }
+
+  return pdf;
+}
+
+// u.x picks a light by its selection probability, u.yz are uniform over its cone
+float3 sample_disk_lights(StructuredBuffer<DiskLight> lights, uint count, float3 u, out float pdf) {
+  uint k = 0;
+  float sum = 0.0f;
+
+  for (; k + 1 < count; ++k) {
+    sum += lights[k].selection;
+
+    if (u.x < sum) {
+      break;
+    }
+  }
+
+  DiskLight light = lights[k];
+
+  float cos_theta = 1.0f - u.y * (1.0f - light.cos_half_angle);
+  float sin_theta = sqrt(max(1.0f - cos_theta * cos_theta, 0.0f));
+  float phi = 2.0f * PI * u.z;
+
+  float3 up = abs(light.direction.y) < 0.999f ? float3(0.0f, 1.0f, 0.0f) : float3(1.0f, 0.0f, 0.0f);
+  float3 t = normalize(cross(up, light.direction));
+  float3 b = cross(light.direction, t);
+
+  float3 dir = normalize(t * (sin_theta * cos(phi)) + b * (sin_theta * sin(phi)) + light.direction * cos_theta);
+  pdf = disk_lights_pdf(lights, count, dir);
+
+  return dir;
+}
+
+// strategy below light_probability samples the lights, otherwise the residual environment. the pdf is that of
+// the mixture, so each strategy covers what the other misses. must match restir::sample_mixture
+float3 sample_mixture(StructuredBuffer<AliasEntry> dist, uint2 size, StructuredBuffer<DiskLight> lights, uint light_count,
+                      float light_probability, float4 u, float strategy, out float pdf) {
+  float3 dir;
+  float env_pdf;
+  float light_pdf;
+
+  if (strategy < light_probability) {
+    dir = sample_disk_lights(lights, light_count, u.xyz, light_pdf);
+    env_pdf = environment_pdf(dist, size, dir);
+  }
+  else {
+    float2 uv;
+    dir = sample_environment(dist, size, u, uv, env_pdf);
+    light_pdf = disk_lights_pdf(lights, light_count, dir);
+  }
+
+  pdf = lerp(env_pdf, light_pdf, light_probability);
+  return dir;
+}
\ No newline at end of file
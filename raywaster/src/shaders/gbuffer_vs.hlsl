@@ -1,5 +1,8 @@
 #include "gbuffer.hlsli"
 
+// must match meshlet.h
+#define MESHLET_MAX_TRIANGLES 124
+
 cbuffer Camera : register(b0) {
   float4x4 inv_view;
   float4x4 inv_view_proj;
@@ -7,20 +10,56 @@ cbuffer Camera : register(b0) {
   uint frame;
 };
 
-StructuredBuffer<float3> positions : register(t0);
-StructuredBuffer<float3> normals : register(t1);
-StructuredBuffer<float2> tex_coords : register(t2);
-StructuredBuffer<uint> indices : register(t3);
+struct Meshlet {
+  uint vertex_offset;
+  uint triangle_offset;
+  uint vertex_count;
+  uint triangle_count;
+
+  float3 center;
+  float radius;
+
+  float3 cone_apex;
+  float3 cone_axis;
+  float cone_cutoff;
+
+  float3 min;
+  float3 max;
+};
+
+ByteAddressBuffer positions : register(t0);
+StructuredBuffer<uint> normals : register(t1);
+StructuredBuffer<uint> tex_coords : register(t2);
+ByteAddressBuffer position_bounds : register(t3);
+StructuredBuffer<Meshlet> meshlets : register(t4);
+StructuredBuffer<uint> meshlet_vertices : register(t5);
+StructuredBuffer<uint> meshlet_triangles : register(t6);
+StructuredBuffer<uint> visible_meshlets : register(t7);
 
+#include "mesh.hlsli"
+
+// every visible meshlet gets MESHLET_MAX_TRIANGLES triangles worth of vertices, the unused tail collapses to a point
 VSOut main(uint vertex_id : SV_VertexID)
 {
-  uint index = indices[vertex_id];
-
-  float3 pos = positions[index];
-  float3 normal = normals[index];
-  float2 tex_coord = tex_coords[index];
+  uint corner = vertex_id % (MESHLET_MAX_TRIANGLES * 3);
+  Meshlet meshlet = meshlets[visible_meshlets[vertex_id / (MESHLET_MAX_TRIANGLES * 3)]];
 
   VSOut vso;
+
+  if (corner >= meshlet.triangle_count * 3) {
+    vso.sv_pos = 0.0f;
+    vso.normal = 0.0f;
+    vso.tex_coord = 0.0f;
+    return vso;
+  }
+
+  uint triangle = meshlet_triangles[meshlet.triangle_offset + corner / 3];
+  uint index = meshlet_vertices[meshlet.vertex_offset + ((triangle >> ((corner % 3) * 8)) & 0xff)];
+
+  float3 pos = load_position(index);
+  float3 normal = load_normal(index);
+  float2 tex_coord = load_tex_coord(index);
+
   vso.sv_pos = mul(view_proj, float4(pos, 1.0f));
   vso.normal = normal;
   vso.tex_coord = tex_coord;
@@ -0,0 +1,160 @@
+#include "common.hlsli"
+#include "environment.hlsli"
+#include "bvh.hlsli"
+
+cbuffer Constants : register(b0) {
+  float4x4 inv_view_proj;
+  float4x4 prev_view_proj;
+  uint width;
+  uint height;
+  uint frame;
+  uint stride;
+  uint max_bounces;
+  uint roulette_start;
+  float albedo;
+  uint env_width;
+  uint env_height;
+  float env_light_probability;
+  uint sampler_type;
+  uint lighting_lod;
+  uint history_valid;
+  uint debug_view;
+};
+
+cbuffer Scene : register(b1) {
+  float4 env_irradiance[9];
+  uint index_width;
+  uint env_light_count;
+};
+
+// must match pathtrace.h
+#define MAX_BOUNCES 8
+
+// must match restir.h, pixels that weren't traced reuse last frame's path with the same tolerances as the reservoirs
+#define DEPTH_TOLERANCE 0.1f
+#define NORMAL_TOLERANCE 0.9f
+
+RWTexture2D<float4> indirect_buffer : register(u0);
+
+ByteAddressBuffer positions : register(t0);
+StructuredBuffer<uint> normals : register(t1);
+StructuredBuffer<uint> tex_coords : register(t2);
+ByteAddressBuffer position_bounds : register(t3);
+ByteAddressBuffer indices : register(t4);
+StructuredBuffer<BVHNode> bvh : register(t5);
+
+Texture2D<float3> hdri : register(t6);
+StructuredBuffer<AliasEntry> env_distribution : register(t7);
+StructuredBuffer<DiskLight> env_lights : register(t8);
+Texture2D<float> depth_buffer : register(t9);
+Texture2D gbuffer_normal : register(t10);
+Texture2D<uint> blue_noise_ranks : register(t11);
+Texture2D<float4> prev_surfaces : register(t12);
+Texture2D<float4> prev_indirect_buffer : register(t13);
+
+SamplerState point_clamp_sampler : register(s0);
+SamplerState linear_clamp_sampler : register(s1);
+
+#include "trace.hlsli"
+#include "sampler.hlsli"
+
+RWStructuredBuffer<TraversalStats> traversal_stats : register(u1); // only written with a debug view on
+
+// one thread per pixel. pixels take turns tracing every stride frames, which keeps the rays per frame within the
+// budget no matter the resolution. the rest reproject what their surface's last path found, so a moving camera
+// doesn't leave stale paths behind, and go dark where that surface wasn't visible
+[numthreads(64, 1, 1)]
+void main( uint3 thread_id : SV_DispatchThreadID )
+{
+  uint p = thread_id.x;
+
+  if (p >= width * height) {
+    return;
+  }
+
+  uint2 texel = uint2(p % width, p / width);
+  float2 uv = float2(texel)/float2(width,height);
+
+  float depth = depth_buffer.SampleLevel(point_clamp_sampler, uv, lighting_lod);
+
+  if (depth <= 0.0f) {
+    indirect_buffer[texel] = 0.0f;
+    return;
+  }
+
+  float3 n = gbuffer_normal.SampleLevel(point_clamp_sampler, uv, lighting_lod).xyz * 2.0f - 1.0f;
+
+  float4 hom = mul(inv_view_proj, float4(uv.x * 2.0f - 1.0f, uv.y * -2.0f + 1.0f, depth, 1.0f));
+  float3 o = hom.xyz / hom.w;
+
+  if (p % stride != frame % stride) {
+    uint2 prev_texel;
+    bool reused = history_valid && reproject(o, n, prev_view_proj, prev_surfaces, uint2(width, height), DEPTH_TOLERANCE, NORMAL_TOLERANCE, prev_texel);
+
+    indirect_buffer[texel] = reused ? prev_indirect_buffer[prev_texel] : 0.0f;
+    return;
+  }
+
+  Sampler s = make_sampler(sampler_type, texel, hash32(p));
+  start_sample(s, frame / stride);
+
+  uint2 env_size = uint2(env_width, env_height);
+
+  float3 radiance = 0.0f;
+  float throughput = 1.0f;
+
+  TraversalStats path_stats = empty_traversal_stats();
+
+  for (uint bounce = 0; bounce < min(max_bounces, MAX_BOUNCES); ++bounce) {
+    float2 u_dir = next_2d(s);
+    float u_roulette = next_1d(s);
+    float u_strategy = next_1d(s);
+    float4 u = float4(next_2d(s), next_2d(s));
+
+    HitRecord rec;
+    TraversalStats stats;
+
+    bool hit = intersect_scene(make_ray(o + n * 1e-6f, cosine_direction(u_dir, n)), rec, stats);
+    path_stats = merge_traversal_stats(path_stats, stats);
+
+    if (!hit) {
+      break; // the environment along bounce rays was already counted by the previous vertex's light sample
+    }
+
+    o = rec.p;
+    n = rec.n;
+
+    // cosine sampling cancels everything of the lambertian brdf but its albedo
+    throughput *= albedo;
+
+    float pdf;
+    float3 wi = sample_mixture(env_distribution, env_size, env_lights, env_light_count, env_light_probability, u, u_strategy, pdf);
+    float cosine = dot(n, wi);
+
+    if (pdf > 0.0f && cosine > 0.0f) {
+      bool occluded = intersect_scene(make_ray(o + n * 1e-6f, wi), rec, stats);
+      path_stats = merge_traversal_stats(path_stats, stats);
+
+      if (!occluded) {
+        float3 env_radiance = hdri.SampleLevel(linear_clamp_sampler, dir_to_octahedral(wi), 0.0f) + disk_lights_radiance(env_lights, env_light_count, wi);
+        radiance += env_radiance * (throughput * cosine / (PI * pdf));
+      }
+    }
+
+    if (bounce + 1 >= roulette_start) {
+      float survival = min(throughput, 0.95f);
+
+      if (u_roulette >= survival) {
+        break;
+      }
+
+      throughput /= survival;
+    }
+  }
+
+  indirect_buffer[texel] = float4(radiance, 0.0f);
+
+  if (debug_view != DEBUG_VIEW_NONE) {
+    traversal_stats[p] = merge_traversal_stats(traversal_stats[p], path_stats);
+  }
+}
\ No newline at end of file
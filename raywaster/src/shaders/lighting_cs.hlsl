@@ -1,157 +1,57 @@
 #include "common.hlsli"
-
-#define MAX_BVH_DEPTH 32
-
-struct BVHNode {
-  float3 min;
-  float3 max;
-  uint children[2];
-};
+#include "environment.hlsli"
+#include "restir.hlsli"
+#include "sh.hlsli"
+#include "bvh.hlsli"
 
 RWTexture2D<float4> render_target : register(u0);
-RWStructuredBuffer<SerializedReservoir> reservoir_buffer : register(u1);
+RWStructuredBuffer<PackedReservoir> reservoir_buffer : register(u1);
+RWStructuredBuffer<float4> accumulation_buffer : register(u2); // running mean and m2 of its luminance per pixel, see accumulation.h
+RWByteAddressBuffer unconverged_pixels : register(u3);
 
 cbuffer Camera : register(b0) {
   float4x4 inv_view;
   float4x4 inv_view_proj;
   float4x4 view_proj;
   uint frame;
+  uint lighting_lod; // the mip of the g-buffer the lighting buffer matches
+  uint debug_view;
 };
 
-StructuredBuffer<float3> positions : register(t0);
-StructuredBuffer<float3> normals : register(t1);
-StructuredBuffer<float2> tex_coords : register(t2);
-StructuredBuffer<uint> indices : register(t3);
-StructuredBuffer<BVHNode> bvh : register(t4);
-
-Texture2D<float3> hdri : register(t5);
-Texture2D<float> depth_buffer : register(t6);
-Texture2D gbuffer_albedo : register(t7);
-Texture2D gbuffer_normal : register(t8);
-
-SamplerState linear_wrap_sampler : register(s0);
-SamplerState point_clamp_sampler : register(s1);
-
-struct Ray {
-  float3 o;
-  float3 d;
-  float3 inv_d;
-
-  float3 at(float t) {
-    return o + d * t;
-  }
-};
-
-struct HitRecord {
-  float3 p;
-  float3 n;
-  float t;
-  float2 uv;
+cbuffer Scene : register(b1) {
+  float4 env_irradiance[9];
+  uint index_width;
+  uint env_light_count;
 };
 
-// Yoinked from
-//https://stackoverflow.com/questions/42740765/intersection-between-line-and-triangle-in-3d/42752998#42752998
-bool intersect_triangle(Ray r, float tmin, float tmax, uint tri_idx, out HitRecord rec) { 
-  uint i0 = indices[tri_idx*3+0];
-  uint i1 = indices[tri_idx*3+2];
-  uint i2 = indices[tri_idx*3+1];
-
-  float3 E1 = positions[i1]-positions[i0];
-  float3 E2 = positions[i2]-positions[i0];
-  float3 N = cross(E1,E2);
-  float det = -dot(r.d, N);
-  float invdet = 1.0f/det;
-  float3 AO  = r.o - positions[i0];
-  float3 DAO = cross(AO, r.d);
-   
-  float t = dot(AO,N)  * invdet; 
-  float u =  dot(E2,DAO) * invdet;
-  float v = -dot(E1,DAO) * invdet;
-
-  float w = 1.0f-u-v;
-
-  rec.p = r.at(t);
-  rec.n = normalize(w * normals[i0] + u * normals[i1] + v * normals[i2]);
-  rec.uv = w * tex_coords[i0] + u * tex_coords[i1] + v * tex_coords[i2];
-  rec.t = t;
-
-  return (det >= 1e-6 && t > tmin && t < tmax && u >= 0.0f && v >= 0.0f && (u+v) <= 1.0f);
-}
-
-float ray_aabb_dst(Ray ray, float3 boxMin, float3 boxMax)
-{
-  float3 tMin = (boxMin - ray.o) * ray.inv_d;
-  float3 tMax = (boxMax - ray.o) * ray.inv_d;
-  float3 t1 = min(tMin, tMax);
-  float3 t2 = max(tMin, tMax);
-  float tNear = max(max(t1.x, t1.y), t1.z);
-  float tFar = min(min(t2.x, t2.y), t2.z);
-
-  bool hit = tFar >= tNear && tFar > 0;
-  float dst = hit ? tNear > 0 ? tNear : 0 : 1.#INF;
-
-  return dst;
+// must match AccumulationConstants in main.cpp
+cbuffer Accumulation : register(b2) {
+  uint sample_count; // zero starts over
+  float target_error;
+  float correlation_length; // see accumulation::correlation_length
 };
 
-bool intersect_scene(Ray ray, out HitRecord rec, out uint box_test_count) {
-  uint bvh_count, bvh_stride;
-  bvh.GetDimensions(bvh_count, bvh_stride);
-
-  int stack_count = 0;
-  uint stack[MAX_BVH_DEPTH];
-
-  stack[stack_count++] = bvh_count-1;
-
-  float closest = 100000.0f;
-  bool hit = false;
-
-  box_test_count = 0;
-
-  while (stack_count) {
-    BVHNode node = bvh[stack[--stack_count]];
-
-    if (node.children[0] >> 31) {
-      HitRecord temp;
-      if (intersect_triangle(ray, 0.0, closest, node.children[0] & ~(1 << 31), temp)) {
-        closest = temp.t;
-        rec = temp;
-        hit = true;
-      }
-    }
-    else{
-      box_test_count++;
-
-      float dists[2];
-      bool hits[2];
-
-      for (int i = 0; i < 2; ++i) {
-        dists[i] = ray_aabb_dst(ray, bvh[node.children[i]].min, bvh[node.children[i]].max);
-        hits[i] = dists[i] < closest;
-      }
-
-      uint closer_child = dists[0] < dists[1] ? 0 : 1;
-      uint further_child = (closer_child + 1) % 2;
-
-      if (hits[further_child] && stack_count < MAX_BVH_DEPTH) {
-        stack[stack_count++] = node.children[further_child];
-      }
-
-      if (hits[closer_child] && stack_count < MAX_BVH_DEPTH) {
-        stack[stack_count++] = node.children[closer_child];
-      }
-    }
-  }
+ByteAddressBuffer positions : register(t0);
+StructuredBuffer<uint> normals : register(t1);
+StructuredBuffer<uint> tex_coords : register(t2);
+ByteAddressBuffer position_bounds : register(t3);
+ByteAddressBuffer indices : register(t4);
+StructuredBuffer<BVHNode> bvh : register(t5);
+
+Texture2D<float3> hdri : register(t6);
+Texture2D<float> depth_buffer : register(t7);
+Texture2D gbuffer_albedo : register(t8);
+Texture2D gbuffer_normal : register(t9);
+StructuredBuffer<DiskLight> env_lights : register(t10);
+Texture2D<float3> indirect_buffer : register(t11);
+
+SamplerState linear_clamp_sampler : register(s0);
+SamplerState point_clamp_sampler : register(s1);
 
-  return hit;
-}
+#include "trace.hlsli"
 
-Ray make_ray(float3 o, float3 d) {
-  Ray ray;
-  ray.o = o;
-  ray.d = d;
-  ray.inv_d = 1.0f / ray.d;
-  return ray;
-}
+RWStructuredBuffer<TraversalStats> traversal_stats : register(u4); // only written with a debug view on
+RWByteAddressBuffer traversal_aggregate : register(u5);
 
 [numthreads(16, 16, 1)]
 void main( uint3 thread_id : SV_DispatchThreadID )
@@ -165,37 +65,79 @@ void main( uint3 thread_id : SV_DispatchThreadID )
   float2 screen_uv = float2(texel.x, texel.y) / float2((float)w, (float)h);
 
   float3 camera_pos = mul(inv_view, float4(0.0f, 0.0f, 0.0f, 1.0f)).xyz;
-  float depth = depth_buffer.SampleLevel(point_clamp_sampler, screen_uv, 1);
-  float3 normal = gbuffer_normal.SampleLevel(point_clamp_sampler, screen_uv, 1).xyz * 2.0f - 1.0f;
+  float depth = depth_buffer.SampleLevel(point_clamp_sampler, screen_uv, lighting_lod);
+  float3 normal = gbuffer_normal.SampleLevel(point_clamp_sampler, screen_uv, lighting_lod).xyz * 2.0f - 1.0f;
 
   float4 ndc = float4(screen_uv.x * 2.0f - 1.0, screen_uv.y * -2.0f + 1.0f, depth, 1.0f);
   float4 hom = mul(inv_view_proj, ndc);
   float3 world = hom.xyz / hom.w;
 
   float3 color;
+  TraversalStats stats = empty_traversal_stats();
 
   if (depth > 0.0f) {
-    SerializedReservoir res = reservoir_buffer[texel.y*w+texel.x];
-    float3 dir = res.dir();
+    Reservoir res = unpack_reservoir(reservoir_buffer[texel.y*w+texel.x]);
+    float3 dir = res.y;
 
     Ray ray = make_ray(world + normal * 1e-6f, dir);
 
     HitRecord rec;
-    uint box_test_count;
 
-    if (intersect_scene(ray, rec, box_test_count)) {
+    if (!res.found) {
+      // no candidate made it into the reservoir, fall back to unshadowed diffuse from the environment's sh
+      color = sh_irradiance(env_irradiance, normal) / PI;
+    }
+    else if (res.contribution <= 0.0f || intersect_scene(ray, rec, stats)) {
       color = 0.0f; // shadowed
     }
     else{
+      // the reservoir keeps luminance times the contribution weight, at the lod its target was evaluated at
+      float3 lights = disk_lights_radiance(env_lights, env_light_count, ray.d);
+      float luminance = compute_luminance(hdri.SampleLevel(linear_clamp_sampler, dir_to_octahedral(ray.d), CANDIDATE_LOD) + lights);
+
       float angle_weighting = dot(dir, normal) / PI;
-      color = angle_weighting * hdri.SampleLevel(linear_wrap_sampler, dir_to_equi(ray.d), 0.0f) * res.factor;
+      float3 radiance = hdri.SampleLevel(linear_clamp_sampler, dir_to_octahedral(ray.d), 0.0f) + lights;
+      color = luminance > 0.0f ? angle_weighting * radiance * res.contribution / luminance : 0.0f;
     }
+
+    // both terms estimate what a white lambertian surface reflects, the albedo scales them together
+    float3 albedo = gbuffer_albedo.SampleLevel(point_clamp_sampler, screen_uv, lighting_lod).rgb;
+    color = albedo * (color + indirect_buffer[texel]);
   }
   else{
     color = 0.0f.xxx;
   }
 
   if (all(texel < uint2(w, h))) {
-    render_target[texel] = float4(sqrt(ACESFilm(color)), 0.0f);
+    // welford's update, the same as accumulation::accumulate
+    uint pixel = texel.y * w + texel.x;
+    float4 acc = sample_count > 0 ? accumulation_buffer[pixel] : 0.0f;
+    float n = (float)(sample_count + 1);
+    float3 mean = acc.rgb + (color - acc.rgb) / n;
+    float l = compute_luminance(color);
+    float m2 = acc.a + (l - compute_luminance(acc.rgb)) * (l - compute_luminance(mean));
+
+    accumulation_buffer[pixel] = float4(mean, m2);
+
+    if (target_error > 0.0f && sample_count > 0) {
+      float variance_of_mean = m2 / (n * (n - 1.0f)) * correlation_length;
+      float tolerance = target_error * (compute_luminance(mean) + 1e-3f);
+
+      if (variance_of_mean > tolerance * tolerance) {
+        unconverged_pixels.InterlockedAdd(0, 1);
+      }
+    }
+
+    render_target[texel] = float4(mean, 0.0f); // linear, combine_ps tonemaps once it's upsampled
+
+    if (debug_view != DEBUG_VIEW_NONE) {
+      // the last pass to trace, so the pixel's count is complete once its shadow ray is in
+      TraversalStats pixel_stats = merge_traversal_stats(traversal_stats[pixel], stats);
+      traversal_stats[pixel] = pixel_stats;
+
+      if (depth > 0.0f) {
+        record_traversal(traversal_aggregate, pixel_stats);
+      }
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,31 @@
+// include with positions, normals, tex_coords and position_bounds declared
+
+// must match quantize.cpp. positions are 3x16-bit unorm with the index of their PositionBounds in the top 16 bits,
+// normals are octahedral 2x16-bit snorm and tex coords 2x16-bit half
+float3 load_position(uint i) {
+  uint2 packed = positions.Load2(i * 8);
+  uint bounds = (packed.y >> 16) * 24;
+
+  float3 offset = asfloat(position_bounds.Load3(bounds));
+  float3 scale = asfloat(position_bounds.Load3(bounds + 12));
+
+  uint3 q = uint3(packed.x & 0xffff, packed.x >> 16, packed.y & 0xffff);
+  return q * (scale / 65535.0f) + offset;
+}
+
+float3 load_normal(uint i) {
+  uint packed = normals[i];
+  int2 s = int2(packed << 16, packed) >> 16;
+  float2 e = max(s / 32767.0f, -1.0f);
+
+  float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+  float t = max(-n.z, 0.0f);
+  n.xy += n.xy >= 0.0f ? -t : t;
+
+  return normalize(n);
+}
+
+float2 load_tex_coord(uint i) {
+  uint packed = tex_coords[i];
+  return f16tof32(uint2(packed, packed >> 16));
+}
\ No newline at end of file
@@ -1,58 +1,147 @@
 #include "common.hlsli"
+#include "environment.hlsli"
+#include "restir.hlsli"
+#include "bvh.hlsli"
 
 cbuffer Constants : register(b0) {
+  float4x4 view_proj;
+  float4x4 inv_view_proj;
+  float4x4 prev_view_proj;
   uint width;
   uint height;
   uint frame;
+  uint env_width;
+  uint env_height;
+  float env_light_probability;
+  uint history_valid;
+  uint sampler_type;
+  uint lighting_lod;
+  uint debug_view;
 };
 
-RWStructuredBuffer<SerializedReservoir> reservoir_buffer : register(u0);
+cbuffer Scene : register(b1) {
+  float4 env_irradiance[9];
+  uint index_width;
+  uint env_light_count;
+};
+
+#define CANDIDATE_COUNT 4
+
+// must match restir.h. history is capped at this many frames worth of candidates so it can't drown out
+// new ones, and is only reused where the reprojected surface is within these tolerances
+#define MAX_HISTORY_LENGTH 20
+#define DEPTH_TOLERANCE 0.1f
+#define NORMAL_TOLERANCE 0.9f
+
+RWStructuredBuffer<PackedReservoir> reservoir_buffer : register(u0);
+RWTexture2D<float4> surfaces : register(u1);
 
-Texture2D gbuffer_normal : register(t0);
-Texture2D<float3> hdri : register(t1);
+ByteAddressBuffer positions : register(t0);
+StructuredBuffer<uint> normals : register(t1);
+StructuredBuffer<uint> tex_coords : register(t2);
+ByteAddressBuffer position_bounds : register(t3);
+ByteAddressBuffer indices : register(t4);
+StructuredBuffer<BVHNode> bvh : register(t5);
+
+Texture2D gbuffer_normal : register(t6);
+Texture2D<float3> hdri : register(t7);
+StructuredBuffer<AliasEntry> env_distribution : register(t8);
+StructuredBuffer<DiskLight> env_lights : register(t9);
+Texture2D<float> depth_buffer : register(t10);
+StructuredBuffer<PackedReservoir> prev_reservoir_buffer : register(t11);
+Texture2D<float4> prev_surfaces : register(t12);
+Texture2D<uint> blue_noise_ranks : register(t13);
 
 SamplerState point_clamp_sampler : register(s0);
-SamplerState linear_wrap_sampler : register(s1);
+SamplerState linear_clamp_sampler : register(s1);
+
+#include "trace.hlsli"
+#include "sampler.hlsli"
+
+// the first pass to trace, so it starts each pixel's count over. only written with a debug view on
+RWStructuredBuffer<TraversalStats> traversal_stats : register(u2);
+
+float sample_luminance(float3 x) {
+  float3 radiance = hdri.SampleLevel(linear_clamp_sampler, dir_to_octahedral(x), CANDIDATE_LOD) + disk_lights_radiance(env_lights, env_light_count, x);
+  return compute_luminance(radiance);
+}
 
 [numthreads(16, 16, 1)]
 void main( uint3 thread_id : SV_DispatchThreadID )
 {
   uint2 texel = thread_id.xy;
-  uint state = hash32(texel.y * width + texel.x) ^ hash32(frame);
+  uint seed = hash32(texel.y * width + texel.x);
+  uint state = seed ^ hash32(frame);
+
+  Sampler candidate_sampler = make_sampler(sampler_type, texel, seed);
 
   float2 uv = float2(texel)/float2(width,height);
 
-  const int m = 4;
+  float depth = depth_buffer.SampleLevel(point_clamp_sampler, uv, lighting_lod);
+  float3 normal = gbuffer_normal.SampleLevel(point_clamp_sampler, uv, lighting_lod).xyz * 2.0f - 1.0f;
+
+  float4 hom = mul(inv_view_proj, float4(uv.x * 2.0f - 1.0f, uv.y * -2.0f + 1.0f, depth, 1.0f));
+  float4 world = float4(hom.xyz / hom.w, 1.0f);
+
+  uint2 env_size = uint2(env_width, env_height);
 
-  float wsum = 0.0f;
-  float3 y = 0.0f;
-  float py = 0.0f;
+  Reservoir r = empty_reservoir();
 
-  float3 normal = gbuffer_normal.SampleLevel(point_clamp_sampler, uv, 1.0f).xyz * 2.0f - 1.0f;
+  // candidates come from either the residual environment's importance distribution or the extracted lights.
+  // every candidate is its own sample of the sequence, so successive frames keep filling it in
+  for (uint i = 0; i < CANDIDATE_COUNT; ++i) {
+    start_sample(candidate_sampler, frame * CANDIDATE_COUNT + i);
 
-  for (int i = 0; i < m; ++i) {
-    float3 x = sample_cosine_hemisphere(state, normal);
-    float s = dot(normal, x)/PI;
-    float r = compute_luminance(hdri.SampleLevel(linear_wrap_sampler, dir_to_equi(x), 0.0f));
+    float4 u = float4(next_2d(candidate_sampler), next_2d(candidate_sampler));
 
-    float w = r/s;
-    wsum += w;
+    float s;
+    float3 x = sample_mixture(env_distribution, env_size, env_lights, env_light_count, env_light_probability, u, next_1d(candidate_sampler), s);
+
+    // the cosine keeps samples below the surface from ever being picked
+    float cosine = max(dot(normal, x), 0.0f);
+    float target = sample_luminance(x) * cosine;
+
+    update_reservoir(r, x, cosine, s > 0.0f ? target/s : 0.0f, next_1d(candidate_sampler));
+  }
 
-    if (uniform_random(state) < w / wsum) {
-      y = x;
-      py = r;
+  float view_depth = 0.0f;
+
+  if (depth > 0.0f) {
+    view_depth = mul(view_proj, world).w;
+
+    // where was this surface last frame
+    uint2 prev_texel;
+
+    if (history_valid && reproject(world.xyz, normal, prev_view_proj, prev_surfaces, uint2(width, height), DEPTH_TOLERANCE, NORMAL_TOLERANCE, prev_texel)) {
+      Reservoir prev = unpack_reservoir(prev_reservoir_buffer[prev_texel.y * width + prev_texel.x]);
+      prev.m = min(prev.m, MAX_HISTORY_LENGTH * CANDIDATE_COUNT);
+
+      merge_reservoir(r, prev, normal, uniform_random(state));
     }
   }
 
-  if (texel.x < width && texel.y < height) {
-    float3 dir = y * 0.5f + 0.5f;
-    uint3 worded = uint3(dir * 255.0f) & 0xff;
+  finalize_reservoir(r);
+
+  // an occluded sample keeps its m but can't contribute, so neighbours and the next frame won't reuse it.
+  // the reservoirs then sample the shadowed integrand, which is what reservoir2_cs's unbiased weights assume
+  TraversalStats stats = empty_traversal_stats();
+
+  if (depth > 0.0f && r.contribution > 0.0f) {
+    Ray ray = make_ray(world.xyz + normal * 1e-6f, r.y);
 
-    SerializedReservoir result;
-    result.y = (worded.x << 16) | (worded.y << 8) | (worded.z);
-    result.w = wsum;
-    result.factor = 1.0f/py*(1.0f/float(m)*wsum);
+    HitRecord rec;
 
-    reservoir_buffer[thread_id.y*width+thread_id.x] = result;
+    if (intersect_scene(ray, rec, stats)) {
+      r.contribution = 0.0f;
+    }
+  }
+
+  if (texel.x < width && texel.y < height) {
+    reservoir_buffer[thread_id.y*width+thread_id.x] = pack_reservoir(r);
+    surfaces[texel] = float4(normal, view_depth);
+
+    if (debug_view != DEBUG_VIEW_NONE) {
+      traversal_stats[texel.y * width + texel.x] = stats;
+    }
   }
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "common.hlsli"
+#include "restir.hlsli"
+#include "bvh.hlsli"
+
+cbuffer Constants : register(b0) {
+  float4x4 inv_view_proj;
+  uint width;
+  uint height;
+  uint frame;
+  uint spatial_count;
+  float spatial_radius;
+  uint unbiased;
+  uint lighting_lod;
+  uint debug_view;
+};
+
+cbuffer Scene : register(b1) {
+  float4 env_irradiance[9];
+  uint index_width;
+  uint env_light_count;
+};
+
+// must match restir.h. neighbours are only reused if their surface is within these tolerances
+#define MAX_SPATIAL_COUNT 8
+#define DEPTH_TOLERANCE 0.1f
+#define NORMAL_TOLERANCE 0.9f
+
+RWStructuredBuffer<PackedReservoir> reservoir_buffer : register(u0);
+
+ByteAddressBuffer positions : register(t0);
+StructuredBuffer<uint> normals : register(t1);
+StructuredBuffer<uint> tex_coords : register(t2);
+ByteAddressBuffer position_bounds : register(t3);
+ByteAddressBuffer indices : register(t4);
+StructuredBuffer<BVHNode> bvh : register(t5);
+
+StructuredBuffer<PackedReservoir> temporal_reservoir_buffer : register(t6);
+Texture2D<float4> surfaces : register(t7);
+Texture2D<float> depth_buffer : register(t8);
+
+SamplerState point_clamp_sampler : register(s0);
+
+#include "trace.hlsli"
+
+RWStructuredBuffer<TraversalStats> traversal_stats : register(u1); // only written with a debug view on
+
+float3 world_position(uint2 texel) {
+  float2 uv = float2(texel)/float2(width,height);
+  float depth = depth_buffer.SampleLevel(point_clamp_sampler, uv, lighting_lod);
+
+  float4 hom = mul(inv_view_proj, float4(uv.x * 2.0f - 1.0f, uv.y * -2.0f + 1.0f, depth, 1.0f));
+  return hom.xyz / hom.w;
+}
+
+// the ray is counted towards pixel_stats, the pixel it's traced for rather than the neighbour it starts at
+bool visible(uint2 texel, float3 normal, float3 dir, inout TraversalStats pixel_stats) {
+  Ray ray = make_ray(world_position(texel) + normal * 1e-6f, dir);
+
+  HitRecord rec;
+  TraversalStats stats;
+
+  bool hit = intersect_scene(ray, rec, stats);
+  pixel_stats = merge_traversal_stats(pixel_stats, stats);
+
+  return !hit;
+}
+
+[numthreads(16, 16, 1)]
+void main( uint3 thread_id : SV_DispatchThreadID )
+{
+  uint2 texel = thread_id.xy;
+  uint state = hash32(texel.y * width + texel.x) ^ hash32(~frame);
+
+  float4 surface = surfaces[texel];
+
+  Reservoir center = unpack_reservoir(temporal_reservoir_buffer[texel.y * width + texel.x]);
+
+  Reservoir r = empty_reservoir();
+  merge_reservoir(r, center, surface.xyz, uniform_random(state));
+
+  uint2 accepted[MAX_SPATIAL_COUNT];
+  float accepted_m[MAX_SPATIAL_COUNT];
+  uint accepted_count = 0;
+
+  TraversalStats stats = empty_traversal_stats();
+
+  // neighbours on a similar surface have sampled a similar integrand, their samples only cost a cosine here
+  for (uint i = 0; i < min(spatial_count, MAX_SPATIAL_COUNT) && surface.w > 0.0f; ++i) {
+    float radius = spatial_radius * sqrt(uniform_random(state));
+    float phi = 2.0f * PI * uniform_random(state);
+
+    int2 neighbour = int2(texel) + int2(round(radius * float2(cos(phi), sin(phi))));
+
+    if (any(neighbour < 0) || any(neighbour >= int2(width, height)) || all(neighbour == int2(texel))) {
+      continue;
+    }
+
+    float4 neighbour_surface = surfaces[neighbour];
+
+    bool same_surface = neighbour_surface.w > 0.0f &&
+                        abs(neighbour_surface.w - surface.w) < DEPTH_TOLERANCE * surface.w &&
+                        dot(neighbour_surface.xyz, surface.xyz) > NORMAL_TOLERANCE;
+
+    if (!same_surface) {
+      continue;
+    }
+
+    Reservoir other = unpack_reservoir(temporal_reservoir_buffer[neighbour.y * width + neighbour.x]);
+    merge_reservoir(r, other, surface.xyz, uniform_random(state));
+
+    accepted[accepted_count] = uint2(neighbour);
+    accepted_m[accepted_count] = other.m;
+    accepted_count++;
+  }
+
+  if (unbiased && r.cosine > 0.0f) {
+    // dividing by every m merged over-counts where a neighbour could never have produced y, because it faces
+    // away or y is blocked from it, which darkens shadow edges. only count the reservoirs that could have
+    float z = center.m;
+
+    for (uint i = 0; i < accepted_count; ++i) {
+      float3 neighbour_normal = surfaces[accepted[i]].xyz;
+
+      if (dot(neighbour_normal, r.y) > 0.0f && visible(accepted[i], neighbour_normal, r.y, stats)) {
+        z += accepted_m[i];
+      }
+    }
+
+    r.contribution = r.wsum / (z * r.cosine);
+  }
+  else {
+    finalize_reservoir(r);
+  }
+
+  if (texel.x < width && texel.y < height) {
+    reservoir_buffer[texel.y * width + texel.x] = pack_reservoir(r);
+
+    if (debug_view != DEBUG_VIEW_NONE) {
+      uint p = texel.y * width + texel.x;
+      traversal_stats[p] = merge_traversal_stats(traversal_stats[p], stats);
+    }
+  }
+}
\ No newline at end of file
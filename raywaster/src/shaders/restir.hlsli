@@ -0,0 +1,82 @@
+// include after common.hlsli
+
+#include "../reservoir_packing.h"
+
+// candidates only need a rough target, a coarse mip keeps their lookups in cache
+#define CANDIDATE_LOD 2.0f
+
+// streaming weighted reservoir, must match restir::Reservoir.
+// the target function is the luminance of the radiance along y times the cosine at the pixel that owns the
+// reservoir. luminance doesn't depend on the pixel, so instead of the contribution weight the reservoir keeps
+// luminance times it, and reuse only needs the cosine rather than another environment lookup.
+// found is set once any candidate behind the reservoir had a positive target, even if it later turned out occluded
+struct Reservoir {
+  float3 y;
+  float cosine;
+  float wsum;
+  float m;
+  float contribution;
+  bool found;
+};
+
+Reservoir empty_reservoir() {
+  Reservoir r;
+  r.y = 0.0f;
+  r.cosine = 0.0f;
+  r.wsum = 0.0f;
+  r.m = 0.0f;
+  r.contribution = 0.0f;
+  r.found = false;
+  return r;
+}
+
+void update_reservoir(inout Reservoir r, float3 x, float cosine, float w, float u) {
+  r.wsum += w;
+  r.m += 1.0f;
+
+  if (w > 0.0f) {
+    r.found = true;
+
+    if (u * r.wsum < w) {
+      r.y = x;
+      r.cosine = cosine;
+    }
+  }
+}
+
+// other was resampled somewhere else, normal is the surface here.
+// it enters as if all of its candidates had been streamed in one by one
+void merge_reservoir(inout Reservoir r, Reservoir other, float3 normal, float u) {
+  float cosine = max(dot(normal, other.y), 0.0f);
+  float w = cosine * other.contribution * other.m;
+
+  r.wsum += w;
+  r.m += other.m;
+  r.found = r.found || other.found;
+
+  if (w > 0.0f && u * r.wsum < w) {
+    r.y = other.y;
+    r.cosine = cosine;
+  }
+}
+
+void finalize_reservoir(inout Reservoir r) {
+  r.contribution = r.cosine > 0.0f ? r.wsum / (r.m * r.cosine) : 0.0f;
+}
+
+PackedReservoir pack_reservoir(Reservoir r) {
+  PackedReservoir p;
+  float2 uv = dir_to_octahedral(r.y);
+  p.dir = pack_unorm2x16(uv.x, uv.y);
+  p.contribution_m = pack_contribution_m(r.contribution, r.found, r.m);
+  return p;
+}
+
+Reservoir unpack_reservoir(PackedReservoir p) {
+  Reservoir r = empty_reservoir();
+  r.y = octahedral_to_dir(float2(unpack_unorm16(p.dir, 16), unpack_unorm16(p.dir, 0)));
+  r.m = unpack_m(p.contribution_m);
+  r.contribution = unpack_contribution(p.contribution_m);
+  r.found = unpack_found(p.contribution_m);
+  return r;
+}
\ No newline at end of file
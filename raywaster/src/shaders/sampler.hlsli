@@ -0,0 +1,61 @@
+// include after common.hlsli, with blue_noise_ranks declared as a BLUE_NOISE_SIZE squared Texture2D<uint> of ranks
+
+// must match sampler::Type
+#define SAMPLER_RANDOM 0
+#define SAMPLER_SOBOL 1
+#define SAMPLER_LATTICE 2
+#define SAMPLER_BLUE_NOISE 3
+
+// one pixel's stream, must match sampler::Sampler. every sample index restarts the dimensions
+struct Sampler {
+  uint type;
+  uint2 pixel;
+  uint seed;
+  uint index;
+  uint dimension;
+  uint state;
+};
+
+Sampler make_sampler(uint type, uint2 pixel, uint seed) {
+  Sampler s;
+  s.type = type;
+  s.pixel = pixel;
+  s.seed = seed;
+  s.index = 0;
+  s.dimension = 0;
+  s.state = 0;
+  return s;
+}
+
+void start_sample(inout Sampler s, uint index) {
+  s.index = index;
+  s.dimension = 0;
+  s.state = s.seed ^ hash32(index);
+}
+
+float next_1d(inout Sampler s) {
+  uint d = s.dimension++;
+
+  switch (s.type) {
+    case SAMPLER_SOBOL:
+      return unit_float(sobol_owen(s.index, d, s.seed));
+
+    case SAMPLER_LATTICE:
+      return unit_float(lattice(s.index, d, s.seed));
+
+    case SAMPLER_BLUE_NOISE: {
+      uint offset = blue_noise_offset(d);
+      uint2 texel = (s.pixel + uint2(offset, offset >> 16)) & (BLUE_NOISE_SIZE - 1);
+      return unit_float(blue_noise(blue_noise_ranks[texel], BLUE_NOISE_RANK_BITS, s.index, d));
+    }
+
+    default:
+      return uniform_random(s.state);
+  }
+}
+
+float2 next_2d(inout Sampler s) {
+  float x = next_1d(s);
+  float y = next_1d(s);
+  return float2(x, y);
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+// l2 spherical harmonics, same ordering and constants as sh.cpp
+
+// coefficients already convolved with the clamped cosine (sh::convolve_cosine), so this is irradiance
+float3 sh_irradiance(float4 coefficients[9], float3 n) {
+  float3 result = coefficients[0].rgb * 0.282095f;
+
+  result += coefficients[1].rgb * (0.488603f * n.y);
+  result += coefficients[2].rgb * (0.488603f * n.z);
+  result += coefficients[3].rgb * (0.488603f * n.x);
+
+  result += coefficients[4].rgb * (1.092548f * n.x * n.y);
+  result += coefficients[5].rgb * (1.092548f * n.y * n.z);
+  result += coefficients[6].rgb * (0.315392f * (3.0f * n.z * n.z - 1.0f));
+  result += coefficients[7].rgb * (1.092548f * n.x * n.z);
+  result += coefficients[8].rgb * (0.546274f * (n.x * n.x - n.y * n.y));
+
+  return max(result, 0.0f);
+}
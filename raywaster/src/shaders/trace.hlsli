@@ -0,0 +1,154 @@
+// include after bvh.hlsli, with positions, normals, tex_coords, position_bounds, indices, bvh and index_width declared
+
+#include "mesh.hlsli"
+#include "../traversal_stats.h"
+
+#define MAX_BVH_DEPTH 32
+
+struct Ray {
+  float3 o;
+  float3 d;
+  float3 inv_d;
+
+  float3 at(float t) {
+    return o + d * t;
+  }
+};
+
+struct HitRecord {
+  float3 p;
+  float3 n;
+  float t;
+  float2 uv;
+};
+
+uint load_index(uint i) {
+  if (index_width == 2) {
+    uint pair = indices.Load((i * 2) & ~3);
+    return (i & 1) ? pair >> 16 : pair & 0xffff;
+  }
+
+  return indices.Load(i * 4);
+}
+
+// Yoinked from
+//https://stackoverflow.com/questions/42740765/intersection-between-line-and-triangle-in-3d/42752998#42752998
+bool intersect_triangle(Ray r, float tmin, float tmax, uint tri_idx, uint base_vertex, out HitRecord rec) { 
+  uint i0 = base_vertex + load_index(tri_idx*3+0);
+  uint i1 = base_vertex + load_index(tri_idx*3+2);
+  uint i2 = base_vertex + load_index(tri_idx*3+1);
+
+  float3 p0 = load_position(i0);
+
+  float3 E1 = load_position(i1)-p0;
+  float3 E2 = load_position(i2)-p0;
+  float3 N = cross(E1,E2);
+  float det = -dot(r.d, N);
+  float invdet = 1.0f/det;
+  float3 AO  = r.o - p0;
+  float3 DAO = cross(AO, r.d);
+   
+  float t = dot(AO,N)  * invdet; 
+  float u =  dot(E2,DAO) * invdet;
+  float v = -dot(E1,DAO) * invdet;
+
+  float w = 1.0f-u-v;
+
+  rec.p = r.at(t);
+  rec.n = normalize(w * load_normal(i0) + u * load_normal(i1) + v * load_normal(i2));
+  rec.uv = w * load_tex_coord(i0) + u * load_tex_coord(i1) + v * load_tex_coord(i2);
+  rec.t = t;
+
+  return (det >= 1e-6 && t > tmin && t < tmax && u >= 0.0f && v >= 0.0f && (u+v) <= 1.0f);
+}
+
+float ray_aabb_dst(Ray ray, float3 boxMin, float3 boxMax)
+{
+  float3 tMin = (boxMin - ray.o) * ray.inv_d;
+  float3 tMax = (boxMax - ray.o) * ray.inv_d;
+  float3 t1 = min(tMin, tMax);
+  float3 t2 = max(tMin, tMax);
+  float tNear = max(max(t1.x, t1.y), t1.z);
+  float tFar = min(min(t2.x, t2.y), t2.z);
+
+  bool hit = tFar >= tNear && tFar > 0;
+  float dst = hit ? tNear > 0 ? tNear : 0 : 1.#INF;
+
+  return dst;
+};
+
+bool intersect_scene(Ray ray, out HitRecord rec, out TraversalStats stats) {
+  uint bvh_count, bvh_stride;
+  bvh.GetDimensions(bvh_count, bvh_stride);
+
+  int stack_count = 0;
+  uint stack[MAX_BVH_DEPTH];
+
+  stack[stack_count++] = bvh_count-1;
+
+  float closest = 100000.0f;
+  bool hit = false;
+
+  stats = empty_traversal_stats();
+  stats.ray_count = 1;
+  stats.stack_depth = 1;
+
+  while (stack_count) {
+    BVHNode node = bvh[stack[--stack_count]];
+    stats.node_visits++;
+
+    if (node.children[0] >> 31) {
+      stats.triangle_tests++;
+
+      HitRecord temp;
+      if (intersect_triangle(ray, 0.0, closest, node.children[0] & ~(1 << 31), node.children[1], temp)) {
+        closest = temp.t;
+        rec = temp;
+        hit = true;
+      }
+    }
+    else{
+      float dists[2];
+      bool hits[2];
+
+      for (int i = 0; i < 2; ++i) {
+        dists[i] = ray_aabb_dst(ray, bvh[node.children[i]].min, bvh[node.children[i]].max);
+        hits[i] = dists[i] < closest;
+      }
+
+      uint closer_child = dists[0] < dists[1] ? 0 : 1;
+      uint further_child = (closer_child + 1) % 2;
+
+      if (hits[further_child] && stack_count < MAX_BVH_DEPTH) {
+        stack[stack_count++] = node.children[further_child];
+      }
+
+      if (hits[closer_child] && stack_count < MAX_BVH_DEPTH) {
+        stack[stack_count++] = node.children[closer_child];
+      }
+
+      stats.stack_depth = max(stats.stack_depth, (uint)stack_count);
+    }
+  }
+
+  return hit;
+}
+
+// adds one pixel's stats to the frame's TraversalAggregate
+void record_traversal(RWByteAddressBuffer aggregate, TraversalStats stats) {
+  aggregate.InterlockedAdd(0, 1);
+
+  for (uint i = 0; i < TRAVERSAL_COUNTERS; ++i) {
+    uint value = traversal_counter(stats, i);
+    aggregate.InterlockedAdd(4 + i * 4, value);
+    aggregate.InterlockedAdd(4 + TRAVERSAL_COUNTERS * 4 + (i * TRAVERSAL_HISTOGRAM_BUCKETS + traversal_bucket(value, i)) * 4, 1);
+  }
+}
+
+Ray make_ray(float3 o, float3 d) {
+  Ray ray;
+  ray.o = o;
+  ray.d = d;
+  ray.inv_d = 1.0f / ray.d;
+  return ray;
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include "../upsample_weights.h"
+
+// joint bilateral upsampling of lighting rendered at mip lod of the guides, the 2x2 texels a bilinear
+// lookup would blend are weighted by how well their depth and normal match the pixel's
+float3 upsample_lighting(Texture2D<float3> lighting, Texture2D<float> depth, Texture2D normals, uint2 pixel, uint lod) {
+  uint2 low_size;
+  lighting.GetDimensions(low_size.x, low_size.y);
+
+  float pixel_depth = depth.Load(int3(pixel, 0));
+  float3 pixel_normal = normalize(normals.Load(int3(pixel, 0)).xyz * 2.0f - 1.0f);
+
+  float2 coord = float2(upsample_coordinate(pixel.x, lod), upsample_coordinate(pixel.y, lod));
+  int2 base = int2(floor(coord));
+  float2 f = coord - float2(base);
+
+  float3 sum = 0.0f;
+  float wsum = 0.0f;
+
+  float3 closest = 0.0f;
+  float closest_difference = 1e30f;
+
+  for (uint i = 0; i < 4; ++i) {
+    int2 offset = int2(i & 1, i >> 1);
+    int2 t = clamp(base + offset, int2(0, 0), int2(low_size) - 1);
+
+    float low_depth = depth.Load(int3(t, lod));
+    float3 low_normal = normalize(normals.Load(int3(t, lod)).xyz * 2.0f - 1.0f);
+    float3 c = lighting.Load(int3(t, 0));
+
+    float bilinear = (offset.x ? f.x : 1.0f - f.x) * (offset.y ? f.y : 1.0f - f.y);
+    float w = upsample_weight(bilinear, pixel_depth, low_depth, dot(pixel_normal, low_normal));
+
+    sum += c * w;
+    wsum += w;
+
+    float difference = relative_depth_difference(pixel_depth, low_depth);
+
+    if (difference < closest_difference) {
+      closest_difference = difference;
+      closest = c;
+    }
+  }
+
+  return wsum > UPSAMPLE_MIN_WEIGHT ? sum / wsum : closest;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include <cmath>
+
+#include "tonemap.h"
+
+using namespace DirectX::PackedVector;
+
+namespace tonemap {
+  PackedColor pack(FXMVECTOR color) {
+    PackedColor packed;
+    XMStoreFloat3PK(&packed, XMVectorMax(color, XMVectorZero()));
+    return packed;
+  }
+
+  XMVECTOR unpack(PackedColor color) {
+    return XMLoadFloat3PK(&color);
+  }
+
+  XMVECTOR aces_film(FXMVECTOR x) {
+    float a = 2.51f;
+    float b = 0.03f;
+    float c = 2.43f;
+    float d = 0.59f;
+    float e = 0.14f;
+    return XMVectorSaturate((x * (a * x + XMVectorReplicate(b))) / (x * (c * x + XMVectorReplicate(d)) + XMVectorReplicate(e)));
+  }
+
+  XMVECTOR tonemap(FXMVECTOR color) {
+    return XMVectorSqrt(aces_film(color));
+  }
+
+  uint32_t to_rgba8(FXMVECTOR display) {
+    XMFLOAT3 c;
+    XMStoreFloat3(&c, XMVectorSaturate(display));
+
+    uint32_t r = (uint32_t)std::lround(c.x * 255.0f);
+    uint32_t g = (uint32_t)std::lround(c.y * 255.0f);
+    uint32_t b = (uint32_t)std::lround(c.z * 255.0f);
+
+    return r | (g << 8) | (b << 16) | (0xffu << 24);
+  }
+};
\ No newline at end of file
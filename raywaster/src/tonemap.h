@@ -0,0 +1,28 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+#include <stdint.h>
+
+using namespace DirectX;
+
+// the lighting buffer's storage and the display transform combine_ps applies at the very end
+namespace tonemap {
+  // DXGI_FORMAT_R11G11B10_FLOAT, the same 4 bytes a texel as the old unorm buffer but linear and unbounded.
+  // rgb9e5 would be as small, but d3d11 can't write it from a compute shader
+  using PackedColor = PackedVector::XMFLOAT3PK;
+
+  // negative values clamp to zero like the gpu's conversion
+  PackedColor pack(FXMVECTOR color);
+  XMVECTOR unpack(PackedColor color);
+
+  // same as ACESFilm in common.hlsli
+  XMVECTOR aces_film(FXMVECTOR x);
+
+  // linear radiance to the display value combine_ps writes, sqrt stands in for the srgb curve
+  XMVECTOR tonemap(FXMVECTOR color);
+
+  // the swapchain's R8G8B8A8_UNORM layout, alpha is 255
+  uint32_t to_rgba8(FXMVECTOR display);
+};
\ No newline at end of file
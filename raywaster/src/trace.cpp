@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+
+#include "trace.h"
+#include "parallel.h"
+#include "tonemap.h"
+
+namespace trace {
+  static constexpr uint32_t LEAF_BIT = 1u << 31;
+
+  struct Ray {
+    XMVECTOR o;
+    XMVECTOR d;
+    XMVECTOR inv_d;
+  };
+
+  // same winding and culling as intersect_triangle in trace.hlsli
+  static bool intersect_triangle(const Mesh& mesh, const Ray& r, float tmin, float tmax, uint32_t tri_idx, uint32_t base_vertex, Hit* hit) {
+    uint32_t i0 = base_vertex + mesh.indices[tri_idx*3+0];
+    uint32_t i1 = base_vertex + mesh.indices[tri_idx*3+2];
+    uint32_t i2 = base_vertex + mesh.indices[tri_idx*3+1];
+
+    XMVECTOR p0 = XMLoadFloat3(&mesh.positions[i0]);
+
+    XMVECTOR e1 = XMLoadFloat3(&mesh.positions[i1]) - p0;
+    XMVECTOR e2 = XMLoadFloat3(&mesh.positions[i2]) - p0;
+    XMVECTOR n = XMVector3Cross(e1, e2);
+    float det = -XMVectorGetX(XMVector3Dot(r.d, n));
+    float invdet = 1.0f / det;
+    XMVECTOR ao = r.o - p0;
+    XMVECTOR dao = XMVector3Cross(ao, r.d);
+
+    float t = XMVectorGetX(XMVector3Dot(ao, n)) * invdet;
+    float u = XMVectorGetX(XMVector3Dot(e2, dao)) * invdet;
+    float v = -XMVectorGetX(XMVector3Dot(e1, dao)) * invdet;
+
+    if (!(det >= 1e-6f && t > tmin && t < tmax && u >= 0.0f && v >= 0.0f && (u+v) <= 1.0f)) {
+      return false;
+    }
+
+    if (hit) {
+      float w = 1.0f - u - v;
+
+      XMVECTOR normal = w * XMLoadFloat3(&mesh.normals[i0]) + u * XMLoadFloat3(&mesh.normals[i1]) + v * XMLoadFloat3(&mesh.normals[i2]);
+      XMVECTOR uv = w * XMLoadFloat2(&mesh.tex_coords[i0]) + u * XMLoadFloat2(&mesh.tex_coords[i1]) + v * XMLoadFloat2(&mesh.tex_coords[i2]);
+
+      XMStoreFloat3(&hit->position, r.o + r.d * t);
+      XMStoreFloat3(&hit->normal, XMVector3Normalize(normal));
+      XMStoreFloat2(&hit->uv, uv);
+      hit->t = t;
+    }
+
+    return true;
+  }
+
+  static float ray_aabb_dst(const Ray& ray, const bvh::Node& node) {
+    XMVECTOR t_min = (XMLoadFloat3(&node.min) - ray.o) * ray.inv_d;
+    XMVECTOR t_max = (XMLoadFloat3(&node.max) - ray.o) * ray.inv_d;
+    XMVECTOR t1 = XMVectorMin(t_min, t_max);
+    XMVECTOR t2 = XMVectorMax(t_min, t_max);
+
+    float t_near = std::max(std::max(XMVectorGetX(t1), XMVectorGetY(t1)), XMVectorGetZ(t1));
+    float t_far = std::min(std::min(XMVectorGetX(t2), XMVectorGetY(t2)), XMVectorGetZ(t2));
+
+    bool hit = t_far >= t_near && t_far > 0.0f;
+    return hit ? std::max(t_near, 0.0f) : INFINITY;
+  }
+
+  // closer child is visited first, a full stack drops the subtree like the shader does
+  static bool traverse(const Scene& scene, FXMVECTOR origin, FXMVECTOR dir, bool any, Hit* hit, TraversalStats* stats) {
+    const std::vector<bvh::Node>& nodes = *scene.bvh;
+
+    Ray ray = {
+      .o = origin,
+      .d = dir,
+      .inv_d = XMVectorReciprocal(dir),
+    };
+
+    uint32_t stack[MAX_BVH_DEPTH];
+    uint32_t stack_count = 0;
+
+    stack[stack_count++] = (uint32_t)nodes.size() - 1;
+
+    float closest = MAX_DISTANCE;
+    bool found = false;
+
+    TraversalStats counted = empty_traversal_stats();
+    counted.ray_count = 1;
+    counted.stack_depth = 1;
+
+    while (stack_count) {
+      const bvh::Node& node = nodes[stack[--stack_count]];
+      counted.node_visits++;
+
+      if (node.left & LEAF_BIT) {
+        counted.triangle_tests++;
+
+        Hit temp;
+
+        if (intersect_triangle(*scene.mesh, ray, 0.0f, closest, node.left & ~LEAF_BIT, node.right, &temp)) {
+          if (any) {
+            found = true;
+            break;
+          }
+
+          closest = temp.t;
+          *hit = temp;
+          found = true;
+        }
+      }
+      else {
+        uint32_t children[2] = { node.left, node.right };
+        float dists[2];
+        bool hits[2];
+
+        for (int i = 0; i < 2; ++i) {
+          dists[i] = ray_aabb_dst(ray, nodes[children[i]]);
+          hits[i] = dists[i] < closest;
+        }
+
+        uint32_t closer_child = dists[0] < dists[1] ? 0 : 1;
+        uint32_t further_child = 1 - closer_child;
+
+        if (hits[further_child] && stack_count < MAX_BVH_DEPTH) {
+          stack[stack_count++] = children[further_child];
+        }
+
+        if (hits[closer_child] && stack_count < MAX_BVH_DEPTH) {
+          stack[stack_count++] = children[closer_child];
+        }
+
+        counted.stack_depth = std::max(counted.stack_depth, stack_count);
+      }
+    }
+
+    if (stats) {
+      *stats = counted;
+    }
+
+    return found;
+  }
+
+  bool intersect(const Scene& scene, FXMVECTOR origin, FXMVECTOR dir, Hit* hit, TraversalStats* stats) {
+    return traverse(scene, origin, dir, false, hit, stats);
+  }
+
+  bool occluded(const Scene& scene, FXMVECTOR origin, FXMVECTOR dir, TraversalStats* stats) {
+    return traverse(scene, origin, dir, true, nullptr, stats);
+  }
+
+  void record(TraversalAggregate& aggregate, TraversalStats stats) {
+    aggregate.pixel_count++;
+
+    for (uint32_t i = 0; i < TRAVERSAL_COUNTERS; ++i) {
+      uint32_t value = traversal_counter(stats, i);
+      aggregate.sums[i] += value;
+      aggregate.histograms[i * TRAVERSAL_HISTOGRAM_BUCKETS + traversal_bucket(value, i)]++;
+    }
+  }
+
+  TraversalSummary summarize(const TraversalAggregate& aggregate) {
+    TraversalSummary summary = {
+      .pixel_count = aggregate.pixel_count,
+    };
+
+    if (aggregate.pixel_count == 0) {
+      return summary;
+    }
+
+    for (uint32_t i = 0; i < TRAVERSAL_COUNTERS; ++i) {
+      summary.mean[i] = (float)aggregate.sums[i] / (float)aggregate.pixel_count;
+
+      const uint32_t* histogram = aggregate.histograms + i * TRAVERSAL_HISTOGRAM_BUCKETS;
+      uint64_t threshold = ((uint64_t)aggregate.pixel_count * 99 + 99) / 100;
+      uint64_t seen = 0;
+
+      for (uint32_t b = 0; b < TRAVERSAL_HISTOGRAM_BUCKETS; ++b) {
+        seen += histogram[b];
+
+        if (seen >= threshold) {
+          summary.p99[i] = (b + 1) * traversal_bucket_width(i) - 1;
+          break;
+        }
+      }
+    }
+
+    return summary;
+  }
+
+  XMVECTOR heatmap(float t) {
+    XMVECTOR offsets = XMVectorSet(3.0f, 2.0f, 1.0f, 0.0f);
+    return XMVectorSaturate(XMVectorReplicate(1.5f) - XMVectorAbs(XMVectorReplicate(4.0f * t) - offsets));
+  }
+
+  void render_heatmap(const TraversalStats* stats, uint32_t width, uint32_t height, uint32_t counter, uint32_t* rgba8) {
+    parallel::for_range(height, 16, [&](size_t begin, size_t end) {
+      for (size_t i = begin * width; i < end * width; ++i) {
+        rgba8[i] = tonemap::to_rgba8(heatmap(traversal_heat(stats[i], counter)));
+      }
+    });
+  }
+};
\ No newline at end of file
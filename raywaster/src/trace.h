@@ -0,0 +1,55 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include <vector>
+
+#include "model.h"
+#include "bvh.h"
+#include "traversal_stats.h"
+
+using namespace DirectX;
+
+// cpu reference for trace.hlsli, the same traversal order, triangle test and culling
+namespace trace {
+  // must match trace.hlsli
+  static constexpr uint32_t MAX_BVH_DEPTH = 32;
+  static constexpr float MAX_DISTANCE = 100000.0f;
+
+  // the combined world space mesh and its bvh, as uploaded
+  struct Scene {
+    const Mesh* mesh;
+    const std::vector<bvh::Node>* bvh;
+  };
+
+  struct Hit {
+    XMFLOAT3 position;
+    XMFLOAT3 normal;
+    XMFLOAT2 uv;
+    float t;
+  };
+
+  // mean and 99th percentile of each counter per pixel, the percentile is the top of its histogram bucket
+  struct TraversalSummary {
+    uint32_t pixel_count;
+    float mean[TRAVERSAL_COUNTERS];
+    uint32_t p99[TRAVERSAL_COUNTERS];
+  };
+
+  // closest front facing hit, dir doesn't need to be normalized but t is in its units.
+  // stats is optional and gets this one ray's counters, the same way intersect_scene counts them
+  bool intersect(const Scene& scene, FXMVECTOR origin, FXMVECTOR dir, Hit* hit, TraversalStats* stats = nullptr);
+
+  // stops at the first hit
+  bool occluded(const Scene& scene, FXMVECTOR origin, FXMVECTOR dir, TraversalStats* stats = nullptr);
+
+  // same as record_traversal in trace.hlsli, stats are a pixel's over the whole frame
+  void record(TraversalAggregate& aggregate, TraversalStats stats);
+  TraversalSummary summarize(const TraversalAggregate& aggregate);
+
+  // same as heatmap in common.hlsli
+  XMVECTOR heatmap(float t);
+
+  // one of the counters as R8G8B8A8_UNORM, like combine_ps shows it
+  void render_heatmap(const TraversalStats* stats, uint32_t width, uint32_t height, uint32_t counter, uint32_t* rgba8);
+};
\ No newline at end of file
@@ -0,0 +1,79 @@
+// per ray traversal counters and the per frame aggregate they're summed into, included by both trace.h and
+// trace.hlsli
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+#include "hlsl_compat.h"
+
+SHARED_NAMESPACE_BEGIN(trace)
+
+// rays, node visits, triangle tests and stack depth, in that order wherever the counters are indexed
+#define TRAVERSAL_COUNTERS 4
+#define TRAVERSAL_HISTOGRAM_BUCKETS 64
+
+// must match DebugView in main.cpp
+#define DEBUG_VIEW_NONE 0
+#define DEBUG_VIEW_RAY_COUNT 1
+#define DEBUG_VIEW_NODE_VISITS 2
+#define DEBUG_VIEW_TRIANGLE_TESTS 3
+#define DEBUG_VIEW_STACK_DEPTH 4
+
+// what one ray cost, or summed over every ray a pixel traced in a frame across the reservoir, indirect and
+// lighting passes
+struct TraversalStats {
+  uint ray_count;
+  uint node_visits;    // interior nodes and leaves popped off the stack
+  uint triangle_tests;
+  uint stack_depth;    // deepest the stack got
+};
+
+// the gpu's aggregate buffer is this struct as raw uints, updated with atomics at each field's byte offset.
+// one entry per lighting pixel with a surface. sums wrap past 2^32, which takes millions of pixels at
+// thousands of visits each
+struct TraversalAggregate {
+  uint pixel_count;
+  uint sums[TRAVERSAL_COUNTERS];
+  uint histograms[TRAVERSAL_COUNTERS * TRAVERSAL_HISTOGRAM_BUCKETS];
+};
+
+SHARED_FN TraversalStats empty_traversal_stats() {
+  TraversalStats stats;
+  stats.ray_count = 0;
+  stats.node_visits = 0;
+  stats.triangle_tests = 0;
+  stats.stack_depth = 0;
+  return stats;
+}
+
+// counts add up, the stack depth is the deepest of either
+SHARED_FN TraversalStats merge_traversal_stats(TraversalStats a, TraversalStats b) {
+  TraversalStats stats;
+  stats.ray_count = a.ray_count + b.ray_count;
+  stats.node_visits = a.node_visits + b.node_visits;
+  stats.triangle_tests = a.triangle_tests + b.triangle_tests;
+  stats.stack_depth = max(a.stack_depth, b.stack_depth);
+  return stats;
+}
+
+SHARED_FN uint traversal_counter(TraversalStats stats, uint counter) {
+  return counter == 0 ? stats.ray_count : counter == 1 ? stats.node_visits : counter == 2 ? stats.triangle_tests : stats.stack_depth;
+}
+
+// histogram buckets are 1 ray, 32 visits, 8 triangle tests and 1 level of stack wide, so each spans the range
+// a pixel's frame usually falls in and the last bucket collects everything above
+SHARED_FN uint traversal_bucket_width(uint counter) {
+  return counter == 0 ? 1 : counter == 1 ? 32 : counter == 2 ? 8 : 1;
+}
+
+SHARED_FN uint traversal_bucket(uint value, uint counter) {
+  return min(value / traversal_bucket_width(counter), (uint)(TRAVERSAL_HISTOGRAM_BUCKETS - 1));
+}
+
+// where the heatmap saturates, the top of the histogram's range
+SHARED_FN float traversal_heat(TraversalStats stats, uint counter) {
+  return min(float(traversal_counter(stats, counter)) / float(traversal_bucket_width(counter) * TRAVERSAL_HISTOGRAM_BUCKETS), 1.0f);
+}
+
+SHARED_NAMESPACE_END
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <cmath>
+
+#include "upsample.h"
+#include "parallel.h"
+
+namespace upsample {
+  void downsample_guide(Guide full, uint32_t lod, float* depth, XMFLOAT3* normals) {
+    uint32_t width = full.width >> lod;
+    uint32_t height = full.height >> lod;
+    uint32_t size = 1u << lod;
+    float area = (float)(size * size);
+
+    parallel::for_range(height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < width; ++x) {
+          float d = 0.0f;
+          XMVECTOR n = XMVectorZero();
+
+          for (uint32_t dy = 0; dy < size; ++dy) {
+            for (uint32_t dx = 0; dx < size; ++dx) {
+              size_t j = ((size_t)y * size + dy) * full.width + (size_t)x * size + dx;
+              d += full.depth[j];
+              n += XMLoadFloat3(&full.normals[j]);
+            }
+          }
+
+          size_t i = y * width + x;
+          depth[i] = d / area;
+          XMStoreFloat3(&normals[i], n / area);
+        }
+      }
+    });
+  }
+
+  void upsample_lighting(const tonemap::PackedColor* lighting, Guide low, Guide full, uint32_t lod, XMFLOAT3* output) {
+    parallel::for_range(full.height, 4, [&](size_t begin, size_t end) {
+      for (size_t y = begin; y < end; ++y) {
+        for (uint32_t x = 0; x < full.width; ++x) {
+          size_t i = y * full.width + x;
+
+          float pixel_depth = full.depth[i];
+          XMVECTOR pixel_normal = XMVector3Normalize(XMLoadFloat3(&full.normals[i]));
+
+          float cx = upsample_coordinate(x, lod);
+          float cy = upsample_coordinate((uint32_t)y, lod);
+          int32_t bx = (int32_t)std::floor(cx);
+          int32_t by = (int32_t)std::floor(cy);
+          float fx = cx - (float)bx;
+          float fy = cy - (float)by;
+
+          XMVECTOR sum = XMVectorZero();
+          float wsum = 0.0f;
+
+          XMVECTOR closest = XMVectorZero();
+          float closest_difference = 1e30f;
+
+          for (uint32_t k = 0; k < 4; ++k) {
+            int32_t ox = k & 1;
+            int32_t oy = k >> 1;
+            int32_t tx = std::clamp(bx + ox, 0, (int32_t)low.width - 1);
+            int32_t ty = std::clamp(by + oy, 0, (int32_t)low.height - 1);
+            size_t j = (size_t)ty * low.width + tx;
+
+            XMVECTOR low_normal = XMVector3Normalize(XMLoadFloat3(&low.normals[j]));
+            XMVECTOR c = tonemap::unpack(lighting[j]);
+
+            float bilinear = (ox ? fx : 1.0f - fx) * (oy ? fy : 1.0f - fy);
+            float w = upsample_weight(bilinear, pixel_depth, low.depth[j], XMVectorGetX(XMVector3Dot(pixel_normal, low_normal)));
+
+            sum += c * w;
+            wsum += w;
+
+            float difference = relative_depth_difference(pixel_depth, low.depth[j]);
+
+            if (difference < closest_difference) {
+              closest_difference = difference;
+              closest = c;
+            }
+          }
+
+          XMStoreFloat3(&output[i], wsum > UPSAMPLE_MIN_WEIGHT ? sum / wsum : closest);
+        }
+      }
+    });
+  }
+};
\ No newline at end of file
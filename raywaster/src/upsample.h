@@ -0,0 +1,27 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+#include "upsample_weights.h"
+#include "tonemap.h"
+
+using namespace DirectX;
+
+// cpu reference for upsample.hlsli
+namespace upsample {
+  // depth is linear view depth or device depth, zero where nothing was hit. normals are unit length, or
+  // averages of unit normals at coarser levels
+  struct Guide {
+    uint32_t width, height;
+    const float* depth;
+    const XMFLOAT3* normals;
+  };
+
+  // box filters the guide down by 2^lod on each axis like GenerateMips does for even sizes,
+  // depth and normals need room for (width >> lod) * (height >> lod) values
+  void downsample_guide(Guide full, uint32_t lod, float* depth, XMFLOAT3* normals);
+
+  // lighting is low.width * low.height in the lighting buffer's format, rendered for the guide at full >> lod.
+  // lod 1 and 2 are the half and quarter resolutions the renderer uses, but any works
+  void upsample_lighting(const tonemap::PackedColor* lighting, Guide low, Guide full, uint32_t lod, XMFLOAT3* output);
+};
\ No newline at end of file
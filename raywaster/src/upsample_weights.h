@@ -0,0 +1,39 @@
+// joint bilateral weights for bringing the lighting up to full resolution, included by both upsample.h and
+// upsample.hlsli
+
+#ifdef __cplusplus
+#pragma once
+#endif
+
+#include "hlsl_compat.h"
+
+SHARED_NAMESPACE_BEGIN(upsample)
+
+// a tap loses most of its weight once its depth is this far off relative to the pixel's
+#define UPSAMPLE_DEPTH_SIGMA 0.05f
+#define UPSAMPLE_NORMAL_POWER 8.0f
+
+// below this total every tap is on another surface, and the closest one in depth is used instead
+#define UPSAMPLE_MIN_WEIGHT 1e-4f
+
+// works the same on linear view depth and reversed z device depth, which is proportional to its reciprocal
+SHARED_FN float relative_depth_difference(float a, float b) {
+  return abs(a - b) / max(max(a, b), 1e-20f);
+}
+
+// texel t at lod covers full resolution pixels [t << lod, (t+1) << lod), this is where a full resolution pixel's
+// center falls in texels of that lod, offset so the bilinear footprint starts at its floor
+SHARED_FN float upsample_coordinate(uint pixel, uint lod) {
+  return (float(pixel) + 0.5f) / float(1u << lod) - 0.5f;
+}
+
+SHARED_FN float upsample_weight(float bilinear, float depth, float low_depth, float cosine) {
+  if (low_depth <= 0.0f) {
+    return 0.0f; // nothing there, the lighting is black
+  }
+
+  float d = relative_depth_difference(depth, low_depth) / UPSAMPLE_DEPTH_SIGMA;
+  return bilinear * pow(max(cosine, 0.0f), UPSAMPLE_NORMAL_POWER) * exp(-d * d);
+}
+
+SHARED_NAMESPACE_END
\ No newline at end of file